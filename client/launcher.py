@@ -37,15 +37,29 @@ class ClientManager:
         self.message_queue = []
         self.message_queue_lock = threading.Lock()
         self._callback_ref = None
-        self._poll_thread = None
+        self._disconnect_callback_ref = None
         self._stop_event = threading.Event()
+
+        # Server messages are pushed into the page by a single thread, as many per evaluate_js as have piled up.
+        # Every message is queued as [seq, json] so the page can merge the attach() backlog with early pushes in
+        # order and drop repeats; a pushed batch stays at the head of the queue until evaluate_js confirms it.
+        self.window = None
+        self._attached = False
+        self._attach_count = 0
+        self._next_seq = 0
+        self._push_event = threading.Event()
+        self._push_thread = None
+        self._user_disconnect = False
         
         self.default_host = os.environ.get('XIANGQI_HOST', '127.0.0.1')
         self.default_port = int(os.environ.get('XIANGQI_PORT', '8080'))
+        # Requests awaiting a response at once; the rest wait in the C library, in order (0 = no limit)
+        self.request_window = int(os.environ.get('XIANGQI_REQUEST_WINDOW', '16'))
         self._lib_path = Path(__file__).parent / "lib" / "libclient.so"
         
         self.reconnect_timeout = 300
         self.reconnect_interval = 5
+        self.push_batch_max = 256
         self._reconnect_thread = None
         self._reconnect_active = False
         self._reconnect_start_time = None
@@ -88,44 +102,98 @@ class ClientManager:
         lib.client_is_connected.argtypes = []
         lib.client_is_connected.restype = ctypes.c_bool
         
-        lib.client_process_messages.argtypes = []
-        lib.client_process_messages.restype = ctypes.c_int
+        lib.client_send_batch.argtypes = [ctypes.POINTER(ctypes.c_char_p), ctypes.POINTER(ctypes.c_int), ctypes.c_int]
+        lib.client_send_batch.restype = ctypes.c_int
+        
+        lib.client_set_window.argtypes = [ctypes.c_int]
+        lib.client_set_window.restype = None
+        
+        lib.client_cancel_request.argtypes = [ctypes.c_int]
+        lib.client_cancel_request.restype = None
         
         self._callback_type = ctypes.CFUNCTYPE(None, ctypes.c_char_p)
         lib.client_set_message_callback.argtypes = [self._callback_type]
         lib.client_set_message_callback.restype = None
+        
+        self._disconnect_callback_type = ctypes.CFUNCTYPE(None)
+        lib.client_set_disconnect_callback.argtypes = [self._disconnect_callback_type]
+        lib.client_set_disconnect_callback.restype = None
+        
+        # Both run on the library's network thread; the references keep the thunks alive
+        self._callback_ref = self._callback_type(self._message_handler)
+        lib.client_set_message_callback(self._callback_ref)
+        self._disconnect_callback_ref = self._disconnect_callback_type(self._disconnect_handler)
+        lib.client_set_disconnect_callback(self._disconnect_callback_ref)
+        lib.client_set_window(self.request_window)
     
     def _message_handler(self, json_str):
         try:
-            message = json_str.decode('utf-8')
-            with self.message_queue_lock:
-                self.message_queue.append(message)
+            self._enqueue(json_str.decode('utf-8'))
         except Exception as e:
             print(f"Error in message handler: {e}")
     
-    def _poll_loop(self):
-        if not self.client_lib:
+    def _disconnect_handler(self):
+        if self._user_disconnect or self._reconnect_active:
             return
-        
-        callback_func = self._callback_type(self._message_handler)
-        self.client_lib.client_set_message_callback(callback_func)
-        self._callback_ref = callback_func
-        
-        was_connected = False
+        print("[ClientManager] Connection lost! Starting auto-reconnect...")
+        self.connected = False
+        self._start_reconnect()
+    
+    def _enqueue(self, message):
+        with self.message_queue_lock:
+            self._next_seq += 1
+            self.message_queue.append([self._next_seq, message])
+        self._push_event.set()
+    
+    def attach(self, window) -> list:
+        """A page registered window.__xqReceive: hand it the backlog, then push everything after it"""
+        with self.message_queue_lock:
+            self.window = window
+            self._attached = True
+            self._attach_count += 1
+            # Includes a batch still in flight; the page drops whichever copy arrives second
+            backlog = self.message_queue
+            self.message_queue = []
+        self._start_push_thread()
+        return backlog
+    
+    def _start_push_thread(self):
+        if self._push_thread is None or not self._push_thread.is_alive():
+            self._push_thread = threading.Thread(target=self._push_loop, daemon=True, name="ClientPushThread")
+            self._push_thread.start()
+    
+    def _push_loop(self):
         while not self._stop_event.is_set():
-            if self.client_lib:
-                is_connected = self.client_lib.client_is_connected()
-                
-                if is_connected:
-                    was_connected = True
-                    self.client_lib.client_process_messages()
-                elif was_connected and not self._reconnect_active:
-                    print("[ClientManager] Connection lost! Starting auto-reconnect...")
-                    self.connected = False
-                    was_connected = False
-                    self._start_reconnect()
-                    
-            self._stop_event.wait(0.01)
+            self._push_event.wait()
+            self._push_event.clear()
+            
+            with self.message_queue_lock:
+                if not self._attached or not self.message_queue or self.window is None:
+                    continue
+                batch = self.message_queue[:self.push_batch_max]
+                window = self.window
+                attach_count = self._attach_count
+            
+            script = f"window.__xqReceive ? window.__xqReceive({json.dumps(batch)}) === true : false"
+            try:
+                delivered = window.evaluate_js(script)
+            except Exception as e:
+                print(f"[ClientManager] Push failed: {e}")
+                delivered = False
+            
+            last_seq = batch[-1][0]
+            with self.message_queue_lock:
+                if delivered is True:
+                    # attach() may have taken the queue meanwhile, so drop by seq rather than by position
+                    done = 0
+                    while done < len(self.message_queue) and self.message_queue[done][0] <= last_seq:
+                        done += 1
+                    del self.message_queue[:done]
+                elif attach_count == self._attach_count:
+                    # No page listening (it is navigating away): the batch waits at the head for the next attach
+                    self._attached = False
+                if self._attached and self.message_queue:
+                    self._push_event.set()
     
     def _start_reconnect(self):
         """Start the auto-reconnect process"""
@@ -135,11 +203,10 @@ class ClientManager:
         self._reconnect_active = True
         self._reconnect_start_time = time.time()
         
-        with self.message_queue_lock:
-            self.message_queue.append(json.dumps({
-                "type": "connection_status",
-                "payload": {"status": "reconnecting", "timeout": self.reconnect_timeout}
-            }))
+        self._enqueue(json.dumps({
+            "type": "connection_status",
+            "payload": {"status": "reconnecting", "timeout": self.reconnect_timeout}
+        }))
         
         self._reconnect_thread = threading.Thread(
             target=self._reconnect_loop, daemon=True, name="ReconnectThread"
@@ -158,22 +225,20 @@ class ClientManager:
             if elapsed >= self.reconnect_timeout:
                 print(f"[Reconnect] Timeout after {self.reconnect_timeout}s")
                 self._reconnect_active = False
-                with self.message_queue_lock:
-                    self.message_queue.append(json.dumps({
-                        "type": "connection_status",
-                        "payload": {"status": "reconnect_failed", "reason": "timeout"}
-                    }))
+                self._enqueue(json.dumps({
+                    "type": "connection_status",
+                    "payload": {"status": "reconnect_failed", "reason": "timeout"}
+                }))
                 return
             
             attempt += 1
             remaining = int(self.reconnect_timeout - elapsed)
             print(f"[Reconnect] Attempt {attempt}, {remaining}s remaining...")
             
-            with self.message_queue_lock:
-                self.message_queue.append(json.dumps({
-                    "type": "connection_status", 
-                    "payload": {"status": "reconnecting", "attempt": attempt, "remaining": remaining}
-                }))
+            self._enqueue(json.dumps({
+                "type": "connection_status",
+                "payload": {"status": "reconnecting", "attempt": attempt, "remaining": remaining}
+            }))
             
             try:
                 host_bytes = host.encode('utf-8')
@@ -184,11 +249,10 @@ class ClientManager:
                     self.connected = True
                     self._reconnect_active = False
                     
-                    with self.message_queue_lock:
-                        self.message_queue.append(json.dumps({
-                            "type": "connection_status",
-                            "payload": {"status": "reconnected", "attempts": attempt}
-                        }))
+                    self._enqueue(json.dumps({
+                        "type": "connection_status",
+                        "payload": {"status": "reconnected", "attempts": attempt}
+                    }))
                     return
             except Exception as e:
                 print(f"[Reconnect] Attempt {attempt} failed: {e}")
@@ -211,7 +275,7 @@ class ClientManager:
                 self.connected = True
                 self._last_host = host
                 self._last_port = port
-                self._start_poll_thread()
+                self._user_disconnect = False
                 return {"success": True, "message": "Connected"}
             else:
                 error_messages = {
@@ -225,23 +289,13 @@ class ClientManager:
             traceback.print_exc()
             return {"success": False, "message": str(e)}
     
-    def _start_poll_thread(self):
-        """Start the polling thread if not already running"""
-        if self._poll_thread is None or not self._poll_thread.is_alive():
-            self._stop_event.clear()
-            self._poll_thread = threading.Thread(target=self._poll_loop, daemon=True, name="ClientPollThread")
-            self._poll_thread.start()
-    
     def disconnect(self) -> dict:
         """Disconnect from server"""
         if not self.client_lib or not self.connected:
             return {"success": False, "message": "Not connected"}
         
         try:
-            self._stop_event.set()
-            if self._poll_thread and self._poll_thread.is_alive():
-                self._poll_thread.join(timeout=1.0)
-            
+            self._user_disconnect = True
             self.client_lib.client_disconnect()
             self.connected = False
             return {"success": True, "message": "Disconnected"}
@@ -264,6 +318,29 @@ class ClientManager:
         except Exception as e:
             return {"success": False, "message": str(e)}
     
+    def send_batch(self, messages: list) -> dict:
+        """Send [json, seq] pairs with one write; seq > 0 marks a request that takes a slot of the in-flight window"""
+        if not self.client_lib or not self.connected:
+            return {"success": False, "message": "Not connected"}
+        
+        try:
+            count = len(messages)
+            json_array = (ctypes.c_char_p * count)(*[json_str.encode('utf-8') for json_str, _ in messages])
+            seq_array = (ctypes.c_int * count)(*[seq for _, seq in messages])
+            result = self.client_lib.client_send_batch(json_array, seq_array, count)
+            
+            if result == 0:
+                return {"success": True}
+            else:
+                return {"success": False, "message": f"Send failed (code: {result})"}
+        except Exception as e:
+            return {"success": False, "message": str(e)}
+    
+    def cancel(self, seq: int):
+        """The page stopped waiting for a request; free its slot in the window"""
+        if self.client_lib:
+            self.client_lib.client_cancel_request(seq)
+    
     def is_connected(self) -> bool:
         """Check connection status"""
         if not self.client_lib:
@@ -274,19 +351,13 @@ class ClientManager:
         except:
             return False
     
-    def get_messages(self) -> list:
-        """Get pending messages from server"""
-        with self.message_queue_lock:
-            messages = self.message_queue.copy()
-            self.message_queue.clear()
-        return messages
-    
     def cleanup(self):
         """Cleanup resources on shutdown"""
         print("\n[Launcher] Cleaning up...")
         self._stop_event.set()
-        if self._poll_thread and self._poll_thread.is_alive():
-            self._poll_thread.join(timeout=1.0)
+        self._push_event.set()
+        if self._push_thread and self._push_thread.is_alive():
+            self._push_thread.join(timeout=1.0)
         if self.client_lib and self.connected:
             self.client_lib.client_disconnect()
         print("[Launcher] Cleanup complete")
@@ -307,11 +378,17 @@ class ClientAPI:
     def send(self, json_str):
         return self.manager.send(json_str)
     
+    def send_batch(self, messages):
+        return self.manager.send_batch(messages)
+    
+    def cancel(self, seq):
+        return self.manager.cancel(seq)
+    
     def is_connected(self):
         return self.manager.is_connected()
     
-    def get_messages(self):
-        return self.manager.get_messages()
+    def attach(self):
+        return self.manager.attach(webview.windows[0])
 
 
 def create_window():
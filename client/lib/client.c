@@ -1,245 +1,219 @@
 #define _DEFAULT_SOURCE
-#include <arpa/inet.h>
-#include <errno.h>
-#include <fcntl.h>
-#include <netdb.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/select.h>
-#include <sys/socket.h>
-#include <unistd.h>
+#include <time.h>
 
-#define RECV_BUFFER_SIZE 16384
-#define CONNECT_TIMEOUT_SEC 5
+#include "xq_client.h"
+
+/*
+ * The desktop client's single connection to the game server, kept for the launcher's ctypes bindings. It is one
+ * xq_client_t on a private loop thread: every complete line goes to the message callback as soon as it is read, and
+ * when the server goes away the disconnect callback runs once; both run on the loop thread. The launcher uses the
+ * disconnect callback to start reconnecting. Tools that want more than one connection use xq_client.h directly.
+ */
 
-#define CLIENT_OK 0
-#define CLIENT_ERR_SOCKET -1
-#define CLIENT_ERR_IP -2
-#define CLIENT_ERR_CONNECT -3
-#define CLIENT_ERR_TIMEOUT -4
-#define CLIENT_ERR_MEMORY -5
-#define CLIENT_ERR_SEND -6
-#define CLIENT_ERR_NOTCONN -7
+#define CONNECT_TIMEOUT_SEC 5
 
-static int sock_fd = -1;
-static char recv_buffer[RECV_BUFFER_SIZE];
-static int buffer_offset = 0;
-static bool is_connected = false;
+#define CLIENT_OK XQ_OK
+#define CLIENT_ERR_SOCKET XQ_ERR_SOCKET
+#define CLIENT_ERR_IP XQ_ERR_IP
+#define CLIENT_ERR_CONNECT XQ_ERR_CONNECT
+#define CLIENT_ERR_TIMEOUT XQ_ERR_TIMEOUT
+#define CLIENT_ERR_MEMORY XQ_ERR_MEMORY
+#define CLIENT_ERR_SEND XQ_ERR_SEND
+#define CLIENT_ERR_NOTCONN XQ_ERR_NOTCONN
 
 typedef void (*MessageCallback)(const char* message);
+typedef void (*DisconnectCallback)(void);
 static MessageCallback g_callback = NULL;
+static DisconnectCallback g_disconnect_callback = NULL;
 
-static void set_nonblocking(int sockfd) {
-    int flags = fcntl(sockfd, F_GETFL, 0);
-    if (flags != -1) {
-        fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
-    }
-}
+static xq_loop_t* loop = NULL;
+static xq_client_t* connection = NULL;
+static atomic_bool is_connected = false;
+static int request_window = 0; /* applied to every new connection */
 
-static void set_blocking(int sockfd) {
-    int flags = fcntl(sockfd, F_GETFL, 0);
-    if (flags != -1) {
-        fcntl(sockfd, F_SETFL, flags & ~O_NONBLOCK);
-    }
-}
+/* connection, and connect_state while client_connect waits: 0 pending, 1 open, else the XQ_ERR_* it failed with */
+static pthread_mutex_t connection_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t connect_done = PTHREAD_COND_INITIALIZER;
+static int connect_state = 0;
 
 void client_set_message_callback(MessageCallback callback) {
     g_callback = callback;
 }
 
-int client_connect(const char* ip, int port) {
-    if (is_connected) {
-        return CLIENT_OK;
-    }
-
-    sock_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock_fd < 0) {
-        return CLIENT_ERR_SOCKET;
-    }
+void client_set_disconnect_callback(DisconnectCallback callback) {
+    g_disconnect_callback = callback;
+}
 
-    struct addrinfo hints, *addr_result;
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_STREAM;
+static void on_open(xq_client_t* client, void* user_data) {
+    (void)client;
+    (void)user_data;
+    pthread_mutex_lock(&connection_lock);
+    connect_state = 1;
+    atomic_store(&is_connected, true);
+    pthread_cond_broadcast(&connect_done);
+    pthread_mutex_unlock(&connection_lock);
+}
 
-    char port_str[6];
-    snprintf(port_str, sizeof(port_str), "%d", port);
+static void on_message(xq_client_t* client, const char* line, size_t len, void* user_data) {
+    (void)client;
+    (void)len;
+    (void)user_data;
+    if (g_callback) {
+        g_callback(line);
+    }
+}
 
-    int ret = getaddrinfo(ip, port_str, &hints, &addr_result);
-    if (ret != 0 || addr_result == NULL) {
-        close(sock_fd);
-        sock_fd = -1;
-        return CLIENT_ERR_IP;
+static void on_close(xq_client_t* client, int error, void* user_data) {
+    (void)client;
+    (void)user_data;
+    pthread_mutex_lock(&connection_lock);
+    if (connect_state == 0) {
+        connect_state = error != XQ_OK ? error : CLIENT_ERR_CONNECT;
     }
+    pthread_cond_broadcast(&connect_done);
+    pthread_mutex_unlock(&connection_lock);
 
-    struct sockaddr_in serv_addr;
-    memset(&serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(port);
-    serv_addr.sin_addr = ((struct sockaddr_in*)addr_result->ai_addr)->sin_addr;
-    freeaddrinfo(addr_result);
+    if (atomic_exchange(&is_connected, false) && g_disconnect_callback) {
+        g_disconnect_callback();
+    }
+}
 
-    set_nonblocking(sock_fd);
+static void close_connection(void) {
+    pthread_mutex_lock(&connection_lock);
+    xq_client_t* old = connection;
+    connection = NULL;
+    atomic_store(&is_connected, false);
+    pthread_mutex_unlock(&connection_lock);
 
-    int result_connect = connect(sock_fd, (struct sockaddr*)&serv_addr, sizeof(serv_addr));
+    xq_client_close(old);
+}
 
-    if (result_connect < 0 && errno != EINPROGRESS) {
-        close(sock_fd);
-        sock_fd = -1;
-        return CLIENT_ERR_CONNECT;
+/* Blocks for up to CONNECT_TIMEOUT_SEC; call it from any thread but the loop's (the launcher reconnects from its
+ * own thread) */
+int client_connect(const char* ip, int port) {
+    if (atomic_load(&is_connected)) {
+        return CLIENT_OK;
     }
+    close_connection();
 
-    fd_set write_fds;
-    FD_ZERO(&write_fds);
-    FD_SET(sock_fd, &write_fds);
-
-    struct timeval timeout;
-    timeout.tv_sec = CONNECT_TIMEOUT_SEC;
-    timeout.tv_usec = 0;
-
-    int select_result = select(sock_fd + 1, NULL, &write_fds, NULL, &timeout);
+    if (!loop) {
+        loop = xq_loop_new();
+        if (!loop) {
+            return CLIENT_ERR_SOCKET;
+        }
+        if (xq_loop_start(loop) != XQ_OK) {
+            xq_loop_free(loop);
+            loop = NULL;
+            return CLIENT_ERR_MEMORY;
+        }
+    }
 
-    if (select_result <= 0) {
+    pthread_mutex_lock(&connection_lock);
+    connect_state = 0;
+    pthread_mutex_unlock(&connection_lock);
 
-        close(sock_fd);
-        sock_fd = -1;
-        return CLIENT_ERR_TIMEOUT;
+    xq_client_callbacks_t callbacks = {on_open, on_message, on_close, NULL};
+    int error;
+    xq_client_t* client = xq_client_connect(loop, ip, port, &callbacks, &error);
+    if (!client) {
+        return error;
     }
+    xq_client_set_window(client, request_window);
 
-    int so_error;
-    socklen_t len = sizeof(so_error);
-    getsockopt(sock_fd, SOL_SOCKET, SO_ERROR, &so_error, &len);
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += CONNECT_TIMEOUT_SEC;
 
-    if (so_error != 0) {
-        close(sock_fd);
-        sock_fd = -1;
-        return CLIENT_ERR_CONNECT;
+    pthread_mutex_lock(&connection_lock);
+    while (connect_state == 0) {
+        if (pthread_cond_timedwait(&connect_done, &connection_lock, &deadline) != 0) {
+            break;
+        }
     }
+    int state = connect_state;
+    if (state == 1) {
+        connection = client;
+    }
+    pthread_mutex_unlock(&connection_lock);
 
-    is_connected = true;
-    buffer_offset = 0;
-    memset(recv_buffer, 0, RECV_BUFFER_SIZE);
-
+    if (state != 1) {
+        xq_client_close(client);
+        atomic_store(&is_connected, false);
+        return state == 0 ? CLIENT_ERR_TIMEOUT : state;
+    }
     return CLIENT_OK;
 }
 
 int client_disconnect(void) {
-    if (sock_fd >= 0) {
-        close(sock_fd);
-        sock_fd = -1;
-    }
-    is_connected = false;
-    buffer_offset = 0;
+    close_connection();
     return CLIENT_OK;
 }
 
 bool client_is_connected(void) {
-    return is_connected;
+    return atomic_load(&is_connected);
 }
 
-int client_send_json(const char* json_str) {
-    if (!is_connected || sock_fd < 0) {
-        return CLIENT_ERR_NOTCONN;
-    }
-
-    size_t json_len = strlen(json_str);
-    size_t total_len = json_len + 2;
-
-    char* send_buffer = (char*)malloc(total_len);
-    if (!send_buffer) {
-        return CLIENT_ERR_MEMORY;
-    }
-
-    snprintf(send_buffer, total_len, "%s\n", json_str);
-
-    size_t total_sent = 0;
-    size_t to_send = json_len + 1;
-    int retry_count = 0;
-    const int max_retries = 100;
-
-    while (total_sent < to_send && retry_count < max_retries) {
-        ssize_t sent = send(sock_fd, send_buffer + total_sent, to_send - total_sent, MSG_NOSIGNAL);
-
-        if (sent < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                usleep(1000);
-                retry_count++;
-                continue;
-            }
-
-            free(send_buffer);
-            client_disconnect();
-            return CLIENT_ERR_SEND;
-        }
-        total_sent += sent;
-    }
-
-    free(send_buffer);
-
-    if (total_sent < to_send) {
+static int send_result(int result, int count) {
+    if (result == XQ_ERR_QUEUE_FULL) {
+        fprintf(stderr, "[Client] Send queue full, %d message(s) dropped\n", count);
         return CLIENT_ERR_SEND;
     }
+    return result;
+}
 
-    return CLIENT_OK;
+/* Never blocks; a line the socket cannot take yet waits in the connection's send queue */
+int client_send_json(const char* json_str) {
+    pthread_mutex_lock(&connection_lock);
+    int result = connection ? xq_client_send(connection, json_str) : CLIENT_ERR_NOTCONN;
+    pthread_mutex_unlock(&connection_lock);
+    return send_result(result, 1);
 }
 
-int client_process_messages(void) {
-    if (!is_connected || sock_fd < 0) {
-        return CLIENT_ERR_NOTCONN;
+/* Sends count messages with one writev. seqs[i] > 0 marks a request that holds a slot of the in-flight window
+ * until its response arrives; seqs may be NULL when nothing is tracked. */
+int client_send_batch(const char** json_strs, const int* seqs, int count) {
+    if (count <= 0) {
+        return CLIENT_OK;
     }
 
-    int capacity = RECV_BUFFER_SIZE - buffer_offset - 1;
-    if (capacity <= 0) {
-
-        fprintf(stderr, "[Client] Warning: Buffer overflow, resetting\n");
-        buffer_offset = 0;
-        capacity = RECV_BUFFER_SIZE - 1;
+    xq_message_t* messages = malloc((size_t)count * sizeof(*messages));
+    if (!messages) {
+        return CLIENT_ERR_MEMORY;
+    }
+    for (int i = 0; i < count; i++) {
+        messages[i].json = json_strs[i];
+        messages[i].seq = seqs ? seqs[i] : 0;
     }
 
-    ssize_t bytes_read = recv(sock_fd, recv_buffer + buffer_offset, capacity, 0);
-
-    if (bytes_read > 0) {
-        buffer_offset += bytes_read;
-        recv_buffer[buffer_offset] = '\0';
-
-        char* start = recv_buffer;
-        char* newline;
-
-        while ((newline = strchr(start, '\n')) != NULL) {
-            *newline = '\0';
-
-            if (g_callback && strlen(start) > 0) {
-                g_callback(start);
-            }
-
-            start = newline + 1;
-        }
-
-        if (start < recv_buffer + buffer_offset) {
-            int remaining = (recv_buffer + buffer_offset) - start;
-            memmove(recv_buffer, start, remaining);
-            buffer_offset = remaining;
-        } else {
-            buffer_offset = 0;
-        }
-
-        return 1;
-
-    } else if (bytes_read == 0) {
-
-        client_disconnect();
-        return CLIENT_ERR_CONNECT;
+    pthread_mutex_lock(&connection_lock);
+    int result = connection ? xq_client_send_batch(connection, messages, count) : CLIENT_ERR_NOTCONN;
+    pthread_mutex_unlock(&connection_lock);
 
-    } else {
+    free(messages);
+    return send_result(result, count);
+}
 
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            return 0;
-        } else {
+/* Most requests awaiting a response at once, 0 for no limit; later requests wait in order */
+void client_set_window(int window) {
+    pthread_mutex_lock(&connection_lock);
+    request_window = window;
+    if (connection) {
+        xq_client_set_window(connection, window);
+    }
+    pthread_mutex_unlock(&connection_lock);
+}
 
-            client_disconnect();
-            return CLIENT_ERR_CONNECT;
-        }
+/* Gives back the window slot of a request whose response the caller stopped waiting for */
+void client_cancel_request(int seq) {
+    pthread_mutex_lock(&connection_lock);
+    if (connection) {
+        xq_client_cancel(connection, seq);
     }
-}
\ No newline at end of file
+    pthread_mutex_unlock(&connection_lock);
+}
@@ -0,0 +1,863 @@
+#define _DEFAULT_SOURCE
+#include "xq_client.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define XQ_LOOP_EVENTS 256
+#define XQ_RECV_INITIAL 4096
+#define XQ_BATCH_IOV 128 /* iovecs per sendmsg: 64 messages and their newlines */
+
+typedef enum { XQ_CONNECTING, XQ_OPEN, XQ_CLOSED } xq_state_t;
+
+/* A message waiting for room in the in-flight window, newline included */
+typedef struct xq_held {
+    struct xq_held* next;
+    int seq;
+    size_t len;
+    char data[];
+} xq_held_t;
+
+struct xq_client {
+    xq_loop_t* loop;
+    xq_client_callbacks_t callbacks;
+
+    /* Only the loop thread changes state or fd, always under lock, so it may read them without it */
+    pthread_mutex_t lock;
+    xq_state_t state;
+    int fd;
+    char* out; /* send queue: bytes [out_off, out_len) are still to be written */
+    size_t out_off;
+    size_t out_len;
+    size_t out_cap;
+    bool want_write; /* EPOLLOUT is armed */
+    int window;      /* 0: no limit */
+    int* in_flight;  /* seqs of the requests awaiting an answer */
+    int in_flight_count;
+    int in_flight_cap;
+    xq_held_t* held_head;
+    xq_held_t* held_tail;
+    size_t held_bytes;
+
+    /* Loop thread only */
+    char* in;
+    size_t in_len;
+    size_t in_cap;
+
+    atomic_bool closing; /* xq_client_close was called; no more callbacks */
+    xq_client_t* prev;   /* loop->clients, under loop->lock */
+    xq_client_t* next;
+    xq_client_t* close_next;
+};
+
+struct xq_loop {
+    int epoll_fd;
+    int wake_fd;
+    atomic_bool stop;
+
+    pthread_mutex_t lock;
+    pthread_cond_t closed;
+    bool running;
+    bool threaded;
+    pthread_t thread;
+    xq_client_t* clients;
+    int client_count;
+    xq_client_t* pending_close; /* handed over by xq_client_close from other threads, freed by the loop */
+    unsigned long close_requested;
+    unsigned long close_completed;
+};
+
+static void wake_loop(xq_loop_t* loop) {
+    uint64_t one = 1;
+    if (write(loop->wake_fd, &one, sizeof(one)) < 0) {
+        fprintf(stderr, "[XQClient] Warning: could not wake the loop\n");
+    }
+}
+
+static bool on_loop_thread(xq_loop_t* loop) {
+    return loop->running && pthread_equal(loop->thread, pthread_self());
+}
+
+/* Arms EPOLLOUT while the queue holds data and disarms it once drained; lock held */
+static void update_interest(xq_client_t* client) {
+    bool want = client->out_len > client->out_off;
+    if (want == client->want_write || client->state != XQ_OPEN) {
+        return;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | (want ? EPOLLOUT : 0);
+    ev.data.ptr = client;
+    if (epoll_ctl(client->loop->epoll_fd, EPOLL_CTL_MOD, client->fd, &ev) == 0) {
+        client->want_write = want;
+    }
+}
+
+/* Writes as much of the queue as the socket takes; false on a socket error. Lock held. */
+static bool flush_queue(xq_client_t* client) {
+    while (client->out_off < client->out_len) {
+        ssize_t sent = send(client->fd, client->out + client->out_off, client->out_len - client->out_off,
+                            MSG_NOSIGNAL);
+        if (sent > 0) {
+            client->out_off += sent;
+        } else if (sent < 0 && errno == EINTR) {
+            continue;
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            return false;
+        }
+    }
+
+    if (client->out_off == client->out_len) {
+        client->out_off = 0;
+        client->out_len = 0;
+    }
+    update_interest(client);
+    return true;
+}
+
+/* Makes room for need more bytes at the end of the queue, reclaiming what was already sent first; lock held */
+static bool reserve_queue(xq_client_t* client, size_t need) {
+    if (client->out_cap - client->out_len >= need) {
+        return true;
+    }
+
+    if (client->out_off > 0) {
+        memmove(client->out, client->out + client->out_off, client->out_len - client->out_off);
+        client->out_len -= client->out_off;
+        client->out_off = 0;
+        if (client->out_cap - client->out_len >= need) {
+            return true;
+        }
+    }
+
+    size_t capacity = client->out_cap ? client->out_cap : 1024;
+    while (capacity - client->out_len < need) {
+        capacity *= 2;
+    }
+    char* grown = realloc(client->out, capacity);
+    if (!grown) {
+        return false;
+    }
+    client->out = grown;
+    client->out_cap = capacity;
+    return true;
+}
+
+static bool queue_bytes(xq_client_t* client, const char* data, size_t len) {
+    if (!reserve_queue(client, len)) {
+        return false;
+    }
+    memcpy(client->out + client->out_len, data, len);
+    client->out_len += len;
+    return true;
+}
+
+static bool queue_line(xq_client_t* client, const char* json) {
+    return queue_bytes(client, json, strlen(json)) && queue_bytes(client, "\n", 1);
+}
+
+/* Whether a message may go out now instead of waiting for the window; lock held */
+static bool window_admits(xq_client_t* client, int seq) {
+    return seq <= 0 || client->window <= 0 || client->in_flight_count < client->window;
+}
+
+/* in_flight always has room for window entries, see xq_client_set_window */
+static void track_request(xq_client_t* client, int seq) {
+    if (seq > 0 && client->window > 0 && client->in_flight_count < client->in_flight_cap) {
+        client->in_flight[client->in_flight_count++] = seq;
+    }
+}
+
+static bool untrack_request(xq_client_t* client, int seq) {
+    for (int i = 0; i < client->in_flight_count; i++) {
+        if (client->in_flight[i] == seq) {
+            client->in_flight[i] = client->in_flight[--client->in_flight_count];
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool hold_message(xq_client_t* client, const char* json, int seq) {
+    size_t json_len = strlen(json);
+    xq_held_t* held = malloc(sizeof(*held) + json_len + 1);
+    if (!held) {
+        return false;
+    }
+    held->next = NULL;
+    held->seq = seq;
+    held->len = json_len + 1;
+    memcpy(held->data, json, json_len);
+    held->data[json_len] = '\n';
+
+    if (client->held_tail) {
+        client->held_tail->next = held;
+    } else {
+        client->held_head = held;
+    }
+    client->held_tail = held;
+    client->held_bytes += held->len;
+    return true;
+}
+
+/* Moves held messages the window now admits into the send queue and flushes it; false on a socket error. Lock
+ * held. */
+static bool release_held(xq_client_t* client) {
+    while (client->held_head && window_admits(client, client->held_head->seq)) {
+        xq_held_t* held = client->held_head;
+        if (!queue_bytes(client, held->data, held->len)) {
+            break;
+        }
+        track_request(client, held->seq);
+
+        client->held_head = held->next;
+        if (!client->held_head) {
+            client->held_tail = NULL;
+        }
+        client->held_bytes -= held->len;
+        free(held);
+    }
+    return client->state != XQ_OPEN || flush_queue(client);
+}
+
+/* The seq a response or error frame answers, 0 for any other line */
+static int answered_seq(const char* line) {
+    static const char response[] = "{\"type\":\"response\",\"seq\":";
+    static const char error[] = "{\"type\":\"error\",\"seq\":";
+
+    if (strncmp(line, response, sizeof(response) - 1) == 0) {
+        return (int)strtol(line + sizeof(response) - 1, NULL, 10);
+    }
+    if (strncmp(line, error, sizeof(error) - 1) == 0) {
+        return (int)strtol(line + sizeof(error) - 1, NULL, 10);
+    }
+    return 0;
+}
+
+/* Closes the socket and drops the queue; true if the connection was still up. Loop thread, or a stopped loop. */
+static bool teardown(xq_client_t* client) {
+    pthread_mutex_lock(&client->lock);
+    bool was_up = client->state != XQ_CLOSED;
+    if (was_up) {
+        epoll_ctl(client->loop->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+        close(client->fd);
+        client->fd = -1;
+        client->state = XQ_CLOSED;
+    }
+    free(client->out);
+    client->out = NULL;
+    client->out_off = client->out_len = client->out_cap = 0;
+    while (client->held_head) {
+        xq_held_t* held = client->held_head;
+        client->held_head = held->next;
+        free(held);
+    }
+    client->held_tail = NULL;
+    client->held_bytes = 0;
+    client->in_flight_count = 0;
+    pthread_mutex_unlock(&client->lock);
+    return was_up;
+}
+
+static void drop_connection(xq_client_t* client, int error) {
+    if (teardown(client) && !atomic_load(&client->closing) && client->callbacks.on_close) {
+        client->callbacks.on_close(client, error, client->callbacks.user_data);
+    }
+}
+
+static void free_client(xq_client_t* client) {
+    xq_loop_t* loop = client->loop;
+    teardown(client);
+
+    pthread_mutex_lock(&loop->lock);
+    if (client->prev) {
+        client->prev->next = client->next;
+    } else {
+        loop->clients = client->next;
+    }
+    if (client->next) {
+        client->next->prev = client->prev;
+    }
+    loop->client_count--;
+    pthread_mutex_unlock(&loop->lock);
+
+    pthread_mutex_destroy(&client->lock);
+    free(client->in_flight);
+    free(client->in);
+    free(client);
+}
+
+static void finish_connect(xq_client_t* client) {
+    int so_error = 0;
+    socklen_t len = sizeof(so_error);
+    if (getsockopt(client->fd, SOL_SOCKET, SO_ERROR, &so_error, &len) < 0 || so_error != 0) {
+        drop_connection(client, XQ_ERR_CONNECT);
+        return;
+    }
+
+    pthread_mutex_lock(&client->lock);
+    client->state = XQ_OPEN;
+    client->want_write = true; /* registered with EPOLLOUT to learn about the connect */
+    bool ok = release_held(client);
+    pthread_mutex_unlock(&client->lock);
+
+    if (!ok) {
+        drop_connection(client, XQ_ERR_SEND);
+        return;
+    }
+    if (client->callbacks.on_open && !atomic_load(&client->closing)) {
+        client->callbacks.on_open(client, client->callbacks.user_data);
+    }
+}
+
+/* Hands every complete line to on_message and keeps the partial tail; false once the client is being closed */
+static bool dispatch_lines(xq_client_t* client) {
+    char* start = client->in;
+    char* end = client->in + client->in_len;
+    char* newline;
+
+    while ((newline = memchr(start, '\n', end - start)) != NULL) {
+        *newline = '\0';
+
+        /* Free the request's slot in the window first so held messages leave before the callback answers */
+        int seq = answered_seq(start);
+        if (seq > 0) {
+            pthread_mutex_lock(&client->lock);
+            bool ok = !untrack_request(client, seq) || release_held(client);
+            pthread_mutex_unlock(&client->lock);
+            if (!ok) {
+                drop_connection(client, XQ_ERR_SEND);
+                return false;
+            }
+        }
+
+        if (newline > start && client->callbacks.on_message) {
+            client->callbacks.on_message(client, start, newline - start, client->callbacks.user_data);
+            if (atomic_load(&client->closing) || client->state == XQ_CLOSED) {
+                return false;
+            }
+        }
+
+        start = newline + 1;
+    }
+
+    size_t remaining = end - start;
+    if (remaining > 0 && start != client->in) {
+        memmove(client->in, start, remaining);
+    }
+    client->in_len = remaining;
+    return true;
+}
+
+/* One recv per readiness keeps a chatty connection from starving the rest; epoll is level-triggered */
+static bool read_ready(xq_client_t* client) {
+    if (client->in_cap - client->in_len < 2) {
+        size_t capacity = client->in_cap ? client->in_cap * 2 : XQ_RECV_INITIAL;
+        if (capacity > XQ_LINE_MAX + 1) {
+            fprintf(stderr, "[XQClient] Line longer than %d bytes, dropping the connection\n", XQ_LINE_MAX);
+            drop_connection(client, XQ_ERR_MEMORY);
+            return false;
+        }
+        char* grown = realloc(client->in, capacity);
+        if (!grown) {
+            drop_connection(client, XQ_ERR_MEMORY);
+            return false;
+        }
+        client->in = grown;
+        client->in_cap = capacity;
+    }
+
+    ssize_t bytes_read = recv(client->fd, client->in + client->in_len, client->in_cap - client->in_len - 1, 0);
+    if (bytes_read > 0) {
+        client->in_len += bytes_read;
+        return dispatch_lines(client);
+    }
+    if (bytes_read < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return true;
+    }
+
+    drop_connection(client, XQ_OK);
+    return false;
+}
+
+static void handle_event(xq_client_t* client, uint32_t events) {
+    if (atomic_load(&client->closing) || client->state == XQ_CLOSED) {
+        return;
+    }
+
+    if (client->state == XQ_CONNECTING) {
+        finish_connect(client);
+        return;
+    }
+
+    if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !read_ready(client)) {
+        return;
+    }
+
+    if (events & EPOLLOUT) {
+        pthread_mutex_lock(&client->lock);
+        bool ok = flush_queue(client);
+        pthread_mutex_unlock(&client->lock);
+        if (!ok) {
+            drop_connection(client, XQ_ERR_SEND);
+        }
+    }
+}
+
+/* Frees clients closed during this iteration and wakes the threads waiting in xq_client_close */
+static void process_closes(xq_loop_t* loop) {
+    pthread_mutex_lock(&loop->lock);
+    xq_client_t* list = loop->pending_close;
+    loop->pending_close = NULL;
+    unsigned long requested = loop->close_requested;
+    pthread_mutex_unlock(&loop->lock);
+
+    while (list) {
+        xq_client_t* next = list->close_next;
+        free_client(list);
+        list = next;
+    }
+
+    pthread_mutex_lock(&loop->lock);
+    loop->close_completed = requested;
+    pthread_cond_broadcast(&loop->closed);
+    pthread_mutex_unlock(&loop->lock);
+}
+
+static void run_loop(xq_loop_t* loop) {
+    struct epoll_event events[XQ_LOOP_EVENTS];
+
+    while (!atomic_load(&loop->stop)) {
+        int n = epoll_wait(loop->epoll_fd, events, XQ_LOOP_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "[XQClient] epoll_wait: %s\n", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) {
+                uint64_t count;
+                if (read(loop->wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                    fprintf(stderr, "[XQClient] Warning: could not reset the wake event\n");
+                }
+                continue;
+            }
+            handle_event(events[i].data.ptr, events[i].events);
+        }
+
+        process_closes(loop);
+    }
+
+    process_closes(loop);
+    pthread_mutex_lock(&loop->lock);
+    loop->running = false;
+    atomic_store(&loop->stop, false);
+    pthread_mutex_unlock(&loop->lock);
+    /* A close queued between the last pass and running going false */
+    process_closes(loop);
+}
+
+static void* loop_thread(void* arg) {
+    run_loop(arg);
+    return NULL;
+}
+
+xq_loop_t* xq_loop_new(void) {
+    xq_loop_t* loop = calloc(1, sizeof(*loop));
+    if (!loop) {
+        return NULL;
+    }
+
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (loop->epoll_fd < 0 || loop->wake_fd < 0) {
+        goto fail;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wake_fd, &ev) < 0) {
+        goto fail;
+    }
+
+    pthread_mutex_init(&loop->lock, NULL);
+    pthread_cond_init(&loop->closed, NULL);
+    atomic_init(&loop->stop, false);
+    return loop;
+
+fail:
+    if (loop->epoll_fd >= 0) {
+        close(loop->epoll_fd);
+    }
+    if (loop->wake_fd >= 0) {
+        close(loop->wake_fd);
+    }
+    free(loop);
+    return NULL;
+}
+
+void xq_loop_free(xq_loop_t* loop) {
+    if (!loop) {
+        return;
+    }
+    xq_loop_stop(loop);
+
+    while (loop->clients) {
+        atomic_store(&loop->clients->closing, true);
+        free_client(loop->clients);
+    }
+
+    close(loop->epoll_fd);
+    close(loop->wake_fd);
+    pthread_cond_destroy(&loop->closed);
+    pthread_mutex_destroy(&loop->lock);
+    free(loop);
+}
+
+int xq_loop_run(xq_loop_t* loop) {
+    pthread_mutex_lock(&loop->lock);
+    if (loop->running) {
+        pthread_mutex_unlock(&loop->lock);
+        return XQ_ERR_SOCKET;
+    }
+    loop->running = true;
+    loop->thread = pthread_self();
+    pthread_mutex_unlock(&loop->lock);
+
+    run_loop(loop);
+    return XQ_OK;
+}
+
+int xq_loop_start(xq_loop_t* loop) {
+    pthread_mutex_lock(&loop->lock);
+    if (loop->running) {
+        pthread_mutex_unlock(&loop->lock);
+        return XQ_ERR_SOCKET;
+    }
+    loop->running = true;
+    loop->threaded = true;
+    if (pthread_create(&loop->thread, NULL, loop_thread, loop) != 0) {
+        loop->running = false;
+        loop->threaded = false;
+        pthread_mutex_unlock(&loop->lock);
+        return XQ_ERR_MEMORY;
+    }
+    pthread_mutex_unlock(&loop->lock);
+    return XQ_OK;
+}
+
+void xq_loop_stop(xq_loop_t* loop) {
+    pthread_mutex_lock(&loop->lock);
+    bool running = loop->running;
+    bool join = loop->threaded && !pthread_equal(loop->thread, pthread_self());
+    pthread_mutex_unlock(&loop->lock);
+
+    if (running) {
+        atomic_store(&loop->stop, true);
+        wake_loop(loop);
+    }
+    if (join) {
+        pthread_join(loop->thread, NULL);
+        loop->threaded = false;
+    }
+}
+
+int xq_loop_client_count(xq_loop_t* loop) {
+    pthread_mutex_lock(&loop->lock);
+    int count = loop->client_count;
+    pthread_mutex_unlock(&loop->lock);
+    return count;
+}
+
+xq_client_t* xq_client_connect(xq_loop_t* loop, const char* host, int port, const xq_client_callbacks_t* callbacks,
+                               int* out_error) {
+    int error = XQ_OK;
+    xq_client_t* client = NULL;
+
+    struct addrinfo hints, *addr_result;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    char port_str[6];
+    snprintf(port_str, sizeof(port_str), "%d", port);
+
+    if (getaddrinfo(host, port_str, &hints, &addr_result) != 0 || addr_result == NULL) {
+        error = XQ_ERR_IP;
+        goto out;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        freeaddrinfo(addr_result);
+        error = XQ_ERR_SOCKET;
+        goto out;
+    }
+
+    int result_connect = connect(fd, addr_result->ai_addr, addr_result->ai_addrlen);
+    freeaddrinfo(addr_result);
+    if (result_connect < 0 && errno != EINPROGRESS) {
+        close(fd);
+        error = XQ_ERR_CONNECT;
+        goto out;
+    }
+
+    client = calloc(1, sizeof(*client));
+    if (!client) {
+        close(fd);
+        error = XQ_ERR_MEMORY;
+        goto out;
+    }
+    client->loop = loop;
+    client->fd = fd;
+    client->state = XQ_CONNECTING;
+    if (callbacks) {
+        client->callbacks = *callbacks;
+    }
+    pthread_mutex_init(&client->lock, NULL);
+    atomic_init(&client->closing, false);
+
+    pthread_mutex_lock(&loop->lock);
+    client->next = loop->clients;
+    if (loop->clients) {
+        loop->clients->prev = client;
+    }
+    loop->clients = client;
+    loop->client_count++;
+    pthread_mutex_unlock(&loop->lock);
+
+    /* Writability reports the end of the connect, successful or not */
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.ptr = client;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        atomic_store(&client->closing, true);
+        free_client(client);
+        client = NULL;
+        error = XQ_ERR_SOCKET;
+    }
+
+out:
+    if (out_error) {
+        *out_error = error;
+    }
+    return client;
+}
+
+/* Writes messages straight from the caller's buffers, 64 to a sendmsg; whatever the socket does not take is queued
+ * for the loop. Lock held, queue empty. */
+static bool write_batch(xq_client_t* client, const xq_message_t* messages, int count) {
+    static const char newline = '\n';
+    struct iovec iov[XQ_BATCH_IOV];
+    int next = 0;
+
+    while (next < count) {
+        int n = 0;
+        size_t bytes = 0;
+        while (next < count && n < XQ_BATCH_IOV) {
+            iov[n].iov_base = (void*)messages[next].json;
+            iov[n].iov_len = strlen(messages[next].json);
+            iov[n + 1].iov_base = (void*)&newline;
+            iov[n + 1].iov_len = 1;
+            bytes += iov[n].iov_len + 1;
+            n += 2;
+            next++;
+        }
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+
+        ssize_t sent;
+        do {
+            sent = sendmsg(client->fd, &msg, MSG_NOSIGNAL);
+        } while (sent < 0 && errno == EINTR);
+        if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            return false;
+        }
+        if (sent >= 0 && (size_t)sent == bytes) {
+            continue;
+        }
+
+        /* The socket is full: queue the unsent end of this chunk and every message after it */
+        size_t skip = sent > 0 ? (size_t)sent : 0;
+        for (int i = 0; i < n; i++) {
+            if (skip >= iov[i].iov_len) {
+                skip -= iov[i].iov_len;
+                continue;
+            }
+            if (!queue_bytes(client, (const char*)iov[i].iov_base + skip, iov[i].iov_len - skip)) {
+                return false;
+            }
+            skip = 0;
+        }
+        for (int i = next; i < count; i++) {
+            if (!queue_line(client, messages[i].json)) {
+                return false;
+            }
+        }
+        update_interest(client);
+        return true;
+    }
+    return true;
+}
+
+int xq_client_send(xq_client_t* client, const char* json) {
+    xq_message_t message = {json, 0};
+    return xq_client_send_batch(client, &message, 1);
+}
+
+int xq_client_send_batch(xq_client_t* client, const xq_message_t* messages, int count) {
+    size_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += strlen(messages[i].json) + 1;
+    }
+    int result = XQ_OK;
+
+    pthread_mutex_lock(&client->lock);
+    if (client->state == XQ_CLOSED) {
+        pthread_mutex_unlock(&client->lock);
+        return XQ_ERR_NOTCONN;
+    }
+    if (client->out_len - client->out_off + client->held_bytes + total > XQ_SEND_QUEUE_MAX) {
+        pthread_mutex_unlock(&client->lock);
+        return XQ_ERR_QUEUE_FULL;
+    }
+
+    /* Once anything is held, everything after it waits too so the order on the wire matches the order of calls */
+    int admitted = 0;
+    if (!client->held_head) {
+        while (admitted < count && window_admits(client, messages[admitted].seq)) {
+            track_request(client, messages[admitted].seq);
+            admitted++;
+        }
+    }
+
+    bool ok = true;
+    if (admitted > 0 && client->state == XQ_OPEN && client->out_len == client->out_off) {
+        ok = write_batch(client, messages, admitted);
+    } else {
+        /* With older data still queued the loop is already waiting for room and will flush these after it */
+        for (int i = 0; i < admitted && ok; i++) {
+            ok = queue_line(client, messages[i].json);
+        }
+    }
+    for (int i = admitted; i < count && ok; i++) {
+        if (!hold_message(client, messages[i].json, messages[i].seq)) {
+            result = XQ_ERR_MEMORY;
+            break;
+        }
+    }
+
+    if (!ok) {
+        /* Part of a line may be out already; the loop sees the connection end and reports it through on_close */
+        shutdown(client->fd, SHUT_RDWR);
+        result = XQ_ERR_SEND;
+    }
+    pthread_mutex_unlock(&client->lock);
+    return result;
+}
+
+void xq_client_set_window(xq_client_t* client, int window) {
+    pthread_mutex_lock(&client->lock);
+    if (window > client->in_flight_cap) {
+        int* grown = realloc(client->in_flight, (size_t)window * sizeof(int));
+        if (!grown) {
+            pthread_mutex_unlock(&client->lock);
+            return;
+        }
+        client->in_flight = grown;
+        client->in_flight_cap = window;
+    }
+    client->window = window > 0 ? window : 0;
+    if (client->window == 0) {
+        client->in_flight_count = 0;
+    }
+    if (!release_held(client)) {
+        shutdown(client->fd, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&client->lock);
+}
+
+void xq_client_cancel(xq_client_t* client, int seq) {
+    pthread_mutex_lock(&client->lock);
+    if (untrack_request(client, seq) && !release_held(client)) {
+        shutdown(client->fd, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&client->lock);
+}
+
+int xq_client_in_flight(xq_client_t* client) {
+    pthread_mutex_lock(&client->lock);
+    int count = client->in_flight_count;
+    pthread_mutex_unlock(&client->lock);
+    return count;
+}
+
+bool xq_client_is_open(xq_client_t* client) {
+    pthread_mutex_lock(&client->lock);
+    bool open = client->state == XQ_OPEN;
+    pthread_mutex_unlock(&client->lock);
+    return open;
+}
+
+size_t xq_client_queued_bytes(xq_client_t* client) {
+    pthread_mutex_lock(&client->lock);
+    size_t queued = client->out_len - client->out_off + client->held_bytes;
+    pthread_mutex_unlock(&client->lock);
+    return queued;
+}
+
+void xq_client_close(xq_client_t* client) {
+    if (!client) {
+        return;
+    }
+    xq_loop_t* loop = client->loop;
+    atomic_store(&client->closing, true);
+
+    pthread_mutex_lock(&loop->lock);
+    if (!loop->running) {
+        pthread_mutex_unlock(&loop->lock);
+        free_client(client);
+        return;
+    }
+
+    /* The loop may be holding this client in its current batch of events, so only the loop frees it */
+    client->close_next = loop->pending_close;
+    loop->pending_close = client;
+    unsigned long ticket = ++loop->close_requested;
+
+    if (on_loop_thread(loop)) {
+        pthread_mutex_unlock(&loop->lock);
+        teardown(client);
+        return;
+    }
+
+    pthread_mutex_unlock(&loop->lock);
+    wake_loop(loop);
+
+    pthread_mutex_lock(&loop->lock);
+    while (loop->close_completed < ticket) {
+        pthread_cond_wait(&loop->closed, &loop->lock);
+    }
+    pthread_mutex_unlock(&loop->lock);
+}
@@ -0,0 +1,88 @@
+#ifndef XQ_CLIENT_H
+#define XQ_CLIENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Connections to the game server, any number per process. Every xq_client_t belongs to one xq_loop_t, an epoll
+ * reactor that connects, reads and flushes all of its connections on a single thread: either the caller's, through
+ * xq_loop_run, or a background one from xq_loop_start. Callbacks always run on the loop thread and may send or
+ * close freely.
+ *
+ * xq_client_send may be called from any thread. It never blocks: the line is written straight away when the socket
+ * has room, and whatever does not fit waits in the connection's send queue until epoll reports the socket writable.
+ * Sends made before the connection opens are queued the same way. xq_client_send_batch hands the socket a whole
+ * batch with one writev, so requests issued together leave in the same segment.
+ *
+ * A connection can also cap how many requests await an answer (xq_client_set_window). A message sent with a seq
+ * counts against the window until a response or error frame with that seq comes back; the server starts every
+ * such frame with {"type":"response","seq":N or {"type":"error","seq":N, so completion needs no JSON parsing.
+ * Messages past the window wait, in order, behind the requests in flight.
+ *
+ * A handle stays valid until xq_client_close, even after the server hangs up; the close callback only reports that
+ * the connection is gone.
+ */
+
+#define XQ_OK 0
+#define XQ_ERR_SOCKET -1
+#define XQ_ERR_IP -2
+#define XQ_ERR_CONNECT -3
+#define XQ_ERR_TIMEOUT -4
+#define XQ_ERR_MEMORY -5
+#define XQ_ERR_SEND -6
+#define XQ_ERR_NOTCONN -7
+#define XQ_ERR_QUEUE_FULL -8
+
+#define XQ_SEND_QUEUE_MAX (4 * 1024 * 1024) /* bytes waiting per connection before sends are refused */
+#define XQ_LINE_MAX (1024 * 1024)           /* longest server line; a longer one drops the connection */
+
+typedef struct xq_loop xq_loop_t;
+typedef struct xq_client xq_client_t;
+
+/* seq > 0 makes the message a request tracked by the in-flight window; 0 for fire-and-forget */
+typedef struct {
+    const char* json;
+    int seq;
+} xq_message_t;
+
+typedef struct {
+    void (*on_open)(xq_client_t* client, void* user_data);
+    /* line is NUL-terminated without its newline and only valid during the call */
+    void (*on_message)(xq_client_t* client, const char* line, size_t len, void* user_data);
+    /* error is XQ_OK when the server closed the connection, XQ_ERR_CONNECT when it never opened */
+    void (*on_close)(xq_client_t* client, int error, void* user_data);
+    void* user_data;
+} xq_client_callbacks_t;
+
+xq_loop_t* xq_loop_new(void);
+/* Closes any connection still open on the loop; the loop must be stopped */
+void xq_loop_free(xq_loop_t* loop);
+/* Runs the loop on this thread until xq_loop_stop */
+int xq_loop_run(xq_loop_t* loop);
+/* Runs the loop on a background thread */
+int xq_loop_start(xq_loop_t* loop);
+/* Wakes the loop and, when it runs on its own thread, waits for that thread to end */
+void xq_loop_stop(xq_loop_t* loop);
+int xq_loop_client_count(xq_loop_t* loop);
+
+/* Starts a non-blocking connect; on_open or on_close follows on the loop thread. NULL with *out_error set if the
+ * host does not resolve or no socket could be made. */
+xq_client_t* xq_client_connect(xq_loop_t* loop, const char* host, int port, const xq_client_callbacks_t* callbacks,
+                               int* out_error);
+/* Queues json plus a newline */
+int xq_client_send(xq_client_t* client, const char* json);
+/* Sends every message, each plus a newline, in order; all or nothing against XQ_SEND_QUEUE_MAX */
+int xq_client_send_batch(xq_client_t* client, const xq_message_t* messages, int count);
+/* Most requests in flight at once; 0 (the default) for no limit */
+void xq_client_set_window(xq_client_t* client, int window);
+/* Stops counting a request against the window, e.g. once the caller gave up waiting for it */
+void xq_client_cancel(xq_client_t* client, int seq);
+int xq_client_in_flight(xq_client_t* client);
+bool xq_client_is_open(xq_client_t* client);
+size_t xq_client_queued_bytes(xq_client_t* client);
+/* No callbacks run for the client once this returns (or, on the loop thread, once its callback returns); the
+ * handle is freed */
+void xq_client_close(xq_client_t* client);
+
+#endif
@@ -25,6 +25,7 @@ class NetworkGameController extends GameController {
         this.isOnlineMode = false;
         this.isMyTurn = false;
         this.isSpectator = false;
+        this.spectateSeq = 0;
 
         this.onMatchFound = null;
         this.onOpponentMove = null;
@@ -168,6 +169,16 @@ class NetworkGameController extends GameController {
         }
     }
 
+    async playBot(level = 3, color = 'random') {
+        try {
+            const response = await this.network.playBot(level, color);
+            return response;
+        } catch (error) {
+            console.error('[NetworkGame] Play bot failed:', error);
+            throw error;
+        }
+    }
+
     handleMatchFound(payload) {
         let data = payload;
         if (typeof data === 'string') {
@@ -262,6 +273,15 @@ class NetworkGameController extends GameController {
     }
 
     handleOpponentMove(payload) {
+        if (this.isSpectator && payload.seq !== undefined) {
+            if (payload.seq <= this.spectateSeq) return;
+            if (payload.seq !== this.spectateSeq + 1) {
+                this.emit('spectate-gap', payload);
+                return;
+            }
+            this.spectateSeq = payload.seq;
+        }
+
         let fromRow, fromCol, toRow, toCol;
 
         if (payload.from && typeof payload.from === 'object') {
@@ -33,6 +33,10 @@ export async function findMatch(bridge, rated = true) {
     return bridge.sendAndWait('find_match', { rated: true }, 'match_found');
 }
 
+export async function playBot(bridge, level = 3, color = 'random') {
+    return bridge.sendAndWait('play_bot', { level, color }, 'play_bot');
+}
+
 export async function cancelMatch(bridge) {
     return bridge.sendAndWait('cancel_match', {}, 'cancel_match');
 }
@@ -111,6 +115,10 @@ export async function leaveSpectate(bridge, matchId) {
     return bridge.sendAndWait('leave_spectate', { match_id: matchId }, 'leave_spectate');
 }
 
+export async function spectateSync(bridge, matchId) {
+    return bridge.sendAndWait('spectate_sync', { match_id: matchId }, 'spectate_sync');
+}
+
 export async function getLiveMatches(bridge) {
     return bridge.sendAndWait('get_live_matches', {}, 'get_live_matches');
 }
@@ -119,8 +127,14 @@ export async function getProfile(bridge, userId = null) {
     return bridge.sendAndWait('get_profile', { user_id: userId }, 'get_profile');
 }
 
-export async function getMatchHistory(bridge, limit = 20, offset = 0) {
-    return bridge.sendAndWait('match_history', { limit, offset }, 'match_history');
+/* cursor is the next_cursor of the previous page; rows streamed in chunk frames come first, oldest rows last */
+export async function getMatchHistory(bridge, limit = 20, cursor = null) {
+    const response = await bridge.sendAndWait('match_history', cursor ? { limit, cursor } : { limit }, 'match_history');
+    if (response.payload && response.chunks?.length) {
+        const streamed = response.chunks.flatMap((chunk) => chunk.payload?.matches || []);
+        response.payload.matches = streamed.concat(response.payload.matches || []);
+    }
+    return response;
 }
 
 export async function getMatch(bridge, matchId) {
@@ -132,6 +146,10 @@ export async function getLeaderboard(bridge, limit = 10, offset = 0) {
     return response.payload || [];
 }
 
+export async function getLeaderboardRank(bridge, userId = null, radius = 2) {
+    return bridge.sendAndWait('leaderboard_rank', { user_id: userId, radius }, 'leaderboard_rank');
+}
+
 export async function sendChallenge(bridge, opponentId, rated = true) {
     return bridge.sendAndWait('challenge', { opponent_id: opponentId, rated }, 'challenge');
 }
@@ -8,7 +8,10 @@ class CClientBridge {
         this.sessionToken = null;
         this.eventListeners = new Map();
         this.pendingRequests = new Map();
-        this._messagePollInterval = null;
+        this._outbox = [];
+        this._streamAttached = false;
+        this._earlyMessages = [];
+        this._lastMessageSeq = 0;
 
         this._heartbeatInterval = null;
         this._heartbeatPingInterval = 10000;
@@ -43,15 +46,22 @@ class CClientBridge {
 
             const msgType = message.type;
 
+            /* Streamed replies (match_history_chunk) arrive under the request's seq ahead of its final response */
+            if (msgType?.endsWith('_chunk') && this.pendingRequests.has(message.seq)) {
+                this.pendingRequests.get(message.seq).chunks.push(message);
+                return;
+            }
+
             if (msgType === 'response' || msgType === 'error') {
                 const seq = message.seq;
                 if (seq && this.pendingRequests.has(seq)) {
-                    const { resolve, reject } = this.pendingRequests.get(seq);
+                    const { resolve, reject, chunks } = this.pendingRequests.get(seq);
                     this.pendingRequests.delete(seq);
 
                     if (msgType === 'error') {
                         reject(new Error(message.message || 'Server error'));
                     } else {
+                        message.chunks = chunks;
                         resolve(message);
                     }
                     return;
@@ -91,17 +101,14 @@ class CClientBridge {
             payload,
         };
 
-        const jsonStr = JSON.stringify(message);
-        const result = await window.pywebview.api.send(jsonStr);
-
-        if (!result.success) {
-            throw new Error(result.message || 'Send failed');
-        }
-
+        /* Registered before the write so a fast response always finds its request */
+        let response = null;
+        let timeout = null;
         if (expectedResponse) {
-            return new Promise((resolve, reject) => {
-                const timeout = setTimeout(() => {
+            response = new Promise((resolve, reject) => {
+                timeout = setTimeout(() => {
                     this.pendingRequests.delete(seq);
+                    window.pywebview.api.cancel(seq).catch(() => {});
                     reject(new Error('Request timeout'));
                 }, 10000);
 
@@ -114,11 +121,46 @@ class CClientBridge {
                         clearTimeout(timeout);
                         reject(error);
                     },
+                    chunks: [],
                 });
             });
         }
 
-        return { success: true };
+        const result = await this._queueSend(JSON.stringify(message), expectedResponse ? seq : 0);
+
+        if (!result.success) {
+            clearTimeout(timeout);
+            this.pendingRequests.delete(seq);
+            throw new Error(result.message || 'Send failed');
+        }
+
+        return response || { success: true };
+    }
+
+    /*
+     * Sends issued in the same tick, like the lobby's initial loads, leave as one send_batch: one bridge call and
+     * one writev. A seq marks a request that holds a slot of the library's in-flight window.
+     */
+    _queueSend(json, seq) {
+        return new Promise((resolve) => {
+            this._outbox.push({ json, seq, resolve });
+            if (this._outbox.length === 1) {
+                queueMicrotask(() => this._flushOutbox());
+            }
+        });
+    }
+
+    async _flushOutbox() {
+        const batch = this._outbox;
+        this._outbox = [];
+
+        let result;
+        try {
+            result = await window.pywebview.api.send_batch(batch.map(({ json, seq }) => [json, seq]));
+        } catch (error) {
+            result = { success: false, message: error.message };
+        }
+        batch.forEach(({ resolve }) => resolve(result));
     }
 
     async sendAndWait(type, payload = {}, expectedResponse = null) {
@@ -168,6 +210,10 @@ class CClientBridge {
         return api.findMatch(this, rated);
     }
 
+    async playBot(level = 3, color = 'random') {
+        return api.playBot(this, level, color);
+    }
+
     async cancelMatch() {
         return api.cancelMatch(this);
     }
@@ -236,6 +282,10 @@ class CClientBridge {
         return api.leaveSpectate(this, matchId);
     }
 
+    async spectateSync(matchId) {
+        return api.spectateSync(this, matchId);
+    }
+
     async getLiveMatches() {
         return api.getLiveMatches(this);
     }
@@ -244,8 +294,8 @@ class CClientBridge {
         return api.getProfile(this, userId);
     }
 
-    async getMatchHistory(limit = 20, offset = 0) {
-        return api.getMatchHistory(this, limit, offset);
+    async getMatchHistory(limit = 20, cursor = null) {
+        return api.getMatchHistory(this, limit, cursor);
     }
 
     async getMatch(matchId) {
@@ -256,6 +306,10 @@ class CClientBridge {
         return api.getLeaderboard(this, limit, offset);
     }
 
+    async getLeaderboardRank(userId = null, radius = 2) {
+        return api.getLeaderboardRank(this, userId, radius);
+    }
+
     async sendChallenge(opponentId, rated = true) {
         return api.sendChallenge(this, opponentId, rated);
     }
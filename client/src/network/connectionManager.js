@@ -1,31 +1,46 @@
-export function startMessagePolling(bridge, intervalMs = 50) {
-    if (bridge._messagePollInterval) return;
-
-    bridge._messagePollInterval = setInterval(() => {
-        pollMessages(bridge);
-    }, intervalMs);
+/*
+ * The launcher pushes server messages in batches through window.__xqReceive as soon as they arrive, each as a
+ * [seq, json] pair numbered by the launcher. attach() hands over whatever queued up while no page was listening,
+ * which can include a batch that is being pushed at the same time. Pushes that land before attach() returns are
+ * held back and merged with the backlog by seq; a seq at or below the last one handled is a repeat and skipped.
+ */
+function deliverMessages(bridge, entries) {
+    entries.forEach(([seq, message]) => {
+        if (seq <= bridge._lastMessageSeq) return;
+        bridge._lastMessageSeq = seq;
+        bridge.handleMessage(message);
+    });
 }
 
-export function stopMessagePolling(bridge) {
-    if (bridge._messagePollInterval) {
-        clearInterval(bridge._messagePollInterval);
-        bridge._messagePollInterval = null;
-    }
-}
+export async function attachMessageStream(bridge) {
+    if (window.__xqReceive) return;
 
-async function pollMessages(bridge) {
-    if (!window.pywebview?.api) return;
+    bridge._streamAttached = false;
+    bridge._earlyMessages = [];
+    bridge._lastMessageSeq = 0;
+    window.__xqReceive = (entries) => {
+        if (!bridge._streamAttached) {
+            bridge._earlyMessages.push(...entries);
+        } else {
+            deliverMessages(bridge, entries);
+        }
+        return true;
+    };
 
+    let backlog = [];
     try {
-        const messages = await window.pywebview.api.get_messages();
-        if (messages && Array.isArray(messages) && messages.length > 0) {
-            messages.forEach((message) => {
-                bridge.handleMessage(message);
-            });
-        }
+        backlog = (await window.pywebview.api.attach()) || [];
     } catch (error) {
-        console.error('[ConnectionManager] Poll error:', error);
+        console.error('[ConnectionManager] Attach error:', error);
     }
+    deliverMessages(bridge, backlog.concat(bridge._earlyMessages).sort((a, b) => a[0] - b[0]));
+    bridge._earlyMessages = [];
+    bridge._streamAttached = true;
+}
+
+export function detachMessageStream(bridge) {
+    delete window.__xqReceive;
+    bridge._streamAttached = false;
 }
 
 export function startHeartbeat(bridge) {
@@ -207,7 +222,7 @@ export async function connect(bridge, host, port) {
                     if (result.success) {
                         bridge.connected = true;
                         bridge.emit('connected');
-                        startMessagePolling(bridge);
+                        await attachMessageStream(bridge);
                         startHeartbeat(bridge);
 
                         const success = await reloginAfterReconnect(bridge);
@@ -238,7 +253,7 @@ export async function disconnect(bridge) {
         console.error('[ConnectionManager] Disconnect error:', error);
     }
 
-    stopMessagePolling(bridge);
+    detachMessageStream(bridge);
     stopHeartbeat(bridge);
     bridge.connected = false;
     bridge.emit('disconnected');
@@ -37,55 +37,23 @@ export async function joinSpectate(syncTimerCallback, updateTurnCallback) {
     try {
         const joinResult = await gameController.joinSpectate(spectateData.match_id);
 
-        if (joinResult && joinResult.payload && joinResult.payload.match_data) {
-            const matchData =
-                typeof joinResult.payload.match_data === 'string'
-                    ? JSON.parse(joinResult.payload.match_data)
-                    : joinResult.payload.match_data;
+        if (joinResult && joinResult.payload && joinResult.payload.keyframe) {
+            const keyframe =
+                typeof joinResult.payload.keyframe === 'string'
+                    ? JSON.parse(joinResult.payload.keyframe)
+                    : joinResult.payload.keyframe;
 
             if (!gameController.chessboard) {
                 throw new Error('Chessboard not initialized');
             }
 
-            if (!gameController.chessboard.board) {
-                throw new Error('Board not initialized');
-            }
-
             if (!gameController.ui) {
                 gameController.initBoardUI('xiangqi-board');
             }
 
             gameController.setupBoard({ flipped: false });
+            applyKeyframe(keyframe, syncTimerCallback);
 
-            if (matchData.moves && matchData.moves.length > 0) {
-                for (const move of matchData.moves) {
-                    if (!isValidMove(move)) {
-                        console.warn('[Spectate] Invalid move coordinates:', move);
-                        continue;
-                    }
-
-                    const piece = gameController.chessboard.board[move.from.row][move.from.col];
-                    if (piece) {
-                        gameController.chessboard.board[move.from.row][move.from.col] = null;
-                        gameController.chessboard.board[move.to.row][move.to.col] = piece;
-                        piece.row = move.to.row;
-                        piece.col = move.to.col;
-
-                        gameController.chessboard.turn = gameController.chessboard.turn === 'red' ? 'black' : 'red';
-                        gameController.chessboard.turnCnt++;
-                    } else {
-                        console.warn('[Spectate] No piece at position:', move.from);
-                    }
-                }
-
-                if (gameController.ui) {
-                    gameController.ui.renderBoard(gameController.chessboard.board);
-                }
-            }
-
-            if (matchData.red_time_ms !== undefined && matchData.black_time_ms !== undefined) {
-                syncTimerCallback?.(matchData.red_time_ms, matchData.black_time_ms);
-            }
             if (joinResult.payload.current_turn) {
                 const currentTurn = joinResult.payload.current_turn;
                 gameController.isMyTurn = currentTurn === gameController.myColor;
@@ -94,8 +62,8 @@ export async function joinSpectate(syncTimerCallback, updateTurnCallback) {
 
             const playerName = document.querySelector('#player-name');
             const opponentName = document.querySelector('#opponent-name');
-            if (playerName) playerName.textContent = `🔴 Player #${matchData.red_user_id}`;
-            if (opponentName) opponentName.textContent = `⚫ Player #${matchData.black_user_id}`;
+            if (playerName) playerName.textContent = `🔴 Player #${keyframe.red_user_id}`;
+            if (opponentName) opponentName.textContent = `⚫ Player #${keyframe.black_user_id}`;
         }
 
         return joinResult;
@@ -117,6 +85,62 @@ export async function leaveSpectate() {
     window.location.href = 'lobby.html';
 }
 
+const KEYFRAME_PIECES = {
+    k: 'general',
+    a: 'advisor',
+    e: 'elephant',
+    h: 'horse',
+    r: 'chariot',
+    c: 'cannon',
+    p: 'pawn',
+};
+
+// Rebuilds the board from a server keyframe: 90 piece letters, row 0 first, uppercase red
+function applyKeyframe(keyframe, syncTimerCallback) {
+    const position = keyframe.position || '';
+    if (position.length !== 90) {
+        console.warn('[Spectate] Invalid keyframe position');
+        return;
+    }
+
+    const situation = [];
+    for (let sq = 0; sq < 90; sq++) {
+        const letter = position[sq];
+        const type = KEYFRAME_PIECES[letter.toLowerCase()];
+        if (!type) continue;
+        const color = letter === letter.toUpperCase() ? 'red' : 'black';
+        situation.push([type, color, Math.floor(sq / 9), sq % 9]);
+    }
+
+    gameController.chessboard.initBoard(situation);
+    gameController.chessboard.turn = keyframe.current_turn || 'red';
+    gameController.chessboard.turnCnt = keyframe.seq || 0;
+    gameController.chessboard.curPiece = null;
+    gameController.spectateSeq = keyframe.seq || 0;
+
+    if (gameController.ui) {
+        gameController.ui.renderBoard(gameController.chessboard.board);
+    }
+
+    if (keyframe.red_time_ms !== undefined && keyframe.black_time_ms !== undefined) {
+        syncTimerCallback?.(keyframe.red_time_ms, keyframe.black_time_ms);
+    }
+}
+
+async function resyncFromKeyframe(syncTimerCallback) {
+    if (!gameController?.network || !spectateData) return;
+
+    try {
+        const result = await gameController.network.spectateSync(spectateData.match_id);
+        const keyframe = typeof result.payload === 'string' ? JSON.parse(result.payload) : result.payload;
+        if (keyframe) {
+            applyKeyframe(keyframe, syncTimerCallback);
+        }
+    } catch (e) {
+        console.warn('[Spectate] Resync failed:', e);
+    }
+}
+
 function isValidMove(move) {
     return (
         move.from &&
@@ -135,6 +159,14 @@ function isValidMove(move) {
 export function setupSpectateListeners(controller, syncTimerCallback) {
     if (!controller.network) return;
 
+    let resyncing = false;
+    controller.on('spectate-gap', async () => {
+        if (resyncing) return;
+        resyncing = true;
+        await resyncFromKeyframe(syncTimerCallback);
+        resyncing = false;
+    });
+
     controller.network.on('spectate_move', (data) => {
         const payload = data.payload || data;
         if (payload.from && payload.to) {
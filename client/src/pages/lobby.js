@@ -59,6 +59,17 @@ async function loadProfile() {
     await profile.loadProfile(window.gameController?.network, showMessage);
 }
 
+/* Issued together so the four requests leave in one batch and come back in one round trip */
+async function loadLobbyData(gameController) {
+    const network = gameController.network;
+    await Promise.all([
+        profile.loadLeaderboard(gameController),
+        profile.loadProfile(network, showMessage),
+        roomManager.refreshRoomList(network, showMessage),
+        profile.refreshLiveMatches(network, showMessage),
+    ]);
+}
+
 function handleMenuAction(action) {
     switch (action) {
         case 'create-room':
@@ -216,6 +227,11 @@ if (btnFindMatch) {
         });
     }
 
+    document.getElementById('btn-play-bot')?.addEventListener('click', async () => {
+        const level = parseInt(document.getElementById('bot-level')?.value, 10) || 3;
+        await matchmaking.startBotMatch(gameController, level, showMessage);
+    });
+
     document.getElementById('btn-cancel-search')?.addEventListener('click', async () => {
         await matchmaking.cancelMatchSearch(gameController, showMessage);
     });
@@ -267,5 +283,5 @@ if (btnFindMatch) {
         await roomManager.startRoomGame(window.gameController?.network, showMessage);
     });
     setupNetworkListeners(gameController);
-    setTimeout(() => profile.loadLeaderboard(gameController), 500);
+    setTimeout(() => loadLobbyData(gameController), 500);
 })();
@@ -55,6 +55,35 @@ export async function startMatchSearch(gameController, showMessage) {
     }
 }
 
+export async function startBotMatch(gameController, level, showMessage) {
+    if (!gameController?.network) {
+        showMessage('error', 'Chưa kết nối đến máy chủ! Vui lòng đợi...');
+        return false;
+    }
+
+    const btnPlayBot = document.getElementById('btn-play-bot');
+    if (btnPlayBot) btnPlayBot.disabled = true;
+
+    try {
+        const response = await gameController.playBot(level);
+        let payload = response?.payload;
+        if (typeof payload === 'string') {
+            try {
+                payload = JSON.parse(payload);
+            } catch (e) {}
+        }
+        if (payload && payload.match_id) {
+            payload.opponent_name = payload.your_color === 'red' ? payload.black_user : payload.red_user;
+            handleMatchFound(payload);
+        }
+        return true;
+    } catch (error) {
+        showMessage('error', `Lỗi: ${error.message}`);
+        if (btnPlayBot) btnPlayBot.disabled = false;
+        return false;
+    }
+}
+
 export async function cancelMatchSearch(gameController, showMessage = null) {
     const btnFindMatch = document.getElementById('btn-find-match');
     const searchingDiv = document.getElementById('searching-indicator');
@@ -41,6 +41,13 @@ export function displayProfile(profile) {
     if (!container) return;
 
     const firstLetter = profile.username ? profile.username.charAt(0).toUpperCase() : '?';
+    const position = profile.leaderboard_rank
+        ? `<div class="profile-position">Hạng #${profile.leaderboard_rank} / ${profile.leaderboard_total}</div>`
+        : '';
+    const deviation = profile.rating_deviation ? ` ±${profile.rating_deviation}` : '';
+    const stats = profile.stats;
+    const streak = stats?.streak.current || 0;
+    const streakText = streak > 0 ? `${streak} trận thắng` : streak < 0 ? `${-streak} trận thua` : '-';
 
     container.innerHTML = `
         <div class="profile-header">
@@ -48,7 +55,8 @@ export function displayProfile(profile) {
             <div class="profile-username">${profile.username}</div>
             <div class="profile-id">ID: ${profile.user_id}</div>
             <div class="profile-rank">${profile.rank_title}</div>
-            <div class="profile-rating-big">Rating: ${profile.rating}</div>
+            ${position}
+            <div class="profile-rating-big">Rating: ${profile.rating}${deviation}</div>
         </div>
         
         <div class="profile-stats">
@@ -72,7 +80,11 @@ export function displayProfile(profile) {
                 <div class="winrate-fill" style="width: ${profile.win_rate}%"></div>
             </div>
             <div>Tỷ lệ thắng: <strong>${profile.win_rate.toFixed(1)}%</strong></div>
+            <div>Chuỗi hiện tại: <strong>${streakText}</strong></div>
+            <div>Chuỗi thắng dài nhất: <strong>${stats?.streak.best_win || 0}</strong></div>
         </div>
+
+        ${stats ? renderStats(stats) : ''}
         
         <div class="profile-joined">
             Tham gia: ${profile.created_at || 'N/A'}
@@ -80,6 +92,71 @@ export function displayProfile(profile) {
     `;
 }
 
+const CHART_WIDTH = 300;
+const CHART_HEIGHT = 90;
+
+/* Rating curve as an SVG polyline scaled to the player's own range */
+function renderRatingChart(history) {
+    if (history.length < 2) return '';
+
+    const ratings = history.map(([, rating]) => rating);
+    const min = Math.min(...ratings);
+    const span = Math.max(Math.max(...ratings) - min, 1);
+    const points = ratings
+        .map((rating, i) => {
+            const x = (i / (ratings.length - 1)) * CHART_WIDTH;
+            const y = CHART_HEIGHT - ((rating - min) / span) * CHART_HEIGHT;
+            return `${x.toFixed(1)},${y.toFixed(1)}`;
+        })
+        .join(' ');
+
+    return `
+        <div class="profile-chart">
+            <div class="profile-chart-title">Rating ${min} - ${min + span}</div>
+            <svg viewBox="0 0 ${CHART_WIDTH} ${CHART_HEIGHT}" preserveAspectRatio="none">
+                <polyline points="${points}" />
+            </svg>
+        </div>
+    `;
+}
+
+function renderColorRate(label, tally) {
+    const games = tally.wins + tally.losses + tally.draws;
+    const rate = games ? (tally.wins / games) * 100 : 0;
+    return `
+        <div class="color-rate">
+            <span>${label}</span>
+            <div class="winrate-bar"><div class="winrate-fill" style="width: ${rate}%"></div></div>
+            <span>${rate.toFixed(0)}% (${games})</span>
+        </div>
+    `;
+}
+
+function renderStats(stats) {
+    const opponents = stats.head_to_head
+        .map(
+            (h2h) => `
+            <tr>
+                <td>${h2h.username || '#' + h2h.user_id}</td>
+                <td>${h2h.wins} - ${h2h.losses} - ${h2h.draws}</td>
+            </tr>
+        `
+        )
+        .join('');
+    const headToHead = opponents
+        ? `<table class="profile-h2h"><tr><th>Đối thủ</th><th>T - B - H</th></tr>${opponents}</table>`
+        : '';
+
+    return `
+        ${renderRatingChart(stats.rating_history)}
+        <div class="profile-colors">
+            ${renderColorRate('Quân đỏ', stats.colors.red)}
+            ${renderColorRate('Quân đen', stats.colors.black)}
+        </div>
+        ${headToHead}
+    `;
+}
+
 export function copyUserId(showMessage) {
     if (currentProfileData && currentProfileData.user_id) {
         navigator.clipboard
@@ -123,7 +200,7 @@ export function displayLeaderboard(leaderboard) {
     tbody.innerHTML = '';
 
     leaderboard.slice(0, 5).forEach((player, index) => {
-        const rank = index + 1;
+        const rank = player.rank || index + 1;
         let rankBadge = `<span class="rank-badge">${rank}</span>`;
 
         if (rank === 1) rankBadge = `<span class="rank-badge gold">👑</span>`;
@@ -12,6 +12,14 @@ let board = null;
 let userData = null;
 let replayBoard = null;
 let replayUI = null;
+let analysis = null;
+let historyMatches = [];
+let historyCursor = null;
+
+const ENGINE_MATE = 30000;
+const ENGINE_MAX_PLY = 64;
+const MOVE_CLASS_TAGS = ['', '?!', '?', '??'];
+const MOVE_CLASS_NAMES = ['', 'Thiếu chính xác', 'Sai lầm', 'Sai lầm nghiêm trọng'];
 
 const OPENING_POSITION = [
     ['chariot', 'red', 9, 0],
@@ -104,15 +112,22 @@ const OPENING_POSITION = [
     }
 })();
 
-async function loadMatchHistory() {
+const HISTORY_PAGE_SIZE = 50;
+
+async function loadMatchHistory(more = false) {
     try {
-        const matchListEl = document.getElementById('match-list');
-        matchListEl.innerHTML = '<div class="loading"><div class="spinner"></div><p>Đang tải...</p></div>';
+        if (!more) {
+            const matchListEl = document.getElementById('match-list');
+            matchListEl.innerHTML = '<div class="loading"><div class="spinner"></div><p>Đang tải...</p></div>';
+            historyMatches = [];
+            historyCursor = null;
+        }
 
-        const response = await gameController.network.getMatchHistory(50, 0);
-        const matches = response.payload?.matches || [];
+        const response = await gameController.network.getMatchHistory(HISTORY_PAGE_SIZE, historyCursor);
+        historyMatches = historyMatches.concat(response.payload?.matches || []);
+        historyCursor = response.payload?.next_cursor || null;
 
-        displayMatchList(matches);
+        displayMatchList(historyMatches);
     } catch (error) {
         console.error('Failed to load history:', error);
         console.error('[Replay] Error details:', error.message, error.stack);
@@ -141,6 +156,7 @@ function displayMatchList(matches) {
             const resultText = match.result === 'win' ? 'Thắng' : match.result === 'loss' ? 'Thua' : 'Hòa';
 
             const colorIcon = match.my_color === 'red' ? '🔴' : '⚫';
+            const delta = match.rating_delta ? ` (${match.rating_delta > 0 ? '+' : ''}${match.rating_delta})` : '';
 
             let date;
             const endedAt = match.ended_at;
@@ -167,7 +183,7 @@ function displayMatchList(matches) {
                 <div class="opponent">${colorIcon} vs ${match.opponent}</div>
                 <div class="details">
                     <span>${dateStr}</span>
-                    <span class="result ${resultClass}">${resultText}</span>
+                    <span class="result ${resultClass}">${resultText}${delta}</span>
                 </div>
             </div>
         `;
@@ -182,6 +198,17 @@ function displayMatchList(matches) {
             loadMatchReplay(item.dataset.matchId);
         });
     });
+
+    if (historyCursor) {
+        const loadMore = document.createElement('button');
+        loadMore.className = 'load-more';
+        loadMore.textContent = 'Xem thêm';
+        loadMore.addEventListener('click', () => {
+            loadMore.disabled = true;
+            loadMatchHistory(true);
+        });
+        container.appendChild(loadMore);
+    }
 }
 
 async function loadMatchReplay(matchId) {
@@ -203,6 +230,8 @@ async function loadMatchReplay(matchId) {
             moves = currentMatchData.moves || [];
         }
 
+        analysis = decodeAnalysis(currentMatchData.analysis);
+
         currentMoveIndex = -1;
         isPlaying = false;
         if (playInterval) clearInterval(playInterval);
@@ -221,6 +250,72 @@ async function loadMatchReplay(matchId) {
     }
 }
 
+/*
+ * Server-side post-game analysis, base64 of a little-endian record: a 10-byte header (version, depth, red and
+ * black accuracy x10, plies, starting eval) then 4 bytes per ply (eval after the move, then the engine's best
+ * move packed as from << 9 | to << 2 | class). Evals are centipawns from red's side.
+ */
+function decodeAnalysis(encoded) {
+    if (!encoded) return null;
+    try {
+        const bytes = Uint8Array.from(atob(encoded), (c) => c.charCodeAt(0));
+        const view = new DataView(bytes.buffer);
+        if (bytes.length < 10 || view.getUint8(0) !== 1) return null;
+
+        const plyCount = view.getUint16(6, true);
+        if (bytes.length < 10 + plyCount * 4) return null;
+
+        const plies = [];
+        for (let i = 0; i < plyCount; i++) {
+            const packed = view.getUint16(10 + i * 4 + 2, true);
+            const from = packed >> 9;
+            const to = (packed >> 2) & 0x7f;
+            plies.push({
+                eval: view.getInt16(10 + i * 4, true),
+                best: {
+                    from: { row: Math.floor(from / 9), col: from % 9 },
+                    to: { row: Math.floor(to / 9), col: to % 9 },
+                },
+                cls: packed & 3,
+            });
+        }
+
+        return {
+            depth: view.getUint8(1),
+            accuracy: { red: view.getUint16(2, true) / 10, black: view.getUint16(4, true) / 10 },
+            startEval: view.getInt16(8, true),
+            plies,
+        };
+    } catch (error) {
+        console.error('[Replay] Bad analysis data:', error);
+        return null;
+    }
+}
+
+function formatEval(cp) {
+    if (Math.abs(cp) > ENGINE_MATE - ENGINE_MAX_PLY) {
+        const mateIn = Math.ceil((ENGINE_MATE - Math.abs(cp)) / 2);
+        return (cp > 0 ? '+' : '-') + '#' + mateIn;
+    }
+    return (cp >= 0 ? '+' : '') + (cp / 100).toFixed(2);
+}
+
+function accuracyHtml(color) {
+    if (!analysis) {
+        return '<div class="accuracy pending">Đang phân tích...</div>';
+    }
+    const sideMoves = Math.floor((analysis.plies.length + (color === 'red' ? 1 : 0)) / 2);
+    const value = sideMoves > 0 ? analysis.accuracy[color].toFixed(1) + '%' : '-';
+    return `<div class="accuracy" title="Độ sâu phân tích ${analysis.depth}">Chính xác: ${value}</div>`;
+}
+
+function openingHtml() {
+    const opening = currentMatchData.opening;
+    if (!opening || !opening.name) return '';
+    const title = `${opening.book_plies} nước đầu theo sách khai cuộc`;
+    return `<div class="opening-name" title="${title}">📖 ${opening.name}</div>`;
+}
+
 function createReplayUI() {
     const boardPanel = document.getElementById('replay-board-panel');
 
@@ -236,11 +331,16 @@ function createReplayUI() {
             <div class="player-info red">
                 <div class="name">🔴 ${currentMatchData.red_user}</div>
                 <div class="color">Quân Đỏ</div>
+                ${accuracyHtml('red')}
+            </div>
+            <div class="result-center">
+                <div class="vs-badge">${resultText}</div>
+                ${openingHtml()}
             </div>
-            <div class="vs-badge">${resultText}</div>
             <div class="player-info black">
                 <div class="name">⚫ ${currentMatchData.black_user}</div>
                 <div class="color">Quân Đen</div>
+                ${accuracyHtml('black')}
             </div>
         </div>
 
@@ -408,12 +508,28 @@ function displayMovesList() {
                 const colorClass = move.color || (i % 2 === 0 ? 'red' : 'black');
                 const colorName = colorClass === 'red' ? '🔴 Đỏ' : '⚫ Đen';
 
-                const moveText = `(${move.from.row},${move.from.col}) → (${move.to.row},${move.to.col})`;
+                const moveText =
+                    move.notation || `(${move.from.row},${move.from.col}) → (${move.to.row},${move.to.col})`;
+
+                const inBook = currentMatchData.opening && i < currentMatchData.opening.book_plies;
+                const bookMark = inBook ? '<span class="book-mark" title="Sách khai cuộc">📖</span>' : '';
+
+                const ply = analysis && analysis.plies[i];
+                let annotation = '';
+                let title = '';
+                if (ply) {
+                    const { from, to } = ply.best;
+                    const bestText = `(${from.row},${from.col}) → (${to.row},${to.col})`;
+                    title = ` title="${MOVE_CLASS_NAMES[ply.cls] || 'Nước tốt'}. Máy đề xuất: ${bestText}"`;
+                    annotation = `
+                    <span class="move-tag cls-${ply.cls}">${MOVE_CLASS_TAGS[ply.cls]}</span>
+                    <span class="move-eval">${formatEval(ply.eval)}</span>`;
+                }
 
                 return `
-                <div class="move-item" data-index="${i}">
+                <div class="move-item" data-index="${i}"${title}>
                     <span class="num">${i + 1}.</span>
-                    <span class="move-text ${colorClass}">${colorName}: ${moveText}</span>
+                    <span class="move-text ${colorClass}">${colorName}: ${moveText}</span>${bookMark}${annotation}
                 </div>
             `;
             })
@@ -0,0 +1,755 @@
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/board.h"
+#include "../include/protocol.h"
+
+/*
+ * Headless bot fleet for end-to-end benchmarks. Every bot is one connection on a shared epoll loop speaking
+ * the same newline-delimited JSON as client/lib/client.c: register, login, then either queue through
+ * find_match and play random legal games, or hop between live matches as a spectator.
+ */
+
+#define RECV_BUFFER_SIZE 16384
+#define MAX_EVENTS 1024
+#define TICK_MS 5
+#define REPORT_INTERVAL_US 5000000ULL
+#define RETRY_DELAY_US 1000000ULL
+
+typedef enum {
+    BOT_CONNECTING,
+    BOT_REGISTERING,
+    BOT_LOGGING_IN,
+    BOT_IDLE,
+    BOT_QUEUED,
+    BOT_PLAYING,
+    BOT_SPECTATING,
+    BOT_DEAD
+} bot_state_t;
+
+typedef enum {
+    REQ_NONE,
+    REQ_REGISTER,
+    REQ_LOGIN,
+    REQ_FIND_MATCH,
+    REQ_MOVE,
+    REQ_LIVE_MATCHES,
+    REQ_JOIN_SPECTATE,
+    REQ_LEAVE_SPECTATE,
+    REQ_OTHER
+} request_kind_t;
+
+typedef enum { ACT_NONE, ACT_FIND_MATCH, ACT_MOVE, ACT_SPECTATE, ACT_LEAVE_SPECTATE } action_t;
+
+typedef struct {
+    int fd;
+    int index;
+    bot_state_t state;
+    bool spectator;
+
+    char* recv_buffer;
+    size_t recv_len;
+    char* send_buffer;
+    size_t send_len;
+    size_t send_capacity;
+    bool want_write;
+
+    int seq;
+    int expect_seq;
+    request_kind_t expect_kind;
+    char token[128];
+
+    char match_id[32];
+    bool black;
+    board_t board;
+    int ply;
+    int move_seq;
+    uint64_t move_sent_us;
+
+    uint64_t connect_started_us;
+    uint64_t next_action_us;
+    action_t next_action;
+} bot_t;
+
+typedef struct {
+    uint32_t* values;
+    size_t count;
+    size_t capacity;
+} samples_t;
+
+typedef struct {
+    const char* host;
+    int port;
+    int bots;
+    int connect_rate;
+    int move_delay_ms;
+    int duration_s;
+    int spectator_percent;
+    int chat_percent;
+    int max_plies;
+    int spectate_s;
+    const char* prefix;
+    const char* password;
+} options_t;
+
+static options_t opts = {"127.0.0.1", 8080, 1000, 200, 500, 60, 10, 5, 150, 10, "bot", "loadgen123"};
+
+static int epoll_fd = -1;
+static struct sockaddr_storage server_addr;
+static socklen_t server_addr_len = 0;
+
+static samples_t move_rtt;
+static samples_t connect_time;
+static uint64_t msgs_sent = 0;
+static uint64_t msgs_received = 0;
+static uint64_t bytes_sent = 0;
+static uint64_t bytes_received = 0;
+static uint64_t moves_sent = 0;
+static uint64_t move_errors = 0;
+static uint64_t games_started = 0;
+static uint64_t games_finished = 0;
+static uint64_t spectate_frames = 0;
+static int connected = 0;
+static int failed = 0;
+static uint64_t first_connect_us = 0;
+static uint64_t last_connect_us = 0;
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+static void samples_add(samples_t* s, uint64_t value) {
+    if (s->count == s->capacity) {
+        size_t new_capacity = s->capacity ? s->capacity * 2 : 4096;
+        uint32_t* values = realloc(s->values, new_capacity * sizeof(uint32_t));
+        if (!values)
+            return;
+        s->values = values;
+        s->capacity = new_capacity;
+    }
+    s->values[s->count++] = value > UINT32_MAX ? UINT32_MAX : (uint32_t)value;
+}
+
+static int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void samples_sort(samples_t* s) {
+    qsort(s->values, s->count, sizeof(uint32_t), compare_u32);
+}
+
+/* Expects samples_sort() first; several percentiles are read from one sort */
+static double samples_percentile(const samples_t* s, double p) {
+    if (s->count == 0)
+        return 0.0;
+    size_t index = (size_t)(p * (double)(s->count - 1));
+    return s->values[index] / 1000.0;
+}
+
+static void bot_update_write_interest(bot_t* bot) {
+    bool want_write = bot->state == BOT_CONNECTING || bot->send_len > 0;
+    if (want_write == bot->want_write)
+        return;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | (want_write ? EPOLLOUT : 0);
+    ev.data.ptr = bot;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, bot->fd, &ev);
+    bot->want_write = want_write;
+}
+
+static void bot_kill(bot_t* bot, const char* reason) {
+    if (bot->state == BOT_DEAD)
+        return;
+
+    if (bot->state == BOT_CONNECTING)
+        failed++;
+    else
+        connected--;
+
+    fprintf(stderr, "[Loadgen] Bot %d dropped: %s\n", bot->index, reason);
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, bot->fd, NULL);
+    close(bot->fd);
+    bot->fd = -1;
+    bot->state = BOT_DEAD;
+    bot->next_action = ACT_NONE;
+}
+
+static void bot_flush(bot_t* bot) {
+    while (bot->send_len > 0) {
+        ssize_t n = send(bot->fd, bot->send_buffer, bot->send_len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            bot_kill(bot, strerror(errno));
+            return;
+        }
+        bytes_sent += (uint64_t)n;
+        memmove(bot->send_buffer, bot->send_buffer + n, bot->send_len - (size_t)n);
+        bot->send_len -= (size_t)n;
+    }
+    bot_update_write_interest(bot);
+}
+
+/* Queues {"type","seq","token","payload"} and returns the seq used */
+static int bot_send(bot_t* bot, request_kind_t kind, const char* type, const char* payload_fmt, ...) {
+    if (bot->state == BOT_DEAD)
+        return -1;
+
+    char payload[512];
+    va_list args;
+    va_start(args, payload_fmt);
+    vsnprintf(payload, sizeof(payload), payload_fmt, args);
+    va_end(args);
+
+    char line[1024];
+    int seq = ++bot->seq;
+    int len = snprintf(line, sizeof(line), "{\"type\":\"%s\",\"seq\":%d,\"token\":\"%s\",\"payload\":%s}\n", type, seq,
+                       bot->token, payload);
+    if (len <= 0 || (size_t)len >= sizeof(line))
+        return -1;
+
+    if (bot->send_len + (size_t)len > bot->send_capacity) {
+        size_t new_capacity = bot->send_capacity ? bot->send_capacity * 2 : 2048;
+        while (new_capacity < bot->send_len + (size_t)len)
+            new_capacity *= 2;
+        char* buffer = realloc(bot->send_buffer, new_capacity);
+        if (!buffer) {
+            bot_kill(bot, "out of memory");
+            return -1;
+        }
+        bot->send_buffer = buffer;
+        bot->send_capacity = new_capacity;
+    }
+
+    memcpy(bot->send_buffer + bot->send_len, line, (size_t)len);
+    bot->send_len += (size_t)len;
+    msgs_sent++;
+
+    if (kind != REQ_OTHER) {
+        bot->expect_seq = seq;
+        bot->expect_kind = kind;
+    }
+
+    bot_flush(bot);
+    return seq;
+}
+
+static void bot_schedule(bot_t* bot, action_t action, uint64_t delay_us) {
+    bot->next_action = action;
+    bot->next_action_us = now_us() + delay_us;
+}
+
+static void bot_send_login(bot_t* bot) {
+    bot->state = BOT_LOGGING_IN;
+    bot_send(bot, REQ_LOGIN, "login", "{\"username\":\"%s%d\",\"password\":\"%s\"}", opts.prefix, bot->index,
+             opts.password);
+}
+
+static void bot_play_move(bot_t* bot) {
+    if (bot->state != BOT_PLAYING)
+        return;
+
+    board_move_t moves[BOARD_MAX_MOVES];
+    int count = board_generate_moves(&bot->board, bot->black, moves);
+
+    if (count == 0) {
+        bot_send(bot, REQ_OTHER, "resign", "{\"match_id\":\"%s\"}", bot->match_id);
+        return;
+    }
+    if (bot->ply >= opts.max_plies) {
+        bot_send(bot, REQ_OTHER, "game_over", "{\"match_id\":\"%s\",\"result\":\"draw\",\"reason\":\"move_limit\"}",
+                 bot->match_id);
+        return;
+    }
+
+    board_move_t move = moves[rand() % count];
+    board_apply(&bot->board, move.from, move.to);
+    bot->ply++;
+
+    bot->move_sent_us = now_us();
+    bot->move_seq = bot_send(bot, REQ_MOVE, "move",
+                             "{\"match_id\":\"%s\",\"from_row\":%d,\"from_col\":%d,\"to_row\":%d,\"to_col\":%d}",
+                             bot->match_id, SQUARE_ROW(move.from), SQUARE_COL(move.from), SQUARE_ROW(move.to),
+                             SQUARE_COL(move.to));
+    moves_sent++;
+
+    if (rand() % 100 < opts.chat_percent) {
+        bot_send(bot, REQ_OTHER, "chat_message", "{\"match_id\":\"%s\",\"message\":\"gg from %s%d\"}", bot->match_id,
+                 opts.prefix, bot->index);
+    }
+}
+
+static bool parse_square(const char* json, const char* key, int* out_square) {
+    char search[32];
+    snprintf(search, sizeof(search), "\"%s\":", key);
+
+    const char* pos = strstr(json, search);
+    int row, col;
+    if (!pos || sscanf(pos + strlen(search), "{\"row\":%d,\"col\":%d}", &row, &col) != 2)
+        return false;
+    if (row < 0 || row >= BOARD_ROWS || col < 0 || col >= BOARD_COLS)
+        return false;
+
+    *out_square = SQUARE(row, col);
+    return true;
+}
+
+/* Picks a random match_id out of a get_live_matches response without a full JSON parse */
+static bool pick_live_match(const char* json, char* out, size_t out_size) {
+    int total = 0;
+    for (const char* p = json; (p = strstr(p, "\"match_id\":\"")) != NULL; p++)
+        total++;
+    if (total == 0)
+        return false;
+
+    int pick = rand() % total;
+    const char* p = json;
+    for (int i = 0; i <= pick; i++) {
+        p = strstr(p, "\"match_id\":\"") + 12;
+    }
+
+    const char* end = strchr(p, '"');
+    if (!end || (size_t)(end - p) >= out_size)
+        return false;
+    memcpy(out, p, (size_t)(end - p));
+    out[end - p] = '\0';
+    return true;
+}
+
+static void bot_handle_response(bot_t* bot, const char* line, bool success) {
+    int seq = json_get_int(line, "seq");
+
+    if (seq == bot->move_seq && bot->move_seq > 0) {
+        samples_add(&move_rtt, now_us() - bot->move_sent_us);
+        bot->move_seq = 0;
+        if (!success)
+            move_errors++;
+    }
+
+    if (seq != bot->expect_seq)
+        return;
+
+    request_kind_t kind = bot->expect_kind;
+    bot->expect_kind = REQ_NONE;
+
+    switch (kind) {
+    case REQ_REGISTER:
+        /* "Username already exists" is expected on reruns */
+        bot_send_login(bot);
+        break;
+    case REQ_LOGIN: {
+        char* token = success ? json_get_string(line, "token") : NULL;
+        if (!token) {
+            bot_kill(bot, "login failed");
+            return;
+        }
+        snprintf(bot->token, sizeof(bot->token), "%s", token);
+        free(token);
+        bot->state = BOT_IDLE;
+        bot_schedule(bot, bot->spectator ? ACT_SPECTATE : ACT_FIND_MATCH, 0);
+        break;
+    }
+    case REQ_FIND_MATCH:
+        if (!success && bot->state == BOT_QUEUED) {
+            bot->state = BOT_IDLE;
+            bot_schedule(bot, ACT_FIND_MATCH, RETRY_DELAY_US);
+        }
+        break;
+    case REQ_LIVE_MATCHES:
+        if (success && pick_live_match(line, bot->match_id, sizeof(bot->match_id))) {
+            bot_send(bot, REQ_JOIN_SPECTATE, "join_spectate", "{\"match_id\":\"%s\"}", bot->match_id);
+        } else {
+            bot_schedule(bot, ACT_SPECTATE, RETRY_DELAY_US);
+        }
+        break;
+    case REQ_JOIN_SPECTATE:
+        if (success) {
+            bot->state = BOT_SPECTATING;
+            bot_schedule(bot, ACT_LEAVE_SPECTATE, (uint64_t)opts.spectate_s * 1000000ULL);
+        } else {
+            bot_schedule(bot, ACT_SPECTATE, RETRY_DELAY_US);
+        }
+        break;
+    case REQ_LEAVE_SPECTATE:
+        bot->state = BOT_IDLE;
+        bot_schedule(bot, ACT_SPECTATE, 0);
+        break;
+    default:
+        break;
+    }
+}
+
+static void bot_handle_line(bot_t* bot, const char* line) {
+    msgs_received++;
+
+    char* type = json_get_string(line, "type");
+    if (!type)
+        return;
+
+    if (strcmp(type, "response") == 0 || strcmp(type, "error") == 0) {
+        bot_handle_response(bot, line, json_get_bool(line, "success"));
+    } else if (strcmp(type, "match_found") == 0) {
+        char* match_id = json_get_string(line, "match_id");
+        char* color = json_get_string(line, "your_color");
+        if (match_id && color && !bot->spectator) {
+            snprintf(bot->match_id, sizeof(bot->match_id), "%s", match_id);
+            bot->black = strcmp(color, "black") == 0;
+            board_init(&bot->board);
+            bot->ply = 0;
+            bot->state = BOT_PLAYING;
+            games_started++;
+            if (!bot->black)
+                bot_schedule(bot, ACT_MOVE, (uint64_t)opts.move_delay_ms * 1000ULL);
+        }
+        free(match_id);
+        free(color);
+    } else if (strcmp(type, "opponent_move") == 0) {
+        int from, to;
+        if (bot->state == BOT_SPECTATING) {
+            spectate_frames++;
+        } else if (bot->state == BOT_PLAYING && parse_square(line, "from", &from) && parse_square(line, "to", &to)) {
+            board_apply(&bot->board, from, to);
+            bot->ply++;
+            bot_schedule(bot, ACT_MOVE, (uint64_t)opts.move_delay_ms * 1000ULL);
+        }
+    } else if (strcmp(type, "game_end") == 0) {
+        if (bot->state == BOT_PLAYING) {
+            games_finished++;
+            bot->state = BOT_IDLE;
+            bot_schedule(bot, ACT_FIND_MATCH, RETRY_DELAY_US);
+        } else if (bot->state == BOT_SPECTATING) {
+            bot_schedule(bot, ACT_LEAVE_SPECTATE, 0);
+        }
+    }
+
+    free(type);
+}
+
+static void bot_read(bot_t* bot) {
+    while (bot->state != BOT_DEAD) {
+        ssize_t n = recv(bot->fd, bot->recv_buffer + bot->recv_len, RECV_BUFFER_SIZE - bot->recv_len - 1, 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                bot_kill(bot, strerror(errno));
+            return;
+        }
+        if (n == 0) {
+            bot_kill(bot, "server closed connection");
+            return;
+        }
+
+        bytes_received += (uint64_t)n;
+        bot->recv_len += (size_t)n;
+        bot->recv_buffer[bot->recv_len] = '\0';
+
+        char* start = bot->recv_buffer;
+        char* newline;
+        while ((newline = strchr(start, '\n')) != NULL) {
+            *newline = '\0';
+            if (newline > start)
+                bot_handle_line(bot, start);
+            if (bot->state == BOT_DEAD)
+                return;
+            start = newline + 1;
+        }
+
+        size_t remaining = bot->recv_buffer + bot->recv_len - start;
+        memmove(bot->recv_buffer, start, remaining);
+        bot->recv_len = remaining;
+
+        /* Oversized responses (a truncated live match list) are skipped rather than fatal */
+        if (bot->recv_len >= RECV_BUFFER_SIZE - 1)
+            bot->recv_len = 0;
+    }
+}
+
+static void bot_on_connected(bot_t* bot) {
+    int so_error = 0;
+    socklen_t len = sizeof(so_error);
+    getsockopt(bot->fd, SOL_SOCKET, SO_ERROR, &so_error, &len);
+    if (so_error != 0) {
+        bot_kill(bot, strerror(so_error));
+        return;
+    }
+
+    uint64_t now = now_us();
+    samples_add(&connect_time, now - bot->connect_started_us);
+    last_connect_us = now;
+    connected++;
+
+    bot->state = BOT_REGISTERING;
+    bot_update_write_interest(bot);
+    bot_send(bot, REQ_REGISTER, "register",
+             "{\"username\":\"%s%d\",\"email\":\"%s%d@loadgen.local\",\"password\":\"%s\"}", opts.prefix,
+             bot->index, opts.prefix, bot->index, opts.password);
+}
+
+static bool bot_start_connect(bot_t* bot) {
+    bot->fd = socket(server_addr.ss_family, SOCK_STREAM, 0);
+    if (bot->fd < 0) {
+        perror("socket");
+        return false;
+    }
+
+    int flags = fcntl(bot->fd, F_GETFL, 0);
+    fcntl(bot->fd, F_SETFL, flags | O_NONBLOCK);
+
+    bot->state = BOT_CONNECTING;
+    bot->connect_started_us = now_us();
+    if (first_connect_us == 0)
+        first_connect_us = bot->connect_started_us;
+
+    if (connect(bot->fd, (struct sockaddr*)&server_addr, server_addr_len) < 0 && errno != EINPROGRESS) {
+        close(bot->fd);
+        bot->fd = -1;
+        bot->state = BOT_DEAD;
+        failed++;
+        return false;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.ptr = bot;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, bot->fd, &ev);
+    bot->want_write = true;
+    return true;
+}
+
+static void bot_run_action(bot_t* bot) {
+    action_t action = bot->next_action;
+    bot->next_action = ACT_NONE;
+
+    switch (action) {
+    case ACT_FIND_MATCH:
+        bot->state = BOT_QUEUED;
+        bot_send(bot, REQ_FIND_MATCH, "find_match", "{\"rated\":false}");
+        break;
+    case ACT_MOVE:
+        bot_play_move(bot);
+        break;
+    case ACT_SPECTATE:
+        bot_send(bot, REQ_LIVE_MATCHES, "get_live_matches", "{}");
+        break;
+    case ACT_LEAVE_SPECTATE:
+        bot_send(bot, REQ_LEAVE_SPECTATE, "leave_spectate", "{\"match_id\":\"%s\"}", bot->match_id);
+        break;
+    default:
+        break;
+    }
+}
+
+static void print_progress(uint64_t elapsed_us, uint64_t window_us, uint64_t window_msgs) {
+    double rate = window_us ? (double)window_msgs * 1e6 / (double)window_us : 0.0;
+    printf("[Loadgen] t=%5.1fs conn=%d/%d failed=%d games=%lu/%lu moves=%lu msgs/s=%.0f\n", elapsed_us / 1e6,
+           connected, opts.bots, failed, (unsigned long)games_finished, (unsigned long)games_started,
+           (unsigned long)moves_sent, rate);
+    fflush(stdout);
+}
+
+static void print_summary(uint64_t elapsed_us) {
+    double seconds = elapsed_us / 1e6;
+    double setup_s = last_connect_us > first_connect_us ? (last_connect_us - first_connect_us) / 1e6 : 0.0;
+    int established = (int)connect_time.count;
+
+    printf("\n=== Loadgen summary (%.1fs, %d bots) ===\n", seconds, opts.bots);
+    printf("connections     : %d established, %d failed, %.0f conn/s setup rate\n", established, failed,
+           setup_s > 0 ? established / setup_s : (double)established);
+    samples_sort(&connect_time);
+    samples_sort(&move_rtt);
+    printf("connect latency : p50=%.2fms p99=%.2fms p999=%.2fms\n", samples_percentile(&connect_time, 0.50),
+           samples_percentile(&connect_time, 0.99), samples_percentile(&connect_time, 0.999));
+    printf("move rtt        : p50=%.2fms p99=%.2fms p999=%.2fms (%zu samples, %lu rejected)\n",
+           samples_percentile(&move_rtt, 0.50), samples_percentile(&move_rtt, 0.99),
+           samples_percentile(&move_rtt, 0.999), move_rtt.count, (unsigned long)move_errors);
+    printf("messages        : %.0f sent/s, %.0f received/s (%.1f KB/s out, %.1f KB/s in)\n", msgs_sent / seconds,
+           msgs_received / seconds, bytes_sent / 1024.0 / seconds, bytes_received / 1024.0 / seconds);
+    printf("games           : %lu started, %lu finished, %lu spectated move frames\n", (unsigned long)games_started,
+           (unsigned long)games_finished, (unsigned long)spectate_frames);
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-H host] [-p port] [-n bots] [-c connects/s] [-m move_delay_ms] [-d duration_s]\n"
+            "          [-s spectator_%%] [-t chat_%%] [-P max_plies] [-S spectate_s] [-u user_prefix]\n",
+            prog);
+}
+
+static bool resolve_server(void) {
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    char port_str[16];
+    snprintf(port_str, sizeof(port_str), "%d", opts.port);
+    if (getaddrinfo(opts.host, port_str, &hints, &res) != 0 || !res)
+        return false;
+
+    memcpy(&server_addr, res->ai_addr, res->ai_addrlen);
+    server_addr_len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "H:p:n:c:m:d:s:t:P:S:u:h")) != -1) {
+        switch (opt) {
+        case 'H':
+            opts.host = optarg;
+            break;
+        case 'p':
+            opts.port = atoi(optarg);
+            break;
+        case 'n':
+            opts.bots = atoi(optarg);
+            break;
+        case 'c':
+            opts.connect_rate = atoi(optarg);
+            break;
+        case 'm':
+            opts.move_delay_ms = atoi(optarg);
+            break;
+        case 'd':
+            opts.duration_s = atoi(optarg);
+            break;
+        case 's':
+            opts.spectator_percent = atoi(optarg);
+            break;
+        case 't':
+            opts.chat_percent = atoi(optarg);
+            break;
+        case 'P':
+            opts.max_plies = atoi(optarg);
+            break;
+        case 'S':
+            opts.spectate_s = atoi(optarg);
+            break;
+        case 'u':
+            opts.prefix = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.bots <= 0 || opts.connect_rate <= 0 || opts.duration_s <= 0 || !resolve_server()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    /* Thousands of sockets need more than the usual 1024 descriptors */
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < (rlim_t)opts.bots + 64) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    srand((unsigned)time(NULL));
+    epoll_fd = epoll_create1(0);
+    bot_t* bots = calloc((size_t)opts.bots, sizeof(bot_t));
+    if (epoll_fd < 0 || !bots) {
+        perror("init");
+        return 1;
+    }
+
+    int spectator_every = opts.spectator_percent > 0 ? 100 / opts.spectator_percent : 0;
+    for (int i = 0; i < opts.bots; i++) {
+        bots[i].index = i;
+        bots[i].fd = -1;
+        bots[i].state = BOT_DEAD;
+        bots[i].spectator = spectator_every > 0 && i % spectator_every == spectator_every - 1;
+        bots[i].recv_buffer = malloc(RECV_BUFFER_SIZE);
+        if (!bots[i].recv_buffer) {
+            perror("malloc");
+            return 1;
+        }
+    }
+
+    printf("[Loadgen] %d bots -> %s:%d, %d conn/s, move every %dms, %ds\n", opts.bots, opts.host, opts.port,
+           opts.connect_rate, opts.move_delay_ms, opts.duration_s);
+
+    uint64_t start = now_us();
+    uint64_t end = start + (uint64_t)opts.duration_s * 1000000ULL;
+    uint64_t last_report = start;
+    uint64_t last_report_msgs = 0;
+    int launched = 0;
+    struct epoll_event events[MAX_EVENTS];
+
+    for (uint64_t now = start; now < end; now = now_us()) {
+        /* Ramp connections at the configured rate so the accept backlog is not the bottleneck */
+        int due = (int)((now - start) * (uint64_t)opts.connect_rate / 1000000ULL) + 1;
+        while (launched < opts.bots && launched < due) {
+            bot_start_connect(&bots[launched++]);
+        }
+
+        int nfds = epoll_wait(epoll_fd, events, MAX_EVENTS, TICK_MS);
+        for (int i = 0; i < nfds; i++) {
+            bot_t* bot = events[i].data.ptr;
+            if (bot->state == BOT_DEAD)
+                continue;
+            if (events[i].events & (EPOLLERR | EPOLLHUP) && bot->state == BOT_CONNECTING) {
+                bot_on_connected(bot);
+                continue;
+            }
+            if (bot->state == BOT_CONNECTING && (events[i].events & EPOLLOUT)) {
+                bot_on_connected(bot);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT)
+                bot_flush(bot);
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                bot_read(bot);
+        }
+
+        now = now_us();
+        for (int i = 0; i < launched; i++) {
+            if (bots[i].next_action != ACT_NONE && bots[i].next_action_us <= now && bots[i].state != BOT_DEAD)
+                bot_run_action(&bots[i]);
+        }
+
+        if (now - last_report >= REPORT_INTERVAL_US) {
+            print_progress(now - start, now - last_report, msgs_received + msgs_sent - last_report_msgs);
+            last_report = now;
+            last_report_msgs = msgs_received + msgs_sent;
+        }
+    }
+
+    print_summary(now_us() - start);
+
+    for (int i = 0; i < opts.bots; i++) {
+        if (bots[i].fd >= 0)
+            close(bots[i].fd);
+        free(bots[i].recv_buffer);
+        free(bots[i].send_buffer);
+    }
+    free(bots);
+    free(move_rtt.values);
+    free(connect_time.values);
+    close(epoll_fd);
+
+    return 0;
+}
@@ -0,0 +1,472 @@
+#define _DEFAULT_SOURCE
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/board.h"
+#include "../include/db.h"
+#include "../include/lobby.h"
+#include "../include/log.h"
+#include "../include/match.h"
+#include "../include/protocol.h"
+#include "../include/rating.h"
+#include "../include/server.h"
+#include "../include/session.h"
+#include "../src/handlers/handlers_common.h"
+
+/*
+ * Microbenchmarks for the per-message hot paths. Each benchmark is calibrated to run for about -t ms, repeated
+ * -r times, and reported as the median ns/op together with heap allocations and bytes per op. -j prints JSON
+ * so results from two commits can be diffed.
+ *
+ * Allocations are counted by replacing malloc/calloc/realloc on top of glibc's __libc_* entry points; the bench
+ * is single-threaded, so plain counters are enough.
+ */
+
+#define DEFAULT_TARGET_MS 200
+#define DEFAULT_REPETITIONS 5
+#define MAX_REPETITIONS 64
+#define SEND_DRAIN_EVERY 32
+#define GAME_PLIES 80
+#define READY_PLAYERS 50
+#define PERIOD_GAMES 100000 /* one busy Glicko-2 rating period */
+#define PERIOD_PLAYERS 20000
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+static uint64_t alloc_count = 0;
+static uint64_t alloc_bytes = 0;
+
+void* malloc(size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    alloc_count++;
+    alloc_bytes += count * size;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+
+typedef struct {
+    const char* name;
+    /* Runs the operation `iters` times and returns the nanoseconds spent, excluding any per-batch upkeep */
+    uint64_t (*run)(uint64_t iters);
+} bench_t;
+
+typedef struct {
+    const char* name;
+    uint64_t iterations;
+    double ns_per_op;
+    double allocs_per_op;
+    double bytes_per_op;
+} result_t;
+
+typedef struct {
+    int target_ms;
+    int repetitions;
+    const char* filter;
+    bool json;
+} options_t;
+
+static options_t opts = {DEFAULT_TARGET_MS, DEFAULT_REPETITIONS, NULL, false};
+
+/* Results are folded into this so the compiler cannot drop the work being measured */
+static volatile uint64_t sink = 0;
+
+static const char* move_message = "{\"type\":\"move\",\"seq\":1842,\"token\":\"4f3a9c2e7b1d8a6f0e5c4b3a2d1f0e9c\","
+                                  "\"payload\":{\"match_id\":\"match_1718000000_42\",\"from_row\":9,\"from_col\":1,"
+                                  "\"to_row\":7,\"to_col\":2}}";
+static const char* move_payload = "{\"match_id\":\"match_1718000000_42\",\"from_row\":9,\"from_col\":1,\"to_row\":7,"
+                                  "\"to_col\":2,\"rated\":true}";
+static const char* profile_payload = "{\"user_id\":42,\"username\":\"testuser\",\"rating\":1534,\"wins\":18,"
+                                     "\"losses\":11,\"draws\":3}";
+
+static server_t bench_server;
+static client_t* bench_client = NULL;
+static int drain_fd = -1;
+static char* bench_match_id = NULL;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t bench_parse_message(uint64_t iters) {
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iters; i++) {
+        message_t* msg = parse_message(move_message);
+        sink += (uint64_t)msg->seq;
+        free_message(msg);
+    }
+    return now_ns() - start;
+}
+
+static uint64_t bench_json_get_string(uint64_t iters) {
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iters; i++) {
+        char* match_id = json_get_string(move_payload, "match_id");
+        sink += (uint64_t)match_id[0];
+        free(match_id);
+    }
+    return now_ns() - start;
+}
+
+static uint64_t bench_json_get_int(uint64_t iters) {
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iters; i++)
+        sink += (uint64_t)json_get_int(move_payload, "to_col");
+    return now_ns() - start;
+}
+
+static uint64_t bench_json_get_bool(uint64_t iters) {
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iters; i++)
+        sink += json_get_bool(move_payload, "rated");
+    return now_ns() - start;
+}
+
+static uint64_t bench_create_response(uint64_t iters) {
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iters; i++) {
+        char* response = create_response("profile", (int)i, NULL, profile_payload);
+        sink += (uint64_t)response[0];
+        free(response);
+    }
+    return now_ns() - start;
+}
+
+static void drain_socket(void) {
+    char buffer[65536];
+    while (recv(drain_fd, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+    }
+}
+
+/* Includes the sendmsg() a real response costs; the peer end is drained outside the timed batches */
+static uint64_t bench_send_response(uint64_t iters) {
+    uint64_t elapsed = 0;
+    for (uint64_t done = 0; done < iters;) {
+        uint64_t batch = iters - done < SEND_DRAIN_EVERY ? iters - done : SEND_DRAIN_EVERY;
+        uint64_t start = now_ns();
+        for (uint64_t i = 0; i < batch; i++)
+            send_response(&bench_server, bench_client, (int)(done + i), true, "Profile", profile_payload);
+        elapsed += now_ns() - start;
+        done += batch;
+        drain_socket();
+    }
+    return elapsed;
+}
+
+static uint64_t bench_match_get_json(uint64_t iters) {
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iters; i++) {
+        char* json = match_get_json(bench_match_id);
+        sink += (uint64_t)json[0];
+        free(json);
+    }
+    return now_ns() - start;
+}
+
+static uint64_t bench_match_get_moves_json(uint64_t iters) {
+    const match_t* match = match_get(bench_match_id);
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iters; i++) {
+        char* json = match_get_moves_json(match);
+        sink += (uint64_t)json[0];
+        free(json);
+    }
+    return now_ns() - start;
+}
+
+static uint64_t bench_rating_calculate(uint64_t iters) {
+    static const char* results[] = {"red_win", "black_win", "draw"};
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iters; i++) {
+        rating_change_t change = rating_calculate(1400 + (int)(i & 511), 1500, results[i % 3], DEFAULT_K_FACTOR);
+        sink += (uint64_t)(change.red_change - change.black_change);
+    }
+    return now_ns() - start;
+}
+
+/* A fixed-seed rating period: PERIOD_GAMES games among PERIOD_PLAYERS players */
+static struct {
+    glicko2_rating_t players[PERIOD_PLAYERS];
+    int red[PERIOD_GAMES];
+    int black[PERIOD_GAMES];
+    double red_score[PERIOD_GAMES];
+    int first_result[PERIOD_PLAYERS + 1];
+    int next_result[PERIOD_PLAYERS];
+    glicko2_result_t results[2 * PERIOD_GAMES];
+    glicko2_period_t batch;
+} period;
+
+static void setup_period(void) {
+    srand(777);
+    for (int p = 0; p < PERIOD_PLAYERS; p++)
+        period.players[p] = (glicko2_rating_t){1000 + rand() % 1200, 50 + rand() % 300, GLICKO2_DEFAULT_VOLATILITY};
+
+    for (int g = 0; g < PERIOD_GAMES; g++) {
+        period.red[g] = rand() % PERIOD_PLAYERS;
+        period.black[g] = (period.red[g] + 1 + rand() % (PERIOD_PLAYERS - 1)) % PERIOD_PLAYERS;
+        period.red_score[g] = (rand() % 3) / 2.0;
+    }
+}
+
+/* One op is a whole period: load it into the batch and rate everyone */
+static uint64_t bench_glicko2_period_100k(uint64_t iters) {
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iters; i++) {
+        glicko2_period_clear(&period.batch);
+        for (int p = 0; p < PERIOD_PLAYERS; p++)
+            glicko2_period_add_player(&period.batch, period.players[p]);
+        for (int g = 0; g < PERIOD_GAMES; g++)
+            glicko2_period_add_game(&period.batch, period.red[g], period.black[g], period.red_score[g]);
+        glicko2_period_run(&period.batch, GLICKO2_TAU);
+        sink += (uint64_t)glicko2_period_rating(&period.batch, (int)(i % PERIOD_PLAYERS)).rating;
+    }
+    return now_ns() - start;
+}
+
+/* The same period through the scalar per-player update, which first needs the results grouped by player */
+static uint64_t bench_glicko2_update_100k(uint64_t iters) {
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iters; i++) {
+        memset(period.next_result, 0, sizeof(period.next_result));
+        for (int g = 0; g < PERIOD_GAMES; g++) {
+            period.next_result[period.red[g]]++;
+            period.next_result[period.black[g]]++;
+        }
+        for (int p = 0; p < PERIOD_PLAYERS; p++) {
+            period.first_result[p + 1] = period.first_result[p] + period.next_result[p];
+            period.next_result[p] = period.first_result[p];
+        }
+        for (int g = 0; g < PERIOD_GAMES; g++) {
+            const glicko2_rating_t* red = &period.players[period.red[g]];
+            const glicko2_rating_t* black = &period.players[period.black[g]];
+            double score = period.red_score[g];
+            period.results[period.next_result[period.red[g]]++] = (glicko2_result_t){black->rating, black->rd, score};
+            period.results[period.next_result[period.black[g]]++] =
+                (glicko2_result_t){red->rating, red->rd, 1.0 - score};
+        }
+
+        for (int p = 0; p < PERIOD_PLAYERS; p++) {
+            int first = period.first_result[p];
+            glicko2_rating_t after = glicko2_update(period.players[p], &period.results[first],
+                                                    period.first_result[p + 1] - first, GLICKO2_TAU);
+            sink += (uint64_t)after.rating;
+        }
+    }
+    return now_ns() - start;
+}
+
+static uint64_t bench_lobby_get_ready_list_json(uint64_t iters) {
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iters; i++) {
+        char* json = lobby_get_ready_list_json();
+        sink += (uint64_t)json[0];
+        free(json);
+    }
+    return now_ns() - start;
+}
+
+static const bench_t benches[] = {
+    {"parse_message", bench_parse_message},
+    {"json_get_string", bench_json_get_string},
+    {"json_get_int", bench_json_get_int},
+    {"json_get_bool", bench_json_get_bool},
+    {"create_response", bench_create_response},
+    {"send_response", bench_send_response},
+    {"match_get_json", bench_match_get_json},
+    {"match_get_moves_json", bench_match_get_moves_json},
+    {"rating_calculate", bench_rating_calculate},
+    {"glicko2_period_100k", bench_glicko2_period_100k},
+    {"glicko2_update_100k", bench_glicko2_update_100k},
+    {"lobby_get_ready_list_json", bench_lobby_get_ready_list_json},
+};
+
+/* A fixed-seed game of GAME_PLIES legal moves, so match serialization sees a realistic move list */
+static bool setup_match(void) {
+    bench_match_id = match_create(1, 2, true, 600000);
+    if (!bench_match_id)
+        return false;
+
+    srand(12345);
+    for (int ply = 0; ply < GAME_PLIES; ply++) {
+        match_t* match = match_get(bench_match_id);
+        board_move_t moves[BOARD_MAX_MOVES];
+        int count = board_generate_moves(&match->board, ply % 2 == 1, moves);
+        if (count == 0)
+            break;
+
+        board_move_t pick = moves[rand() % count];
+        move_t move = {.from = pick.from, .to = pick.to, .clock_delta_ms = 1500 + rand() % 20000};
+        if (!match_add_move(bench_match_id, &move))
+            return false;
+    }
+    return true;
+}
+
+static bool setup(void) {
+    log_set_level(LOG_LEVEL_WARN);
+
+    if (!db_init("memory") || !session_init() || !lobby_init() || !match_init())
+        return false;
+
+    for (int i = 0; i < READY_PLAYERS; i++) {
+        char username[32];
+        snprintf(username, sizeof(username), "player%02d", i);
+        lobby_set_ready(100 + i, username, 1200 + i * 13, 0, true);
+    }
+    setup_period();
+
+    if (!setup_match())
+        return false;
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        return false;
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL, 0) | O_NONBLOCK);
+    bench_client = client_create(fds[0]);
+    drain_fd = fds[1];
+    return bench_client != NULL;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static result_t run_bench(const bench_t* bench) {
+    uint64_t target_ns = (uint64_t)opts.target_ms * 1000000ULL;
+
+    /* Calibrate: double until a run takes a tenth of the target, then scale up to the target */
+    uint64_t iters = 1;
+    uint64_t elapsed = bench->run(iters);
+    while (elapsed < target_ns / 10 && iters < (1ULL << 40)) {
+        iters *= 2;
+        elapsed = bench->run(iters);
+    }
+    /* The first runs pay for cold caches and page faults; rescale once more from a warm run */
+    for (int pass = 0; pass < 2; pass++) {
+        if (elapsed > 0)
+            iters = iters * target_ns / elapsed;
+        if (iters == 0)
+            iters = 1;
+        if (pass == 0)
+            elapsed = bench->run(iters);
+    }
+
+    double samples[MAX_REPETITIONS];
+    uint64_t allocs_before = alloc_count;
+    uint64_t bytes_before = alloc_bytes;
+    for (int r = 0; r < opts.repetitions; r++)
+        samples[r] = (double)bench->run(iters) / (double)iters;
+    uint64_t total_ops = iters * (uint64_t)opts.repetitions;
+
+    qsort(samples, (size_t)opts.repetitions, sizeof(double), compare_double);
+
+    result_t result = {bench->name, iters, samples[opts.repetitions / 2], 0, 0};
+    result.allocs_per_op = (double)(alloc_count - allocs_before) / (double)total_ops;
+    result.bytes_per_op = (double)(alloc_bytes - bytes_before) / (double)total_ops;
+    return result;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-j] [-t ms] [-r repetitions] [-f filter]\n", prog);
+    fprintf(stderr, "  -j   print JSON instead of a table\n");
+    fprintf(stderr, "  -t   target time per repetition in ms (default %d)\n", DEFAULT_TARGET_MS);
+    fprintf(stderr, "  -r   repetitions, the median is reported (default %d, max %d)\n", DEFAULT_REPETITIONS,
+            MAX_REPETITIONS);
+    fprintf(stderr, "  -f   only run benchmarks whose name contains filter\n");
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "jt:r:f:h")) != -1) {
+        switch (opt) {
+        case 'j':
+            opts.json = true;
+            break;
+        case 't':
+            opts.target_ms = atoi(optarg);
+            break;
+        case 'r':
+            opts.repetitions = atoi(optarg);
+            break;
+        case 'f':
+            opts.filter = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.target_ms <= 0 || opts.repetitions <= 0 || opts.repetitions > MAX_REPETITIONS) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (!setup()) {
+        fprintf(stderr, "Benchmark setup failed\n");
+        return 1;
+    }
+
+    if (opts.json)
+        printf("{\"target_ms\":%d,\"repetitions\":%d,\"benchmarks\":[", opts.target_ms, opts.repetitions);
+    else
+        printf("%-28s %14s %12s %12s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op", "bytes/op");
+
+    bool first = true;
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        if (opts.filter && !strstr(benches[i].name, opts.filter))
+            continue;
+
+        result_t r = run_bench(&benches[i]);
+        if (opts.json) {
+            printf("%s\n  {\"name\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.2f,\"allocs_per_op\":%.2f,"
+                   "\"bytes_per_op\":%.1f}",
+                   first ? "" : ",", r.name, (unsigned long long)r.iterations, r.ns_per_op, r.allocs_per_op,
+                   r.bytes_per_op);
+        } else {
+            printf("%-28s %14llu %12.1f %12.2f %12.1f\n", r.name, (unsigned long long)r.iterations, r.ns_per_op,
+                   r.allocs_per_op, r.bytes_per_op);
+        }
+        fflush(stdout);
+        first = false;
+    }
+
+    if (opts.json)
+        printf("\n]}\n");
+
+    client_destroy(bench_client);
+    close(drain_fd);
+    free(bench_match_id);
+    match_shutdown();
+    lobby_shutdown();
+    session_shutdown();
+    db_shutdown();
+    return 0;
+}
@@ -0,0 +1,265 @@
+#define _DEFAULT_SOURCE
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/board.h"
+#include "../include/engine.h"
+
+/*
+ * Lazy SMP scaling benchmark. Searches a fixed set of positions at each thread count and reports time to
+ * depth, total nodes and nodes per second, with speedups relative to the first thread count. -t switches to
+ * a fixed time per position, where the useful numbers are nps and the depth reached instead.
+ *
+ * Every position starts from a cleared hash table, so runs do not feed each other.
+ */
+
+#define DEFAULT_DEPTH 7
+#define DEFAULT_THREADS "1,2,4,8,16"
+#define MAX_THREAD_COUNTS 16
+
+typedef struct {
+    const char* name;
+    const char* moves;    /* ICCS moves from the initial position, e.g. "h2e2 h9g7" */
+    const char* position; /* or a board_format_position() string, red to move */
+} bench_position_t;
+
+static const bench_position_t positions[] = {
+    {"central cannon", "h2e2 h9g7 h0g2 i9h9 i0h0 b9c7", NULL},
+    {"same direction cannons", "h2e2 h7e7 h0g2 h9g7 i0h0 i9h9", NULL},
+    {"opposite cannons", "h2e2 b7e7 h0g2 b9c7 i0h0 a9b9", NULL},
+    {"elephant opening", "c0e2 h9g7 h0g2 g6g5 g3g4 g5g4 e2g4", NULL},
+    {"pawn opening", "c3c4 b9c7 b0c2 h9g7 h0g2 i9h9", NULL},
+    {"horse opening", "h0g2 c6c5 g3g4 b9c7 i0h0 h7i7", NULL},
+    {"early middlegame", "h2e2 h9g7 h0g2 g6g5 i0h0 i9h9 b0c2 b9c7 a0b0 b7a7 b2a2 a9b9", NULL},
+    {"chariot and pawn ending", NULL,
+     "...akah.."
+     "........."
+     "..h......"
+     "....P...."
+     "........."
+     "R........"
+     "........."
+     "....E...."
+     "........."
+     "....K...."},
+};
+
+#define POSITION_COUNT (sizeof(positions) / sizeof(positions[0]))
+
+static struct {
+    int depth;
+    int time_ms;
+    int hash_mb;
+    const char* cpu_list;
+    bool json;
+    int thread_counts[MAX_THREAD_COUNTS];
+    int thread_count_n;
+} opts = {DEFAULT_DEPTH, 0, ENGINE_DEFAULT_HASH_MB, NULL, false, {0}, 0};
+
+typedef struct {
+    board_t board;
+    bool black;
+} start_t;
+
+static start_t starts[POSITION_COUNT];
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* ICCS: files a-i left to right from red's side, ranks 0-9 from red's back rank */
+static int parse_square(const char* s) {
+    if (s[0] < 'a' || s[0] > 'i' || s[1] < '0' || s[1] > '9')
+        return -1;
+    return SQUARE(9 - (s[1] - '0'), s[0] - 'a');
+}
+
+static bool is_legal(const board_t* board, bool black, int from, int to) {
+    board_move_t moves[BOARD_MAX_MOVES];
+    int count = board_generate_moves(board, black, moves);
+    for (int i = 0; i < count; i++) {
+        if (moves[i].from == from && moves[i].to == to)
+            return true;
+    }
+    return false;
+}
+
+static bool setup_position(const bench_position_t* p, start_t* out) {
+    out->black = false;
+    if (p->position)
+        return board_parse_position(&out->board, p->position);
+
+    board_init(&out->board);
+    for (const char* m = p->moves; *m;) {
+        int from = parse_square(m);
+        int to = from >= 0 ? parse_square(m + 2) : -1;
+        if (to < 0 || !is_legal(&out->board, out->black, from, to)) {
+            fprintf(stderr, "%s: illegal move at \"%.4s\"\n", p->name, m);
+            return false;
+        }
+        board_apply(&out->board, from, to);
+        out->black = !out->black;
+        m += 4;
+        while (*m == ' ')
+            m++;
+    }
+    return true;
+}
+
+static bool parse_thread_counts(const char* spec) {
+    opts.thread_count_n = 0;
+    for (const char* p = spec; *p;) {
+        char* end;
+        long n = strtol(p, &end, 10);
+        if (end == p || n < 1 || n > ENGINE_MAX_THREADS || opts.thread_count_n == MAX_THREAD_COUNTS)
+            return false;
+        opts.thread_counts[opts.thread_count_n++] = (int)n;
+        p = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',')
+            return false;
+    }
+    return opts.thread_count_n > 0;
+}
+
+typedef struct {
+    int threads;
+    double seconds;
+    uint64_t nodes;
+    double depth; /* mean completed depth */
+} run_t;
+
+static bool run_threads(int threads, const int* cpus, int cpu_count, run_t* out) {
+    engine_t* engine = engine_create((size_t)opts.hash_mb, threads);
+    if (!engine)
+        return false;
+    if (cpu_count > 0 && !engine_set_affinity(engine, cpus, cpu_count, 0))
+        fprintf(stderr, "warning: could not pin %d threads\n", threads);
+
+    engine_limits_t limits = {opts.time_ms ? 0 : opts.depth, opts.time_ms, NULL};
+    memset(out, 0, sizeof(*out));
+    out->threads = threads;
+
+    for (size_t i = 0; i < POSITION_COUNT; i++) {
+        engine_result_t result;
+        engine_clear(engine);
+        uint64_t start = now_ns();
+        if (!engine_search(engine, &starts[i].board, starts[i].black, NULL, 0, &limits, &result)) {
+            engine_destroy(engine);
+            return false;
+        }
+        out->seconds += (double)(now_ns() - start) / 1e9;
+        out->nodes += result.nodes;
+        out->depth += result.depth;
+    }
+    out->depth /= (double)POSITION_COUNT;
+
+    engine_destroy(engine);
+    return true;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-j] [-d depth | -t ms] [-T threads] [-H mb] [-c cpus]\n", prog);
+    fprintf(stderr, "  -j   print JSON instead of a table\n");
+    fprintf(stderr, "  -d   search every position to this depth (default %d)\n", DEFAULT_DEPTH);
+    fprintf(stderr, "  -t   search every position for this many ms instead\n");
+    fprintf(stderr, "  -T   comma-separated thread counts (default %s)\n", DEFAULT_THREADS);
+    fprintf(stderr, "  -H   hash table size in MB (default %d)\n", ENGINE_DEFAULT_HASH_MB);
+    fprintf(stderr, "  -c   pin search threads to these cpus, e.g. 0-7\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* thread_spec = DEFAULT_THREADS;
+    int opt;
+    while ((opt = getopt(argc, argv, "jd:t:T:H:c:h")) != -1) {
+        switch (opt) {
+        case 'j':
+            opts.json = true;
+            break;
+        case 'd':
+            opts.depth = atoi(optarg);
+            break;
+        case 't':
+            opts.time_ms = atoi(optarg);
+            break;
+        case 'T':
+            thread_spec = optarg;
+            break;
+        case 'H':
+            opts.hash_mb = atoi(optarg);
+            break;
+        case 'c':
+            opts.cpu_list = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.depth <= 0 || opts.depth >= ENGINE_MAX_PLY || opts.time_ms < 0 || opts.hash_mb <= 0 ||
+        !parse_thread_counts(thread_spec)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int cpus[ENGINE_MAX_THREADS];
+    int cpu_count = 0;
+    if (opts.cpu_list && (cpu_count = engine_parse_cpu_list(opts.cpu_list, cpus, ENGINE_MAX_THREADS)) <= 0) {
+        fprintf(stderr, "Invalid cpu list: %s\n", opts.cpu_list);
+        return 1;
+    }
+
+    for (size_t i = 0; i < POSITION_COUNT; i++) {
+        if (!setup_position(&positions[i], &starts[i]))
+            return 1;
+    }
+
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (opts.json) {
+        printf("{\"positions\":%zu,\"depth\":%d,\"time_ms\":%d,\"hash_mb\":%d,\"cpus\":%ld,\"runs\":[",
+               POSITION_COUNT, opts.time_ms ? 0 : opts.depth, opts.time_ms, opts.hash_mb, online);
+    } else {
+        printf("%zu positions, %s, %d MB hash, %ld cpus online\n", POSITION_COUNT,
+               opts.time_ms ? "fixed time" : "fixed depth", opts.hash_mb, online);
+        printf("%8s %10s %14s %12s %8s %10s %10s\n", "threads", "seconds", "nodes", "nps", "depth", "speedup",
+               "nps x");
+    }
+
+    run_t base = {0};
+    for (int i = 0; i < opts.thread_count_n; i++) {
+        run_t r;
+        if (!run_threads(opts.thread_counts[i], cpus, cpu_count, &r)) {
+            fprintf(stderr, "Search with %d threads failed\n", opts.thread_counts[i]);
+            return 1;
+        }
+        if (i == 0)
+            base = r;
+
+        double nps = r.seconds > 0 ? (double)r.nodes / r.seconds : 0;
+        double base_nps = base.seconds > 0 ? (double)base.nodes / base.seconds : 0;
+        /* Time to depth only means something when every run searched to the same depth */
+        double speedup = !opts.time_ms && r.seconds > 0 ? base.seconds / r.seconds : 0;
+        double nps_scale = base_nps > 0 ? nps / base_nps : 0;
+
+        if (opts.json) {
+            printf("%s\n  {\"threads\":%d,\"seconds\":%.3f,\"nodes\":%llu,\"nps\":%.0f,\"depth\":%.2f,"
+                   "\"speedup\":%.2f,\"nps_scale\":%.2f}",
+                   i ? "," : "", r.threads, r.seconds, (unsigned long long)r.nodes, nps, r.depth, speedup, nps_scale);
+        } else {
+            printf("%8d %10.3f %14llu %12.0f %8.2f %10.2f %10.2f\n", r.threads, r.seconds,
+                   (unsigned long long)r.nodes, nps, r.depth, speedup, nps_scale);
+        }
+        fflush(stdout);
+    }
+
+    if (opts.json)
+        printf("\n]}\n");
+    return 0;
+}
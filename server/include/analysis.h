@@ -0,0 +1,72 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "match.h"
+
+/*
+ * Post-game analysis. Once a finished match is saved, its moves are queued for a pool of low-priority workers
+ * that replay the game and search every position to a fixed depth. Each move is scored by how much it lost
+ * against the engine's choice, classified (inaccuracy, mistake, blunder) and folded into a per-side accuracy.
+ * Results come back to the reactor over an eventfd, like bot moves, and are written with
+ * db_save_match_analysis() so the database is still only touched from the reactor thread.
+ *
+ * Workers run under SCHED_IDLE and additionally hold off while the load average says no core is idle, so
+ * analysis only ever soaks up spare cycles. Jobs are taken highest priority first: somebody waiting on the
+ * replay page, then rated games, then the rest.
+ *
+ * Stored format (little endian), base64-encoded:
+ *   header  u8 version, u8 depth, u16 red accuracy x10, u16 black accuracy x10, u16 plies, i16 start eval
+ *   per ply i16 eval after the move, u16 engine best move (from << 9 | to << 2 | class)
+ * Evals are centipawns from red's point of view; beyond +-(ENGINE_MATE - ENGINE_MAX_PLY) they are mates.
+ */
+
+#define ANALYSIS_VERSION 1
+#define ANALYSIS_DEFAULT_THREADS 1
+#define ANALYSIS_DEFAULT_DEPTH 6
+#define ANALYSIS_HEADER_SIZE 10
+#define ANALYSIS_PLY_SIZE 4
+#define ANALYSIS_MAX_BYTES (ANALYSIS_HEADER_SIZE + ANALYSIS_PLY_SIZE * MAX_MOVES_PER_MATCH)
+/* base64 plus the terminator */
+#define ANALYSIS_MAX_ENCODED ((ANALYSIS_MAX_BYTES + 2) / 3 * 4 + 1)
+
+/* Centipawns lost by a move, from the mover's side */
+#define ANALYSIS_INACCURACY_CP 60
+#define ANALYSIS_MISTAKE_CP 150
+#define ANALYSIS_BLUNDER_CP 300
+
+typedef enum {
+    ANALYSIS_MOVE_GOOD = 0,
+    ANALYSIS_MOVE_INACCURACY = 1,
+    ANALYSIS_MOVE_MISTAKE = 2,
+    ANALYSIS_MOVE_BLUNDER = 3,
+} analysis_class_t;
+
+typedef enum {
+    ANALYSIS_PRIORITY_LOW = 0,    /* unrated and bot games */
+    ANALYSIS_PRIORITY_NORMAL = 1, /* rated games */
+    ANALYSIS_PRIORITY_HIGH = 2,   /* a player opened the replay before it was done */
+} analysis_priority_t;
+
+typedef struct {
+    char match_id[32];
+    char* encoded; /* base64, owned by the caller after analysis_take_results() */
+} analysis_result_t;
+
+/* threads workers (0 disables analysis) each searching to depth with a single-threaded engine */
+bool analysis_init(int threads, int depth, int hash_mb);
+void analysis_shutdown(void);
+bool analysis_enabled(void);
+
+/* Copies the moves of a finished match into a job; call after db_save_match() */
+bool analysis_request(const match_t* match);
+/* Moves a queued job to the front of the line; false if it is not queued (done, running or never asked) */
+bool analysis_prioritize(const char* match_id);
+
+/* Readable whenever finished analyses are waiting */
+int analysis_event_fd(void);
+int analysis_take_results(analysis_result_t* out, int max_count);
+
+#endif
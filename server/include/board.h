@@ -0,0 +1,66 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BOARD_ROWS 10
+#define BOARD_COLS 9
+#define BOARD_SQUARES 90
+
+/* Squares are row * BOARD_COLS + col; black starts on row 0, red on row 9 */
+#define SQUARE(row, col) ((row) * BOARD_COLS + (col))
+#define SQUARE_ROW(sq) ((sq) / BOARD_COLS)
+#define SQUARE_COL(sq) ((sq) % BOARD_COLS)
+
+/* Piece codes fit in a nibble: low 3 bits are the type, bit 3 marks black */
+#define PIECE_NONE 0
+#define PIECE_KING 1
+#define PIECE_ADVISOR 2
+#define PIECE_ELEPHANT 3
+#define PIECE_HORSE 4
+#define PIECE_CHARIOT 5
+#define PIECE_CANNON 6
+#define PIECE_PAWN 7
+#define PIECE_BLACK 8
+
+#define PIECE_TYPE(p) ((p) & 7)
+#define PIECE_IS_BLACK(p) (((p) & PIECE_BLACK) != 0)
+
+#define BOARD_MAX_MOVES 128
+
+typedef struct {
+    uint8_t squares[BOARD_SQUARES];
+} board_t;
+
+typedef struct {
+    uint8_t from;
+    uint8_t to;
+} board_move_t;
+
+void board_init(board_t* board);
+
+/* Moves whatever stands on `from` to `to` and returns the captured piece code */
+uint8_t board_apply(board_t* board, int from, int to);
+
+char board_piece_char(uint8_t piece);
+
+/* Writes BOARD_SQUARES piece letters (row 0 first, '.' for empty) plus a terminating NUL */
+void board_format_position(const board_t* board, char* out);
+/* Inverse of board_format_position; fails on unknown letters or a short string */
+bool board_parse_position(board_t* board, const char* position);
+
+/* Legal moves for one side: piece rules, then no self-check and no facing generals */
+int board_generate_moves(const board_t* board, bool black, board_move_t* moves);
+bool board_in_check(const board_t* board, bool black);
+/* Same test for a general already known to stand on king_sq, including the facing-generals rule */
+bool board_king_attacked(const board_t* board, int king_sq, bool black);
+
+/* Moves by piece rules only, which may leave the mover's general attacked; captures_only skips quiet moves */
+int board_generate_pseudo_moves(const board_t* board, bool black, bool captures_only, board_move_t* moves);
+
+/* WXF notation (e.g. "C2.5", "H8+7") for a move on the board before it is played */
+bool board_format_notation(const board_t* board, int from, int to, char* out, size_t out_size);
+
+#endif
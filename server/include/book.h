@@ -0,0 +1,68 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "board.h"
+
+/*
+ * Opening book: a read-only file mapped once at startup and shared by every thread that probes it, so loading
+ * costs nothing beyond the page faults of the positions actually looked up. Positions are keyed by
+ * engine_position_key() and stored in Eytzinger (breadth-first) order, which turns the binary search into a
+ * walk down an implicit tree whose next few levels sit in the same or the prefetched cache line.
+ *
+ * File layout (little endian, written by bin/bookgen):
+ *   book_header_t
+ *   uint64_t          keys[position_count + 1]       Eytzinger order, index 0 unused
+ *   book_position_t   positions[position_count + 1]  parallel to keys
+ *   book_move_t       moves[move_count]              grouped per position
+ *   uint32_t          name_offsets[name_count]       into the name blob
+ *   char              names[names_size]              NUL-terminated UTF-8 opening names
+ */
+
+#define BOOK_MAGIC "XQBOOK\0"
+#define BOOK_VERSION 1
+/* Games are only followed this deep, both by the builder and by the prober */
+#define BOOK_MAX_PLY 24
+#define BOOK_MAX_MOVES 32
+#define BOOK_NO_NAME 0xFFFF
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t position_count;
+    uint32_t move_count;
+    uint32_t name_count;
+    uint32_t names_size;
+    uint32_t reserved;
+    uint64_t start_key; /* key of the initial position; a mismatch means the hashing changed since the build */
+    uint8_t padding[24];
+} book_header_t;
+
+typedef struct {
+    uint32_t first_move;
+    uint16_t move_count;
+    uint16_t name; /* index into name_offsets, or BOOK_NO_NAME */
+} book_position_t;
+
+typedef struct {
+    uint8_t from;
+    uint8_t to;
+    uint16_t weight; /* relative; 0 never appears in a built book */
+} book_move_t;
+
+bool book_open(const char* path);
+void book_close(void);
+bool book_loaded(void);
+
+/* Copies up to max_moves book moves for the position; returns how many, 0 if the position is not in the book */
+int book_probe(const board_t* board, bool black, book_move_t* out, int max_moves);
+/* Weighted choice among the legal book moves; roll is any random number. False when out of book. */
+bool book_pick(const board_t* board, bool black, uint32_t roll, int* out_from, int* out_to);
+
+/* Follows moves (from, to pairs) from the initial position and returns the name of the deepest named
+ * position reached, or NULL. book_plies gets how many leading moves stayed in the book. */
+const char* book_identify(const uint8_t (*moves)[2], int move_count, int* book_plies);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "match.h"
+
+/*
+ * Computer opponents. Each strength level is a real user account (so matches, history and profiles work
+ * unchanged) whose moves come from the engine running on a pool of worker threads. The reactor only copies
+ * the position into a job; finished searches are queued back and signalled on an eventfd that the reactor
+ * polls, so a search never blocks message handling.
+ */
+
+#define BOT_LEVEL_MIN 1
+#define BOT_LEVEL_MAX 5
+#define BOT_DEFAULT_LEVEL 3
+#define BOT_DEFAULT_THREADS 2
+/* Lazy SMP threads per search; total engine threads are bot threads times this */
+#define BOT_DEFAULT_SEARCH_THREADS 1
+#define BOT_MIN_THINK_MS 50
+/* Share of the remaining clock a single move may use */
+#define BOT_CLOCK_FRACTION 20
+
+typedef struct {
+    char match_id[32];
+    int move_count; /* position the search was for; stale results are dropped */
+    int from;       /* -1 if the bot has no legal move */
+    int to;
+    int think_ms;
+} bot_move_t;
+
+/* threads concurrent searches (0 disables bots), each on search_threads threads; cpu_list (may be NULL)
+ * pins every engine thread, e.g. "2-7" to keep them off the reactor's core */
+bool bot_init(int threads, int search_threads, int hash_mb, const char* cpu_list);
+void bot_shutdown(void);
+bool bot_enabled(void);
+
+int bot_user_id(int level);
+/* BOT_LEVEL_MIN..BOT_LEVEL_MAX for a bot account, 0 for everyone else */
+int bot_level_of(int user_id);
+
+/* Queues a search for the side to move; the result comes back through bot_take_moves() */
+bool bot_request_move(const match_t* match);
+
+/* Readable whenever finished moves are waiting */
+int bot_event_fd(void);
+int bot_take_moves(bot_move_t* out, int max_count);
+
+#endif
@@ -3,10 +3,15 @@
 
 #include <stdbool.h>
 
+#include "frame.h"
+#include "match.h"
 #include "server.h"
 
 void broadcast_to_match(server_t* server, const char* match_id, const char* message);
 
+/* Queues one shared frame to both players and every spectator; returns recipients reached */
+int broadcast_frame_to_match(server_t* server, const match_t* match, frame_t* frame, int exclude_user_id);
+
 void broadcast_to_lobby(server_t* server, const char* message);
 
 bool send_to_user(server_t* server, int user_id, const char* message);
@@ -5,50 +5,22 @@
 #include <stddef.h>
 #include <time.h>
 
-#include <sql.h>
-#include <sqlext.h>
-
-extern SQLHENV g_db_env;
-extern SQLHDBC g_db_conn;
-extern SQLHSTMT g_db_stmt;
-
-#define DB_PREPARE(stmt, sql)                                                                                          \
-    SQLHSTMT stmt;                                                                                                     \
-    SQLRETURN db_ret;                                                                                                  \
-    SQLLEN db_indicator;                                                                                               \
-    do {                                                                                                               \
-        db_ret = SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &(stmt));                                                  \
-        if (db_ret != SQL_SUCCESS)                                                                                     \
-            return false;                                                                                              \
-        db_ret = SQLPrepare((stmt), (SQLCHAR*)(sql), SQL_NTS);                                                         \
-        if (db_ret != SQL_SUCCESS) {                                                                                   \
-            SQLFreeHandle(SQL_HANDLE_STMT, (stmt));                                                                    \
-            return false;                                                                                              \
-        }                                                                                                              \
-    } while (0)
-
-#define DB_EXECUTE(stmt)                                                                                               \
-    do {                                                                                                               \
-        db_ret = SQLExecute(stmt);                                                                                     \
-        if (db_ret != SQL_SUCCESS && db_ret != SQL_SUCCESS_WITH_INFO) {                                                \
-            SQLFreeHandle(SQL_HANDLE_STMT, (stmt));                                                                    \
-            return false;                                                                                              \
-        }                                                                                                              \
-    } while (0)
-
-#define DB_EXECUTE_OR_FAIL(stmt, cleanup_stmt)                                                                         \
-    do {                                                                                                               \
-        db_ret = SQLExecute(stmt);                                                                                     \
-        if (db_ret != SQL_SUCCESS && db_ret != SQL_SUCCESS_WITH_INFO) {                                                \
-            SQLFreeHandle(SQL_HANDLE_STMT, (cleanup_stmt));                                                            \
-            return false;                                                                                              \
-        }                                                                                                              \
-    } while (0)
-
-#define DB_CLEANUP(stmt) SQLFreeHandle(SQL_HANDLE_STMT, (stmt))
+/*
+ * Storage API. The implementation is picked at startup by a spec string:
+ *   "memory"                 - process-local tables, nothing persisted (tests, benchmarks, loadgen)
+ *   "odbc:<conn string>"     - SQL Server through unixODBC (needs a build with ODBC=1)
+ *
+ * Only ODBC builds have a default: the server's own SQL Server. Without ODBC the memory store must be asked for by
+ * name, so a server never loses its games to a store nobody meant to pick.
+ */
+#ifdef DB_HAVE_ODBC
+#define DB_DEFAULT_SPEC                                                                                                \
+    "odbc:Driver={ODBC Driver 17 for SQL Server};Server=localhost;Database=XiangqiDB;UID=sa;PWD=Hieudo@831;"
+#endif
 
-bool db_init(const char* connection_string);
+bool db_init(const char* spec);
 void db_shutdown(void);
+const char* db_backend_name(void);
 
 bool db_create_user(const char* username, const char* email, const char* password_hash, int* out_user_id);
 bool db_get_user_by_username(const char* username, int* out_user_id, char* out_password_hash, int* out_rating);
@@ -57,14 +29,93 @@ bool db_get_user_by_id(int user_id, char* out_username, char* out_email, int* ou
 bool db_update_user_rating(int user_id, int new_rating);
 bool db_update_user_stats(int user_id, int wins, int losses, int draws);
 
-bool db_save_match(const char* match_id, int red_user_id, int black_user_id, const char* result, const char* moves_json,
-                   const char* started_at, const char* ended_at);
-bool db_get_match(const char* match_id, char* out_json, size_t json_size);
-bool db_get_match_history(int user_id, int limit, int offset, char* out_json, size_t json_size);
+/* Also writes each player's UserMatches row in the same transaction; the deltas are 0 for unrated games. end_reason
+ * is finish_match's reason ("timeout", "resign", ...). */
+bool db_save_match(const char* match_id, int red_user_id, int black_user_id, const char* result,
+                   const char* end_reason, const char* moves_json, const char* started_at, const char* ended_at,
+                   bool rated, int red_rating_delta, int black_rating_delta);
+/* analysis is the base64 blob from analysis.h; get_match returns it as "analysis" (null until written) */
+bool db_save_match_analysis(const char* match_id, const char* analysis);
+/* malloc'd JSON sized to the stored row, NULL if there is no such match */
+char* db_get_match(const char* match_id);
+/* Keyset position in a player's history: the (ended_at, match_id) of the last row already seen */
+typedef struct {
+    char ended_at[32];
+    char match_id[64];
+} db_history_cursor_t;
+/* One history row from the player's side: my_color "red"/"black", result "win"/"loss"/"draw"/"unknown" */
+typedef struct {
+    const char* match_id;
+    const char* opponent;
+    const char* my_color;
+    const char* result;
+    const char* started_at;
+    const char* ended_at;
+    int rating_delta;
+} db_history_row_t;
+typedef bool (*db_history_visitor_t)(const db_history_row_t* row, void* ctx);
+/* Visits up to limit of the player's matches newest first by (ended_at, match_id), starting just past after (NULL
+ * for the newest) and stopping early when visit returns false. A deep page is the same index seek as the first one.
+ * Returns rows visited or -1. */
+int db_get_match_history(int user_id, const db_history_cursor_t* after, int limit, db_history_visitor_t visit,
+                         void* ctx);
+/* One UserMatches row; result is "win"/"loss"/"draw" from user_id's side */
+typedef struct {
+    int user_id;
+    int opponent_id;
+    const char* color;
+    const char* result;
+    const char* ended_at;
+    int rating_delta;
+} db_user_match_t;
+typedef bool (*db_user_match_visitor_t)(const db_user_match_t* row, void* ctx);
+/* Calls visit for every UserMatches row, each player's oldest first, until it returns false; returns rows visited or
+ * -1. Feeds stats.h at startup. */
+int db_for_each_user_match(db_user_match_visitor_t visit, void* ctx);
+/* Offline tools: calls visit for every saved match until it returns false; returns matches visited or -1 */
+typedef bool (*db_match_visitor_t)(const char* result, const char* moves_json, void* ctx);
+int db_for_each_match(db_match_visitor_t visit, void* ctx);
+/* One finished rated game as the rating replay needs it; result is the Matches result */
+typedef struct {
+    int red_user_id;
+    int black_user_id;
+    const char* result;
+    const char* end_reason; /* "" for games saved before Matches.end_reason existed */
+    long ended_at;
+} db_rated_match_t;
+typedef bool (*db_rated_match_visitor_t)(const db_rated_match_t* match, void* ctx);
+/* Calls visit for every rated match that ended at or after since (0 for all) in (ended_at, match_id) order until it
+ * returns false; returns matches visited or -1 */
+int db_for_each_rated_match(long since, db_rated_match_visitor_t visit, void* ctx);
+typedef struct {
+    int user_id;
+    int old_rating; /* the rating the new one was computed against */
+    int rating;
+    double rd; /* Glicko-2 deviation; 0 keeps rd, volatility and rated_at as they are */
+    double volatility;
+    long rated_at; /* end of the rating period the row closes, unix seconds */
+} db_rating_update_t;
+/* Writes many ratings in a few round trips. A row only applies while the user still has old_rating, so a game the
+ * server finished meanwhile is never overwritten. Returns rows applied or -1. */
+int db_update_ratings(const db_rating_update_t* updates, int count);
+typedef struct {
+    int user_id;
+    int rating;
+    double rd;
+    double volatility;
+    long rated_at; /* 0 until a rating period has rated the player */
+} db_user_rating_t;
+typedef bool (*db_user_rating_visitor_t)(const db_user_rating_t* row, void* ctx);
+/* Calls visit for every account's Glicko-2 state until it returns false; returns users visited or -1 */
+int db_for_each_user_rating(db_user_rating_visitor_t visit, void* ctx);
 
 bool db_get_user_profile(int user_id, char* out_json, size_t json_size);
 
 bool db_get_leaderboard(int limit, int offset, char* out_json, size_t json_size);
+/* Calls visit for every account until it returns false; returns users visited or -1. Feeds leaderboard.h. */
+typedef bool (*db_user_visitor_t)(int user_id, const char* username, int rating, int wins, int losses, int draws,
+                                  void* ctx);
+int db_for_each_user(db_user_visitor_t visit, void* ctx);
 
 bool db_execute(const char* sql);
 bool db_check_username_exists(const char* username);
@@ -74,6 +125,7 @@ bool db_get_username(int user_id, char* out_username, size_t username_size);
 bool db_save_active_match(const char* match_id, int red_user_id, int black_user_id, const char* current_turn,
                           int red_time_ms, int black_time_ms, int move_count, const char* moves_json, bool rated,
                           time_t started_at, time_t last_move_at);
+#define DB_TURN_SIZE 6 /* current_turn buffer: "black" plus NUL */
 bool db_get_active_match(const char* match_id, int* red_user_id, int* black_user_id, char* current_turn,
                          int* red_time_ms, int* black_time_ms, int* move_count, char* moves_json,
                          size_t moves_json_size, bool* rated, time_t* started_at, time_t* last_move_at);
@@ -86,6 +138,4 @@ bool db_session_validate(const char* token, int* out_user_id);
 bool db_session_destroy(const char* token);
 bool db_session_cleanup_expired(void);
 
-void db_print_error(SQLHANDLE handle, SQLSMALLINT type, const char* msg);
-
 #endif
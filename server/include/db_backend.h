@@ -0,0 +1,75 @@
+#ifndef DB_BACKEND_H
+#define DB_BACKEND_H
+
+#include "db.h"
+
+/*
+ * Storage backend interface. Every db_* call in db.h dispatches through the backend chosen by db_init().
+ * Backends fill the same JSON shapes so handlers never know which one is running.
+ */
+
+typedef struct {
+    const char* name;
+
+    /* config is the part of the db spec after "<name>:", or "" */
+    bool (*init)(const char* config);
+    void (*shutdown)(void);
+    bool (*execute)(const char* sql);
+
+    bool (*create_user)(const char* username, const char* email, const char* password_hash, int* out_user_id);
+    bool (*get_user_by_username)(const char* username, int* out_user_id, char* out_password_hash, int* out_rating);
+    bool (*get_user_by_id)(int user_id, char* out_username, char* out_email, int* out_rating, int* out_wins,
+                           int* out_losses, int* out_draws);
+    bool (*update_user_rating)(int user_id, int new_rating);
+    bool (*update_user_stats)(int user_id, int wins, int losses, int draws);
+
+    bool (*save_match)(const char* match_id, int red_user_id, int black_user_id, const char* result,
+                       const char* end_reason, const char* moves_json, const char* started_at, const char* ended_at,
+                       bool rated, int red_rating_delta, int black_rating_delta);
+    bool (*save_match_analysis)(const char* match_id, const char* analysis);
+    char* (*get_match)(const char* match_id);
+    int (*for_each_match)(db_match_visitor_t visit, void* ctx);
+    int (*for_each_rated_match)(long since, db_rated_match_visitor_t visit, void* ctx);
+    int (*update_ratings)(const db_rating_update_t* updates, int count);
+    int (*for_each_user_rating)(db_user_rating_visitor_t visit, void* ctx);
+    int (*get_match_history)(int user_id, const db_history_cursor_t* after, int limit, db_history_visitor_t visit,
+                             void* ctx);
+    int (*for_each_user_match)(db_user_match_visitor_t visit, void* ctx);
+    bool (*get_user_profile)(int user_id, char* out_json, size_t json_size);
+    bool (*get_leaderboard)(int limit, int offset, char* out_json, size_t json_size);
+    int (*for_each_user)(db_user_visitor_t visit, void* ctx);
+
+    bool (*check_username_exists)(const char* username);
+    bool (*check_email_exists)(const char* email);
+    bool (*get_username)(int user_id, char* out_username, size_t username_size);
+
+    bool (*save_active_match)(const char* match_id, int red_user_id, int black_user_id, const char* current_turn,
+                              int red_time_ms, int black_time_ms, int move_count, const char* moves_json, bool rated,
+                              time_t started_at, time_t last_move_at);
+    bool (*get_active_match)(const char* match_id, int* red_user_id, int* black_user_id, char* current_turn,
+                             int* red_time_ms, int* black_time_ms, int* move_count, char* moves_json,
+                             size_t moves_json_size, bool* rated, time_t* started_at, time_t* last_move_at);
+    bool (*delete_active_match)(const char* match_id);
+    int (*load_all_active_matches)(void* matches_array, int max_matches);
+
+    bool (*session_create)(const char* token, int user_id, int expires_hours);
+    bool (*session_validate)(const char* token, int* out_user_id);
+    bool (*session_destroy)(const char* token);
+    bool (*session_cleanup_expired)(void);
+} db_backend_t;
+
+extern const db_backend_t db_memory_backend;
+#ifdef DB_HAVE_ODBC
+extern const db_backend_t db_odbc_backend;
+#endif
+
+/* Shared by backends so profile JSON stays identical */
+const char* db_rank_title(int rating);
+/* A player's result ("win"/"loss"/"draw") from a Matches result and their color */
+const char* db_player_result(const char* result, bool red);
+/* The get_match object, malloc'd at its exact size; analysis may be NULL */
+char* db_format_match_json(const char* match_id, const char* red_user, const char* black_user, const char* result,
+                           const char* moves_json, const char* started_at, const char* ended_at,
+                           const char* analysis);
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "board.h"
+
+/*
+ * Xiangqi search: negamax alpha-beta (PVS) under iterative deepening, with a transposition table, MVV-LVA
+ * capture ordering followed by killer and history quiet moves, a check extension and a captures-only
+ * quiescence search. An engine_t owns a hash table and one or more searchers; one caller searches on it at a
+ * time. With several threads it runs Lazy SMP: helper threads search the same position independently and
+ * only share the lock-free hash table. Positions covered by a loaded endgame tablebase (tablebase.h) are scored
+ * from it, and a root position it covers is answered by probing alone (depth 0 in the result). Nothing in here
+ * touches the match, session or database modules.
+ */
+
+#define ENGINE_MAX_PLY 64
+#define ENGINE_MATE 30000
+#define ENGINE_DEFAULT_HASH_MB 16
+#define ENGINE_MAX_THREADS 64
+
+typedef struct engine engine_t;
+
+typedef struct {
+    int max_depth;           /* plies; 0 for no limit (ENGINE_MAX_PLY) */
+    int time_ms;             /* 0 for no limit */
+    const atomic_bool* stop; /* optional; checked together with the clock */
+} engine_limits_t;
+
+typedef struct {
+    int from; /* -1 when the side to move has no legal move */
+    int to;
+    int score; /* for the side to move; beyond ENGINE_MATE - ENGINE_MAX_PLY it is a forced mate */
+    int depth; /* deepest completed iteration; 0 when the tablebases chose the move */
+    uint64_t nodes; /* all threads */
+    uint64_t nps;
+    int elapsed_ms;
+    int threads;
+} engine_result_t;
+
+/* threads counts the caller of engine_search; threads - 1 helpers are started here and idle between searches */
+engine_t* engine_create(size_t hash_mb, int threads);
+void engine_destroy(engine_t* engine);
+/* Forgets the hash table and move-ordering statistics, e.g. between games */
+void engine_clear(engine_t* engine);
+int engine_thread_count(const engine_t* engine);
+
+/* Pins the calling thread to cpus[first % cpu_count] and helper i to the cpus after it, wrapping around; call
+ * it from the thread that will run engine_search */
+bool engine_set_affinity(engine_t* engine, const int* cpus, int cpu_count, int first);
+/* "0-3,6" style list; returns the number of cpus written, -1 if malformed or longer than max_cpus */
+int engine_parse_cpu_list(const char* spec, int* cpus, int max_cpus);
+
+/* history holds the keys of the game's earlier positions (may be NULL) so repetitions score as draws */
+bool engine_search(engine_t* engine, const board_t* board, bool black, const uint64_t* history, int history_count,
+                   const engine_limits_t* limits, engine_result_t* out);
+
+uint64_t engine_position_key(const board_t* board, bool black);
+/* Static evaluation in centipawns for the side to move */
+int engine_evaluate(const board_t* board, bool black);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/* Immutable, newline-terminated wire frame shared by reference between send queues */
+typedef struct {
+    atomic_int refcount;
+    size_t len;
+    char data[];
+} frame_t;
+
+frame_t* frame_create(const char* message);
+frame_t* frame_create_len(const char* message, size_t len);
+frame_t* frame_retain(frame_t* frame);
+void frame_release(frame_t* frame);
+
+#endif
@@ -18,6 +18,7 @@ void handle_challenge(server_t* server, client_t* client, message_t* msg);
 void handle_challenge_response(server_t* server, client_t* client, message_t* msg);
 void handle_get_match(server_t* server, client_t* client, message_t* msg);
 void handle_leaderboard(server_t* server, client_t* client, message_t* msg);
+void handle_leaderboard_rank(server_t* server, client_t* client, message_t* msg);
 void handle_heartbeat(server_t* server, client_t* client, message_t* msg);
 void handle_chat_message(server_t* server, client_t* client, message_t* msg);
 
@@ -35,11 +36,28 @@ void handle_match_history(server_t* server, client_t* client, message_t* msg);
 void handle_get_live_matches(server_t* server, client_t* client, message_t* msg);
 void handle_join_spectate(server_t* server, client_t* client, message_t* msg);
 void handle_leave_spectate(server_t* server, client_t* client, message_t* msg);
+void handle_spectate_sync(server_t* server, client_t* client, message_t* msg);
+
+void handle_relay_join_spectate(server_t* server, client_t* client, message_t* msg);
+void handle_relay_leave_spectate(server_t* server, client_t* client, message_t* msg);
+void handle_relay_spectate_sync(server_t* server, client_t* client, message_t* msg);
 
 void handle_get_profile(server_t* server, client_t* client, message_t* msg);
 
 void handle_get_timer(server_t* server, client_t* client, message_t* msg);
 
+void handle_stats(server_t* server, client_t* client, message_t* msg);
+void handle_log_level(server_t* server, client_t* client, message_t* msg);
+void handle_reload_ratings(server_t* server, client_t* client, message_t* msg);
+
+void handle_play_bot(server_t* server, client_t* client, message_t* msg);
+/* Reactor side of the bot pool: plays finished engine searches into their matches */
+void handle_bot_moves(server_t* server);
+/* Reactor side of the analysis pool: writes finished post-game analyses to the database */
+void handle_analysis_results(server_t* server);
+/* Ends the matches match_check_all_timeouts flagged, through finish_match like any other result */
+void handle_match_timeouts(server_t* server);
+
 void dispatch_handler(server_t* server, client_t* client, message_t* msg);
 
 #endif
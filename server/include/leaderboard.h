@@ -0,0 +1,38 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <stdbool.h>
+
+/*
+ * Ranked view of every account, kept in memory so leaderboard pages and ranks never query the database.
+ * Users sit in a skip list ordered by rating (then user_id) whose links also count the entries they skip, so
+ * finding the n-th user or a user's rank is O(log n). Loaded once from the backend at startup and kept current
+ * by the db_* calls that create users or change their rating or record. Reactor thread only.
+ */
+
+#define LEADERBOARD_MAX_PAGE 100
+#define LEADERBOARD_MAX_RADIUS 25
+
+bool leaderboard_init(void);
+void leaderboard_shutdown(void);
+bool leaderboard_ready(void);
+
+/* Inserts the user or replaces everything known about them */
+void leaderboard_set_user(int user_id, const char* username, int rating, int wins, int losses, int draws);
+void leaderboard_set_rating(int user_id, int rating);
+void leaderboard_set_stats(int user_id, int wins, int losses, int draws);
+
+int leaderboard_count(void);
+/* 1 for the highest rated user, 0 if the user is unknown */
+int leaderboard_rank(int user_id);
+/* Current rating, or 0 / NULL if the user is unknown */
+int leaderboard_rating(int user_id);
+const char* leaderboard_username(int user_id);
+
+/* JSON array of up to limit entries starting at offset (0-based). The string is cached and owned by the
+ * leaderboard; it stays valid until the next change to the leaderboard. NULL on allocation failure. */
+const char* leaderboard_page_json(int limit, int offset);
+/* {"rank":r,"total":n,"entries":[...]} with radius users on each side of user_id; malloc'd, NULL if unknown */
+char* leaderboard_around_json(int user_id, int radius);
+
+#endif
@@ -14,6 +14,7 @@ typedef struct {
     int user_id;
     char username[64];
     int rating;
+    int rd; /* Glicko-2 deviation, 0 under Elo */
     bool ready;
     time_t ready_since;
 } lobby_player_t;
@@ -42,12 +43,13 @@ typedef struct {
 bool lobby_init(void);
 void lobby_shutdown(void);
 
-void lobby_set_ready(int user_id, const char* username, int rating, bool ready);
+void lobby_set_ready(int user_id, const char* username, int rating, int rd, bool ready);
 void lobby_remove_player(int user_id);
 char* lobby_get_ready_list_json(void);
 
 bool lobby_find_random_match(int user_id, int* out_opponent_id);
-bool lobby_find_rated_match(int user_id, int rating, int tolerance, int* out_opponent_id);
+/* Closest rating within tolerance, widened by the pair's combined deviation so uncertain players pair sooner */
+bool lobby_find_rated_match(int user_id, int rating, int rd, int tolerance, int* out_opponent_id);
 
 char* lobby_create_room(int host_user_id, const char* room_name, const char* password, bool rated);
 bool lobby_join_room(const char* room_code, const char* password, int user_id, int* out_host_id);
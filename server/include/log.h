@@ -1,39 +1,70 @@
 #ifndef LOG_H
 #define LOG_H
 
-#include <stdio.h>
-#include <time.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Asynchronous logger. LOG_* formats into a per-thread lock-free ring and returns; a background writer drains
+ * the rings to stderr with timestamps. A full ring drops the record (counted and reported) rather than block.
+ *
+ * Each call site is rate limited to log_set_rate_limit() messages per second; the next message that gets through
+ * says how many were suppressed. Before log_init() and after log_shutdown() messages are written synchronously.
+ */
 
 #define LOG_LEVEL_DEBUG 0
 #define LOG_LEVEL_INFO 1
 #define LOG_LEVEL_WARN 2
 #define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_OFF 4
+
+/* Compile-time floor; anything below it is compiled out. The runtime level is set with log_set_level(). */
 #ifndef LOG_LEVEL
-#define LOG_LEVEL LOG_LEVEL_INFO
+#define LOG_LEVEL LOG_LEVEL_DEBUG
 #endif
 
-#define LOG_DEBUG(fmt, ...)                                                                                            \
-    do {                                                                                                               \
-        if (LOG_LEVEL <= LOG_LEVEL_DEBUG)                                                                              \
-            fprintf(stderr, "[DEBUG] " fmt "\n", ##__VA_ARGS__);                                                       \
-    } while (0)
+#define LOG_RING_SLOTS 2048
+#define LOG_MESSAGE_MAX 240
+#define LOG_DEFAULT_RATE_LIMIT 200
 
-#define LOG_INFO(fmt, ...)                                                                                             \
-    do {                                                                                                               \
-        if (LOG_LEVEL <= LOG_LEVEL_INFO)                                                                               \
-            fprintf(stderr, "[INFO] " fmt "\n", ##__VA_ARGS__);                                                        \
-    } while (0)
+typedef struct {
+    _Atomic int64_t window;
+    _Atomic uint32_t count;
+    _Atomic uint32_t suppressed;
+} log_site_t;
 
-#define LOG_WARN(fmt, ...)                                                                                             \
-    do {                                                                                                               \
-        if (LOG_LEVEL <= LOG_LEVEL_WARN)                                                                               \
-            fprintf(stderr, "[WARN] " fmt "\n", ##__VA_ARGS__);                                                        \
-    } while (0)
+extern _Atomic int log_runtime_level;
+
+bool log_init(void);
+void log_shutdown(void);
+
+void log_set_level(int level);
+int log_get_level(void);
+/* "debug", "info", "warn", "error", "off"; -1 if unknown */
+int log_level_from_name(const char* name);
+const char* log_level_name(int level);
+
+/* Messages per second per call site; 0 disables the limit */
+void log_set_rate_limit(int per_second);
+int log_get_rate_limit(void);
 
-#define LOG_ERROR(fmt, ...)                                                                                            \
+bool log_site_allow(log_site_t* site, uint32_t* out_suppressed);
+void log_write(int level, uint32_t suppressed, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+
+#define LOG_AT(level, fmt, ...)                                                                                        \
     do {                                                                                                               \
-        if (LOG_LEVEL <= LOG_LEVEL_ERROR)                                                                              \
-            fprintf(stderr, "[ERROR] " fmt "\n", ##__VA_ARGS__);                                                       \
+        if ((level) >= LOG_LEVEL && (level) >= atomic_load_explicit(&log_runtime_level, memory_order_relaxed)) {       \
+            static log_site_t log_site;                                                                                \
+            uint32_t log_suppressed;                                                                                   \
+            if (log_site_allow(&log_site, &log_suppressed))                                                            \
+                log_write((level), log_suppressed, fmt, ##__VA_ARGS__);                                                \
+        }                                                                                                              \
     } while (0)
 
-#endif
\ No newline at end of file
+#define LOG_DEBUG(fmt, ...) LOG_AT(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...) LOG_AT(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define LOG_WARN(fmt, ...) LOG_AT(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define LOG_ERROR(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+
+#endif
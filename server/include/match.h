@@ -2,33 +2,49 @@
 #define MATCH_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
 
-#define MAX_MATCHES 500
-#define MAX_MOVES_PER_MATCH 300
-#define MAX_SPECTATORS_PER_MATCH 50
+#include "board.h"
 
+struct client;
+
+#define MATCH_INITIAL_CAPACITY 64
+#define MATCH_INITIAL_MOVES 32
+#define MATCH_RETAIN_SECONDS 300
+#define MAX_PENDING_TIMEOUTS 500
+#define MAX_MOVES_PER_MATCH 1024
+#define MOVE_CLOCK_DELTA_MAX 0xFFFFFF
+#define MATCH_INITIAL_SPECTATORS 8
+#define SPECTATE_KEYFRAME_MOVES 16
+
+/* Packed 8-byte history record; the move id is its index in match_t.moves */
 typedef struct {
-    int move_id;
-    char from_row;
-    char from_col;
-    char to_row;
-    char to_col;
-    char piece[16];
-    char capture[16];
-    char notation[32];
-    time_t timestamp;
-    int red_time_ms;
-    int black_time_ms;
+    uint8_t from;
+    uint8_t to;
+    uint8_t piece : 4;
+    uint8_t capture : 4;
+    uint8_t flags;
+    uint32_t clock_delta_ms : 24;
+    uint32_t reserved : 8;
 } move_t;
 
+_Static_assert(sizeof(move_t) == 8, "move_t must stay packed");
+
+#define MOVE_FROM_ROW(m) SQUARE_ROW((m)->from)
+#define MOVE_FROM_COL(m) SQUARE_COL((m)->from)
+#define MOVE_TO_ROW(m) SQUARE_ROW((m)->to)
+#define MOVE_TO_COL(m) SQUARE_COL((m)->to)
+
 typedef struct {
     char match_id[32];
     int red_user_id;
     int black_user_id;
     char current_turn[6];
     int move_count;
-    move_t moves[MAX_MOVES_PER_MATCH];
+    int move_capacity;
+    move_t* moves;
+    board_t board;
     bool rated;
     int red_time_ms;
     int black_time_ms;
@@ -37,9 +53,13 @@ typedef struct {
     bool active;
     char result[16];
     char end_reason[32];
+    time_t ended_at;
 
-    int spectator_ids[MAX_SPECTATORS_PER_MATCH];
+    struct client** spectators;
     int spectator_count;
+    int spectator_capacity;
+
+    int slot_index;
 } match_t;
 
 bool match_init(void);
@@ -54,15 +74,25 @@ bool match_add_move(const char* match_id, const move_t* move);
 bool match_end(const char* match_id, const char* result, const char* reason);
 char* match_get_json(const char* match_id);
 char* match_get_moves_json(const match_t* match);
+char* match_get_annotated_moves_json(const match_t* match);
+char* match_get_keyframe_json(const match_t* match, int recent_moves);
+bool match_get_move_notation(const match_t* match, int index, char* out, size_t out_size);
 int match_get_opponent_id(const match_t* match, int user_id);
-bool match_is_checkmate(match_t* match);
+bool match_is_checkmate(const match_t* match);
+/* Whether from -> to is one of the legal moves of the side to move */
+bool match_is_legal_move(const match_t* match, int from, int to);
+/* Whether the current position already decides the game: no legal move for the side to move, or a tablebase win
+ * for either side (perfect play assumed). Tablebase draws are left to the players, since the tables ignore the
+ * long-check and long-chase rules. Sets result ("red_win", "black_win") and reason ("checkmate", "tablebase"). */
+bool match_adjudicate(const match_t* match, const char** result, const char** reason);
 
 bool is_valid_position(int row, int col);
 bool is_correct_turn(match_t* match, int user_id);
 
-bool match_add_spectator(const char* match_id, int user_id);
-bool match_remove_spectator(const char* match_id, int user_id);
-bool match_is_spectator(const match_t* match, int user_id);
+bool match_add_spectator(const char* match_id, struct client* client);
+bool match_remove_spectator(const char* match_id, struct client* client);
+bool match_is_spectator(const match_t* match, const struct client* client);
+int match_get_spectator_count(const char* match_id);
 char* match_get_live_matches_json(void);
 
 bool match_update_timer(const char* match_id);
@@ -79,9 +109,9 @@ typedef struct {
 
 int match_get_pending_timeouts(timeout_info_t* timeouts, int max_count);
 
-bool match_add_spectator(const char* match_id, int user_id);
-bool match_remove_spectator(const char* match_id, int user_id);
-int match_get_spectator_count(const char* match_id);
+/* Releases matches that ended more than MATCH_RETAIN_SECONDS ago */
+int match_reap_finished(void);
+int match_get_active_count(void);
 
 bool match_persist(const char* match_id);
 bool match_restore_all(void);
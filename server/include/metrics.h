@@ -0,0 +1,57 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Process-wide counters, gauges and log-bucket histograms. Metrics are registered once (under a lock) and
+ * updated with relaxed atomics, so the reactor never blocks on the scrape thread that reads them.
+ *
+ * Histograms keep 4 linear sub-buckets per power of two (~25% relative error), enough for p50/p99 of
+ * anything from nanoseconds to minutes in a fixed 2 KB per series.
+ */
+
+#define METRICS_MAX_SERIES 256
+#define METRICS_HIST_SUB_BITS 2
+#define METRICS_HIST_BUCKETS (64 << METRICS_HIST_SUB_BITS)
+
+/* Histogram units: latencies are observed in nanoseconds and exported in seconds */
+#define METRICS_UNIT_NS 1e-9
+#define METRICS_UNIT_COUNT 1.0
+
+typedef struct metrics_counter metrics_counter_t;
+typedef struct metrics_gauge metrics_gauge_t;
+typedef struct metrics_histogram metrics_histogram_t;
+
+bool metrics_init(void);
+void metrics_shutdown(void);
+
+/* Find-or-create; label may be NULL for unlabelled series. Returns NULL once the registry is full. */
+metrics_counter_t* metrics_counter(const char* name, const char* help, const char* label, const char* label_value);
+metrics_gauge_t* metrics_gauge(const char* name, const char* help);
+metrics_histogram_t* metrics_histogram(const char* name, const char* help, const char* label,
+                                       const char* label_value, double unit);
+
+void metrics_counter_add(metrics_counter_t* counter, uint64_t delta);
+void metrics_gauge_set(metrics_gauge_t* gauge, int64_t value);
+void metrics_observe(metrics_histogram_t* histogram, uint64_t value);
+
+uint64_t metrics_now_ns(void);
+
+static inline void metrics_observe_since(metrics_histogram_t* histogram, uint64_t start_ns) {
+    metrics_observe(histogram, metrics_now_ns() - start_ns);
+}
+
+/* Value at quantile q (0..1) in observed units, upper edge of the containing bucket */
+uint64_t metrics_histogram_quantile(const metrics_histogram_t* histogram, double q);
+
+/* Both return malloc'd text the caller frees */
+char* metrics_format_prometheus(void);
+char* metrics_format_json(void);
+
+/* Serves metrics_format_prometheus() over HTTP on 127.0.0.1:port from a background thread */
+bool metrics_http_start(int port);
+
+#endif
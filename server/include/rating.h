@@ -1,8 +1,13 @@
 #ifndef RATING_H
 #define RATING_H
 
+#include <stdbool.h>
+
 #define DEFAULT_RATING 1200
 #define DEFAULT_K_FACTOR 32
+/* Elo games lost on time cost the loser this much on top of the rated change, never below RATING_FLOOR */
+#define RATING_TIMEOUT_PENALTY 25
+#define RATING_FLOOR 100
 
 typedef struct {
     int red_change;
@@ -13,4 +18,73 @@ rating_change_t rating_calculate(int red_rating, int black_rating, const char* r
 
 double rating_expected_score(int rating_a, int rating_b);
 
+/* 1, 0.5 or 0 for the given side of a "red_win"/"black_win"/"draw" result */
+double rating_score(const char* result, bool red);
+
+/*
+ * Glicko-2 (Glickman, 2012) on the Elo scale. Results are applied a rating period at a time: every player who
+ * played in the period is updated against their opponents' ratings from before it, and a player's deviation
+ * grows by their volatility for each period they sit out.
+ */
+#define GLICKO2_DEFAULT_RD 350.0
+#define GLICKO2_DEFAULT_VOLATILITY 0.06
+#define GLICKO2_TAU 0.5
+#define GLICKO2_DEFAULT_PERIOD (24 * 3600)
+
+typedef struct {
+    double rating;
+    double rd;
+    double volatility;
+} glicko2_rating_t;
+
+typedef struct {
+    double opponent_rating;
+    double opponent_rd;
+    double score;
+} glicko2_result_t;
+
+/* The player's rating after one period with count results; count 0 only widens the deviation */
+glicko2_rating_t glicko2_update(glicko2_rating_t player, const glicko2_result_t* results, int count, double tau);
+/* Deviation after the given number of periods without games, capped at GLICKO2_DEFAULT_RD */
+double glicko2_idle_rd(double rd, double volatility, int periods);
+
+/*
+ * A whole rating period at once, as structure of arrays on the Glicko-2 scale. Players are added with their state
+ * at the start of the period and games refer to them by index, so every result is scored against the opponent as
+ * they stood before the period. glicko2_period_run gathers each result's mu and g(phi) into contiguous arrays and
+ * computes the per-result terms in one branch-free loop the compiler can vectorize (glibc's SIMD exp needs -O3
+ * -ffast-math); only the volatility root, one per player, stays scalar. Buffers are kept across periods.
+ */
+typedef struct {
+    int player_count;
+    int player_capacity;
+    double* mu;
+    double* phi;
+    double* sigma;
+    double* g; /* g(phi) at the start of the period */
+    double* variance_sum;
+    double* improvement_sum;
+
+    int result_count;
+    int result_capacity;
+    int* owner;
+    int* opponent;
+    double* score;
+    double* own_mu;
+    double* opponent_mu;
+    double* opponent_g;
+    double* variance;
+    double* improvement;
+} glicko2_period_t;
+
+/* Index of the new player, or -1 when out of memory */
+int glicko2_period_add_player(glicko2_period_t* period, glicko2_rating_t rating);
+/* A game between two added players; the second scores 1 - score */
+bool glicko2_period_add_game(glicko2_period_t* period, int player, int opponent, double score);
+void glicko2_period_run(glicko2_period_t* period, double tau);
+glicko2_rating_t glicko2_period_rating(const glicko2_period_t* period, int player);
+/* Empties the period for reuse; _free also releases the buffers */
+void glicko2_period_clear(glicko2_period_t* period);
+void glicko2_period_free(glicko2_period_t* period);
+
 #endif
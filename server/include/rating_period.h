@@ -0,0 +1,32 @@
+#ifndef RATING_PERIOD_H
+#define RATING_PERIOD_H
+
+#include <stdbool.h>
+#include <time.h>
+
+#include "rating.h"
+
+/*
+ * Live rating. Under Elo (the default) every rated game changes both ratings as it ends. Under Glicko-2 a finished
+ * game is only queued; periods are aligned to multiples of the period length in unix time, and the first tick past
+ * a boundary rates every game of the period in one batch (glicko2_period_t), writes the results with a few
+ * db_update_ratings round trips and moves the leaderboard. Deviations of players who sit a period out are never
+ * written; they grow lazily from Users.rated_at when read. Games queued when the server stops are found again in
+ * Matches on the next start. Reactor thread only.
+ */
+
+#define RATING_PERIOD_DEFAULT_SECONDS GLICKO2_DEFAULT_PERIOD
+
+bool rating_period_init(bool glicko2, int period_seconds);
+void rating_period_shutdown(void);
+bool rating_period_glicko2(void);
+
+/* The Elo change for a finished rated game, or no change under Glicko-2, where the game joins the open period */
+rating_change_t rating_period_rate(int red_user_id, int black_user_id, int red_rating, int black_rating,
+                                   const char* result);
+/* Current deviation, rounded, including growth over idle periods; 0 under Elo */
+int rating_period_rd(int user_id);
+/* Closes every period that has ended by now; returns the number closed */
+int rating_period_tick(time_t now);
+
+#endif
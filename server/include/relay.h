@@ -0,0 +1,32 @@
+#ifndef RELAY_H
+#define RELAY_H
+
+#include <stdbool.h>
+
+#include "server.h"
+
+/*
+ * Relay mode: this process holds no players. Each featured match gets one upstream spectator connection to
+ * the primary server, and every move frame it receives is fanned out to the relay's own spectators.
+ */
+
+#define RELAY_MAX_FEEDS 64
+#define RELAY_IDLE_SECONDS 60
+
+bool relay_init(const char* primary_host, int primary_port);
+void relay_shutdown(server_t* server);
+bool relay_is_enabled(void);
+
+/* Answers the join itself, possibly later once the upstream keyframe arrives */
+bool relay_join_spectate(server_t* server, client_t* client, const char* match_id, int seq);
+bool relay_leave_spectate(client_t* client, const char* match_id);
+void relay_remove_spectator(client_t* client);
+char* relay_get_keyframe_json(const char* match_id);
+
+void relay_handle_upstream(server_t* server, client_t* upstream, const char* json);
+void relay_upstream_closed(server_t* server, client_t* upstream);
+
+/* Drops feeds that have had no spectators for RELAY_IDLE_SECONDS */
+int relay_reap_idle(server_t* server);
+
+#endif
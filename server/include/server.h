@@ -4,23 +4,44 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <sys/epoll.h>
+#include <time.h>
+
+#include "frame.h"
 
 #define MAX_EVENTS 1024
 #define MAX_CLIENTS 1000
 #define BUFFER_SIZE 8192
 #define MAX_MESSAGE_SIZE 16384
+#define SEND_QUEUE_INITIAL 16
+#define SEND_QUEUE_MAX_BYTES (4 * 1024 * 1024)
+#define SEND_IOV_BATCH 64
+#define CLIENT_USER_BUCKETS 1024 /* power of two, at least MAX_CLIENTS */
 
-typedef struct {
+typedef struct client {
     int fd;
     char recv_buffer[MAX_MESSAGE_SIZE];
     size_t recv_len;
-    char send_buffer[MAX_MESSAGE_SIZE];
-    size_t send_len;
+
+    /* Ring of shared frames waiting to be written; send_offset is into the head frame */
+    frame_t** send_queue;
+    size_t send_head;
+    size_t send_count;
+    size_t send_capacity;
     size_t send_offset;
+    size_t send_bytes;
+    bool want_write;
+    bool send_failed;
+
     char* session_token;
-    int user_id;
+    int user_id; /* set through server_set_client_user so the user index stays in step */
+    struct client* user_next;
     bool authenticated;
     time_t last_heartbeat;
+
+    char spectate_match_id[32];
+
+    /* Relay mode: this connection is our subscription to the primary, not an audience member */
+    bool upstream;
 } client_t;
 
 typedef struct {
@@ -28,6 +49,8 @@ typedef struct {
     int epoll_fd;
     client_t* clients[MAX_CLIENTS];
     int client_count;
+    /* Clients with a user_id, chained per bucket through user_next; newest login first */
+    client_t* user_index[CLIENT_USER_BUCKETS];
     bool running;
 } server_t;
 
@@ -37,12 +60,17 @@ void server_shutdown(server_t* server);
 
 client_t* client_create(int fd);
 void client_destroy(client_t* client);
-int client_send(client_t* client, const char* json);
+int client_send(server_t* server, client_t* client, const char* json);
+int client_send_frame(server_t* server, client_t* client, frame_t* frame);
+void client_flush(server_t* server, client_t* client);
 void client_disconnect(server_t* server, client_t* client);
 client_t* server_get_client_by_user_id(server_t* server, int user_id);
+/* Assigns client->user_id (0 to clear) and moves the client to the matching index bucket */
+void server_set_client_user(server_t* server, client_t* client, int user_id);
 
 void handle_new_connection(server_t* server);
-void handle_client_read(server_t* server, client_t* client);
+/* Returns false once the client has been disconnected and freed */
+bool handle_client_read(server_t* server, client_t* client);
 void handle_client_write(server_t* server, client_t* client);
 
 void process_message(server_t* server, client_t* client, const char* json);
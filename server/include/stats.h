@@ -0,0 +1,28 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+
+/*
+ * Per-player aggregates for the profile page: results by color, win/loss streaks, the recent rating curve and
+ * head-to-head records. Built once from UserMatches at startup, then updated as each match is saved, so a profile
+ * request only formats what is already in memory. Reactor thread only.
+ */
+
+#define STATS_RATING_POINTS 100 /* most recent rating changes kept per player */
+#define STATS_TOP_OPPONENTS 10  /* head-to-head records a profile reports, most played first */
+
+bool stats_init(void);
+void stats_shutdown(void);
+bool stats_ready(void);
+
+/* One finished game from one player's side; result is "win", "loss" or "draw", ended_at unix seconds */
+void stats_record(int user_id, int opponent_id, bool red, const char* result, long ended_at, int rating_delta);
+/* A rating change not tied to one game, such as a Glicko-2 period closing at unix time at */
+void stats_rating_changed(int user_id, long at, int rating_delta);
+
+/* {"colors":{...},"streak":{...},"rating_history":[[t,rating],...],"head_to_head":[...]}; malloc'd, NULL if the
+ * player has no games or stats are not loaded */
+char* stats_profile_json(int user_id);
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "board.h"
+
+/*
+ * Endgame tablebases: for every position of a small material signature (both generals plus up to
+ * TB_MAX_EXTRA other pieces), whether the side to move wins, loses or draws, and the distance to mate in plies.
+ * Tables are built offline by bin/tbgen with retrograde analysis and stored one file per signature
+ * ("KRKAA.xtb"), RLE-compressed in fixed-size blocks so a probe decodes at most one block of a read-only
+ * mapping.
+ *
+ * A signature names the stronger side first, as red: "KRKAA" is chariot against two advisors. Positions where
+ * black holds the stronger material are probed through the table with the board flipped top to bottom.
+ * Pieces are indexed over the squares they can ever stand on (9 for a general, 5 for an advisor, 7 for an
+ * elephant, 55 for a pawn, 90 otherwise), so a table holds 2 * product(domains) entries,
+ * red to move first.
+ *
+ * The generator plays by the plain rules only: repetition is a draw and the long-check and long-chase
+ * prohibitions are not modelled, so a few tablebase draws are wins over the board.
+ */
+
+#define TB_MAX_EXTRA 3
+#define TB_MAX_PIECES (TB_MAX_EXTRA + 2)
+#define TB_BLOCK_SIZE 1024
+#define TB_MAGIC "XQTB\0\0\0"
+#define TB_VERSION 1
+#define TB_FILE_SUFFIX ".xtb"
+
+/* Stored byte per position: 0 draw, TB_INVALID unreachable, otherwise plies to mate + 1; an even number of plies
+ * means the side to move is being mated, an odd number that it mates */
+#define TB_DRAW 0
+#define TB_INVALID 255
+#define TB_MAX_DTM 253
+#define TB_NO_INDEX UINT64_MAX
+
+typedef struct {
+    char name[16];
+    uint32_t key;                  /* piece counts per color and type, for quick matching */
+    int piece_count;               /* including both generals */
+    uint8_t pieces[TB_MAX_PIECES]; /* board piece codes: red general, black general, red pieces, black pieces */
+    uint32_t domains[TB_MAX_PIECES];
+    uint64_t size; /* entries, side to move included */
+} tb_material_t;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t material_key;
+    char name[16];
+    uint64_t entry_count;
+    uint32_t block_size;
+    uint32_t block_count;
+    uint32_t max_dtm;
+    uint8_t padding[12];
+} tb_header_t;
+
+typedef struct {
+    int wdl; /* 1 the side to move wins, -1 it loses, 0 draw */
+    int dtm; /* plies to mate with best play, 0 for draws */
+} tb_result_t;
+
+/* "KRKAA"; the stronger side must come first as the generator writes it */
+bool tb_material_parse(const char* name, tb_material_t* out);
+/* Material of a position in canonical orientation; mirrored is set when the board must be flipped to match */
+bool tb_material_of(const board_t* board, tb_material_t* out, bool* mirrored);
+
+uint64_t tb_index(const tb_material_t* material, const board_t* board, bool black, bool mirrored);
+/* Inverse of tb_index for the generator; false if two pieces share a square */
+bool tb_decode(const tb_material_t* material, uint64_t index, board_t* board, bool* black);
+
+bool tb_value_decode(uint8_t value, tb_result_t* out);
+
+/* Maps every *.xtb in dir; returns the number of tables found (0 is not an error) or -1 */
+int tb_init(const char* dir);
+void tb_shutdown(void);
+/* Largest piece count any loaded table covers, 0 when none are loaded */
+int tb_max_pieces(void);
+bool tb_probe(const board_t* board, bool black, tb_result_t* out);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Sampled request tracing. One message in every N is followed from recv to send-enqueue and written to a file
+ * as Chrome trace events (chrome://tracing, Perfetto): one track per client fd, one event per message keyed by
+ * fd and seq, with the recv, parse, auth, handler, db_* calls, serialize and send_enqueue stages nested inside.
+ *
+ * Only the thread that called trace_begin() records spans, so storage calls made from other threads cost a
+ * thread-local load and nothing else.
+ */
+
+#define TRACE_DEFAULT_SAMPLE 100
+#define TRACE_MAX_SPANS 64
+
+bool trace_init(const char* path, int sample_every, int min_duration_us);
+void trace_shutdown(void);
+bool trace_enabled(void);
+void trace_flush(void);
+
+/* Clock reading for a span start; 0 unless this thread is inside a trace, which makes trace_span a no-op */
+uint64_t trace_clock(void);
+
+/* Called after each recv() with a start taken while trace_enabled(); the window goes to the first message traced
+ * out of that read */
+void trace_recv(uint64_t start_ns);
+
+/* Samples the next message from fd; returns true if it is being traced */
+bool trace_begin(int fd);
+void trace_set_key(int seq, const char* type);
+void trace_end(void);
+
+/* Closes a stage that started at start_ns (from trace_clock) in the current trace; name must be a literal */
+void trace_span(const char* name, uint64_t start_ns);
+
+#endif
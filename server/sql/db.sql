@@ -14,6 +14,9 @@ CREATE TABLE Users (
     losses INT DEFAULT 0,
     draws INT DEFAULT 0,
     created_at DATETIME DEFAULT GETDATE(),
+    rd FLOAT NOT NULL DEFAULT 350, -- Glicko-2 rating deviation, used with --rating glicko2
+    volatility FLOAT NOT NULL DEFAULT 0.06,
+    rated_at BIGINT NOT NULL DEFAULT 0, -- unix seconds at the end of the last rating period that rated the player
     INDEX IX_Users_Rating (rating DESC),
     INDEX IX_Users_Username (username)
 );
@@ -27,6 +30,9 @@ CREATE TABLE Matches (
     moves_json NVARCHAR(MAX),
     started_at NVARCHAR(32),
     ended_at NVARCHAR(32),
+    analysis VARCHAR(MAX) NULL, -- base64 engine annotations, filled in after the game by the analysis workers
+    rated BIT NOT NULL DEFAULT 1,
+    end_reason NVARCHAR(32) NULL, -- 'timeout', 'resign', 'checkmate', ...; bin/rerate replays the timeout penalty
     FOREIGN KEY (red_user_id) REFERENCES Users(user_id),
     FOREIGN KEY (black_user_id) REFERENCES Users(user_id),
     INDEX IX_Matches_Users (red_user_id, black_user_id),
@@ -34,6 +40,30 @@ CREATE TABLE Matches (
 );
 GO
 
+-- Rating replays (bin/rerate) read every rated game in the order it ended; the filtered index covers that scan
+CREATE INDEX IX_Matches_Replay ON Matches (ended_at, match_id) INCLUDE (red_user_id, black_user_id, result, end_reason)
+    WHERE rated = 1;
+GO
+
+-- One row per player per finished match, written in the same transaction as the match. History pages, profile
+-- streaks and head-to-head records are range scans of (user_id, ended_at) instead of an OR across the color columns.
+-- Databases created before this table existed are backfilled by migrate_user_matches.sql.
+CREATE TABLE UserMatches (
+    user_id INT NOT NULL,
+    ended_at NVARCHAR(32) NOT NULL,
+    match_id NVARCHAR(64) NOT NULL,
+    color NVARCHAR(5) NOT NULL CHECK (color IN ('red', 'black')),
+    result NVARCHAR(8) NOT NULL CHECK (result IN ('win', 'loss', 'draw')),
+    opponent_id INT NOT NULL,
+    rating_delta INT NOT NULL DEFAULT 0,
+    PRIMARY KEY CLUSTERED (user_id, ended_at DESC, match_id DESC),
+    FOREIGN KEY (user_id) REFERENCES Users(user_id),
+    FOREIGN KEY (opponent_id) REFERENCES Users(user_id),
+    FOREIGN KEY (match_id) REFERENCES Matches(match_id),
+    INDEX IX_UserMatches_Opponent (user_id, opponent_id, ended_at DESC)
+);
+GO
+
 CREATE TABLE Sessions (
     session_token NVARCHAR(64) PRIMARY KEY,
     user_id INT NOT NULL,
@@ -0,0 +1,21 @@
+-- Adds Matches.end_reason and widens the replay index to cover it. Safe to run again.
+-- Games saved before it existed keep NULL; bin/rerate treats them as ordinary results, so a timeout among them
+-- is replayed without its extra penalty.
+
+USE XiangqiDB;
+GO
+
+IF COL_LENGTH('Matches', 'end_reason') IS NULL
+ALTER TABLE Matches ADD end_reason NVARCHAR(32) NULL;
+GO
+
+IF EXISTS (SELECT 1 FROM sys.indexes WHERE name = 'IX_Matches_Replay' AND object_id = OBJECT_ID('Matches'))
+DROP INDEX IX_Matches_Replay ON Matches;
+GO
+
+CREATE INDEX IX_Matches_Replay ON Matches (ended_at, match_id) INCLUDE (red_user_id, black_user_id, result, end_reason)
+    WHERE rated = 1;
+GO
+
+PRINT 'Matches.end_reason added.';
+GO
@@ -0,0 +1,20 @@
+-- Adds the Glicko-2 columns (rd, volatility, rated_at) to Users in a database created before they existed. Safe to
+-- run again. Everyone starts fully uncertain; run bin/rerate -s glicko2 --apply afterwards to seed them from history.
+
+USE XiangqiDB;
+GO
+
+IF COL_LENGTH('Users', 'rd') IS NULL
+ALTER TABLE Users ADD rd FLOAT NOT NULL CONSTRAINT DF_Users_Rd DEFAULT 350;
+GO
+
+IF COL_LENGTH('Users', 'volatility') IS NULL
+ALTER TABLE Users ADD volatility FLOAT NOT NULL CONSTRAINT DF_Users_Volatility DEFAULT 0.06;
+GO
+
+IF COL_LENGTH('Users', 'rated_at') IS NULL
+ALTER TABLE Users ADD rated_at BIGINT NOT NULL CONSTRAINT DF_Users_RatedAt DEFAULT 0;
+GO
+
+PRINT 'Users Glicko-2 columns added.';
+GO
@@ -0,0 +1,18 @@
+-- Adds Matches.rated and the replay index to a database created before they existed. Safe to run again.
+-- Whether older games were rated was never stored, so they are all marked rated; set rated = 0 by hand for known
+-- casual games before running bin/rerate if that matters.
+
+USE XiangqiDB;
+GO
+
+IF COL_LENGTH('Matches', 'rated') IS NULL
+ALTER TABLE Matches ADD rated BIT NOT NULL CONSTRAINT DF_Matches_Rated DEFAULT 1;
+GO
+
+IF NOT EXISTS (SELECT 1 FROM sys.indexes WHERE name = 'IX_Matches_Replay' AND object_id = OBJECT_ID('Matches'))
+CREATE INDEX IX_Matches_Replay ON Matches (ended_at, match_id) INCLUDE (red_user_id, black_user_id, result)
+    WHERE rated = 1;
+GO
+
+PRINT 'Matches.rated added.';
+GO
@@ -0,0 +1,59 @@
+-- Adds UserMatches to a database created before it existed and fills it from Matches. Safe to run again: rows that
+-- are already there are skipped. Rating changes were never stored per match, so backfilled rows carry rating_delta 0.
+
+USE XiangqiDB;
+GO
+
+IF OBJECT_ID('UserMatches', 'U') IS NULL
+CREATE TABLE UserMatches (
+    user_id INT NOT NULL,
+    ended_at NVARCHAR(32) NOT NULL,
+    match_id NVARCHAR(64) NOT NULL,
+    color NVARCHAR(5) NOT NULL CHECK (color IN ('red', 'black')),
+    result NVARCHAR(8) NOT NULL CHECK (result IN ('win', 'loss', 'draw')),
+    opponent_id INT NOT NULL,
+    rating_delta INT NOT NULL DEFAULT 0,
+    PRIMARY KEY CLUSTERED (user_id, ended_at DESC, match_id DESC),
+    FOREIGN KEY (user_id) REFERENCES Users(user_id),
+    FOREIGN KEY (opponent_id) REFERENCES Users(user_id),
+    FOREIGN KEY (match_id) REFERENCES Matches(match_id),
+    INDEX IX_UserMatches_Opponent (user_id, opponent_id, ended_at DESC)
+);
+GO
+
+-- Batches of 10000 matches keep the transaction log and lock footprint small on large tables
+DECLARE @batch INT = 10000;
+DECLARE @copied INT = 1;
+
+WHILE @copied > 0
+BEGIN
+    BEGIN TRANSACTION;
+
+    SELECT TOP (@batch) m.match_id, m.red_user_id, m.black_user_id, m.result, m.ended_at
+    INTO #pending
+    FROM Matches m
+    WHERE m.result IN ('red_win', 'black_win', 'draw')
+      AND m.ended_at IS NOT NULL
+      AND NOT EXISTS (SELECT 1 FROM UserMatches um
+                      WHERE um.user_id = m.red_user_id AND um.ended_at = m.ended_at AND um.match_id = m.match_id);
+
+    SET @copied = @@ROWCOUNT;
+
+    INSERT INTO UserMatches (user_id, ended_at, match_id, color, result, opponent_id, rating_delta)
+    SELECT red_user_id, ended_at, match_id, 'red',
+           CASE result WHEN 'red_win' THEN 'win' WHEN 'black_win' THEN 'loss' ELSE 'draw' END,
+           black_user_id, 0
+    FROM #pending
+    UNION ALL
+    SELECT black_user_id, ended_at, match_id, 'black',
+           CASE result WHEN 'black_win' THEN 'win' WHEN 'red_win' THEN 'loss' ELSE 'draw' END,
+           red_user_id, 0
+    FROM #pending
+    WHERE black_user_id <> red_user_id;
+
+    DROP TABLE #pending;
+    COMMIT TRANSACTION;
+END
+GO
+
+PRINT 'UserMatches backfilled.';
@@ -7,6 +7,7 @@
 #include <string.h>
 
 #include "../include/db.h"
+#include "../include/log.h"
 
 bool validate_username(const char* username) {
     if (!username)
@@ -51,22 +52,22 @@ bool email_exists(const char* email) {
 bool account_register(const char* username, const char* email, const char* password_hash, int* out_user_id) {
 
     if (!validate_username(username)) {
-        fprintf(stderr, "Invalid username: %s\n", username);
+        LOG_ERROR("Invalid username: %s", username);
         return false;
     }
 
     if (!validate_email(email)) {
-        fprintf(stderr, "Invalid email: %s\n", email);
+        LOG_ERROR("Invalid email: %s", email);
         return false;
     }
 
     if (username_exists(username)) {
-        fprintf(stderr, "Username already exists: %s\n", username);
+        LOG_ERROR("Username already exists: %s", username);
         return false;
     }
 
     if (email_exists(email)) {
-        fprintf(stderr, "Email already exists: %s\n", email);
+        LOG_ERROR("Email already exists: %s", email);
         return false;
     }
 
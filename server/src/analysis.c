@@ -0,0 +1,520 @@
+#define _GNU_SOURCE
+#include "../include/analysis.h"
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/engine.h"
+#include "../include/log.h"
+#include "../include/metrics.h"
+
+/* Per-position cap so a pathological position cannot pin a worker at fixed depth */
+#define ANALYSIS_POSITION_MS 5000
+/* How long a worker waits before looking at the load average again */
+#define ANALYSIS_BACKOFF_MS 1000
+/* Evals are clamped here before scoring moves, so missing a mate while still winning big is not a blunder */
+#define ANALYSIS_CLAMP_CP 1000
+
+typedef struct {
+    char match_id[32];
+    int priority;
+    uint64_t order; /* FIFO within a priority */
+    uint64_t queued_ns;
+    int move_count;
+    uint8_t moves[][2];
+} analysis_job_t;
+
+static bool enabled = false;
+static int search_depth = ANALYSIS_DEFAULT_DEPTH;
+static size_t hash_size_mb = ENGINE_DEFAULT_HASH_MB;
+static long online_cpus = 1;
+
+static pthread_t* workers = NULL;
+static int worker_count = 0;
+
+/* Binary max-heap on (priority, -order) */
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_ready = PTHREAD_COND_INITIALIZER;
+static analysis_job_t** heap = NULL;
+static int heap_count = 0;
+static int heap_capacity = 0;
+static uint64_t next_order = 0;
+static int busy_workers = 0;
+static bool stopping = false;
+static atomic_bool abort_search = false;
+
+static pthread_mutex_t result_lock = PTHREAD_MUTEX_INITIALIZER;
+static analysis_result_t* results = NULL;
+static int result_count = 0;
+static int result_capacity = 0;
+static int event_fd = -1;
+
+static metrics_histogram_t* game_histogram = NULL;
+static metrics_counter_t* nodes_counter = NULL;
+static metrics_counter_t* backoff_counter = NULL;
+static metrics_gauge_t* queue_gauge = NULL;
+
+static bool job_before(const analysis_job_t* a, const analysis_job_t* b) {
+    if (a->priority != b->priority)
+        return a->priority > b->priority;
+    return a->order < b->order;
+}
+
+static void heap_swap(int i, int j) {
+    analysis_job_t* tmp = heap[i];
+    heap[i] = heap[j];
+    heap[j] = tmp;
+}
+
+static void sift_up(int i) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!job_before(heap[i], heap[parent]))
+            break;
+        heap_swap(i, parent);
+        i = parent;
+    }
+}
+
+static void sift_down(int i) {
+    while (1) {
+        int best = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < heap_count && job_before(heap[left], heap[best]))
+            best = left;
+        if (right < heap_count && job_before(heap[right], heap[best]))
+            best = right;
+        if (best == i)
+            break;
+        heap_swap(i, best);
+        i = best;
+    }
+}
+
+static analysis_job_t* heap_pop(void) {
+    analysis_job_t* top = heap[0];
+    heap[0] = heap[--heap_count];
+    if (heap_count > 0)
+        sift_down(0);
+    return top;
+}
+
+static void push_result(const char* match_id, char* encoded) {
+    pthread_mutex_lock(&result_lock);
+    if (result_count == result_capacity) {
+        int new_capacity = result_capacity ? result_capacity * 2 : 16;
+        analysis_result_t* grown = realloc(results, (size_t)new_capacity * sizeof(analysis_result_t));
+        if (!grown) {
+            pthread_mutex_unlock(&result_lock);
+            LOG_ERROR("[Analysis] Dropping analysis of %s: out of memory", match_id);
+            free(encoded);
+            return;
+        }
+        results = grown;
+        result_capacity = new_capacity;
+    }
+    analysis_result_t* result = &results[result_count++];
+    snprintf(result->match_id, sizeof(result->match_id), "%s", match_id);
+    result->encoded = encoded;
+    pthread_mutex_unlock(&result_lock);
+
+    uint64_t one = 1;
+    if (write(event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        LOG_ERROR("[Analysis] eventfd write: %s", strerror(errno));
+}
+
+/*
+ * SCHED_IDLE already keeps workers off any core something else wants; the load average check also keeps them
+ * from starting work while the machine is saturated. The one-minute average includes the busy workers
+ * themselves, so they are subtracted out. Returns false when shutting down.
+ */
+static bool wait_for_idle_core(void) {
+    pthread_mutex_lock(&job_lock);
+    while (!stopping) {
+        double load;
+        if (getloadavg(&load, 1) != 1 || load - busy_workers < (double)online_cpus - 0.5)
+            break;
+
+        metrics_counter_add(backoff_counter, 1);
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += ANALYSIS_BACKOFF_MS / 1000;
+        deadline.tv_nsec += (long)(ANALYSIS_BACKOFF_MS % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&job_ready, &job_lock, &deadline);
+    }
+    bool running = !stopping;
+    pthread_mutex_unlock(&job_lock);
+    return running;
+}
+
+/* Mover's winning chances in percent, lichess-style logistic on centipawns */
+static double win_percent(int cp) {
+    return 50.0 + 50.0 * (2.0 / (1.0 + exp(-0.00368208 * cp)) - 1.0);
+}
+
+static double move_accuracy(int before_cp, int after_cp) {
+    double drop = win_percent(before_cp) - win_percent(after_cp);
+    if (drop < 0)
+        drop = 0;
+    double accuracy = 103.1668 * exp(-0.04354 * drop) - 3.1669;
+    return accuracy < 0 ? 0 : accuracy > 100 ? 100 : accuracy;
+}
+
+static int clamp_cp(int cp) {
+    return cp > ANALYSIS_CLAMP_CP ? ANALYSIS_CLAMP_CP : cp < -ANALYSIS_CLAMP_CP ? -ANALYSIS_CLAMP_CP : cp;
+}
+
+static analysis_class_t classify(int loss) {
+    if (loss >= ANALYSIS_BLUNDER_CP)
+        return ANALYSIS_MOVE_BLUNDER;
+    if (loss >= ANALYSIS_MISTAKE_CP)
+        return ANALYSIS_MOVE_MISTAKE;
+    if (loss >= ANALYSIS_INACCURACY_CP)
+        return ANALYSIS_MOVE_INACCURACY;
+    return ANALYSIS_MOVE_GOOD;
+}
+
+static void put_u16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)(v & 0xFF);
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static char* base64_encode(const uint8_t* data, size_t len) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char* out = malloc((len + 2) / 3 * 4 + 1);
+    if (!out)
+        return NULL;
+
+    char* p = out;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t n = (uint32_t)data[i] << 16;
+        if (i + 1 < len)
+            n |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < len)
+            n |= data[i + 2];
+        *p++ = alphabet[(n >> 18) & 63];
+        *p++ = alphabet[(n >> 12) & 63];
+        *p++ = i + 1 < len ? alphabet[(n >> 6) & 63] : '=';
+        *p++ = i + 2 < len ? alphabet[n & 63] : '=';
+    }
+    *p = '\0';
+    return out;
+}
+
+/* Searches all move_count + 1 positions; returns the encoded record or NULL if interrupted */
+static char* analyse_game(engine_t* engine, const analysis_job_t* job, uint64_t* nodes) {
+    int plies = job->move_count;
+    int* scores = malloc((size_t)(plies + 1) * sizeof(int)); /* side to move's point of view */
+    int* best = malloc((size_t)(plies + 1) * 2 * sizeof(int));
+    uint64_t* history = malloc((size_t)(plies + 1) * sizeof(uint64_t));
+    uint8_t* record = malloc(ANALYSIS_HEADER_SIZE + (size_t)plies * ANALYSIS_PLY_SIZE);
+    char* encoded = NULL;
+    if (!scores || !best || !history || !record)
+        goto done;
+
+    engine_clear(engine);
+    engine_limits_t limits = {search_depth, ANALYSIS_POSITION_MS, &abort_search};
+
+    board_t board;
+    board_init(&board);
+    for (int i = 0; i <= plies; i++) {
+        if (!wait_for_idle_core())
+            goto done;
+
+        bool black = i % 2 == 1;
+        engine_result_t result;
+        if (!engine_search(engine, &board, black, history, i, &limits, &result) || atomic_load(&abort_search))
+            goto done;
+        *nodes += result.nodes;
+
+        /* No legal move means the side to move is mated */
+        scores[i] = result.from < 0 ? -ENGINE_MATE : result.score;
+        best[i * 2] = result.from < 0 ? 0 : result.from;
+        best[i * 2 + 1] = result.from < 0 ? 0 : result.to;
+
+        if (i < plies) {
+            history[i] = engine_position_key(&board, black);
+            board_apply(&board, job->moves[i][0], job->moves[i][1]);
+        }
+    }
+
+    double accuracy_sum[2] = {0, 0};
+    int accuracy_count[2] = {0, 0};
+    uint8_t* p = record + ANALYSIS_HEADER_SIZE;
+    for (int i = 0; i < plies; i++) {
+        int side = i % 2;
+        int before = clamp_cp(scores[i]);
+        int after = clamp_cp(-scores[i + 1]);
+        int loss = before - after;
+        analysis_class_t cls = classify(loss > 0 ? loss : 0);
+
+        accuracy_sum[side] += move_accuracy(before, after);
+        accuracy_count[side]++;
+
+        int red_eval = (i + 1) % 2 == 1 ? -scores[i + 1] : scores[i + 1];
+        put_u16(p, (uint16_t)(int16_t)red_eval);
+        put_u16(p + 2, (uint16_t)(best[i * 2] << 9 | best[i * 2 + 1] << 2 | cls));
+        p += ANALYSIS_PLY_SIZE;
+    }
+
+    record[0] = ANALYSIS_VERSION;
+    record[1] = (uint8_t)search_depth;
+    for (int side = 0; side < 2; side++) {
+        double accuracy = accuracy_count[side] ? accuracy_sum[side] / accuracy_count[side] : 0;
+        put_u16(record + 2 + side * 2, (uint16_t)lround(accuracy * 10));
+    }
+    put_u16(record + 6, (uint16_t)plies);
+    put_u16(record + 8, (uint16_t)(int16_t)scores[0]);
+
+    encoded = base64_encode(record, ANALYSIS_HEADER_SIZE + (size_t)plies * ANALYSIS_PLY_SIZE);
+
+done:
+    free(scores);
+    free(best);
+    free(history);
+    free(record);
+    return encoded;
+}
+
+static void lower_priority(void) {
+    struct sched_param param = {0};
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) == 0)
+        return;
+    /* Nice values are per thread on Linux */
+    if (setpriority(PRIO_PROCESS, (id_t)gettid(), 19) != 0)
+        LOG_WARN("[Analysis] Could not lower worker priority: %s", strerror(errno));
+}
+
+static void* worker_loop(void* arg) {
+    (void)arg;
+    lower_priority();
+
+    engine_t* engine = engine_create(hash_size_mb, 1);
+    if (!engine) {
+        LOG_ERROR("[Analysis] Engine allocation failed; worker exiting");
+        return NULL;
+    }
+
+    while (1) {
+        pthread_mutex_lock(&job_lock);
+        while (heap_count == 0 && !stopping)
+            pthread_cond_wait(&job_ready, &job_lock);
+        if (stopping) {
+            pthread_mutex_unlock(&job_lock);
+            break;
+        }
+        analysis_job_t* job = heap_pop();
+        busy_workers++;
+        metrics_gauge_set(queue_gauge, heap_count);
+        pthread_mutex_unlock(&job_lock);
+
+        uint64_t start = metrics_now_ns();
+        uint64_t nodes = 0;
+        char* encoded = analyse_game(engine, job, &nodes);
+        metrics_counter_add(nodes_counter, nodes);
+        if (encoded) {
+            metrics_observe(game_histogram, metrics_now_ns() - start);
+            LOG_DEBUG("[Analysis] %s: %d plies at depth %d, %llu nodes in %llu ms (queued %llu ms)", job->match_id,
+                      job->move_count, search_depth, (unsigned long long)nodes,
+                      (unsigned long long)((metrics_now_ns() - start) / 1000000ULL),
+                      (unsigned long long)((start - job->queued_ns) / 1000000ULL));
+            push_result(job->match_id, encoded);
+        }
+
+        pthread_mutex_lock(&job_lock);
+        busy_workers--;
+        pthread_mutex_unlock(&job_lock);
+        free(job);
+    }
+
+    engine_destroy(engine);
+    return NULL;
+}
+
+bool analysis_init(int threads, int depth, int hash_mb) {
+    if (threads <= 0) {
+        LOG_INFO("[Analysis] Post-game analysis disabled");
+        return true;
+    }
+    if (depth < 1 || depth >= ENGINE_MAX_PLY) {
+        LOG_ERROR("[Analysis] Depth must be 1-%d", ENGINE_MAX_PLY - 1);
+        return false;
+    }
+    search_depth = depth;
+    hash_size_mb = hash_mb > 0 ? (size_t)hash_mb : ENGINE_DEFAULT_HASH_MB;
+
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    online_cpus = online > 0 ? online : 1;
+
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd < 0) {
+        LOG_ERROR("[Analysis] eventfd: %s", strerror(errno));
+        return false;
+    }
+
+    game_histogram = metrics_histogram("xiangqi_analysis_duration_seconds", "Engine time per analysed game", NULL,
+                                       NULL, METRICS_UNIT_NS);
+    nodes_counter = metrics_counter("xiangqi_analysis_nodes_total", "Positions searched by game analysis", NULL, NULL);
+    backoff_counter = metrics_counter("xiangqi_analysis_backoffs_total",
+                                      "Times an analysis worker waited for an idle core", NULL, NULL);
+    queue_gauge = metrics_gauge("xiangqi_analysis_queue_depth", "Finished games waiting for analysis");
+
+    workers = calloc((size_t)threads, sizeof(pthread_t));
+    if (!workers)
+        return false;
+
+    stopping = false;
+    atomic_store(&abort_search, false);
+    for (worker_count = 0; worker_count < threads; worker_count++) {
+        if (pthread_create(&workers[worker_count], NULL, worker_loop, NULL) != 0) {
+            LOG_ERROR("[Analysis] Failed to start worker %d", worker_count);
+            break;
+        }
+    }
+    if (worker_count == 0) {
+        analysis_shutdown();
+        return false;
+    }
+
+    enabled = true;
+    LOG_INFO("[Analysis] %d idle-priority workers, depth %d, %zu MB hash each", worker_count, search_depth,
+             hash_size_mb);
+    return true;
+}
+
+void analysis_shutdown(void) {
+    pthread_mutex_lock(&job_lock);
+    stopping = true;
+    atomic_store(&abort_search, true);
+    pthread_cond_broadcast(&job_ready);
+    pthread_mutex_unlock(&job_lock);
+
+    for (int i = 0; i < worker_count; i++)
+        pthread_join(workers[i], NULL);
+    free(workers);
+    workers = NULL;
+    worker_count = 0;
+
+    if (heap_count > 0)
+        LOG_INFO("[Analysis] %d games left unanalysed", heap_count);
+    for (int i = 0; i < heap_count; i++)
+        free(heap[i]);
+    free(heap);
+    heap = NULL;
+    heap_count = heap_capacity = 0;
+
+    for (int i = 0; i < result_count; i++)
+        free(results[i].encoded);
+    free(results);
+    results = NULL;
+    result_count = result_capacity = 0;
+
+    if (event_fd >= 0)
+        close(event_fd);
+    event_fd = -1;
+    enabled = false;
+}
+
+bool analysis_enabled(void) {
+    return enabled;
+}
+
+bool analysis_request(const match_t* match) {
+    if (!enabled || !match || match->move_count <= 0)
+        return false;
+
+    int count = match->move_count < MAX_MOVES_PER_MATCH ? match->move_count : MAX_MOVES_PER_MATCH;
+    analysis_job_t* job = malloc(sizeof(analysis_job_t) + (size_t)count * 2);
+    if (!job)
+        return false;
+
+    snprintf(job->match_id, sizeof(job->match_id), "%s", match->match_id);
+    job->priority = match->rated ? ANALYSIS_PRIORITY_NORMAL : ANALYSIS_PRIORITY_LOW;
+    job->queued_ns = metrics_now_ns();
+    job->move_count = count;
+    for (int i = 0; i < count; i++) {
+        job->moves[i][0] = match->moves[i].from;
+        job->moves[i][1] = match->moves[i].to;
+    }
+
+    pthread_mutex_lock(&job_lock);
+    if (heap_count == heap_capacity) {
+        int new_capacity = heap_capacity ? heap_capacity * 2 : 16;
+        analysis_job_t** grown = realloc(heap, (size_t)new_capacity * sizeof(analysis_job_t*));
+        if (!grown) {
+            pthread_mutex_unlock(&job_lock);
+            free(job);
+            return false;
+        }
+        heap = grown;
+        heap_capacity = new_capacity;
+    }
+    job->order = next_order++;
+    heap[heap_count] = job;
+    sift_up(heap_count++);
+    metrics_gauge_set(queue_gauge, heap_count);
+    pthread_cond_signal(&job_ready);
+    pthread_mutex_unlock(&job_lock);
+    return true;
+}
+
+bool analysis_prioritize(const char* match_id) {
+    if (!enabled || !match_id)
+        return false;
+
+    bool found = false;
+    pthread_mutex_lock(&job_lock);
+    for (int i = 0; i < heap_count; i++) {
+        if (strcmp(heap[i]->match_id, match_id) == 0) {
+            if (heap[i]->priority < ANALYSIS_PRIORITY_HIGH) {
+                heap[i]->priority = ANALYSIS_PRIORITY_HIGH;
+                sift_up(i);
+            }
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&job_lock);
+    return found;
+}
+
+int analysis_event_fd(void) {
+    return event_fd;
+}
+
+int analysis_take_results(analysis_result_t* out, int max_count) {
+    uint64_t pending;
+    if (read(event_fd, &pending, sizeof(pending)) < 0 && errno != EAGAIN)
+        LOG_ERROR("[Analysis] eventfd read: %s", strerror(errno));
+
+    pthread_mutex_lock(&result_lock);
+    int count = result_count < max_count ? result_count : max_count;
+    memcpy(out, results, (size_t)count * sizeof(analysis_result_t));
+    memmove(results, results + count, (size_t)(result_count - count) * sizeof(analysis_result_t));
+    result_count -= count;
+    bool more = result_count > 0;
+    pthread_mutex_unlock(&result_lock);
+
+    /* Leftovers keep the eventfd readable for the next loop iteration */
+    if (more) {
+        uint64_t one = 1;
+        if (write(event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            LOG_ERROR("[Analysis] eventfd write: %s", strerror(errno));
+    }
+    return count;
+}
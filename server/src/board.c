@@ -0,0 +1,314 @@
+#include "../include/board.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const uint8_t back_rank[BOARD_COLS] = {PIECE_CHARIOT, PIECE_HORSE,    PIECE_ELEPHANT, PIECE_ADVISOR, PIECE_KING,
+                                              PIECE_ADVISOR, PIECE_ELEPHANT, PIECE_HORSE,    PIECE_CHARIOT};
+
+void board_init(board_t* board) {
+    memset(board->squares, PIECE_NONE, sizeof(board->squares));
+
+    for (int col = 0; col < BOARD_COLS; col++) {
+        board->squares[SQUARE(0, col)] = back_rank[col] | PIECE_BLACK;
+        board->squares[SQUARE(9, col)] = back_rank[col];
+    }
+
+    board->squares[SQUARE(2, 1)] = PIECE_CANNON | PIECE_BLACK;
+    board->squares[SQUARE(2, 7)] = PIECE_CANNON | PIECE_BLACK;
+    board->squares[SQUARE(7, 1)] = PIECE_CANNON;
+    board->squares[SQUARE(7, 7)] = PIECE_CANNON;
+
+    for (int col = 0; col < BOARD_COLS; col += 2) {
+        board->squares[SQUARE(3, col)] = PIECE_PAWN | PIECE_BLACK;
+        board->squares[SQUARE(6, col)] = PIECE_PAWN;
+    }
+}
+
+uint8_t board_apply(board_t* board, int from, int to) {
+    if (from < 0 || from >= BOARD_SQUARES || to < 0 || to >= BOARD_SQUARES)
+        return PIECE_NONE;
+
+    uint8_t captured = board->squares[to];
+    board->squares[to] = board->squares[from];
+    board->squares[from] = PIECE_NONE;
+    return captured;
+}
+
+char board_piece_char(uint8_t piece) {
+    static const char letters[] = ".kaehrcp";
+    char c = letters[PIECE_TYPE(piece)];
+    if (piece != PIECE_NONE && !PIECE_IS_BLACK(piece))
+        c = (char)(c - 'a' + 'A');
+    return c;
+}
+
+void board_format_position(const board_t* board, char* out) {
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        out[sq] = board_piece_char(board->squares[sq]);
+    }
+    out[BOARD_SQUARES] = '\0';
+}
+
+bool board_parse_position(board_t* board, const char* position) {
+    static const char letters[] = ".kaehrcp";
+
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        char c = position[sq];
+        if (c == '\0')
+            return false;
+
+        bool red = (c >= 'A' && c <= 'Z');
+        const char* found = strchr(letters, red ? c - 'A' + 'a' : c);
+        if (!found || *found == '\0')
+            return false;
+
+        uint8_t piece = (uint8_t)(found - letters);
+        if (piece != PIECE_NONE && !red)
+            piece |= PIECE_BLACK;
+        board->squares[sq] = piece;
+    }
+
+    return true;
+}
+
+static bool in_palace(int row, int col, bool black) {
+    if (col < 3 || col > 5)
+        return false;
+    return black ? row <= 2 : row >= 7;
+}
+
+static bool on_own_side(int row, bool black) {
+    return black ? row <= 4 : row >= 5;
+}
+
+static int add_target(const board_t* board, bool black, bool captures_only, int from, int row, int col,
+                      board_move_t* moves, int count) {
+    if (row < 0 || row >= BOARD_ROWS || col < 0 || col >= BOARD_COLS)
+        return count;
+
+    uint8_t target = board->squares[SQUARE(row, col)];
+    if (target == PIECE_NONE ? captures_only : PIECE_IS_BLACK(target) == black)
+        return count;
+
+    moves[count].from = (uint8_t)from;
+    moves[count].to = (uint8_t)SQUARE(row, col);
+    return count + 1;
+}
+
+int board_generate_pseudo_moves(const board_t* board, bool black, bool captures_only, board_move_t* moves) {
+    static const int orth[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    static const int diag[4][2] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+    int count = 0;
+
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        uint8_t piece = board->squares[sq];
+        if (piece == PIECE_NONE || PIECE_IS_BLACK(piece) != black)
+            continue;
+
+        int row = SQUARE_ROW(sq), col = SQUARE_COL(sq);
+
+        switch (PIECE_TYPE(piece)) {
+        case PIECE_KING:
+            for (int d = 0; d < 4; d++) {
+                int r = row + orth[d][0], c = col + orth[d][1];
+                if (in_palace(r, c, black))
+                    count = add_target(board, black, captures_only, sq, r, c, moves, count);
+            }
+            break;
+        case PIECE_ADVISOR:
+            for (int d = 0; d < 4; d++) {
+                int r = row + diag[d][0], c = col + diag[d][1];
+                if (in_palace(r, c, black))
+                    count = add_target(board, black, captures_only, sq, r, c, moves, count);
+            }
+            break;
+        case PIECE_ELEPHANT:
+            for (int d = 0; d < 4; d++) {
+                int r = row + 2 * diag[d][0], c = col + 2 * diag[d][1];
+                if (r < 0 || r >= BOARD_ROWS || c < 0 || c >= BOARD_COLS || !on_own_side(r, black))
+                    continue;
+                if (board->squares[SQUARE(row + diag[d][0], col + diag[d][1])] == PIECE_NONE)
+                    count = add_target(board, black, captures_only, sq, r, c, moves, count);
+            }
+            break;
+        case PIECE_HORSE:
+            for (int d = 0; d < 4; d++) {
+                int leg_r = row + orth[d][0], leg_c = col + orth[d][1];
+                if (leg_r < 0 || leg_r >= BOARD_ROWS || leg_c < 0 || leg_c >= BOARD_COLS ||
+                    board->squares[SQUARE(leg_r, leg_c)] != PIECE_NONE)
+                    continue;
+                /* Step straight once, then diagonally away from the origin */
+                if (orth[d][0] != 0) {
+                    count = add_target(board, black, captures_only, sq, leg_r + orth[d][0], leg_c - 1, moves, count);
+                    count = add_target(board, black, captures_only, sq, leg_r + orth[d][0], leg_c + 1, moves, count);
+                } else {
+                    count = add_target(board, black, captures_only, sq, leg_r - 1, leg_c + orth[d][1], moves, count);
+                    count = add_target(board, black, captures_only, sq, leg_r + 1, leg_c + orth[d][1], moves, count);
+                }
+            }
+            break;
+        case PIECE_CHARIOT:
+        case PIECE_CANNON: {
+            bool cannon = PIECE_TYPE(piece) == PIECE_CANNON;
+            for (int d = 0; d < 4; d++) {
+                bool screened = false;
+                for (int r = row + orth[d][0], c = col + orth[d][1];
+                     r >= 0 && r < BOARD_ROWS && c >= 0 && c < BOARD_COLS; r += orth[d][0], c += orth[d][1]) {
+                    uint8_t target = board->squares[SQUARE(r, c)];
+                    if (!cannon) {
+                        count = add_target(board, black, captures_only, sq, r, c, moves, count);
+                        if (target != PIECE_NONE)
+                            break;
+                    } else if (!screened) {
+                        if (target == PIECE_NONE)
+                            count = add_target(board, black, captures_only, sq, r, c, moves, count);
+                        else
+                            screened = true;
+                    } else if (target != PIECE_NONE) {
+                        count = add_target(board, black, captures_only, sq, r, c, moves, count);
+                        break;
+                    }
+                }
+            }
+            break;
+        }
+        case PIECE_PAWN: {
+            int forward = black ? 1 : -1;
+            count = add_target(board, black, captures_only, sq, row + forward, col, moves, count);
+            if (!on_own_side(row, black)) {
+                count = add_target(board, black, captures_only, sq, row, col - 1, moves, count);
+                count = add_target(board, black, captures_only, sq, row, col + 1, moves, count);
+            }
+            break;
+        }
+        }
+    }
+
+    return count;
+}
+
+static int find_king(const board_t* board, bool black) {
+    uint8_t king = PIECE_KING | (black ? PIECE_BLACK : 0);
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        if (board->squares[sq] == king)
+            return sq;
+    }
+    return -1;
+}
+
+bool board_king_attacked(const board_t* board, int king, bool black) {
+    static const int orth[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    uint8_t enemy = black ? 0 : PIECE_BLACK;
+    int row = SQUARE_ROW(king), col = SQUARE_COL(king);
+
+    /* Chariots and the facing general hit the first piece on a line, cannons the second */
+    for (int d = 0; d < 4; d++) {
+        int screens = 0;
+        for (int r = row + orth[d][0], c = col + orth[d][1]; r >= 0 && r < BOARD_ROWS && c >= 0 && c < BOARD_COLS;
+             r += orth[d][0], c += orth[d][1]) {
+            uint8_t piece = board->squares[SQUARE(r, c)];
+            if (piece == PIECE_NONE)
+                continue;
+            if (screens == 0) {
+                if (piece == (PIECE_CHARIOT | enemy) || (piece == (PIECE_KING | enemy) && orth[d][1] == 0))
+                    return true;
+                screens = 1;
+            } else {
+                if (piece == (PIECE_CANNON | enemy))
+                    return true;
+                break;
+            }
+        }
+    }
+
+    /* A horse attacks from a knight's jump away when its own leg (the orthogonal step next to it) is empty */
+    static const int jumps[8][2] = {{-2, -1}, {-2, 1}, {2, -1}, {2, 1}, {-1, -2}, {1, -2}, {-1, 2}, {1, 2}};
+    for (int j = 0; j < 8; j++) {
+        int r = row + jumps[j][0], c = col + jumps[j][1];
+        if (r < 0 || r >= BOARD_ROWS || c < 0 || c >= BOARD_COLS ||
+            board->squares[SQUARE(r, c)] != (PIECE_HORSE | enemy))
+            continue;
+        int leg_r = jumps[j][0] == 2 || jumps[j][0] == -2 ? r - jumps[j][0] / 2 : r;
+        int leg_c = jumps[j][1] == 2 || jumps[j][1] == -2 ? c - jumps[j][1] / 2 : c;
+        if (board->squares[SQUARE(leg_r, leg_c)] == PIECE_NONE)
+            return true;
+    }
+
+    /* Enemy pawns step toward this side's back rank, and sideways once across the river */
+    int behind = black ? row + 1 : row - 1;
+    if (behind >= 0 && behind < BOARD_ROWS && board->squares[SQUARE(behind, col)] == (PIECE_PAWN | enemy))
+        return true;
+    for (int c = col - 1; c <= col + 1; c += 2) {
+        if (c >= 0 && c < BOARD_COLS && board->squares[SQUARE(row, c)] == (PIECE_PAWN | enemy) &&
+            !on_own_side(row, !black))
+            return true;
+    }
+
+    return false;
+}
+
+bool board_in_check(const board_t* board, bool black) {
+    int king = find_king(board, black);
+    if (king < 0)
+        return true;
+    return board_king_attacked(board, king, black);
+}
+
+int board_generate_moves(const board_t* board, bool black, board_move_t* moves) {
+    board_move_t pseudo[BOARD_MAX_MOVES];
+    int pseudo_count = board_generate_pseudo_moves(board, black, false, pseudo);
+    int count = 0;
+
+    for (int i = 0; i < pseudo_count; i++) {
+        board_t next = *board;
+        board_apply(&next, pseudo[i].from, pseudo[i].to);
+        if (!board_in_check(&next, black))
+            moves[count++] = pseudo[i];
+    }
+
+    return count;
+}
+
+bool board_format_notation(const board_t* board, int from, int to, char* out, size_t out_size) {
+    if (!out || out_size < 6 || from < 0 || from >= BOARD_SQUARES || to < 0 || to >= BOARD_SQUARES)
+        return false;
+
+    uint8_t piece = board->squares[from];
+    if (piece == PIECE_NONE)
+        return false;
+
+    bool black = PIECE_IS_BLACK(piece);
+    int type = PIECE_TYPE(piece);
+    int from_row = SQUARE_ROW(from), from_col = SQUARE_COL(from);
+    int to_row = SQUARE_ROW(to), to_col = SQUARE_COL(to);
+
+    /* Files count from the mover's right-hand side */
+    int from_file = black ? from_col + 1 : BOARD_COLS - from_col;
+    int to_file = black ? to_col + 1 : BOARD_COLS - to_col;
+    int forward = black ? to_row - from_row : from_row - to_row;
+
+    /* Two identical pieces on one file are told apart by front/rear instead of file */
+    char file_mark = (char)('0' + from_file);
+    for (int row = 0; row < BOARD_ROWS; row++) {
+        if (row != from_row && board->squares[SQUARE(row, from_col)] == piece) {
+            bool ahead = black ? row > from_row : row < from_row;
+            file_mark = ahead ? '-' : '+';
+            break;
+        }
+    }
+
+    char op = forward > 0 ? '+' : (forward < 0 ? '-' : '.');
+
+    int target;
+    bool diagonal = (type == PIECE_HORSE || type == PIECE_ELEPHANT || type == PIECE_ADVISOR);
+    if (op == '.' || diagonal) {
+        target = to_file;
+    } else {
+        target = abs(forward);
+    }
+
+    snprintf(out, out_size, "%c%c%c%d", board_piece_char(piece & ~PIECE_BLACK), file_mark, op, target);
+    return true;
+}
@@ -0,0 +1,200 @@
+#include "../include/book.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/engine.h"
+#include "../include/log.h"
+
+static struct {
+    void* map;
+    size_t map_size;
+    const book_header_t* header;
+    const uint64_t* keys;
+    const book_position_t* positions;
+    const book_move_t* moves;
+    const uint32_t* name_offsets;
+    const char* names;
+    uint32_t count;
+} book = {0};
+
+/*
+ * Eytzinger lower bound: descend left or right by comparison, then undo the trailing right turns to land on
+ * the first key not less than the target. Prefetching 8*k pulls in the node three levels further down.
+ */
+static uint32_t find(uint64_t key) {
+    const uint64_t* keys = book.keys;
+    uint64_t n = book.count;
+    uint64_t k = 1;
+    while (k <= n) {
+        __builtin_prefetch(keys + 8 * k);
+        k = 2 * k + (keys[k] < key);
+    }
+    k >>= __builtin_ffsll((long long)~k);
+    return k != 0 && keys[k] == key ? (uint32_t)k : 0;
+}
+
+static const book_position_t* lookup(const board_t* board, bool black) {
+    if (!book.map)
+        return NULL;
+    uint32_t k = find(engine_position_key(board, black));
+    return k ? &book.positions[k] : NULL;
+}
+
+static const char* name_of(const book_position_t* pos) {
+    if (!pos || pos->name == BOOK_NO_NAME || pos->name >= book.header->name_count)
+        return NULL;
+    return book.names + book.name_offsets[pos->name];
+}
+
+bool book_open(const char* path) {
+    book_close();
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERROR("[Book] Cannot open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(book_header_t)) {
+        LOG_ERROR("[Book] %s is not an opening book", path);
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void* map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        LOG_ERROR("[Book] mmap %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    const book_header_t* header = map;
+    const char* base = map;
+    size_t slots = (size_t)header->position_count + 1;
+    size_t keys_at = sizeof(book_header_t);
+    size_t positions_at = keys_at + slots * sizeof(uint64_t);
+    size_t moves_at = positions_at + slots * sizeof(book_position_t);
+    size_t offsets_at = moves_at + (size_t)header->move_count * sizeof(book_move_t);
+    size_t names_at = offsets_at + (size_t)header->name_count * sizeof(uint32_t);
+
+    board_t start;
+    board_init(&start);
+    const char* problem = NULL;
+    if (memcmp(header->magic, BOOK_MAGIC, sizeof(header->magic)) != 0)
+        problem = "bad magic";
+    else if (header->version != BOOK_VERSION)
+        problem = "unsupported version";
+    else if (header->start_key != engine_position_key(&start, false))
+        problem = "built with different position hashing";
+    else if (names_at + header->names_size != size)
+        problem = "truncated or oversized";
+
+    if (problem) {
+        LOG_ERROR("[Book] Rejecting %s: %s", path, problem);
+        munmap(map, size);
+        return false;
+    }
+
+    /* Opening lines are probed in no particular order; don't let readahead guess */
+    madvise(map, size, MADV_RANDOM);
+
+    book.map = map;
+    book.map_size = size;
+    book.header = header;
+    book.keys = (const uint64_t*)(base + keys_at);
+    book.positions = (const book_position_t*)(base + positions_at);
+    book.moves = (const book_move_t*)(base + moves_at);
+    book.name_offsets = (const uint32_t*)(base + offsets_at);
+    book.names = base + names_at;
+    book.count = header->position_count;
+
+    LOG_INFO("[Book] %s: %u positions, %u moves, %u named openings", path, header->position_count,
+             header->move_count, header->name_count);
+    return true;
+}
+
+void book_close(void) {
+    if (book.map)
+        munmap(book.map, book.map_size);
+    memset(&book, 0, sizeof(book));
+}
+
+bool book_loaded(void) {
+    return book.map != NULL;
+}
+
+int book_probe(const board_t* board, bool black, book_move_t* out, int max_moves) {
+    const book_position_t* pos = lookup(board, black);
+    if (!pos || pos->first_move + pos->move_count > book.header->move_count)
+        return 0;
+
+    int count = pos->move_count < max_moves ? pos->move_count : max_moves;
+    memcpy(out, book.moves + pos->first_move, (size_t)count * sizeof(book_move_t));
+    return count;
+}
+
+bool book_pick(const board_t* board, bool black, uint32_t roll, int* out_from, int* out_to) {
+    book_move_t candidates[BOOK_MAX_MOVES];
+    int count = book_probe(board, black, candidates, BOOK_MAX_MOVES);
+    if (count == 0)
+        return false;
+
+    /* A key collision could suggest anything, so only legal moves take part */
+    board_move_t legal[BOARD_MAX_MOVES];
+    int legal_count = board_generate_moves(board, black, legal);
+    uint32_t total = 0;
+    for (int i = 0; i < count; i++) {
+        bool ok = false;
+        for (int j = 0; j < legal_count && !ok; j++)
+            ok = legal[j].from == candidates[i].from && legal[j].to == candidates[i].to;
+        if (!ok)
+            candidates[i].weight = 0;
+        total += candidates[i].weight;
+    }
+    if (total == 0)
+        return false;
+
+    uint32_t target = roll % total;
+    for (int i = 0; i < count; i++) {
+        if (target < candidates[i].weight) {
+            *out_from = candidates[i].from;
+            *out_to = candidates[i].to;
+            return true;
+        }
+        target -= candidates[i].weight;
+    }
+    return false;
+}
+
+const char* book_identify(const uint8_t (*moves)[2], int move_count, int* book_plies) {
+    const char* name = NULL;
+    int plies = 0;
+
+    if (book.map) {
+        board_t board;
+        board_init(&board);
+        name = name_of(lookup(&board, false));
+        for (int i = 0; i < move_count && i < BOOK_MAX_PLY; i++) {
+            board_apply(&board, moves[i][0], moves[i][1]);
+            const book_position_t* pos = lookup(&board, i % 2 == 0);
+            if (!pos)
+                break;
+            plies = i + 1;
+            const char* deeper = name_of(pos);
+            if (deeper)
+                name = deeper;
+        }
+    }
+
+    if (book_plies)
+        *book_plies = plies;
+    return name;
+}
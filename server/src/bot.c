@@ -0,0 +1,373 @@
+#include "../include/bot.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/random.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/book.h"
+#include "../include/db.h"
+#include "../include/engine.h"
+#include "../include/log.h"
+#include "../include/metrics.h"
+
+typedef struct {
+    const char* username;
+    int max_depth;
+    int max_time_ms;
+} bot_level_t;
+
+/* Index 0 is unused so levels index directly */
+static const bot_level_t levels[BOT_LEVEL_MAX + 1] = {
+    {NULL, 0, 0},
+    {"bot_level1", 1, 200},
+    {"bot_level2", 2, 500},
+    {"bot_level3", 4, 1000},
+    {"bot_level4", 8, 2500},
+    {"bot_level5", 0, 5000},
+};
+
+typedef struct bot_job {
+    struct bot_job* next;
+    char match_id[32];
+    int move_count;
+    int level;
+    int time_ms;
+    uint64_t queued_ns;
+    board_t board;
+    bool black;
+    int history_count;
+    uint64_t history[MAX_MOVES_PER_MATCH];
+} bot_job_t;
+
+static int level_user_ids[BOT_LEVEL_MAX + 1];
+static bool enabled = false;
+
+static pthread_t* workers = NULL;
+static int worker_count = 0;
+static int search_thread_count = BOT_DEFAULT_SEARCH_THREADS;
+static size_t hash_size_mb = ENGINE_DEFAULT_HASH_MB;
+static int pin_cpus[ENGINE_MAX_THREADS];
+static int pin_cpu_count = 0;
+
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_ready = PTHREAD_COND_INITIALIZER;
+static bot_job_t* job_head = NULL;
+static bot_job_t* job_tail = NULL;
+static bool stopping = false;
+static atomic_bool abort_search = false;
+
+static pthread_mutex_t result_lock = PTHREAD_MUTEX_INITIALIZER;
+static bot_move_t* results = NULL;
+static int result_count = 0;
+static int result_capacity = 0;
+static int event_fd = -1;
+
+static metrics_histogram_t* search_histogram = NULL;
+static metrics_counter_t* nodes_counter = NULL;
+static metrics_counter_t* book_counter = NULL;
+
+static void push_result(const bot_move_t* move) {
+    pthread_mutex_lock(&result_lock);
+    if (result_count == result_capacity) {
+        int new_capacity = result_capacity ? result_capacity * 2 : 16;
+        bot_move_t* grown = realloc(results, (size_t)new_capacity * sizeof(bot_move_t));
+        if (!grown) {
+            pthread_mutex_unlock(&result_lock);
+            LOG_ERROR("[Bot] Dropping move for %s: out of memory", move->match_id);
+            return;
+        }
+        results = grown;
+        result_capacity = new_capacity;
+    }
+    results[result_count++] = *move;
+    pthread_mutex_unlock(&result_lock);
+
+    uint64_t one = 1;
+    if (write(event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        LOG_ERROR("[Bot] eventfd write: %s", strerror(errno));
+}
+
+static void* worker_loop(void* arg) {
+    int index = (int)(intptr_t)arg;
+    engine_t* engine = engine_create(hash_size_mb, search_thread_count);
+    if (!engine) {
+        LOG_ERROR("[Bot] Engine allocation failed; worker exiting");
+        return NULL;
+    }
+    /* Workers take consecutive blocks of the cpu list so their helpers don't share cores */
+    if (pin_cpu_count > 0 && !engine_set_affinity(engine, pin_cpus, pin_cpu_count, index * search_thread_count))
+        LOG_WARN("[Bot] Could not pin engine threads of worker %d", index);
+
+    while (1) {
+        pthread_mutex_lock(&job_lock);
+        while (!job_head && !stopping)
+            pthread_cond_wait(&job_ready, &job_lock);
+        if (stopping) {
+            pthread_mutex_unlock(&job_lock);
+            break;
+        }
+        bot_job_t* job = job_head;
+        job_head = job->next;
+        if (!job_head)
+            job_tail = NULL;
+        pthread_mutex_unlock(&job_lock);
+
+        const bot_level_t* level = &levels[job->level];
+        engine_limits_t limits = {level->max_depth, job->time_ms, &abort_search};
+        engine_result_t result;
+        bot_move_t move = {0};
+        snprintf(move.match_id, sizeof(move.match_id), "%s", job->match_id);
+        move.move_count = job->move_count;
+        move.from = move.to = -1;
+
+        uint32_t roll = 0;
+        if (job->move_count < BOOK_MAX_PLY && getrandom(&roll, sizeof(roll), 0) == (ssize_t)sizeof(roll) &&
+            book_pick(&job->board, job->black, roll, &move.from, &move.to)) {
+            /* Book moves are played straight away, without a search */
+            metrics_counter_add(book_counter, 1);
+            LOG_DEBUG("[Bot] %s level %d: book move %d->%d", job->match_id, job->level, move.from, move.to);
+        } else if (engine_search(engine, &job->board, job->black, job->history, job->history_count, &limits, &result)) {
+            move.from = result.from;
+            move.to = result.to;
+            metrics_observe(search_histogram, (uint64_t)result.elapsed_ms * 1000000ULL);
+            metrics_counter_add(nodes_counter, result.nodes);
+            LOG_DEBUG("[Bot] %s level %d: depth %d score %d, %llu nodes in %d ms (%llu nps, %d threads)",
+                      job->match_id, job->level, result.depth, result.score, (unsigned long long)result.nodes,
+                      result.elapsed_ms, (unsigned long long)result.nps, result.threads);
+        }
+        move.think_ms = (int)((metrics_now_ns() - job->queued_ns) / 1000000ULL);
+
+        if (!atomic_load(&abort_search))
+            push_result(&move);
+        free(job);
+    }
+
+    engine_destroy(engine);
+    return NULL;
+}
+
+/* Bot accounts get a random password hash nobody can log in with */
+static bool ensure_account(int level) {
+    const char* username = levels[level].username;
+    int user_id = 0;
+    if (db_get_user_by_username(username, &user_id, NULL, NULL)) {
+        level_user_ids[level] = user_id;
+        return true;
+    }
+
+    unsigned char random[32];
+    if (getrandom(random, sizeof(random), 0) != (ssize_t)sizeof(random))
+        return false;
+    char password_hash[65];
+    for (size_t i = 0; i < sizeof(random); i++)
+        snprintf(password_hash + i * 2, 3, "%02x", random[i]);
+
+    char email[64];
+    snprintf(email, sizeof(email), "%s@bot.xiangqi.local", username);
+    if (!db_create_user(username, email, password_hash, &user_id))
+        return false;
+
+    level_user_ids[level] = user_id;
+    return true;
+}
+
+bool bot_init(int threads, int search_threads, int hash_mb, const char* cpu_list) {
+    if (threads <= 0) {
+        LOG_INFO("[Bot] Computer opponents disabled");
+        return true;
+    }
+
+    if (search_threads < 1 || search_threads > ENGINE_MAX_THREADS) {
+        LOG_ERROR("[Bot] Search threads must be 1-%d", ENGINE_MAX_THREADS);
+        return false;
+    }
+    search_thread_count = search_threads;
+    hash_size_mb = hash_mb > 0 ? (size_t)hash_mb : ENGINE_DEFAULT_HASH_MB;
+
+    pin_cpu_count = 0;
+    if (cpu_list && cpu_list[0]) {
+        pin_cpu_count = engine_parse_cpu_list(cpu_list, pin_cpus, ENGINE_MAX_THREADS);
+        if (pin_cpu_count <= 0) {
+            LOG_ERROR("[Bot] Invalid cpu list: %s", cpu_list);
+            return false;
+        }
+    }
+
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (online > 0 && (long)threads * search_threads >= online)
+        LOG_WARN("[Bot] %d engine threads on %ld cpus leave none for the reactor", threads * search_threads, online);
+
+    for (int level = BOT_LEVEL_MIN; level <= BOT_LEVEL_MAX; level++) {
+        if (!ensure_account(level)) {
+            LOG_ERROR("[Bot] Cannot create account %s", levels[level].username);
+            return false;
+        }
+    }
+
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd < 0) {
+        LOG_ERROR("[Bot] eventfd: %s", strerror(errno));
+        return false;
+    }
+
+    search_histogram = metrics_histogram("xiangqi_bot_search_duration_seconds", "Engine time per bot move", NULL, NULL,
+                                         METRICS_UNIT_NS);
+    nodes_counter = metrics_counter("xiangqi_bot_nodes_total", "Positions searched for bot moves", NULL, NULL);
+    book_counter =
+        metrics_counter("xiangqi_bot_book_moves_total", "Bot moves played from the opening book", NULL, NULL);
+
+    workers = calloc((size_t)threads, sizeof(pthread_t));
+    if (!workers)
+        return false;
+
+    stopping = false;
+    atomic_store(&abort_search, false);
+    for (worker_count = 0; worker_count < threads; worker_count++) {
+        if (pthread_create(&workers[worker_count], NULL, worker_loop, (void*)(intptr_t)worker_count) != 0) {
+            LOG_ERROR("[Bot] Failed to start engine thread %d", worker_count);
+            break;
+        }
+    }
+    if (worker_count == 0) {
+        bot_shutdown();
+        return false;
+    }
+
+    enabled = true;
+    LOG_INFO("[Bot] %d workers x %d search threads, %zu MB hash each, levels %d-%d ready", worker_count,
+             search_thread_count, hash_size_mb, BOT_LEVEL_MIN, BOT_LEVEL_MAX);
+    return true;
+}
+
+void bot_shutdown(void) {
+    pthread_mutex_lock(&job_lock);
+    stopping = true;
+    atomic_store(&abort_search, true);
+    pthread_cond_broadcast(&job_ready);
+    pthread_mutex_unlock(&job_lock);
+
+    for (int i = 0; i < worker_count; i++)
+        pthread_join(workers[i], NULL);
+    free(workers);
+    workers = NULL;
+    worker_count = 0;
+
+    while (job_head) {
+        bot_job_t* next = job_head->next;
+        free(job_head);
+        job_head = next;
+    }
+    job_tail = NULL;
+
+    free(results);
+    results = NULL;
+    result_count = result_capacity = 0;
+
+    if (event_fd >= 0)
+        close(event_fd);
+    event_fd = -1;
+    enabled = false;
+}
+
+bool bot_enabled(void) {
+    return enabled;
+}
+
+int bot_user_id(int level) {
+    if (!enabled || level < BOT_LEVEL_MIN || level > BOT_LEVEL_MAX)
+        return 0;
+    return level_user_ids[level];
+}
+
+int bot_level_of(int user_id) {
+    if (!enabled || user_id <= 0)
+        return 0;
+    for (int level = BOT_LEVEL_MIN; level <= BOT_LEVEL_MAX; level++) {
+        if (level_user_ids[level] == user_id)
+            return level;
+    }
+    return 0;
+}
+
+bool bot_request_move(const match_t* match) {
+    if (!enabled || !match || !match->active)
+        return false;
+
+    bool black = match->move_count % 2 == 1;
+    int level = bot_level_of(black ? match->black_user_id : match->red_user_id);
+    if (level == 0)
+        return false;
+
+    bot_job_t* job = malloc(sizeof(bot_job_t));
+    if (!job)
+        return false;
+
+    snprintf(job->match_id, sizeof(job->match_id), "%s", match->match_id);
+    job->next = NULL;
+    job->move_count = match->move_count;
+    job->level = level;
+    job->board = match->board;
+    job->black = black;
+    job->queued_ns = metrics_now_ns();
+
+    /* Replay the game for the repetition history; the match keeps moves, not positions */
+    board_t replay;
+    board_init(&replay);
+    job->history_count = 0;
+    for (int i = 0; i < match->move_count && i < MAX_MOVES_PER_MATCH; i++) {
+        job->history[job->history_count++] = engine_position_key(&replay, i % 2 == 1);
+        board_apply(&replay, match->moves[i].from, match->moves[i].to);
+    }
+
+    /* Budget from the bot's own clock, capped by the level */
+    int remaining = black ? match->black_time_ms : match->red_time_ms;
+    remaining -= (int)(time(NULL) - match->last_move_at) * 1000;
+    job->time_ms = remaining / BOT_CLOCK_FRACTION;
+    if (job->time_ms > levels[level].max_time_ms)
+        job->time_ms = levels[level].max_time_ms;
+    if (job->time_ms < BOT_MIN_THINK_MS)
+        job->time_ms = BOT_MIN_THINK_MS;
+
+    pthread_mutex_lock(&job_lock);
+    if (job_tail)
+        job_tail->next = job;
+    else
+        job_head = job;
+    job_tail = job;
+    pthread_cond_signal(&job_ready);
+    pthread_mutex_unlock(&job_lock);
+    return true;
+}
+
+int bot_event_fd(void) {
+    return event_fd;
+}
+
+int bot_take_moves(bot_move_t* out, int max_count) {
+    uint64_t pending;
+    if (read(event_fd, &pending, sizeof(pending)) < 0 && errno != EAGAIN)
+        LOG_ERROR("[Bot] eventfd read: %s", strerror(errno));
+
+    pthread_mutex_lock(&result_lock);
+    int count = result_count < max_count ? result_count : max_count;
+    memcpy(out, results, (size_t)count * sizeof(bot_move_t));
+    memmove(results, results + count, (size_t)(result_count - count) * sizeof(bot_move_t));
+    result_count -= count;
+    bool more = result_count > 0;
+    pthread_mutex_unlock(&result_lock);
+
+    /* Leftovers keep the eventfd readable for the next loop iteration */
+    if (more) {
+        uint64_t one = 1;
+        if (write(event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            LOG_ERROR("[Bot] eventfd write: %s", strerror(errno));
+    }
+    return count;
+}
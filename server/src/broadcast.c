@@ -6,38 +6,31 @@
 #include <unistd.h>
 
 #include "../include/lobby.h"
+#include "../include/log.h"
 #include "../include/match.h"
 #include "../include/server.h"
 
-bool send_to_client(server_t* server, int client_fd, const char* message) {
-    if (!server || !message || client_fd < 0) {
-        return false;
-    }
-
-    client_t* client = NULL;
+static client_t* find_client_by_fd(server_t* server, int client_fd) {
     for (int i = 0; i < MAX_CLIENTS; i++) {
         if (server->clients[i] && server->clients[i]->fd == client_fd) {
-            client = server->clients[i];
-            break;
+            return server->clients[i];
         }
     }
+    return NULL;
+}
 
-    if (!client) {
-        fprintf(stderr, "[Broadcast] Client fd %d not found\n", client_fd);
+bool send_to_client(server_t* server, int client_fd, const char* message) {
+    if (!server || !message || client_fd < 0) {
         return false;
     }
 
-    char buffer[MAX_MESSAGE_SIZE];
-    snprintf(buffer, sizeof(buffer), "%s%s", message, (message[strlen(message) - 1] == '\n') ? "" : "\n");
-
-    ssize_t sent = send(client_fd, buffer, strlen(buffer), MSG_NOSIGNAL);
-    if (sent < 0) {
-        perror("[Broadcast] send() failed");
+    client_t* client = find_client_by_fd(server, client_fd);
+    if (!client) {
+        LOG_ERROR("[Broadcast] Client fd %d not found", client_fd);
         return false;
     }
 
-    printf("[Broadcast] Sent to fd %d: %.*s\n", client_fd, (int)(strlen(buffer) - 1), buffer);
-    return true;
+    return client_send(server, client, message) == 0;
 }
 
 bool send_to_user(server_t* server, int user_id, const char* message) {
@@ -45,33 +38,43 @@ bool send_to_user(server_t* server, int user_id, const char* message) {
         return false;
     }
 
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (server->clients[i] && server->clients[i]->user_id == user_id) {
-            return send_to_client(server, server->clients[i]->fd, message);
-        }
+    client_t* client = server_get_client_by_user_id(server, user_id);
+    if (!client) {
+        return false;
     }
 
-    fprintf(stderr, "[Broadcast] User %d not connected\n", user_id);
-
-    fprintf(stderr, "[Broadcast] Connected clients (user_id:fd):");
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        client_t* c = server->clients[i];
-        if (c) {
-            fprintf(stderr, " %d:%d", c->user_id, c->fd);
-        }
-    }
-    fprintf(stderr, "\n");
-    return false;
+    return client_send(server, client, message) == 0;
 }
 
 bool is_user_connected(server_t* server, int user_id) {
-    if (!server || user_id <= 0)
-        return false;
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (server->clients[i] && server->clients[i]->user_id == user_id)
-            return true;
+    return server_get_client_by_user_id(server, user_id) != NULL;
+}
+
+int broadcast_frame_to_match(server_t* server, const match_t* match, frame_t* frame, int exclude_user_id) {
+    if (!server || !match || !frame) {
+        return 0;
+    }
+
+    int sent = 0;
+
+    if (match->red_user_id != exclude_user_id) {
+        client_t* red = server_get_client_by_user_id(server, match->red_user_id);
+        if (red && client_send_frame(server, red, frame) == 0)
+            sent++;
     }
-    return false;
+
+    if (match->black_user_id != exclude_user_id) {
+        client_t* black = server_get_client_by_user_id(server, match->black_user_id);
+        if (black && client_send_frame(server, black, frame) == 0)
+            sent++;
+    }
+
+    for (int i = 0; i < match->spectator_count; i++) {
+        if (client_send_frame(server, match->spectators[i], frame) == 0)
+            sent++;
+    }
+
+    return sent;
 }
 
 void broadcast_to_match(server_t* server, const char* match_id, const char* message) {
@@ -81,19 +84,17 @@ void broadcast_to_match(server_t* server, const char* match_id, const char* mess
 
     match_t* match = match_find_by_id(match_id);
     if (!match) {
-        fprintf(stderr, "[Broadcast] Match %s not found\n", match_id);
+        LOG_ERROR("[Broadcast] Match %s not found", match_id);
         return;
     }
 
-    send_to_user(server, match->red_user_id, message);
-    send_to_user(server, match->black_user_id, message);
-
-    for (int i = 0; i < match->spectator_count; i++) {
-        send_to_user(server, match->spectator_ids[i], message);
+    frame_t* frame = frame_create(message);
+    if (!frame) {
+        return;
     }
 
-    printf("[Broadcast] Sent to match %s (players: %d, %d, spectators: %d)\n", match_id, match->red_user_id,
-           match->black_user_id, match->spectator_count);
+    broadcast_frame_to_match(server, match, frame, 0);
+    frame_release(frame);
 }
 
 void broadcast_to_lobby(server_t* server, const char* message) {
@@ -104,11 +105,19 @@ void broadcast_to_lobby(server_t* server, const char* message) {
     int ready_users[MAX_CLIENTS];
     int count = lobby_get_ready_users(ready_users, MAX_CLIENTS);
 
+    frame_t* frame = frame_create(message);
+    if (!frame) {
+        return;
+    }
+
     for (int i = 0; i < count; i++) {
-        send_to_user(server, ready_users[i], message);
+        client_t* client = server_get_client_by_user_id(server, ready_users[i]);
+        if (client) {
+            client_send_frame(server, client, frame);
+        }
     }
 
-    printf("[Broadcast] Sent to %d ready users in lobby\n", count);
+    frame_release(frame);
 }
 
 void broadcast_to_all(server_t* server, const char* message) {
@@ -116,12 +125,16 @@ void broadcast_to_all(server_t* server, const char* message) {
         return;
     }
 
-    int sent_count = 0;
+    frame_t* frame = frame_create(message);
+    if (!frame) {
+        return;
+    }
+
     for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (server->clients[i] && send_to_client(server, server->clients[i]->fd, message)) {
-            sent_count++;
+        if (server->clients[i]) {
+            client_send_frame(server, server->clients[i], frame);
         }
     }
 
-    printf("[Broadcast] Sent to %d/%d clients\n", sent_count, server->client_count);
+    frame_release(frame);
 }
@@ -0,0 +1,863 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/log.h"
+#include "../include/rating.h"
+
+#include "../include/db_backend.h"
+
+/*
+ * In-process backend: the same tables as sql/db.sql kept in hash-indexed arrays. Nothing survives a restart,
+ * which is what benchmarks and load tests want - every db_* call costs a hash lookup instead of a round trip,
+ * so the numbers measure the server rather than SQL Server.
+ */
+
+#define MEM_INITIAL_CAPACITY 256
+#define MEM_TOMBSTONE ((const char*)-1)
+
+typedef struct {
+    const char* key; /* points into the record it indexes */
+    void* value;
+} mem_entry_t;
+
+typedef struct {
+    mem_entry_t* entries;
+    size_t capacity;
+    size_t used;
+} mem_index_t;
+
+typedef struct mem_match mem_match_t;
+
+typedef struct {
+    int user_id;
+    char username[64];
+    char email[128];
+    char password_hash[128];
+    int rating;
+    int wins;
+    int losses;
+    int draws;
+    char created_at[32];
+    double rd;
+    double volatility;
+    long rated_at;
+
+    /* Saved matches ordered by (ended_at, match_id): this user's slice of UserMatches */
+    mem_match_t** history;
+    int history_count;
+    int history_capacity;
+} mem_user_t;
+
+struct mem_match {
+    char match_id[64];
+    int red_user_id;
+    int black_user_id;
+    char result[16];
+    char end_reason[32];
+    char* moves_json;
+    char* analysis; /* NULL until the analysis workers get to it */
+    char started_at[32];
+    char ended_at[32];
+    bool rated;
+    int red_rating_delta;
+    int black_rating_delta;
+};
+
+typedef struct {
+    char match_id[64];
+    int red_user_id;
+    int black_user_id;
+    char current_turn[DB_TURN_SIZE];
+    int red_time_ms;
+    int black_time_ms;
+    int move_count;
+    char* moves_json;
+    bool rated;
+    time_t started_at;
+    time_t last_move_at;
+} mem_active_t;
+
+typedef struct {
+    char token[65];
+    int user_id;
+    time_t expires_at;
+} mem_session_t;
+
+static mem_user_t** users = NULL;
+static int user_count = 0;
+static int user_capacity = 0;
+
+static mem_match_t** matches = NULL;
+static int match_count = 0;
+static int match_capacity = 0;
+
+static mem_index_t users_by_name;
+static mem_index_t users_by_email;
+static mem_index_t matches_by_id;
+static mem_index_t active_by_id;
+static mem_index_t sessions_by_token;
+
+static uint32_t hash_string(const char* str) {
+    uint32_t h = 2166136261u;
+    while (*str) {
+        h ^= (unsigned char)*str++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static bool index_put(mem_index_t* index, const char* key, void* value);
+
+static bool index_resize(mem_index_t* index, size_t new_capacity) {
+    mem_entry_t* old = index->entries;
+    size_t old_capacity = index->capacity;
+
+    index->entries = calloc(new_capacity, sizeof(mem_entry_t));
+    if (!index->entries) {
+        index->entries = old;
+        return false;
+    }
+    index->capacity = new_capacity;
+    index->used = 0;
+
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i].key && old[i].key != MEM_TOMBSTONE) {
+            index_put(index, old[i].key, old[i].value);
+        }
+    }
+    free(old);
+    return true;
+}
+
+static size_t index_find_slot(const mem_index_t* index, const char* key) {
+    if (!index->capacity)
+        return SIZE_MAX;
+
+    size_t mask = index->capacity - 1;
+    size_t i = hash_string(key) & mask;
+    while (index->entries[i].key) {
+        if (index->entries[i].key != MEM_TOMBSTONE && strcmp(index->entries[i].key, key) == 0) {
+            return i;
+        }
+        i = (i + 1) & mask;
+    }
+    return SIZE_MAX;
+}
+
+static void* index_get(const mem_index_t* index, const char* key) {
+    size_t i = index_find_slot(index, key);
+    return i == SIZE_MAX ? NULL : index->entries[i].value;
+}
+
+static bool index_put(mem_index_t* index, const char* key, void* value) {
+    size_t existing = index_find_slot(index, key);
+    if (existing != SIZE_MAX) {
+        index->entries[existing].key = key;
+        index->entries[existing].value = value;
+        return true;
+    }
+
+    if ((index->used + 1) * 10 >= index->capacity * 7) {
+        if (!index_resize(index, index->capacity ? index->capacity * 2 : MEM_INITIAL_CAPACITY))
+            return false;
+    }
+
+    size_t mask = index->capacity - 1;
+    size_t i = hash_string(key) & mask;
+    while (index->entries[i].key && index->entries[i].key != MEM_TOMBSTONE) {
+        i = (i + 1) & mask;
+    }
+    if (!index->entries[i].key)
+        index->used++;
+    index->entries[i].key = key;
+    index->entries[i].value = value;
+    return true;
+}
+
+static void* index_remove(mem_index_t* index, const char* key) {
+    size_t i = index_find_slot(index, key);
+    if (i == SIZE_MAX)
+        return NULL;
+
+    void* value = index->entries[i].value;
+    index->entries[i].key = MEM_TOMBSTONE;
+    index->entries[i].value = NULL;
+    return value;
+}
+
+static void index_free(mem_index_t* index) {
+    free(index->entries);
+    memset(index, 0, sizeof(*index));
+}
+
+static bool grow_array(void** array, int* capacity, int needed, size_t elem_size) {
+    if (needed <= *capacity)
+        return true;
+
+    int new_capacity = *capacity ? *capacity * 2 : MEM_INITIAL_CAPACITY;
+    while (new_capacity < needed)
+        new_capacity *= 2;
+
+    void* grown = realloc(*array, (size_t)new_capacity * elem_size);
+    if (!grown)
+        return false;
+    *array = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+static void copy_field(char* dst, size_t dst_size, const char* src) {
+    snprintf(dst, dst_size, "%s", src ? src : "");
+}
+
+static mem_user_t* find_user(int user_id) {
+    if (user_id < 1 || user_id > user_count)
+        return NULL;
+    return users[user_id - 1];
+}
+
+static const char* username_or_empty(int user_id) {
+    mem_user_t* user = find_user(user_id);
+    return user ? user->username : "";
+}
+
+static bool memory_create_user(const char* username, const char* email, const char* password_hash,
+                               int* out_user_id);
+
+static bool memory_init(const char* config) {
+    (void)config;
+
+    /* Same seed row as sql/db.sql (testuser / test123) */
+    int user_id;
+    memory_create_user("testuser", "test@example.com",
+                       "d91da15b07b01fb413e31be527f05b9563b0515652b0515672b0bcb1ca2a6185", &user_id);
+
+    LOG_INFO("[DB] In-memory store ready (data is not persisted)");
+    return true;
+}
+
+static void memory_shutdown(void) {
+    for (int i = 0; i < user_count; i++) {
+        free(users[i]->history);
+        free(users[i]);
+    }
+    for (int i = 0; i < match_count; i++) {
+        free(matches[i]->moves_json);
+        free(matches[i]->analysis);
+        free(matches[i]);
+    }
+    for (size_t i = 0; i < active_by_id.capacity; i++) {
+        mem_entry_t* entry = &active_by_id.entries[i];
+        if (entry->key && entry->key != MEM_TOMBSTONE) {
+            mem_active_t* active = entry->value;
+            free(active->moves_json);
+            free(active);
+        }
+    }
+    for (size_t i = 0; i < sessions_by_token.capacity; i++) {
+        mem_entry_t* entry = &sessions_by_token.entries[i];
+        if (entry->key && entry->key != MEM_TOMBSTONE) {
+            free(entry->value);
+        }
+    }
+
+    free(users);
+    free(matches);
+    users = NULL;
+    matches = NULL;
+    user_count = user_capacity = 0;
+    match_count = match_capacity = 0;
+
+    index_free(&users_by_name);
+    index_free(&users_by_email);
+    index_free(&matches_by_id);
+    index_free(&active_by_id);
+    index_free(&sessions_by_token);
+
+    LOG_INFO("[DB] In-memory store released");
+}
+
+static bool memory_execute(const char* sql) {
+    LOG_ERROR("[DB] Raw SQL is not supported by the memory backend: %s", sql);
+    return false;
+}
+
+static bool memory_create_user(const char* username, const char* email, const char* password_hash,
+                               int* out_user_id) {
+    if (!username || !email || !password_hash)
+        return false;
+    if (index_get(&users_by_name, username) || index_get(&users_by_email, email))
+        return false;
+    if (!grow_array((void**)&users, &user_capacity, user_count + 1, sizeof(mem_user_t*)))
+        return false;
+
+    mem_user_t* user = calloc(1, sizeof(mem_user_t));
+    if (!user)
+        return false;
+
+    user->user_id = user_count + 1;
+    copy_field(user->username, sizeof(user->username), username);
+    copy_field(user->email, sizeof(user->email), email);
+    copy_field(user->password_hash, sizeof(user->password_hash), password_hash);
+    user->rating = 1200;
+    user->rd = GLICKO2_DEFAULT_RD;
+    user->volatility = GLICKO2_DEFAULT_VOLATILITY;
+
+    time_t now = time(NULL);
+    strftime(user->created_at, sizeof(user->created_at), "%Y-%m-%d %H:%M:%S", localtime(&now));
+
+    if (!index_put(&users_by_name, user->username, user) || !index_put(&users_by_email, user->email, user)) {
+        index_remove(&users_by_name, user->username);
+        free(user);
+        return false;
+    }
+
+    users[user_count++] = user;
+    if (out_user_id)
+        *out_user_id = user->user_id;
+    return true;
+}
+
+static bool memory_get_user_by_username(const char* username, int* out_user_id, char* out_password_hash,
+                                        int* out_rating) {
+    mem_user_t* user = username ? index_get(&users_by_name, username) : NULL;
+    if (!user)
+        return false;
+
+    if (out_user_id)
+        *out_user_id = user->user_id;
+    if (out_password_hash)
+        strcpy(out_password_hash, user->password_hash);
+    if (out_rating)
+        *out_rating = user->rating;
+    return true;
+}
+
+static bool memory_get_user_by_id(int user_id, char* out_username, char* out_email, int* out_rating, int* out_wins,
+                                  int* out_losses, int* out_draws) {
+    mem_user_t* user = find_user(user_id);
+    if (!user)
+        return false;
+
+    if (out_username)
+        strcpy(out_username, user->username);
+    if (out_email)
+        strcpy(out_email, user->email);
+    if (out_rating)
+        *out_rating = user->rating;
+    if (out_wins)
+        *out_wins = user->wins;
+    if (out_losses)
+        *out_losses = user->losses;
+    if (out_draws)
+        *out_draws = user->draws;
+    return true;
+}
+
+static bool memory_update_user_rating(int user_id, int new_rating) {
+    mem_user_t* user = find_user(user_id);
+    if (!user)
+        return false;
+    user->rating = new_rating;
+    return true;
+}
+
+static bool memory_update_user_stats(int user_id, int wins, int losses, int draws) {
+    mem_user_t* user = find_user(user_id);
+    if (!user)
+        return false;
+    user->wins = wins;
+    user->losses = losses;
+    user->draws = draws;
+    return true;
+}
+
+/* Orders a saved match against a history key, like the (ended_at, match_id) index */
+static int compare_history(const mem_match_t* match, const char* ended_at, const char* match_id) {
+    int order = strcmp(match->ended_at, ended_at);
+    return order ? order : strcmp(match->match_id, match_id);
+}
+
+static bool add_to_history(mem_user_t* user, mem_match_t* match) {
+    if (!grow_array((void**)&user->history, &user->history_capacity, user->history_count + 1, sizeof(mem_match_t*)))
+        return false;
+    /* Matches are saved as they end, so this almost always appends */
+    int i = user->history_count;
+    while (i > 0 && compare_history(user->history[i - 1], match->ended_at, match->match_id) > 0) {
+        user->history[i] = user->history[i - 1];
+        i--;
+    }
+    user->history[i] = match;
+    user->history_count++;
+    return true;
+}
+
+static bool memory_save_match(const char* match_id, int red_user_id, int black_user_id, const char* result,
+                              const char* end_reason, const char* moves_json, const char* started_at,
+                              const char* ended_at, bool rated, int red_rating_delta, int black_rating_delta) {
+    mem_user_t* red = find_user(red_user_id);
+    mem_user_t* black = find_user(black_user_id);
+
+    /* Matches has a primary key and foreign keys on both players */
+    if (!match_id || !red || !black || index_get(&matches_by_id, match_id))
+        return false;
+    if (!grow_array((void**)&matches, &match_capacity, match_count + 1, sizeof(mem_match_t*)))
+        return false;
+
+    mem_match_t* match = calloc(1, sizeof(mem_match_t));
+    if (!match)
+        return false;
+
+    copy_field(match->match_id, sizeof(match->match_id), match_id);
+    match->red_user_id = red_user_id;
+    match->black_user_id = black_user_id;
+    copy_field(match->result, sizeof(match->result), result);
+    copy_field(match->end_reason, sizeof(match->end_reason), end_reason);
+    copy_field(match->started_at, sizeof(match->started_at), started_at);
+    copy_field(match->ended_at, sizeof(match->ended_at), ended_at);
+    match->rated = rated;
+    match->red_rating_delta = red_rating_delta;
+    match->black_rating_delta = black_rating_delta;
+    match->moves_json = strdup(moves_json && moves_json[0] ? moves_json : "[]");
+
+    if (!match->moves_json || !index_put(&matches_by_id, match->match_id, match)) {
+        free(match->moves_json);
+        free(match);
+        return false;
+    }
+
+    matches[match_count++] = match;
+    add_to_history(red, match);
+    if (black != red)
+        add_to_history(black, match);
+    return true;
+}
+
+static bool memory_save_match_analysis(const char* match_id, const char* analysis) {
+    mem_match_t* match = match_id ? index_get(&matches_by_id, match_id) : NULL;
+    if (!match || !analysis)
+        return false;
+
+    char* copy = strdup(analysis);
+    if (!copy)
+        return false;
+    free(match->analysis);
+    match->analysis = copy;
+    return true;
+}
+
+static char* memory_get_match(const char* match_id) {
+    mem_match_t* match = match_id ? index_get(&matches_by_id, match_id) : NULL;
+    if (!match)
+        return NULL;
+
+    return db_format_match_json(match->match_id, username_or_empty(match->red_user_id),
+                                username_or_empty(match->black_user_id), match->result, match->moves_json,
+                                match->started_at, match->ended_at, match->analysis);
+}
+
+static int memory_for_each_match(db_match_visitor_t visit, void* ctx) {
+    int visited = 0;
+    for (int i = 0; i < match_count; i++) {
+        visited++;
+        if (!visit(matches[i]->result, matches[i]->moves_json, ctx))
+            break;
+    }
+    return visited;
+}
+
+static int compare_replay_order(const void* a, const void* b) {
+    const mem_match_t* left = *(const mem_match_t* const*)a;
+    const mem_match_t* right = *(const mem_match_t* const*)b;
+    return compare_history(left, right->ended_at, right->match_id);
+}
+
+static int memory_for_each_rated_match(long since, db_rated_match_visitor_t visit, void* ctx) {
+    mem_match_t** rated = malloc((size_t)(match_count ? match_count : 1) * sizeof(mem_match_t*));
+    if (!rated)
+        return -1;
+    int rated_count = 0;
+    for (int i = 0; i < match_count; i++) {
+        if (matches[i]->rated && strtol(matches[i]->ended_at, NULL, 10) >= since)
+            rated[rated_count++] = matches[i];
+    }
+    qsort(rated, (size_t)rated_count, sizeof(mem_match_t*), compare_replay_order);
+
+    int visited = 0;
+    for (int i = 0; i < rated_count; i++) {
+        db_rated_match_t row = {rated[i]->red_user_id, rated[i]->black_user_id, rated[i]->result,
+                                rated[i]->end_reason, strtol(rated[i]->ended_at, NULL, 10)};
+        visited++;
+        if (!visit(&row, ctx))
+            break;
+    }
+    free(rated);
+    return visited;
+}
+
+static int memory_update_ratings(const db_rating_update_t* updates, int count) {
+    int applied = 0;
+    for (int i = 0; i < count; i++) {
+        mem_user_t* user = find_user(updates[i].user_id);
+        if (user && user->rating == updates[i].old_rating) {
+            user->rating = updates[i].rating;
+            if (updates[i].rd > 0) {
+                user->rd = updates[i].rd;
+                user->volatility = updates[i].volatility;
+                user->rated_at = updates[i].rated_at;
+            }
+            applied++;
+        }
+    }
+    return applied;
+}
+
+static int memory_for_each_user_rating(db_user_rating_visitor_t visit, void* ctx) {
+    int visited = 0;
+    for (int i = 0; i < user_count; i++) {
+        const mem_user_t* user = users[i];
+        db_user_rating_t row = {user->user_id, user->rating, user->rd, user->volatility, user->rated_at};
+        visited++;
+        if (!visit(&row, ctx))
+            break;
+    }
+    return visited;
+}
+
+static int memory_get_match_history(int user_id, const db_history_cursor_t* after, int limit,
+                                    db_history_visitor_t visit, void* ctx) {
+    mem_user_t* user = find_user(user_id);
+    if (!user)
+        return 0;
+
+    /* Binary search for the first entry at or past the cursor; everything before it is older */
+    int start = user->history_count;
+    if (after) {
+        int low = 0, high = user->history_count;
+        while (low < high) {
+            int mid = low + (high - low) / 2;
+            if (compare_history(user->history[mid], after->ended_at, after->match_id) < 0)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        start = low;
+    }
+
+    int visited = 0;
+    /* Newest first, matching ORDER BY ended_at DESC, match_id DESC */
+    for (int i = start - 1; i >= 0 && visited < limit; i--) {
+        const mem_match_t* match = user->history[i];
+        bool is_red = (match->red_user_id == user_id);
+
+        db_history_row_t row = {
+            .match_id = match->match_id,
+            .opponent = username_or_empty(is_red ? match->black_user_id : match->red_user_id),
+            .my_color = is_red ? "red" : "black",
+            .result = db_player_result(match->result, is_red),
+            .started_at = match->started_at,
+            .ended_at = match->ended_at,
+            .rating_delta = is_red ? match->red_rating_delta : match->black_rating_delta,
+        };
+        visited++;
+        if (!visit(&row, ctx))
+            break;
+    }
+    return visited;
+}
+
+static int memory_for_each_user_match(db_user_match_visitor_t visit, void* ctx) {
+    int visited = 0;
+    for (int u = 0; u < user_count; u++) {
+        const mem_user_t* user = users[u];
+        for (int i = 0; i < user->history_count; i++) {
+            const mem_match_t* match = user->history[i];
+            bool is_red = (match->red_user_id == user->user_id);
+            db_user_match_t row = {
+                .user_id = user->user_id,
+                .opponent_id = is_red ? match->black_user_id : match->red_user_id,
+                .color = is_red ? "red" : "black",
+                .result = db_player_result(match->result, is_red),
+                .ended_at = match->ended_at,
+                .rating_delta = is_red ? match->red_rating_delta : match->black_rating_delta,
+            };
+            visited++;
+            if (!visit(&row, ctx))
+                return visited;
+        }
+    }
+    return visited;
+}
+
+static bool memory_get_user_profile(int user_id, char* out_json, size_t json_size) {
+    mem_user_t* user = find_user(user_id);
+    if (!user)
+        return false;
+
+    int total_matches = user->wins + user->losses + user->draws;
+    double win_rate = 0.0;
+    if (total_matches > 0) {
+        win_rate = (double)user->wins / total_matches * 100.0;
+    }
+
+    snprintf(out_json, json_size,
+             "{"
+             "\"user_id\":%d,"
+             "\"username\":\"%s\","
+             "\"email\":\"%s\","
+             "\"rating\":%d,"
+             "\"rank_title\":\"%s\","
+             "\"wins\":%d,"
+             "\"losses\":%d,"
+             "\"draws\":%d,"
+             "\"total_matches\":%d,"
+             "\"win_rate\":%.1f,"
+             "\"created_at\":\"%s\""
+             "}",
+             user->user_id, user->username, user->email, user->rating, db_rank_title(user->rating), user->wins,
+             user->losses, user->draws, total_matches, win_rate, user->created_at);
+    return true;
+}
+
+static int compare_rating_desc(const void* a, const void* b) {
+    const mem_user_t* ua = *(const mem_user_t* const*)a;
+    const mem_user_t* ub = *(const mem_user_t* const*)b;
+    if (ua->rating != ub->rating)
+        return ub->rating - ua->rating;
+    return ua->user_id - ub->user_id;
+}
+
+static bool memory_get_leaderboard(int limit, int offset, char* out_json, size_t json_size) {
+    char buffer[512];
+
+    mem_user_t** sorted = malloc((size_t)(user_count ? user_count : 1) * sizeof(mem_user_t*));
+    if (!sorted)
+        return false;
+    memcpy(sorted, users, (size_t)user_count * sizeof(mem_user_t*));
+    qsort(sorted, (size_t)user_count, sizeof(mem_user_t*), compare_rating_desc);
+
+    strcpy(out_json, "[");
+    bool first = true;
+
+    for (int i = offset < 0 ? 0 : offset, n = 0; i < user_count && n < limit; i++, n++) {
+        const mem_user_t* user = sorted[i];
+        snprintf(buffer, sizeof(buffer),
+                 "%s{\"username\":\"%s\",\"rating\":%d,\"wins\":%d,\"losses\":%"
+                 "d,\"draws\":%d}",
+                 first ? "" : ",", user->username, user->rating, user->wins, user->losses, user->draws);
+
+        if (strlen(out_json) + strlen(buffer) + 2 < json_size) {
+            strcat(out_json, buffer);
+            first = false;
+        }
+    }
+
+    strcat(out_json, "]");
+    free(sorted);
+    return true;
+}
+
+static int memory_for_each_user(db_user_visitor_t visit, void* ctx) {
+    int visited = 0;
+    for (int i = 0; i < user_count; i++) {
+        const mem_user_t* user = users[i];
+        visited++;
+        if (!visit(user->user_id, user->username, user->rating, user->wins, user->losses, user->draws, ctx))
+            break;
+    }
+    return visited;
+}
+
+static bool memory_check_username_exists(const char* username) {
+    return username && index_get(&users_by_name, username) != NULL;
+}
+
+static bool memory_check_email_exists(const char* email) {
+    return email && index_get(&users_by_email, email) != NULL;
+}
+
+static bool memory_get_username(int user_id, char* out_username, size_t username_size) {
+    mem_user_t* user = find_user(user_id);
+    if (!user)
+        return false;
+    copy_field(out_username, username_size, user->username);
+    return true;
+}
+
+static bool memory_save_active_match(const char* match_id, int red_user_id, int black_user_id,
+                                     const char* current_turn, int red_time_ms, int black_time_ms, int move_count,
+                                     const char* moves_json, bool rated, time_t started_at, time_t last_move_at) {
+    if (!match_id)
+        return false;
+
+    char* moves_copy = strdup(moves_json && moves_json[0] ? moves_json : "[]");
+    if (!moves_copy)
+        return false;
+
+    mem_active_t* active = index_get(&active_by_id, match_id);
+    if (!active) {
+        active = calloc(1, sizeof(mem_active_t));
+        if (!active) {
+            free(moves_copy);
+            return false;
+        }
+        copy_field(active->match_id, sizeof(active->match_id), match_id);
+        if (!index_put(&active_by_id, active->match_id, active)) {
+            free(moves_copy);
+            free(active);
+            return false;
+        }
+    }
+
+    active->red_user_id = red_user_id;
+    active->black_user_id = black_user_id;
+    copy_field(active->current_turn, sizeof(active->current_turn), current_turn);
+    active->red_time_ms = red_time_ms;
+    active->black_time_ms = black_time_ms;
+    active->move_count = move_count;
+    free(active->moves_json);
+    active->moves_json = moves_copy;
+    active->rated = rated;
+    active->started_at = started_at;
+    active->last_move_at = last_move_at;
+    return true;
+}
+
+static bool memory_get_active_match(const char* match_id, int* red_user_id, int* black_user_id, char* current_turn,
+                                    int* red_time_ms, int* black_time_ms, int* move_count, char* moves_json,
+                                    size_t moves_json_size, bool* rated, time_t* started_at, time_t* last_move_at) {
+    mem_active_t* active = match_id ? index_get(&active_by_id, match_id) : NULL;
+    if (!active)
+        return false;
+
+    *red_user_id = active->red_user_id;
+    *black_user_id = active->black_user_id;
+    copy_field(current_turn, DB_TURN_SIZE, active->current_turn);
+    *red_time_ms = active->red_time_ms;
+    *black_time_ms = active->black_time_ms;
+    *move_count = active->move_count;
+    copy_field(moves_json, moves_json_size, active->moves_json);
+    *rated = active->rated;
+    *started_at = active->started_at;
+    *last_move_at = active->last_move_at;
+    return true;
+}
+
+static bool memory_delete_active_match(const char* match_id) {
+    mem_active_t* active = match_id ? index_remove(&active_by_id, match_id) : NULL;
+    if (!active)
+        return false;
+    free(active->moves_json);
+    free(active);
+    return true;
+}
+
+static int memory_load_all_active_matches(void* matches_array, int max_matches) {
+    (void)matches_array;
+    (void)max_matches;
+
+    /* A fresh process never has active matches to recover */
+    return 0;
+}
+
+static bool memory_session_create(const char* token, int user_id, int expires_hours) {
+    if (!token || !find_user(user_id))
+        return false;
+
+    mem_session_t* session = index_get(&sessions_by_token, token);
+    if (!session) {
+        session = calloc(1, sizeof(mem_session_t));
+        if (!session)
+            return false;
+        copy_field(session->token, sizeof(session->token), token);
+        if (!index_put(&sessions_by_token, session->token, session)) {
+            free(session);
+            return false;
+        }
+    }
+
+    session->user_id = user_id;
+    session->expires_at = time(NULL) + (time_t)expires_hours * 3600;
+    return true;
+}
+
+static bool memory_session_validate(const char* token, int* out_user_id) {
+    if (!token || !out_user_id)
+        return false;
+
+    mem_session_t* session = index_get(&sessions_by_token, token);
+    if (!session || session->expires_at <= time(NULL))
+        return false;
+
+    *out_user_id = session->user_id;
+    return true;
+}
+
+static bool memory_session_destroy(const char* token) {
+    mem_session_t* session = token ? index_remove(&sessions_by_token, token) : NULL;
+    if (!session)
+        return false;
+    free(session);
+    return true;
+}
+
+static bool memory_session_cleanup_expired(void) {
+    time_t now = time(NULL);
+    int removed = 0;
+
+    for (size_t i = 0; i < sessions_by_token.capacity; i++) {
+        mem_entry_t* entry = &sessions_by_token.entries[i];
+        if (!entry->key || entry->key == MEM_TOMBSTONE)
+            continue;
+
+        mem_session_t* session = entry->value;
+        if (session->expires_at < now) {
+            entry->key = MEM_TOMBSTONE;
+            entry->value = NULL;
+            free(session);
+            removed++;
+        }
+    }
+
+    if (removed > 0) {
+        LOG_INFO("[DB] Cleaned up %d expired sessions", removed);
+    }
+    return true;
+}
+
+const db_backend_t db_memory_backend = {
+    .name = "memory",
+    .init = memory_init,
+    .shutdown = memory_shutdown,
+    .execute = memory_execute,
+    .create_user = memory_create_user,
+    .get_user_by_username = memory_get_user_by_username,
+    .get_user_by_id = memory_get_user_by_id,
+    .update_user_rating = memory_update_user_rating,
+    .update_user_stats = memory_update_user_stats,
+    .save_match = memory_save_match,
+    .save_match_analysis = memory_save_match_analysis,
+    .for_each_match = memory_for_each_match,
+    .for_each_rated_match = memory_for_each_rated_match,
+    .update_ratings = memory_update_ratings,
+    .for_each_user_rating = memory_for_each_user_rating,
+    .get_match = memory_get_match,
+    .get_match_history = memory_get_match_history,
+    .for_each_user_match = memory_for_each_user_match,
+    .get_user_profile = memory_get_user_profile,
+    .get_leaderboard = memory_get_leaderboard,
+    .for_each_user = memory_for_each_user,
+    .check_username_exists = memory_check_username_exists,
+    .check_email_exists = memory_check_email_exists,
+    .get_username = memory_get_username,
+    .save_active_match = memory_save_active_match,
+    .get_active_match = memory_get_active_match,
+    .delete_active_match = memory_delete_active_match,
+    .load_all_active_matches = memory_load_all_active_matches,
+    .session_create = memory_session_create,
+    .session_validate = memory_session_validate,
+    .session_destroy = memory_session_destroy,
+    .session_cleanup_expired = memory_session_cleanup_expired,
+};
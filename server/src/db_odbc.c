@@ -0,0 +1,1305 @@
+#include "../include/db_backend.h"
+
+#ifdef DB_HAVE_ODBC
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sql.h>
+#include <sqlext.h>
+
+#include "../include/analysis.h"
+#include "../include/log.h"
+#include "../include/rating.h"
+
+/* SQL Server backend over unixODBC. Selected with "odbc:<connection string>". */
+
+static SQLHENV g_db_env = NULL;
+static SQLHDBC g_db_conn = NULL;
+static SQLHSTMT g_db_stmt = NULL;
+
+#define DB_PREPARE(stmt, sql)                                                                                          \
+    SQLHSTMT stmt;                                                                                                     \
+    SQLRETURN db_ret;                                                                                                  \
+    SQLLEN db_indicator;                                                                                               \
+    do {                                                                                                               \
+        db_ret = SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &(stmt));                                                  \
+        if (db_ret != SQL_SUCCESS)                                                                                     \
+            return false;                                                                                              \
+        db_ret = SQLPrepare((stmt), (SQLCHAR*)(sql), SQL_NTS);                                                         \
+        if (db_ret != SQL_SUCCESS) {                                                                                   \
+            SQLFreeHandle(SQL_HANDLE_STMT, (stmt));                                                                    \
+            return false;                                                                                              \
+        }                                                                                                              \
+    } while (0)
+
+#define DB_EXECUTE(stmt)                                                                                               \
+    do {                                                                                                               \
+        db_ret = SQLExecute(stmt);                                                                                     \
+        if (db_ret != SQL_SUCCESS && db_ret != SQL_SUCCESS_WITH_INFO) {                                                \
+            SQLFreeHandle(SQL_HANDLE_STMT, (stmt));                                                                    \
+            return false;                                                                                              \
+        }                                                                                                              \
+    } while (0)
+
+#define DB_EXECUTE_OR_FAIL(stmt, cleanup_stmt)                                                                         \
+    do {                                                                                                               \
+        db_ret = SQLExecute(stmt);                                                                                     \
+        if (db_ret != SQL_SUCCESS && db_ret != SQL_SUCCESS_WITH_INFO) {                                                \
+            SQLFreeHandle(SQL_HANDLE_STMT, (cleanup_stmt));                                                            \
+            return false;                                                                                              \
+        }                                                                                                              \
+    } while (0)
+
+#define DB_CLEANUP(stmt) SQLFreeHandle(SQL_HANDLE_STMT, (stmt))
+
+static void odbc_print_error(SQLHANDLE handle, SQLSMALLINT type, const char* msg) {
+    SQLCHAR sql_state[6];
+    SQLCHAR error_msg[SQL_MAX_MESSAGE_LENGTH];
+    SQLINTEGER native_error;
+    SQLSMALLINT msg_len;
+
+    if (msg) {
+        LOG_ERROR("[DB Error] %s", msg);
+    }
+
+    SQLGetDiagRec(type, handle, 1, sql_state, &native_error, error_msg, sizeof(error_msg), &msg_len);
+
+    LOG_ERROR("[SQL Server] State: %s, Error: %d, Message: %s", sql_state, (int)native_error, error_msg);
+}
+
+/* Reads a text column of any length into *buffer, growing it as SQLGetData reports truncation, so long move lists
+ * are never cut off. The buffer can be reused across rows; false on SQL NULL or failure, with *buffer left "". */
+static bool odbc_get_text(SQLHSTMT stmt, SQLUSMALLINT column, char** buffer, size_t* capacity) {
+    size_t len = 0;
+    size_t needed = *capacity ? *capacity : 8192;
+
+    for (;;) {
+        if (needed > *capacity) {
+            char* grown = realloc(*buffer, needed);
+            if (!grown)
+                break;
+            *buffer = grown;
+            *capacity = needed;
+        }
+
+        SQLLEN indicator = 0;
+        SQLRETURN ret = SQLGetData(stmt, column, SQL_C_CHAR, *buffer + len, (SQLLEN)(*capacity - len), &indicator);
+        if (ret == SQL_NO_DATA)
+            return true;
+        if ((ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) || indicator == SQL_NULL_DATA)
+            break;
+        if (ret == SQL_SUCCESS || (indicator != SQL_NO_TOTAL && (size_t)indicator < *capacity - len))
+            return true;
+
+        /* Truncated: the chunk is full up to its terminator and indicator is what was left before this call */
+        needed = indicator != SQL_NO_TOTAL ? len + (size_t)indicator + 1 : *capacity * 2;
+        len = *capacity - 1;
+        if (needed <= *capacity)
+            needed = *capacity * 2;
+    }
+
+    if (*buffer)
+        (*buffer)[0] = '\0';
+    return false;
+}
+
+static void odbc_shutdown(void);
+
+static bool odbc_init(const char* connection_string) {
+    SQLRETURN ret;
+
+    ret = SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &g_db_env);
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        LOG_ERROR("Failed to allocate environment handle");
+        return false;
+    }
+
+    ret = SQLSetEnvAttr(g_db_env, SQL_ATTR_ODBC_VERSION, (void*)SQL_OV_ODBC3, 0);
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        odbc_print_error(g_db_env, SQL_HANDLE_ENV, "Failed to set ODBC version");
+        SQLFreeHandle(SQL_HANDLE_ENV, g_db_env);
+        return false;
+    }
+
+    ret = SQLAllocHandle(SQL_HANDLE_DBC, g_db_env, &g_db_conn);
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        odbc_print_error(g_db_env, SQL_HANDLE_ENV, "Failed to allocate connection handle");
+        SQLFreeHandle(SQL_HANDLE_ENV, g_db_env);
+        return false;
+    }
+
+    ret = SQLDriverConnect(g_db_conn, NULL, (SQLCHAR*)connection_string, SQL_NTS, NULL, 0, NULL, SQL_DRIVER_NOPROMPT);
+
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        odbc_print_error(g_db_conn, SQL_HANDLE_DBC, "Failed to connect to database");
+        SQLFreeHandle(SQL_HANDLE_DBC, g_db_conn);
+        SQLFreeHandle(SQL_HANDLE_ENV, g_db_env);
+        return false;
+    }
+
+    LOG_INFO("[DB] Connected to SQL Server successfully");
+
+    ret = SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &g_db_stmt);
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        odbc_print_error(g_db_conn, SQL_HANDLE_DBC, "Failed to allocate statement handle");
+        odbc_shutdown();
+        return false;
+    }
+
+    return true;
+}
+
+static void odbc_shutdown(void) {
+    if (g_db_stmt) {
+        SQLFreeHandle(SQL_HANDLE_STMT, g_db_stmt);
+        g_db_stmt = NULL;
+    }
+
+    if (g_db_conn) {
+        SQLDisconnect(g_db_conn);
+        SQLFreeHandle(SQL_HANDLE_DBC, g_db_conn);
+        g_db_conn = NULL;
+    }
+
+    if (g_db_env) {
+        SQLFreeHandle(SQL_HANDLE_ENV, g_db_env);
+        g_db_env = NULL;
+    }
+
+    LOG_INFO("[DB] Disconnected from SQL Server");
+}
+
+static bool odbc_execute(const char* sql) {
+    SQLHSTMT stmt;
+    SQLRETURN ret;
+
+    ret = SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &stmt);
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        odbc_print_error(g_db_conn, SQL_HANDLE_DBC, "Failed to allocate statement");
+        return false;
+    }
+
+    ret = SQLExecDirect(stmt, (SQLCHAR*)sql, SQL_NTS);
+
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        odbc_print_error(stmt, SQL_HANDLE_STMT, sql);
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+        return false;
+    }
+
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    return true;
+}
+
+static bool odbc_create_user(const char* username, const char* email, const char* password_hash, int* out_user_id) {
+    const char* sql = "INSERT INTO Users (username, email, password_hash, rating, wins, "
+                      "losses, draws) "
+                      "VALUES (?, ?, ?, 1200, 0, 0, 0); SELECT SCOPE_IDENTITY();";
+    int user_id;
+
+    DB_PREPARE(stmt, sql);
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 64, 0, (SQLCHAR*)username, 0, NULL);
+    SQLBindParameter(stmt, 2, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 128, 0, (SQLCHAR*)email, 0, NULL);
+    SQLBindParameter(stmt, 3, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 128, 0, (SQLCHAR*)password_hash, 0, NULL);
+
+    db_ret = SQLExecute(stmt);
+    if (db_ret != SQL_SUCCESS && db_ret != SQL_SUCCESS_WITH_INFO) {
+        odbc_print_error(stmt, SQL_HANDLE_STMT, "Failed to execute INSERT");
+        DB_CLEANUP(stmt);
+        return false;
+    }
+
+    SQLMoreResults(stmt);
+    db_ret = SQLFetch(stmt);
+    if (db_ret == SQL_SUCCESS || db_ret == SQL_SUCCESS_WITH_INFO) {
+        SQLGetData(stmt, 1, SQL_C_SLONG, &user_id, 0, &db_indicator);
+        if (out_user_id)
+            *out_user_id = user_id;
+    }
+
+    DB_CLEANUP(stmt);
+    return true;
+}
+
+static bool odbc_get_user_by_username(const char* username, int* out_user_id, char* out_password_hash,
+                                      int* out_rating) {
+    const char* sql = "SELECT user_id, password_hash, rating FROM Users WHERE username = ?";
+    int user_id, rating;
+    char password_hash[128];
+
+    DB_PREPARE(stmt, sql);
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 64, 0, (SQLCHAR*)username, 0, NULL);
+    DB_EXECUTE(stmt);
+
+    db_ret = SQLFetch(stmt);
+    if (db_ret == SQL_SUCCESS || db_ret == SQL_SUCCESS_WITH_INFO) {
+        SQLGetData(stmt, 1, SQL_C_SLONG, &user_id, 0, &db_indicator);
+        SQLGetData(stmt, 2, SQL_C_CHAR, password_hash, sizeof(password_hash), &db_indicator);
+        SQLGetData(stmt, 3, SQL_C_SLONG, &rating, 0, &db_indicator);
+
+        if (out_user_id)
+            *out_user_id = user_id;
+        if (out_password_hash)
+            strcpy(out_password_hash, password_hash);
+        if (out_rating)
+            *out_rating = rating;
+
+        DB_CLEANUP(stmt);
+        return true;
+    }
+
+    DB_CLEANUP(stmt);
+    return false;
+}
+
+static bool odbc_get_user_by_id(int user_id, char* out_username, char* out_email, int* out_rating, int* out_wins,
+                                int* out_losses, int* out_draws) {
+    const char* sql = "SELECT username, email, rating, wins, losses, draws FROM Users WHERE user_id = ?";
+    char username[64], email[128];
+    int rating, wins, losses, draws;
+
+    DB_PREPARE(stmt, sql);
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &user_id, 0, NULL);
+    DB_EXECUTE(stmt);
+
+    db_ret = SQLFetch(stmt);
+    if (db_ret == SQL_SUCCESS || db_ret == SQL_SUCCESS_WITH_INFO) {
+        SQLGetData(stmt, 1, SQL_C_CHAR, username, sizeof(username), &db_indicator);
+        SQLGetData(stmt, 2, SQL_C_CHAR, email, sizeof(email), &db_indicator);
+        SQLGetData(stmt, 3, SQL_C_SLONG, &rating, 0, &db_indicator);
+        SQLGetData(stmt, 4, SQL_C_SLONG, &wins, 0, &db_indicator);
+        SQLGetData(stmt, 5, SQL_C_SLONG, &losses, 0, &db_indicator);
+        SQLGetData(stmt, 6, SQL_C_SLONG, &draws, 0, &db_indicator);
+
+        if (out_username)
+            strcpy(out_username, username);
+        if (out_email)
+            strcpy(out_email, email);
+        if (out_rating)
+            *out_rating = rating;
+        if (out_wins)
+            *out_wins = wins;
+        if (out_losses)
+            *out_losses = losses;
+        if (out_draws)
+            *out_draws = draws;
+
+        DB_CLEANUP(stmt);
+        return true;
+    }
+
+    DB_CLEANUP(stmt);
+    return false;
+}
+
+static bool odbc_update_user_rating(int user_id, int new_rating) {
+    const char* sql = "UPDATE Users SET rating = ? WHERE user_id = ?";
+
+    DB_PREPARE(stmt, sql);
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &new_rating, 0, NULL);
+    SQLBindParameter(stmt, 2, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &user_id, 0, NULL);
+
+    db_ret = SQLExecute(stmt);
+    bool success = (db_ret == SQL_SUCCESS || db_ret == SQL_SUCCESS_WITH_INFO);
+    DB_CLEANUP(stmt);
+    return success;
+}
+
+static bool odbc_update_user_stats(int user_id, int wins, int losses, int draws) {
+    const char* sql = "UPDATE Users SET wins = ?, losses = ?, draws = ? WHERE user_id = ?";
+
+    DB_PREPARE(stmt, sql);
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &wins, 0, NULL);
+    SQLBindParameter(stmt, 2, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &losses, 0, NULL);
+    SQLBindParameter(stmt, 3, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &draws, 0, NULL);
+    SQLBindParameter(stmt, 4, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &user_id, 0, NULL);
+
+    db_ret = SQLExecute(stmt);
+    bool success = (db_ret == SQL_SUCCESS || db_ret == SQL_SUCCESS_WITH_INFO);
+    DB_CLEANUP(stmt);
+    return success;
+}
+
+/* The match and both players' UserMatches rows go in one round trip and one transaction */
+static bool odbc_save_match(const char* match_id, int red_user_id, int black_user_id, const char* result,
+                            const char* end_reason, const char* moves_json, const char* started_at,
+                            const char* ended_at, bool rated, int red_rating_delta, int black_rating_delta) {
+    const char* sql = "SET XACT_ABORT ON; BEGIN TRANSACTION; "
+                      "INSERT INTO Matches (match_id, red_user_id, black_user_id, result, "
+                      "moves_json, started_at, ended_at, rated, end_reason) "
+                      "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?); "
+                      "INSERT INTO UserMatches (user_id, ended_at, match_id, color, result, opponent_id, rating_delta) "
+                      "VALUES (?, ?, ?, 'red', ?, ?, ?), (?, ?, ?, 'black', ?, ?, ?); "
+                      "COMMIT TRANSACTION;";
+
+    SQLULEN moves_len = moves_json ? strlen(moves_json) : 0;
+    const char* red_result = db_player_result(result, true);
+    const char* black_result = db_player_result(result, false);
+    int rated_bit = rated ? 1 : 0;
+    const char* reason = end_reason ? end_reason : "";
+
+    DB_PREPARE(stmt, sql);
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 64, 0, (SQLCHAR*)match_id, 0, NULL);
+    SQLBindParameter(stmt, 2, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &red_user_id, 0, NULL);
+    SQLBindParameter(stmt, 3, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &black_user_id, 0, NULL);
+    SQLBindParameter(stmt, 4, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 16, 0, (SQLCHAR*)result, 0, NULL);
+    SQLBindParameter(stmt, 5, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_LONGVARCHAR, moves_len > 0 ? moves_len : 1, 0,
+                     (SQLCHAR*)moves_json, 0, NULL);
+    SQLBindParameter(stmt, 6, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 32, 0, (SQLCHAR*)started_at, 0, NULL);
+    SQLBindParameter(stmt, 7, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 32, 0, (SQLCHAR*)ended_at, 0, NULL);
+    SQLBindParameter(stmt, 8, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_BIT, 0, 0, &rated_bit, 0, NULL);
+    SQLBindParameter(stmt, 9, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 32, 0, (SQLCHAR*)reason, 0, NULL);
+
+    SQLBindParameter(stmt, 10, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &red_user_id, 0, NULL);
+    SQLBindParameter(stmt, 11, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 32, 0, (SQLCHAR*)ended_at, 0, NULL);
+    SQLBindParameter(stmt, 12, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 64, 0, (SQLCHAR*)match_id, 0, NULL);
+    SQLBindParameter(stmt, 13, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 8, 0, (SQLCHAR*)red_result, 0, NULL);
+    SQLBindParameter(stmt, 14, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &black_user_id, 0, NULL);
+    SQLBindParameter(stmt, 15, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &red_rating_delta, 0, NULL);
+
+    SQLBindParameter(stmt, 16, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &black_user_id, 0, NULL);
+    SQLBindParameter(stmt, 17, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 32, 0, (SQLCHAR*)ended_at, 0, NULL);
+    SQLBindParameter(stmt, 18, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 64, 0, (SQLCHAR*)match_id, 0, NULL);
+    SQLBindParameter(stmt, 19, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 8, 0, (SQLCHAR*)black_result, 0, NULL);
+    SQLBindParameter(stmt, 20, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &red_user_id, 0, NULL);
+    SQLBindParameter(stmt, 21, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &black_rating_delta, 0, NULL);
+
+    /* Each statement of the batch has its own result; a failure past the first only shows up in SQLMoreResults */
+    db_ret = SQLExecute(stmt);
+    bool success = (db_ret == SQL_SUCCESS || db_ret == SQL_SUCCESS_WITH_INFO);
+    while (success && (db_ret = SQLMoreResults(stmt)) != SQL_NO_DATA)
+        success = (db_ret == SQL_SUCCESS || db_ret == SQL_SUCCESS_WITH_INFO);
+    if (!success)
+        odbc_print_error(stmt, SQL_HANDLE_STMT, "save_match");
+    DB_CLEANUP(stmt);
+    return success;
+}
+
+static bool odbc_save_match_analysis(const char* match_id, const char* analysis) {
+    const char* sql = "UPDATE Matches SET analysis = ? WHERE match_id = ?";
+
+    SQLULEN analysis_len = analysis ? strlen(analysis) : 0;
+
+    DB_PREPARE(stmt, sql);
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_LONGVARCHAR, analysis_len > 0 ? analysis_len : 1, 0,
+                     (SQLCHAR*)analysis, 0, NULL);
+    SQLBindParameter(stmt, 2, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 64, 0, (SQLCHAR*)match_id, 0, NULL);
+
+    db_ret = SQLExecute(stmt);
+    bool success = (db_ret == SQL_SUCCESS || db_ret == SQL_SUCCESS_WITH_INFO);
+    DB_CLEANUP(stmt);
+    return success;
+}
+
+static char* odbc_get_match(const char* match_id) {
+    SQLHSTMT stmt;
+    SQLRETURN ret;
+    SQLLEN indicator;
+    SQLLEN analysis_indicator;
+    char red_username[64], black_username[64], result[16], started[32], ended[32];
+    char analysis[ANALYSIS_MAX_ENCODED];
+    char* moves = NULL;
+    size_t moves_capacity = 0;
+
+    const char* sql = "SELECT m.result, m.moves_json, m.started_at, m.ended_at, "
+                      "u1.username as red_name, u2.username as black_name, m.analysis "
+                      "FROM Matches m "
+                      "JOIN Users u1 ON m.red_user_id = u1.user_id "
+                      "JOIN Users u2 ON m.black_user_id = u2.user_id "
+                      "WHERE m.match_id = ?";
+
+    ret = SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &stmt);
+    if (ret != SQL_SUCCESS) {
+        return NULL;
+    }
+
+    ret = SQLPrepare(stmt, (SQLCHAR*)sql, SQL_NTS);
+    if (ret != SQL_SUCCESS) {
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+        return NULL;
+    }
+
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 64, 0, (SQLCHAR*)match_id, 0, NULL);
+
+    ret = SQLExecute(stmt);
+    if (ret != SQL_SUCCESS) {
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+        return NULL;
+    }
+
+    ret = SQLFetch(stmt);
+    if (ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO) {
+        SQLGetData(stmt, 1, SQL_C_CHAR, result, sizeof(result), &indicator);
+        if (!odbc_get_text(stmt, 2, &moves, &moves_capacity) && !moves) {
+            SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+            return NULL;
+        }
+        SQLGetData(stmt, 3, SQL_C_CHAR, started, sizeof(started), &indicator);
+        SQLGetData(stmt, 4, SQL_C_CHAR, ended, sizeof(ended), &indicator);
+        SQLGetData(stmt, 5, SQL_C_CHAR, red_username, sizeof(red_username), &indicator);
+        SQLGetData(stmt, 6, SQL_C_CHAR, black_username, sizeof(black_username), &indicator);
+        SQLGetData(stmt, 7, SQL_C_CHAR, analysis, sizeof(analysis), &analysis_indicator);
+        bool analysed = analysis_indicator != SQL_NULL_DATA;
+
+        char* json = db_format_match_json(match_id, red_username, black_username, result, moves, started, ended,
+                                          analysed ? analysis : NULL);
+
+        free(moves);
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+        return json;
+    }
+
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    return NULL;
+}
+
+static int odbc_for_each_match(db_match_visitor_t visit, void* ctx) {
+    SQLHSTMT stmt;
+    SQLLEN indicator;
+    char result[16];
+    char* moves = NULL;
+    size_t moves_capacity = 0;
+
+    if (SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &stmt) != SQL_SUCCESS)
+        return -1;
+
+    SQLRETURN ret = SQLExecDirect(stmt, (SQLCHAR*)"SELECT result, moves_json FROM Matches", SQL_NTS);
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        odbc_print_error(stmt, SQL_HANDLE_STMT, "for_each_match");
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+        return -1;
+    }
+
+    int visited = 0;
+    while ((ret = SQLFetch(stmt)) == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO) {
+        result[0] = '\0';
+        SQLGetData(stmt, 1, SQL_C_CHAR, result, sizeof(result), &indicator);
+        odbc_get_text(stmt, 2, &moves, &moves_capacity);
+        visited++;
+        if (!visit(result, moves ? moves : "", ctx))
+            break;
+    }
+
+    free(moves);
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    return visited;
+}
+
+#define REPLAY_FETCH_ROWS 1000
+#define RATING_UPDATE_ROWS 300 /* six parameters a row; SQL Server takes at most 2100 in one statement */
+
+typedef struct {
+    SQLINTEGER red[REPLAY_FETCH_ROWS];
+    SQLINTEGER black[REPLAY_FETCH_ROWS];
+    char result[REPLAY_FETCH_ROWS][16];
+    char ended_at[REPLAY_FETCH_ROWS][32];
+    char end_reason[REPLAY_FETCH_ROWS][32];
+    SQLLEN indicators[5][REPLAY_FETCH_ROWS];
+    SQLUSMALLINT status[REPLAY_FETCH_ROWS];
+} replay_block_t;
+
+/* A replay reads every rated game, so rows come a block at a time into bound arrays rather than through a SQLGetData
+ * call per column per row */
+static int odbc_for_each_rated_match(long since, db_rated_match_visitor_t visit, void* ctx) {
+    SQLHSTMT stmt;
+    SQLULEN fetched = 0;
+    char since_text[24];
+    replay_block_t* block = malloc(sizeof(replay_block_t));
+    if (!block)
+        return -1;
+    if (SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &stmt) != SQL_SUCCESS) {
+        free(block);
+        return -1;
+    }
+
+    SQLSetStmtAttr(stmt, SQL_ATTR_ROW_BIND_TYPE, (SQLPOINTER)SQL_BIND_BY_COLUMN, 0);
+    SQLSetStmtAttr(stmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)(SQLULEN)REPLAY_FETCH_ROWS, 0);
+    SQLSetStmtAttr(stmt, SQL_ATTR_ROW_STATUS_PTR, block->status, 0);
+    SQLSetStmtAttr(stmt, SQL_ATTR_ROWS_FETCHED_PTR, &fetched, 0);
+
+    /* ended_at is text, compared as text like the ORDER BY; unix seconds keep ten digits until 2286 */
+    snprintf(since_text, sizeof(since_text), "%ld", since);
+    SQLRETURN ret = SQLPrepare(stmt,
+                               (SQLCHAR*)"SELECT red_user_id, black_user_id, result, ended_at, end_reason FROM Matches "
+                                         "WHERE rated = 1 AND result <> 'ongoing' AND ended_at >= ? "
+                                         "ORDER BY ended_at, match_id",
+                               SQL_NTS);
+    if (ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO) {
+        SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, sizeof(since_text), 0, since_text, 0,
+                         NULL);
+        ret = SQLExecute(stmt);
+    }
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        odbc_print_error(stmt, SQL_HANDLE_STMT, "for_each_rated_match");
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+        free(block);
+        return -1;
+    }
+
+    SQLBindCol(stmt, 1, SQL_C_SLONG, block->red, 0, block->indicators[0]);
+    SQLBindCol(stmt, 2, SQL_C_SLONG, block->black, 0, block->indicators[1]);
+    SQLBindCol(stmt, 3, SQL_C_CHAR, block->result, sizeof(block->result[0]), block->indicators[2]);
+    SQLBindCol(stmt, 4, SQL_C_CHAR, block->ended_at, sizeof(block->ended_at[0]), block->indicators[3]);
+    SQLBindCol(stmt, 5, SQL_C_CHAR, block->end_reason, sizeof(block->end_reason[0]), block->indicators[4]);
+
+    int visited = 0;
+    bool more = true;
+    while (more && ((ret = SQLFetch(stmt)) == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO)) {
+        for (SQLULEN i = 0; more && i < fetched; i++) {
+            if (block->status[i] != SQL_ROW_SUCCESS && block->status[i] != SQL_ROW_SUCCESS_WITH_INFO)
+                continue;
+            const char* end_reason = block->indicators[4][i] == SQL_NULL_DATA ? "" : block->end_reason[i];
+            db_rated_match_t row = {block->red[i], block->black[i], block->result[i], end_reason,
+                                    strtol(block->ended_at[i], NULL, 10)};
+            visited++;
+            more = visit(&row, ctx);
+        }
+    }
+
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    free(block);
+    return visited;
+}
+
+/* "UPDATE ... JOIN (VALUES (?, ?, ?, ?, ?, ?), ...)" for rows rows; a row with rd 0 leaves the Glicko-2 columns */
+static char* rating_update_sql(int rows) {
+    const char* head = "UPDATE Users SET rating = v.rating, "
+                       "rd = CASE WHEN v.rd > 0 THEN v.rd ELSE Users.rd END, "
+                       "volatility = CASE WHEN v.rd > 0 THEN v.volatility ELSE Users.volatility END, "
+                       "rated_at = CASE WHEN v.rd > 0 THEN v.rated_at ELSE Users.rated_at END "
+                       "FROM Users JOIN (VALUES ";
+    const char* tail = ") AS v (user_id, old_rating, rating, rd, volatility, rated_at) ON Users.user_id = v.user_id "
+                       "WHERE Users.rating = v.old_rating";
+    size_t size = strlen(head) + (size_t)rows * 20 + strlen(tail) + 1;
+    char* sql = malloc(size);
+    if (!sql)
+        return NULL;
+    size_t len = (size_t)snprintf(sql, size, "%s", head);
+    for (int i = 0; i < rows; i++)
+        len += (size_t)snprintf(sql + len, size - len, "%s(?, ?, ?, ?, ?, ?)", i ? ", " : "");
+    snprintf(sql + len, size - len, "%s", tail);
+    return sql;
+}
+
+/* Batches commit on their own so the server's rating writes never wait behind the whole run */
+static int odbc_update_ratings(const db_rating_update_t* updates, int count) {
+    SQLHSTMT stmt = NULL;
+    int prepared_rows = 0;
+    int applied = 0;
+
+    for (int start = 0; start < count; start += RATING_UPDATE_ROWS) {
+        int rows = count - start < RATING_UPDATE_ROWS ? count - start : RATING_UPDATE_ROWS;
+        if (rows != prepared_rows) {
+            if (stmt)
+                SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+            stmt = NULL;
+            char* sql = rating_update_sql(rows);
+            if (!sql || SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &stmt) != SQL_SUCCESS) {
+                free(sql);
+                return -1;
+            }
+            SQLRETURN ret = SQLPrepare(stmt, (SQLCHAR*)sql, SQL_NTS);
+            free(sql);
+            if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+                odbc_print_error(stmt, SQL_HANDLE_STMT, "update_ratings");
+                SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+                return -1;
+            }
+            prepared_rows = rows;
+        }
+
+        for (int i = 0; i < rows; i++) {
+            db_rating_update_t* row = (db_rating_update_t*)&updates[start + i];
+            SQLUSMALLINT param = (SQLUSMALLINT)(i * 6 + 1);
+            SQLBindParameter(stmt, param, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &row->user_id, 0, NULL);
+            SQLBindParameter(stmt, param + 1, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &row->old_rating, 0,
+                             NULL);
+            SQLBindParameter(stmt, param + 2, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &row->rating, 0, NULL);
+            SQLBindParameter(stmt, param + 3, SQL_PARAM_INPUT, SQL_C_DOUBLE, SQL_FLOAT, 0, 0, &row->rd, 0, NULL);
+            SQLBindParameter(stmt, param + 4, SQL_PARAM_INPUT, SQL_C_DOUBLE, SQL_FLOAT, 0, 0, &row->volatility, 0,
+                             NULL);
+            /* long is 64-bit on the Linux targets, the width SQL_C_SBIGINT reads */
+            SQLBindParameter(stmt, param + 5, SQL_PARAM_INPUT, SQL_C_SBIGINT, SQL_BIGINT, 0, 0, &row->rated_at, 0,
+                             NULL);
+        }
+
+        SQLLEN changed = 0;
+        SQLRETURN ret = SQLExecute(stmt);
+        if ((ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) || SQLRowCount(stmt, &changed) != SQL_SUCCESS) {
+            odbc_print_error(stmt, SQL_HANDLE_STMT, "update_ratings");
+            SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+            return -1;
+        }
+        applied += (int)changed;
+    }
+
+    if (stmt)
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    return applied;
+}
+
+static int odbc_for_each_user_rating(db_user_rating_visitor_t visit, void* ctx) {
+    SQLHSTMT stmt;
+    SQLLEN indicator;
+    SQLBIGINT rated_at;
+
+    if (SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &stmt) != SQL_SUCCESS)
+        return -1;
+
+    SQLRETURN ret =
+        SQLExecDirect(stmt, (SQLCHAR*)"SELECT user_id, rating, rd, volatility, rated_at FROM Users", SQL_NTS);
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        odbc_print_error(stmt, SQL_HANDLE_STMT, "for_each_user_rating");
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+        return -1;
+    }
+
+    int visited = 0;
+    while ((ret = SQLFetch(stmt)) == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO) {
+        db_user_rating_t row = {0, 0, GLICKO2_DEFAULT_RD, GLICKO2_DEFAULT_VOLATILITY, 0};
+        rated_at = 0;
+        SQLGetData(stmt, 1, SQL_C_SLONG, &row.user_id, 0, &indicator);
+        SQLGetData(stmt, 2, SQL_C_SLONG, &row.rating, 0, &indicator);
+        SQLGetData(stmt, 3, SQL_C_DOUBLE, &row.rd, 0, &indicator);
+        SQLGetData(stmt, 4, SQL_C_DOUBLE, &row.volatility, 0, &indicator);
+        SQLGetData(stmt, 5, SQL_C_SBIGINT, &rated_at, 0, &indicator);
+        row.rated_at = (long)rated_at;
+        visited++;
+        if (!visit(&row, ctx))
+            break;
+    }
+
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    return visited;
+}
+
+static int odbc_for_each_user(db_user_visitor_t visit, void* ctx) {
+    SQLHSTMT stmt;
+    SQLLEN indicator;
+    char username[64];
+    int user_id, rating, wins, losses, draws;
+
+    if (SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &stmt) != SQL_SUCCESS)
+        return -1;
+
+    SQLRETURN ret = SQLExecDirect(
+        stmt, (SQLCHAR*)"SELECT user_id, username, rating, wins, losses, draws FROM Users", SQL_NTS);
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        odbc_print_error(stmt, SQL_HANDLE_STMT, "for_each_user");
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+        return -1;
+    }
+
+    int visited = 0;
+    while ((ret = SQLFetch(stmt)) == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO) {
+        username[0] = '\0';
+        user_id = rating = wins = losses = draws = 0;
+        SQLGetData(stmt, 1, SQL_C_SLONG, &user_id, 0, &indicator);
+        SQLGetData(stmt, 2, SQL_C_CHAR, username, sizeof(username), &indicator);
+        SQLGetData(stmt, 3, SQL_C_SLONG, &rating, 0, &indicator);
+        SQLGetData(stmt, 4, SQL_C_SLONG, &wins, 0, &indicator);
+        SQLGetData(stmt, 5, SQL_C_SLONG, &losses, 0, &indicator);
+        SQLGetData(stmt, 6, SQL_C_SLONG, &draws, 0, &indicator);
+        visited++;
+        if (!visit(user_id, username, rating, wins, losses, draws, ctx))
+            break;
+    }
+
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    return visited;
+}
+
+static bool odbc_get_leaderboard(int limit, int offset, char* out_json, size_t json_size) {
+    SQLHSTMT stmt;
+    SQLRETURN ret;
+    SQLLEN indicator;
+    char username[64];
+    int rating, wins, losses, draws;
+    char buffer[512];
+
+    const char* sql = "SELECT username, rating, wins, losses, draws FROM Users "
+                      "ORDER BY rating DESC OFFSET ? ROWS FETCH NEXT ? ROWS ONLY";
+
+    ret = SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &stmt);
+    if (ret != SQL_SUCCESS) {
+        return false;
+    }
+
+    ret = SQLPrepare(stmt, (SQLCHAR*)sql, SQL_NTS);
+    if (ret != SQL_SUCCESS) {
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+        return false;
+    }
+
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &offset, 0, NULL);
+    SQLBindParameter(stmt, 2, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &limit, 0, NULL);
+
+    ret = SQLExecute(stmt);
+    if (ret != SQL_SUCCESS) {
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+        return false;
+    }
+
+    strcpy(out_json, "[");
+    bool first = true;
+
+    while (SQLFetch(stmt) == SQL_SUCCESS) {
+        SQLGetData(stmt, 1, SQL_C_CHAR, username, sizeof(username), &indicator);
+        SQLGetData(stmt, 2, SQL_C_SLONG, &rating, 0, &indicator);
+        SQLGetData(stmt, 3, SQL_C_SLONG, &wins, 0, &indicator);
+        SQLGetData(stmt, 4, SQL_C_SLONG, &losses, 0, &indicator);
+        SQLGetData(stmt, 5, SQL_C_SLONG, &draws, 0, &indicator);
+
+        snprintf(buffer, sizeof(buffer),
+                 "%s{\"username\":\"%s\",\"rating\":%d,\"wins\":%d,\"losses\":%"
+                 "d,\"draws\":%d}",
+                 first ? "" : ",", username, rating, wins, losses, draws);
+
+        if (strlen(out_json) + strlen(buffer) + 2 < json_size) {
+            strcat(out_json, buffer);
+            first = false;
+        }
+    }
+
+    strcat(out_json, "]");
+
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    return true;
+}
+
+#define HISTORY_SELECT                                                                                                 \
+    "SELECT TOP (?) um.match_id, um.color, um.result, m.started_at, um.ended_at, u.username, um.rating_delta "         \
+    "FROM UserMatches um "                                                                                             \
+    "JOIN Matches m ON m.match_id = um.match_id "                                                                      \
+    "JOIN Users u ON u.user_id = um.opponent_id "                                                                      \
+    "WHERE um.user_id = ? "
+#define HISTORY_ORDER "ORDER BY um.ended_at DESC, um.match_id DESC"
+
+static int odbc_get_match_history(int user_id, const db_history_cursor_t* after, int limit, db_history_visitor_t visit,
+                                  void* ctx) {
+    SQLHSTMT stmt;
+    SQLRETURN ret;
+    SQLLEN indicator;
+    char match_id[64], color[8], result[8], started[32], ended[32], opponent[64];
+    int rating_delta;
+
+    /* One range scan of the UserMatches clustered key, resumed just past the cursor */
+    const char* sql = after ? HISTORY_SELECT "AND (um.ended_at < ? OR (um.ended_at = ? AND um.match_id < ?)) "
+                                             HISTORY_ORDER
+                            : HISTORY_SELECT HISTORY_ORDER;
+
+    ret = SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &stmt);
+    if (ret != SQL_SUCCESS) {
+        return -1;
+    }
+
+    ret = SQLPrepare(stmt, (SQLCHAR*)sql, SQL_NTS);
+    if (ret != SQL_SUCCESS) {
+        odbc_print_error(stmt, SQL_HANDLE_STMT, "get_match_history");
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+        return -1;
+    }
+
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &limit, 0, NULL);
+    SQLBindParameter(stmt, 2, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &user_id, 0, NULL);
+    if (after) {
+        SQLBindParameter(stmt, 3, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 32, 0, (SQLCHAR*)after->ended_at, 0, NULL);
+        SQLBindParameter(stmt, 4, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 32, 0, (SQLCHAR*)after->ended_at, 0, NULL);
+        SQLBindParameter(stmt, 5, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 64, 0, (SQLCHAR*)after->match_id, 0, NULL);
+    }
+
+    ret = SQLExecute(stmt);
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        odbc_print_error(stmt, SQL_HANDLE_STMT, "get_match_history");
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+        return -1;
+    }
+
+    int visited = 0;
+    while ((ret = SQLFetch(stmt)) == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO) {
+        rating_delta = 0;
+        started[0] = '\0';
+        SQLGetData(stmt, 1, SQL_C_CHAR, match_id, sizeof(match_id), &indicator);
+        SQLGetData(stmt, 2, SQL_C_CHAR, color, sizeof(color), &indicator);
+        SQLGetData(stmt, 3, SQL_C_CHAR, result, sizeof(result), &indicator);
+        SQLGetData(stmt, 4, SQL_C_CHAR, started, sizeof(started), &indicator);
+        SQLGetData(stmt, 5, SQL_C_CHAR, ended, sizeof(ended), &indicator);
+        SQLGetData(stmt, 6, SQL_C_CHAR, opponent, sizeof(opponent), &indicator);
+        SQLGetData(stmt, 7, SQL_C_SLONG, &rating_delta, 0, &indicator);
+
+        db_history_row_t row = {
+            .match_id = match_id,
+            .opponent = opponent,
+            .my_color = color,
+            .result = result,
+            .started_at = started,
+            .ended_at = ended,
+            .rating_delta = rating_delta,
+        };
+        visited++;
+        if (!visit(&row, ctx))
+            break;
+    }
+
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    return visited;
+}
+
+static int odbc_for_each_user_match(db_user_match_visitor_t visit, void* ctx) {
+    SQLHSTMT stmt;
+    SQLLEN indicator;
+    char color[8], result[8], ended_at[32];
+    int user_id, opponent_id, rating_delta;
+
+    if (SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &stmt) != SQL_SUCCESS)
+        return -1;
+
+    SQLRETURN ret = SQLExecDirect(stmt,
+                                  (SQLCHAR*)"SELECT user_id, opponent_id, color, result, ended_at, rating_delta "
+                                            "FROM UserMatches ORDER BY user_id, ended_at, match_id",
+                                  SQL_NTS);
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        odbc_print_error(stmt, SQL_HANDLE_STMT, "for_each_user_match");
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+        return -1;
+    }
+
+    int visited = 0;
+    while ((ret = SQLFetch(stmt)) == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO) {
+        color[0] = result[0] = ended_at[0] = '\0';
+        user_id = opponent_id = rating_delta = 0;
+        SQLGetData(stmt, 1, SQL_C_SLONG, &user_id, 0, &indicator);
+        SQLGetData(stmt, 2, SQL_C_SLONG, &opponent_id, 0, &indicator);
+        SQLGetData(stmt, 3, SQL_C_CHAR, color, sizeof(color), &indicator);
+        SQLGetData(stmt, 4, SQL_C_CHAR, result, sizeof(result), &indicator);
+        SQLGetData(stmt, 5, SQL_C_CHAR, ended_at, sizeof(ended_at), &indicator);
+        SQLGetData(stmt, 6, SQL_C_SLONG, &rating_delta, 0, &indicator);
+
+        db_user_match_t row = {
+            .user_id = user_id,
+            .opponent_id = opponent_id,
+            .color = color,
+            .result = result,
+            .ended_at = ended_at,
+            .rating_delta = rating_delta,
+        };
+        visited++;
+        if (!visit(&row, ctx))
+            break;
+    }
+
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    return visited;
+}
+
+static bool odbc_get_user_profile(int user_id, char* out_json, size_t json_size) {
+    SQLHSTMT stmt;
+    SQLRETURN ret;
+    SQLLEN indicator;
+    char username[64], email[128], created_at[32];
+    int rating, wins, losses, draws;
+    int total_matches;
+
+    const char* sql = "SELECT username, email, rating, wins, losses, draws, created_at "
+                      "FROM Users WHERE user_id = ?";
+
+    ret = SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &stmt);
+    if (ret != SQL_SUCCESS) {
+        return false;
+    }
+
+    ret = SQLPrepare(stmt, (SQLCHAR*)sql, SQL_NTS);
+    if (ret != SQL_SUCCESS) {
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+        return false;
+    }
+
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &user_id, 0, NULL);
+
+    ret = SQLExecute(stmt);
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+        return false;
+    }
+
+    if (SQLFetch(stmt) != SQL_SUCCESS) {
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+        return false;
+    }
+
+    SQLGetData(stmt, 1, SQL_C_CHAR, username, sizeof(username), &indicator);
+    SQLGetData(stmt, 2, SQL_C_CHAR, email, sizeof(email), &indicator);
+    SQLGetData(stmt, 3, SQL_C_SLONG, &rating, 0, &indicator);
+    SQLGetData(stmt, 4, SQL_C_SLONG, &wins, 0, &indicator);
+    SQLGetData(stmt, 5, SQL_C_SLONG, &losses, 0, &indicator);
+    SQLGetData(stmt, 6, SQL_C_SLONG, &draws, 0, &indicator);
+    SQLGetData(stmt, 7, SQL_C_CHAR, created_at, sizeof(created_at), &indicator);
+
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+
+    total_matches = wins + losses + draws;
+
+    double win_rate = 0.0;
+    if (total_matches > 0) {
+        win_rate = (double)wins / total_matches * 100.0;
+    }
+
+    const char* rank_title = db_rank_title(rating);
+
+    snprintf(out_json, json_size,
+             "{"
+             "\"user_id\":%d,"
+             "\"username\":\"%s\","
+             "\"email\":\"%s\","
+             "\"rating\":%d,"
+             "\"rank_title\":\"%s\","
+             "\"wins\":%d,"
+             "\"losses\":%d,"
+             "\"draws\":%d,"
+             "\"total_matches\":%d,"
+             "\"win_rate\":%.1f,"
+             "\"created_at\":\"%s\""
+             "}",
+             user_id, username, email, rating, rank_title, wins, losses, draws, total_matches, win_rate, created_at);
+
+    return true;
+}
+
+static bool odbc_check_username_exists(const char* username) {
+    const char* sql = "SELECT COUNT(*) FROM Users WHERE username = ?";
+    int count = 0;
+
+    DB_PREPARE(stmt, sql);
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 64, 0, (SQLCHAR*)username, 0, NULL);
+
+    db_ret = SQLExecute(stmt);
+    if (db_ret == SQL_SUCCESS) {
+        SQLFetch(stmt);
+        SQLGetData(stmt, 1, SQL_C_SLONG, &count, 0, &db_indicator);
+    }
+
+    DB_CLEANUP(stmt);
+    return count > 0;
+}
+
+static bool odbc_check_email_exists(const char* email) {
+    const char* sql = "SELECT COUNT(*) FROM Users WHERE email = ?";
+    int count = 0;
+
+    DB_PREPARE(stmt, sql);
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 128, 0, (SQLCHAR*)email, 0, NULL);
+
+    db_ret = SQLExecute(stmt);
+    if (db_ret == SQL_SUCCESS) {
+        SQLFetch(stmt);
+        SQLGetData(stmt, 1, SQL_C_SLONG, &count, 0, &db_indicator);
+    }
+
+    DB_CLEANUP(stmt);
+    return count > 0;
+}
+
+static bool odbc_get_username(int user_id, char* out_username, size_t username_size) {
+    const char* sql = "SELECT username FROM Users WHERE user_id = ?";
+    char username[64] = {0};
+
+    DB_PREPARE(stmt, sql);
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &user_id, 0, NULL);
+
+    db_ret = SQLExecute(stmt);
+    if (db_ret == SQL_SUCCESS || db_ret == SQL_SUCCESS_WITH_INFO) {
+        db_ret = SQLFetch(stmt);
+        if (db_ret == SQL_SUCCESS || db_ret == SQL_SUCCESS_WITH_INFO) {
+            SQLGetData(stmt, 1, SQL_C_CHAR, username, sizeof(username), &db_indicator);
+            strncpy(out_username, username, username_size - 1);
+            out_username[username_size - 1] = '\0';
+            DB_CLEANUP(stmt);
+            return true;
+        }
+    }
+
+    DB_CLEANUP(stmt);
+    return false;
+}
+
+static bool odbc_save_active_match(const char* match_id, int red_user_id, int black_user_id,
+                                   const char* current_turn, int red_time_ms, int black_time_ms, int move_count,
+                                   const char* moves_json, bool rated, time_t started_at, time_t last_move_at) {
+    SQLHSTMT stmt;
+    SQLRETURN ret;
+
+    char started_str[32], last_move_str[32];
+    strftime(started_str, sizeof(started_str), "%Y-%m-%d %H:%M:%S", localtime(&started_at));
+    strftime(last_move_str, sizeof(last_move_str), "%Y-%m-%d %H:%M:%S", localtime(&last_move_at));
+
+    ret = SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &stmt);
+    if (ret == SQL_SUCCESS) {
+        char delete_sql[256];
+        snprintf(delete_sql, sizeof(delete_sql), "DELETE FROM active_matches WHERE match_id = '%s'", match_id);
+        SQLExecDirect(stmt, (SQLCHAR*)delete_sql, SQL_NTS);
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    }
+
+    ret = SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &stmt);
+    if (ret != SQL_SUCCESS)
+        return false;
+
+    char* insert_sql = malloc(65536);
+    if (!insert_sql) {
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+        return false;
+    }
+
+    const char* safe_moves = (moves_json && moves_json[0]) ? moves_json : "[]";
+
+    snprintf(insert_sql, 65536,
+             "INSERT INTO active_matches (match_id, red_user_id, black_user_id, "
+             "current_turn, red_time_ms, black_time_ms, move_count, moves_json, "
+             "rated, started_at, last_move_at) VALUES ('%s', %d, %d, '%s', %d, "
+             "%d, %d, "
+             "N'%s', %d, '%s', '%s')",
+             match_id, red_user_id, black_user_id, current_turn, red_time_ms, black_time_ms, move_count, safe_moves,
+             rated ? 1 : 0, started_str, last_move_str);
+
+    ret = SQLExecDirect(stmt, (SQLCHAR*)insert_sql, SQL_NTS);
+
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        odbc_print_error(stmt, SQL_HANDLE_STMT, "db_save_active_match");
+    } else {
+        LOG_INFO("[DB] Active match saved: %s", match_id);
+    }
+
+    free(insert_sql);
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    return (ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO);
+}
+
+static bool odbc_delete_active_match(const char* match_id) {
+    SQLHSTMT stmt;
+    SQLRETURN ret;
+
+    const char* sql = "DELETE FROM active_matches WHERE match_id = ?";
+
+    ret = SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &stmt);
+    if (ret != SQL_SUCCESS)
+        return false;
+
+    ret = SQLPrepare(stmt, (SQLCHAR*)sql, SQL_NTS);
+    if (ret != SQL_SUCCESS) {
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+        return false;
+    }
+
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 64, 0, (SQLCHAR*)match_id, 0, NULL);
+
+    ret = SQLExecute(stmt);
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+
+    return (ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO);
+}
+
+static bool odbc_get_active_match(const char* match_id, int* red_user_id, int* black_user_id, char* current_turn,
+                                  int* red_time_ms, int* black_time_ms, int* move_count, char* moves_json,
+                                  size_t moves_json_size, bool* rated, time_t* started_at, time_t* last_move_at) {
+    SQLHSTMT stmt;
+    SQLRETURN ret;
+
+    const char* sql = "SELECT red_user_id, black_user_id, current_turn, "
+                      "red_time_ms, black_time_ms, "
+                      "move_count, moves_json, rated, started_at, last_move_at "
+                      "FROM active_matches WHERE match_id = ?";
+
+    ret = SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &stmt);
+    if (ret != SQL_SUCCESS)
+        return false;
+
+    ret = SQLPrepare(stmt, (SQLCHAR*)sql, SQL_NTS);
+    if (ret != SQL_SUCCESS) {
+        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+        return false;
+    }
+
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 64, 0, (SQLCHAR*)match_id, 0, NULL);
+
+    ret = SQLExecute(stmt);
+    if (ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO) {
+        if (SQLFetch(stmt) == SQL_SUCCESS) {
+            SQLLEN indicator;
+            int rated_int = 0;
+            char started_str[32] = {0}, last_move_str[32] = {0};
+
+            SQLGetData(stmt, 1, SQL_C_SLONG, red_user_id, 0, &indicator);
+            SQLGetData(stmt, 2, SQL_C_SLONG, black_user_id, 0, &indicator);
+            SQLGetData(stmt, 3, SQL_C_CHAR, current_turn, DB_TURN_SIZE, &indicator);
+            SQLGetData(stmt, 4, SQL_C_SLONG, red_time_ms, 0, &indicator);
+            SQLGetData(stmt, 5, SQL_C_SLONG, black_time_ms, 0, &indicator);
+            SQLGetData(stmt, 6, SQL_C_SLONG, move_count, 0, &indicator);
+            SQLGetData(stmt, 7, SQL_C_CHAR, moves_json, moves_json_size, &indicator);
+            SQLGetData(stmt, 8, SQL_C_SLONG, &rated_int, 0, &indicator);
+            SQLGetData(stmt, 9, SQL_C_CHAR, started_str, sizeof(started_str), &indicator);
+            SQLGetData(stmt, 10, SQL_C_CHAR, last_move_str, sizeof(last_move_str), &indicator);
+
+            *rated = (rated_int != 0);
+
+            *started_at = time(NULL);
+            *last_move_at = time(NULL);
+
+            SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+            return true;
+        }
+    }
+
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    return false;
+}
+
+static int odbc_load_all_active_matches(void* matches_array, int max_matches) {
+
+    (void)matches_array;
+    (void)max_matches;
+
+    SQLHSTMT stmt;
+    SQLRETURN ret;
+    int count = 0;
+
+    const char* sql = "SELECT COUNT(*) FROM active_matches";
+
+    ret = SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &stmt);
+    if (ret != SQL_SUCCESS)
+        return 0;
+
+    ret = SQLExecDirect(stmt, (SQLCHAR*)sql, SQL_NTS);
+    if (ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO) {
+        if (SQLFetch(stmt) == SQL_SUCCESS) {
+            SQLLEN indicator;
+            SQLGetData(stmt, 1, SQL_C_SLONG, &count, 0, &indicator);
+        }
+    }
+
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    LOG_INFO("[DB] Found %d active matches in database", count);
+    return count;
+}
+
+static bool odbc_session_create(const char* token, int user_id, int expires_hours) {
+    const char* sql = "INSERT INTO Sessions (session_token, user_id, expires_at) "
+                      "VALUES (?, ?, DATEADD(HOUR, ?, GETDATE()))";
+
+    DB_PREPARE(stmt, sql);
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 64, 0, (SQLCHAR*)token, 0, NULL);
+    SQLBindParameter(stmt, 2, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &user_id, 0, NULL);
+    SQLBindParameter(stmt, 3, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &expires_hours, 0, NULL);
+
+    db_ret = SQLExecute(stmt);
+    bool success = (db_ret == SQL_SUCCESS || db_ret == SQL_SUCCESS_WITH_INFO);
+    DB_CLEANUP(stmt);
+
+    if (success) {
+        LOG_INFO("[DB] Session created for user %d (expires in %d hours)", user_id, expires_hours);
+    }
+    return success;
+}
+
+static bool odbc_session_validate(const char* token, int* out_user_id) {
+    if (!token || !out_user_id)
+        return false;
+
+    const char* sql = "SELECT user_id FROM Sessions WHERE session_token = ? AND expires_at > GETDATE()";
+    int user_id = 0;
+
+    DB_PREPARE(stmt, sql);
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 64, 0, (SQLCHAR*)token, 0, NULL);
+    DB_EXECUTE(stmt);
+
+    db_ret = SQLFetch(stmt);
+    if (db_ret == SQL_SUCCESS || db_ret == SQL_SUCCESS_WITH_INFO) {
+        SQLGetData(stmt, 1, SQL_C_SLONG, &user_id, 0, &db_indicator);
+        *out_user_id = user_id;
+        DB_CLEANUP(stmt);
+        return true;
+    }
+
+    DB_CLEANUP(stmt);
+    return false;
+}
+
+static bool odbc_session_destroy(const char* token) {
+    if (!token)
+        return false;
+
+    const char* sql = "DELETE FROM Sessions WHERE session_token = ?";
+
+    DB_PREPARE(stmt, sql);
+    SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 64, 0, (SQLCHAR*)token, 0, NULL);
+
+    db_ret = SQLExecute(stmt);
+    bool success = (db_ret == SQL_SUCCESS || db_ret == SQL_SUCCESS_WITH_INFO);
+    DB_CLEANUP(stmt);
+
+    if (success) {
+        LOG_INFO("[DB] Session destroyed");
+    }
+    return success;
+}
+
+static bool odbc_session_cleanup_expired(void) {
+    const char* sql = "DELETE FROM Sessions WHERE expires_at < GETDATE()";
+
+    SQLHSTMT stmt;
+    SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_STMT, g_db_conn, &stmt);
+    if (ret != SQL_SUCCESS)
+        return false;
+
+    ret = SQLExecDirect(stmt, (SQLCHAR*)sql, SQL_NTS);
+    bool success = (ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO);
+
+    if (success) {
+        SQLLEN rows_affected = 0;
+        SQLRowCount(stmt, &rows_affected);
+        if (rows_affected > 0) {
+            LOG_INFO("[DB] Cleaned up %ld expired sessions", (long)rows_affected);
+        }
+    }
+
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    return success;
+}
+
+const db_backend_t db_odbc_backend = {
+    .name = "odbc",
+    .init = odbc_init,
+    .shutdown = odbc_shutdown,
+    .execute = odbc_execute,
+    .create_user = odbc_create_user,
+    .get_user_by_username = odbc_get_user_by_username,
+    .get_user_by_id = odbc_get_user_by_id,
+    .update_user_rating = odbc_update_user_rating,
+    .update_user_stats = odbc_update_user_stats,
+    .save_match = odbc_save_match,
+    .save_match_analysis = odbc_save_match_analysis,
+    .for_each_match = odbc_for_each_match,
+    .for_each_rated_match = odbc_for_each_rated_match,
+    .update_ratings = odbc_update_ratings,
+    .for_each_user_rating = odbc_for_each_user_rating,
+    .get_match = odbc_get_match,
+    .get_match_history = odbc_get_match_history,
+    .for_each_user_match = odbc_for_each_user_match,
+    .get_user_profile = odbc_get_user_profile,
+    .get_leaderboard = odbc_get_leaderboard,
+    .for_each_user = odbc_for_each_user,
+    .check_username_exists = odbc_check_username_exists,
+    .check_email_exists = odbc_check_email_exists,
+    .get_username = odbc_get_username,
+    .save_active_match = odbc_save_active_match,
+    .get_active_match = odbc_get_active_match,
+    .delete_active_match = odbc_delete_active_match,
+    .load_all_active_matches = odbc_load_all_active_matches,
+    .session_create = odbc_session_create,
+    .session_validate = odbc_session_validate,
+    .session_destroy = odbc_session_destroy,
+    .session_cleanup_expired = odbc_session_cleanup_expired,
+};
+
+#endif
@@ -0,0 +1,825 @@
+#define _GNU_SOURCE /* pthread_setaffinity_np */
+
+#include "../include/engine.h"
+
+#include <ctype.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/tablebase.h"
+
+#define INF 32000
+#define MATE_BOUND (ENGINE_MATE - ENGINE_MAX_PLY)
+#define MAX_KEYS (MAX_GAME_KEYS + ENGINE_MAX_PLY * 2)
+#define MAX_GAME_KEYS 1100
+#define REPETITION_WINDOW 100
+#define NODE_CHECK_INTERVAL 2047
+#define HISTORY_LIMIT 100000
+/* Tablebase wins score below real mates, so a mate found by search still outranks them */
+#define TB_WIN_SCORE 20000
+
+#define TT_EXACT 1
+#define TT_LOWER 2
+#define TT_UPPER 3
+
+/* Moves pack into 16 bits as from << 8 | to; 0 is never a real move since from != to */
+#define MOVE_PACK(from, to) ((uint16_t)((from) << 8 | (to)))
+#define MOVE_FROM(m) ((m) >> 8)
+#define MOVE_TO(m) ((m) & 0xFF)
+
+/*
+ * Shared by every thread of a search without locks. An entry is two words: the packed data and key ^ data.
+ * A torn write (one word from each of two stores) then fails the key check and reads as a miss, instead of
+ * handing back another position's move.
+ */
+typedef struct {
+    _Atomic uint64_t check;
+    _Atomic uint64_t data;
+} tt_entry_t;
+
+/* data layout: move 0-15, score 16-31, depth 32-39, flag 40-47 */
+#define TT_PACK(move, score, depth, flag)                                                                          \
+    ((uint64_t)(move) | (uint64_t)(uint16_t)(score) << 16 | (uint64_t)(uint8_t)(depth) << 32 |                      \
+     (uint64_t)(flag) << 40)
+#define TT_MOVE(d) ((uint16_t)(d))
+#define TT_SCORE(d) ((int16_t)(uint16_t)((d) >> 16))
+#define TT_DEPTH(d) ((int8_t)(uint8_t)((d) >> 32))
+#define TT_FLAG(d) ((uint8_t)((d) >> 40))
+
+/* One searching thread's private state; only the transposition table is shared */
+typedef struct {
+    engine_t* engine;
+    int index;
+
+    board_t board;
+    bool black;
+    uint64_t key;
+    int kings[2];
+    int piece_count;
+    int eval; /* material + placement, red's point of view */
+
+    uint64_t keys[MAX_KEYS];
+    int key_count;
+
+    uint16_t killers[ENGINE_MAX_PLY][2];
+    int history[BOARD_SQUARES][BOARD_SQUARES];
+
+    _Atomic uint64_t nodes; /* written by the owner only; atomic so the main thread can total it */
+    bool aborted;
+    bool can_abort;
+    uint16_t root_best;
+
+    /* Deepest completed iteration */
+    int best_depth;
+    int best_score;
+    uint16_t best_move;
+} searcher_t;
+
+struct engine {
+    tt_entry_t* table;
+    size_t table_mask;
+
+    int thread_count;
+    searcher_t* searchers; /* [0] runs on the caller of engine_search, the rest on helpers */
+    pthread_t* helpers;
+    int helper_count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start_cond;
+    pthread_cond_t done_cond;
+    unsigned generation; /* bumped to start a search */
+    int running;         /* helpers still searching */
+    bool quit;
+
+    /* Limits of the current search */
+    int max_depth;
+    int tb_pieces; /* positions with at most this many pieces are probed instead of searched */
+    uint64_t start_ns;
+    uint64_t deadline_ns;
+    const atomic_bool* stop;
+    atomic_bool helpers_stop; /* raised once the main thread has its answer */
+};
+
+/* Indexed by PIECE_TYPE */
+static const int piece_value[8] = {0, 0, 120, 120, 270, 600, 285, 30};
+static const int victim_order[8] = {0, 7, 2, 2, 4, 6, 5, 1};
+
+static uint64_t zobrist[16][BOARD_SQUARES];
+static uint64_t zobrist_side;
+/* Signed value of a piece code on a square: positive for red, negative for black */
+static int piece_square[16][BOARD_SQUARES];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* Placement bonus for a red piece; black uses the mirrored row */
+static int placement(int type, int row, int col) {
+    int center = 4 - abs(col - 4);
+    int advanced = 9 - row;
+
+    switch (type) {
+    case PIECE_KING:
+        return col == 4 ? 8 : 0;
+    case PIECE_ADVISOR:
+    case PIECE_ELEPHANT:
+        return col == 4 ? 6 : 0;
+    case PIECE_HORSE:
+        return center * 4 + (row <= 4 ? 12 : 0) - (row == 9 ? 10 : 0);
+    case PIECE_CHARIOT:
+        return center * 2 + (row <= 4 ? 10 : 0) + (row == 9 && (col == 0 || col == 8) ? -6 : 0);
+    case PIECE_CANNON:
+        return (col == 4 ? 12 : center * 2) + (row >= 7 ? 4 : 0);
+    case PIECE_PAWN:
+        if (row >= 5)
+            return 0;
+        /* Across the river a pawn can move sideways; it is worth most before it reaches the last rank */
+        return 40 + center * 6 + (row == 0 ? 0 : advanced * 4);
+    default:
+        return 0;
+    }
+}
+
+static void init_tables(void) {
+    uint64_t seed = 0x5851F42D4C957F2DULL;
+    for (int piece = 0; piece < 16; piece++) {
+        for (int sq = 0; sq < BOARD_SQUARES; sq++)
+            zobrist[piece][sq] = splitmix64(&seed);
+    }
+    zobrist_side = splitmix64(&seed);
+
+    for (int type = PIECE_KING; type <= PIECE_PAWN; type++) {
+        for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+            int row = SQUARE_ROW(sq), col = SQUARE_COL(sq);
+            piece_square[type][sq] = piece_value[type] + placement(type, row, col);
+            piece_square[type | PIECE_BLACK][sq] = -(piece_value[type] + placement(type, 9 - row, col));
+        }
+    }
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t engine_position_key(const board_t* board, bool black) {
+    pthread_once(&tables_once, init_tables);
+
+    uint64_t key = black ? zobrist_side : 0;
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        if (board->squares[sq] != PIECE_NONE)
+            key ^= zobrist[board->squares[sq]][sq];
+    }
+    return key;
+}
+
+static int board_eval(const board_t* board) {
+    int eval = 0;
+    for (int sq = 0; sq < BOARD_SQUARES; sq++)
+        eval += piece_square[board->squares[sq]][sq];
+    return eval;
+}
+
+int engine_evaluate(const board_t* board, bool black) {
+    pthread_once(&tables_once, init_tables);
+    int eval = board_eval(board);
+    return black ? -eval : eval;
+}
+
+static void load_position(searcher_t* e, const board_t* board, bool black) {
+    e->board = *board;
+    e->black = black;
+    e->key = engine_position_key(board, black);
+    e->eval = board_eval(board);
+    e->kings[0] = e->kings[1] = -1;
+    e->piece_count = 0;
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        uint8_t piece = board->squares[sq];
+        e->piece_count += piece != PIECE_NONE;
+        if (PIECE_TYPE(piece) == PIECE_KING)
+            e->kings[PIECE_IS_BLACK(piece)] = sq;
+    }
+}
+
+static uint8_t make_move(searcher_t* e, uint16_t move) {
+    int from = MOVE_FROM(move), to = MOVE_TO(move);
+    uint8_t piece = e->board.squares[from];
+    uint8_t captured = e->board.squares[to];
+
+    e->key ^= zobrist[piece][from] ^ zobrist[piece][to] ^ zobrist_side;
+    e->eval += piece_square[piece][to] - piece_square[piece][from];
+    if (captured != PIECE_NONE) {
+        e->key ^= zobrist[captured][to];
+        e->eval -= piece_square[captured][to];
+        e->piece_count--;
+    }
+
+    e->board.squares[to] = piece;
+    e->board.squares[from] = PIECE_NONE;
+    if (PIECE_TYPE(piece) == PIECE_KING)
+        e->kings[e->black] = to;
+
+    e->black = !e->black;
+    e->keys[e->key_count++] = e->key;
+    return captured;
+}
+
+static void unmake_move(searcher_t* e, uint16_t move, uint8_t captured) {
+    int from = MOVE_FROM(move), to = MOVE_TO(move);
+    uint8_t piece = e->board.squares[to];
+
+    e->key_count--;
+    e->black = !e->black;
+    if (PIECE_TYPE(piece) == PIECE_KING)
+        e->kings[e->black] = from;
+
+    e->board.squares[from] = piece;
+    e->board.squares[to] = captured;
+
+    e->key ^= zobrist[piece][from] ^ zobrist[piece][to] ^ zobrist_side;
+    e->eval -= piece_square[piece][to] - piece_square[piece][from];
+    if (captured != PIECE_NONE) {
+        e->key ^= zobrist[captured][to];
+        e->eval += piece_square[captured][to];
+        e->piece_count++;
+    }
+}
+
+/* Whether the side that just moved left its own general attacked */
+static bool left_in_check(const searcher_t* e) {
+    bool mover = !e->black;
+    return board_king_attacked(&e->board, e->kings[mover], mover);
+}
+
+static bool in_check(const searcher_t* e) {
+    return board_king_attacked(&e->board, e->kings[e->black], e->black);
+}
+
+static bool is_repetition(const searcher_t* e) {
+    int stop = e->key_count - REPETITION_WINDOW;
+    for (int i = e->key_count - 3; i >= 0 && i >= stop; i -= 2) {
+        if (e->keys[i] == e->key)
+            return true;
+    }
+    return false;
+}
+
+static bool time_up(searcher_t* e) {
+    if (!e->can_abort)
+        return false;
+    const engine_t* shared = e->engine;
+    if ((shared->stop && atomic_load_explicit(shared->stop, memory_order_relaxed)) ||
+        (e->index > 0 && atomic_load_explicit(&shared->helpers_stop, memory_order_relaxed)) ||
+        (shared->deadline_ns && now_ns() >= shared->deadline_ns))
+        e->aborted = true;
+    return e->aborted;
+}
+
+/* Mate scores are stored relative to the node so they stay valid when reached at another ply */
+static int score_to_tt(int score, int ply) {
+    if (score > MATE_BOUND)
+        return score + ply;
+    if (score < -MATE_BOUND)
+        return score - ply;
+    return score;
+}
+
+static int score_from_tt(int score, int ply) {
+    if (score > MATE_BOUND)
+        return score - ply;
+    if (score < -MATE_BOUND)
+        return score + ply;
+    return score;
+}
+
+static bool tt_probe(const engine_t* engine, uint64_t key, uint64_t* out) {
+    const tt_entry_t* entry = &engine->table[key & engine->table_mask];
+    uint64_t data = atomic_load_explicit(&entry->data, memory_order_relaxed);
+    uint64_t check = atomic_load_explicit(&entry->check, memory_order_relaxed);
+    if ((check ^ data) != key || data == 0)
+        return false;
+    *out = data;
+    return true;
+}
+
+static void tt_store(searcher_t* e, int depth, int score, int flag, uint16_t move, int ply) {
+    engine_t* engine = e->engine;
+    tt_entry_t* entry = &engine->table[e->key & engine->table_mask];
+    uint64_t old;
+    if (tt_probe(engine, e->key, &old)) {
+        /* Keep a deeper result for the same position, otherwise always replace */
+        if (TT_DEPTH(old) > depth && flag != TT_EXACT)
+            return;
+        if (!move)
+            move = TT_MOVE(old);
+    }
+    uint64_t data = TT_PACK(move, score_to_tt(score, ply), depth, flag);
+    atomic_store_explicit(&entry->data, data, memory_order_relaxed);
+    atomic_store_explicit(&entry->check, e->key ^ data, memory_order_relaxed);
+}
+
+static void score_moves(const searcher_t* e, const board_move_t* moves, int count, int* scores, uint16_t tt_move,
+                        int ply) {
+    for (int i = 0; i < count; i++) {
+        uint16_t move = MOVE_PACK(moves[i].from, moves[i].to);
+        uint8_t victim = e->board.squares[moves[i].to];
+        if (move == tt_move) {
+            scores[i] = 1 << 30;
+        } else if (victim != PIECE_NONE) {
+            /* MVV-LVA: most valuable victim first, cheapest attacker breaking ties */
+            uint8_t attacker = e->board.squares[moves[i].from];
+            scores[i] = (1 << 24) + victim_order[PIECE_TYPE(victim)] * 16 - victim_order[PIECE_TYPE(attacker)];
+        } else if (ply < ENGINE_MAX_PLY && move == e->killers[ply][0]) {
+            scores[i] = (1 << 23);
+        } else if (ply < ENGINE_MAX_PLY && move == e->killers[ply][1]) {
+            scores[i] = (1 << 22);
+        } else {
+            scores[i] = e->history[moves[i].from][moves[i].to];
+        }
+    }
+}
+
+/* Selection sort step: moves the best remaining move to index i */
+static uint16_t pick_move(board_move_t* moves, int* scores, int count, int i) {
+    int best = i;
+    for (int j = i + 1; j < count; j++) {
+        if (scores[j] > scores[best])
+            best = j;
+    }
+    if (best != i) {
+        board_move_t tm = moves[i];
+        moves[i] = moves[best];
+        moves[best] = tm;
+        int ts = scores[i];
+        scores[i] = scores[best];
+        scores[best] = ts;
+    }
+    return MOVE_PACK(moves[i].from, moves[i].to);
+}
+
+static uint64_t count_node(searcher_t* e) {
+    uint64_t nodes = atomic_load_explicit(&e->nodes, memory_order_relaxed) + 1;
+    atomic_store_explicit(&e->nodes, nodes, memory_order_relaxed);
+    return nodes;
+}
+
+static int quiesce(searcher_t* e, int alpha, int beta, int ply) {
+    if ((count_node(e) & NODE_CHECK_INTERVAL) == 0 && time_up(e))
+        return 0;
+
+    int stand_pat = e->black ? -e->eval : e->eval;
+    if (ply >= ENGINE_MAX_PLY - 1 || stand_pat >= beta)
+        return stand_pat;
+    if (stand_pat > alpha)
+        alpha = stand_pat;
+
+    board_move_t moves[BOARD_MAX_MOVES];
+    int scores[BOARD_MAX_MOVES];
+    int count = board_generate_pseudo_moves(&e->board, e->black, true, moves);
+    score_moves(e, moves, count, scores, 0, ply);
+
+    for (int i = 0; i < count; i++) {
+        uint16_t move = pick_move(moves, scores, count, i);
+        uint8_t captured = make_move(e, move);
+        if (left_in_check(e)) {
+            unmake_move(e, move, captured);
+            continue;
+        }
+        int score = -quiesce(e, -beta, -alpha, ply + 1);
+        unmake_move(e, move, captured);
+
+        if (e->aborted)
+            return 0;
+        if (score >= beta)
+            return score;
+        if (score > alpha)
+            alpha = score;
+    }
+    return alpha;
+}
+
+static int tb_score(const tb_result_t* result, int ply) {
+    if (result->wdl == 0)
+        return 0;
+    int score = TB_WIN_SCORE - ply - result->dtm;
+    return result->wdl > 0 ? score : -score;
+}
+
+static int search(searcher_t* e, int depth, int alpha, int beta, int ply, bool pv_node) {
+    if (ply > 0 && is_repetition(e))
+        return 0;
+
+    tb_result_t tb;
+    if (ply > 0 && e->piece_count <= e->engine->tb_pieces && tb_probe(&e->board, e->black, &tb)) {
+        count_node(e);
+        return tb_score(&tb, ply);
+    }
+
+    bool checked = in_check(e);
+    if (checked && ply < ENGINE_MAX_PLY / 2)
+        depth++;
+    if (depth <= 0)
+        return quiesce(e, alpha, beta, ply);
+
+    if ((count_node(e) & NODE_CHECK_INTERVAL) == 0 && time_up(e))
+        return 0;
+    if (ply >= ENGINE_MAX_PLY - 1)
+        return e->black ? -e->eval : e->eval;
+
+    uint16_t tt_move = 0;
+    uint64_t entry;
+    if (tt_probe(e->engine, e->key, &entry)) {
+        tt_move = TT_MOVE(entry);
+        if (!pv_node && ply > 0 && TT_DEPTH(entry) >= depth) {
+            int score = score_from_tt(TT_SCORE(entry), ply);
+            int flag = TT_FLAG(entry);
+            if (flag == TT_EXACT || (flag == TT_LOWER && score >= beta) || (flag == TT_UPPER && score <= alpha))
+                return score;
+        }
+    }
+
+    board_move_t moves[BOARD_MAX_MOVES];
+    int scores[BOARD_MAX_MOVES];
+    int count = board_generate_pseudo_moves(&e->board, e->black, false, moves);
+    score_moves(e, moves, count, scores, tt_move, ply);
+
+    int original_alpha = alpha;
+    int best_score = -INF;
+    uint16_t best_move = 0;
+    int legal = 0;
+
+    for (int i = 0; i < count; i++) {
+        uint16_t move = pick_move(moves, scores, count, i);
+        bool quiet = e->board.squares[MOVE_TO(move)] == PIECE_NONE;
+        uint8_t captured = make_move(e, move);
+        if (left_in_check(e)) {
+            unmake_move(e, move, captured);
+            continue;
+        }
+        legal++;
+
+        int score;
+        if (legal == 1) {
+            score = -search(e, depth - 1, -beta, -alpha, ply + 1, pv_node);
+        } else {
+            /* Principal variation search: prove the rest worse with a null window, re-search if one is not */
+            score = -search(e, depth - 1, -alpha - 1, -alpha, ply + 1, false);
+            if (score > alpha && score < beta)
+                score = -search(e, depth - 1, -beta, -alpha, ply + 1, true);
+        }
+        unmake_move(e, move, captured);
+
+        if (e->aborted)
+            return 0;
+
+        if (score > best_score) {
+            best_score = score;
+            best_move = move;
+            if (ply == 0)
+                e->root_best = move;
+        }
+        if (score > alpha)
+            alpha = score;
+        if (alpha >= beta) {
+            if (quiet && ply < ENGINE_MAX_PLY) {
+                if (e->killers[ply][0] != move) {
+                    e->killers[ply][1] = e->killers[ply][0];
+                    e->killers[ply][0] = move;
+                }
+                int* h = &e->history[MOVE_FROM(move)][MOVE_TO(move)];
+                *h += depth * depth;
+                if (*h > HISTORY_LIMIT) {
+                    for (int a = 0; a < BOARD_SQUARES; a++) {
+                        for (int b = 0; b < BOARD_SQUARES; b++)
+                            e->history[a][b] /= 2;
+                    }
+                }
+            }
+            break;
+        }
+    }
+
+    /* No legal move loses in xiangqi, whether the general is in check or not */
+    if (legal == 0)
+        return -ENGINE_MATE + ply;
+
+    int flag = best_score >= beta ? TT_LOWER : best_score > original_alpha ? TT_EXACT : TT_UPPER;
+    tt_store(e, depth, best_score, flag, best_move, ply);
+    return best_score;
+}
+
+/* Iterative deepening on one thread; odd helpers start a ply deeper so the threads spread over two depths */
+static void iterate(searcher_t* e) {
+    engine_t* engine = e->engine;
+
+    atomic_store_explicit(&e->nodes, 0, memory_order_relaxed);
+    e->aborted = false;
+    e->can_abort = e->index > 0;
+    e->best_depth = 0;
+    e->best_score = 0;
+    e->best_move = 0;
+    memset(e->killers, 0, sizeof(e->killers));
+
+    for (int depth = 1 + (e->index & 1); depth <= engine->max_depth; depth++) {
+        e->root_best = 0;
+        int score = search(e, depth, -INF, INF, 0, true);
+        if (e->aborted)
+            break;
+
+        /* Depth 1 always finishes on the main thread so there is a move to play, however small the budget */
+        e->can_abort = true;
+        if (!e->root_best)
+            break;
+
+        e->best_depth = depth;
+        e->best_score = score;
+        e->best_move = e->root_best;
+
+        if (score > MATE_BOUND || score < -MATE_BOUND)
+            break;
+        /* The next iteration costs several times this one; don't start what can't finish */
+        uint64_t now = now_ns();
+        if (e->index == 0 && engine->deadline_ns && now + (now - engine->start_ns) * 2 >= engine->deadline_ns)
+            break;
+    }
+}
+
+static void* helper_loop(void* arg) {
+    searcher_t* e = arg;
+    engine_t* engine = e->engine;
+    unsigned seen = 0;
+
+    pthread_mutex_lock(&engine->lock);
+    while (1) {
+        while (!engine->quit && engine->generation == seen)
+            pthread_cond_wait(&engine->start_cond, &engine->lock);
+        if (engine->quit)
+            break;
+        seen = engine->generation;
+        pthread_mutex_unlock(&engine->lock);
+
+        iterate(e);
+
+        pthread_mutex_lock(&engine->lock);
+        if (--engine->running == 0)
+            pthread_cond_signal(&engine->done_cond);
+    }
+    pthread_mutex_unlock(&engine->lock);
+    return NULL;
+}
+
+/*
+ * Answers a position the tablebases cover without searching: the quickest win, else a drawing move, else the
+ * slowest loss. False if any position after a legal move is missing, so the search takes over.
+ */
+static bool tablebase_move(engine_t* engine, const board_t* board, bool black, engine_result_t* out) {
+    tb_result_t root;
+    if (!tb_probe(board, black, &root))
+        return false;
+
+    board_move_t moves[BOARD_MAX_MOVES];
+    int count = board_generate_moves(board, black, moves);
+    int best = -1, best_rank = 0;
+    for (int i = 0; i < count; i++) {
+        board_t child = *board;
+        board_apply(&child, moves[i].from, moves[i].to);
+        tb_result_t result;
+        if (!tb_probe(&child, !black, &result))
+            return false;
+        /* Higher is better for the mover: won quickly > won slowly > drawn > lost slowly > lost quickly */
+        int rank = result.wdl < 0 ? 2 * TB_MAX_DTM + 2 - result.dtm : result.wdl == 0 ? TB_MAX_DTM + 1 : result.dtm;
+        if (best < 0 || rank > best_rank) {
+            best = i;
+            best_rank = rank;
+        }
+    }
+
+    out->from = best >= 0 ? moves[best].from : -1;
+    out->to = best >= 0 ? moves[best].to : -1;
+    out->score = tb_score(&root, 0);
+    out->depth = 0;
+    out->nodes = (uint64_t)count + 1;
+    out->threads = 1;
+    out->elapsed_ms = (int)((now_ns() - engine->start_ns) / 1000000ULL);
+    out->nps = 0;
+    return true;
+}
+
+bool engine_search(engine_t* engine, const board_t* board, bool black, const uint64_t* history, int history_count,
+                   const engine_limits_t* limits, engine_result_t* out) {
+    if (!engine || !board || !out)
+        return false;
+
+    searcher_t* main_searcher = &engine->searchers[0];
+    load_position(main_searcher, board, black);
+    if (main_searcher->kings[0] < 0 || main_searcher->kings[1] < 0)
+        return false;
+
+    /* Only the most recent positions matter for repetitions */
+    if (history_count > MAX_GAME_KEYS) {
+        history += history_count - MAX_GAME_KEYS;
+        history_count = MAX_GAME_KEYS;
+    }
+    main_searcher->key_count = 0;
+    for (int i = 0; history && i < history_count; i++)
+        main_searcher->keys[main_searcher->key_count++] = history[i];
+    main_searcher->keys[main_searcher->key_count++] = main_searcher->key;
+
+    engine->tb_pieces = tb_max_pieces();
+    engine->start_ns = now_ns();
+    if (main_searcher->piece_count <= engine->tb_pieces && tablebase_move(engine, board, black, out))
+        return true;
+
+    int max_depth = limits && limits->max_depth > 0 ? limits->max_depth : ENGINE_MAX_PLY - 1;
+    engine->max_depth = max_depth > ENGINE_MAX_PLY - 1 ? ENGINE_MAX_PLY - 1 : max_depth;
+    engine->deadline_ns =
+        limits && limits->time_ms > 0 ? engine->start_ns + (uint64_t)limits->time_ms * 1000000ULL : 0;
+    engine->stop = limits ? limits->stop : NULL;
+    atomic_store(&engine->helpers_stop, false);
+
+    for (int i = 1; i < engine->thread_count; i++) {
+        searcher_t* helper = &engine->searchers[i];
+        load_position(helper, board, black);
+        memcpy(helper->keys, main_searcher->keys, (size_t)main_searcher->key_count * sizeof(uint64_t));
+        helper->key_count = main_searcher->key_count;
+    }
+
+    if (engine->helper_count > 0) {
+        pthread_mutex_lock(&engine->lock);
+        engine->generation++;
+        engine->running = engine->helper_count;
+        pthread_cond_broadcast(&engine->start_cond);
+        pthread_mutex_unlock(&engine->lock);
+    }
+
+    iterate(main_searcher);
+
+    if (engine->helper_count > 0) {
+        atomic_store(&engine->helpers_stop, true);
+        pthread_mutex_lock(&engine->lock);
+        while (engine->running > 0)
+            pthread_cond_wait(&engine->done_cond, &engine->lock);
+        pthread_mutex_unlock(&engine->lock);
+    }
+
+    /* The main thread's answer unless a helper completed a deeper iteration */
+    const searcher_t* best = main_searcher;
+    uint64_t nodes = 0;
+    for (int i = 0; i < engine->thread_count; i++) {
+        const searcher_t* s = &engine->searchers[i];
+        nodes += atomic_load_explicit(&s->nodes, memory_order_relaxed);
+        if (s->best_move && s->best_depth > best->best_depth)
+            best = s;
+    }
+
+    out->from = best->best_move ? MOVE_FROM(best->best_move) : -1;
+    out->to = best->best_move ? MOVE_TO(best->best_move) : -1;
+    out->score = best->best_score;
+    out->depth = best->best_depth;
+    out->nodes = nodes;
+    out->threads = engine->thread_count;
+
+    uint64_t elapsed_ns = now_ns() - engine->start_ns;
+    out->elapsed_ms = (int)(elapsed_ns / 1000000ULL);
+    out->nps = elapsed_ns ? (uint64_t)((double)nodes * 1e9 / (double)elapsed_ns) : 0;
+    return true;
+}
+
+engine_t* engine_create(size_t hash_mb, int threads) {
+    pthread_once(&tables_once, init_tables);
+
+    if (threads < 1)
+        threads = 1;
+    if (threads > ENGINE_MAX_THREADS)
+        threads = ENGINE_MAX_THREADS;
+
+    engine_t* engine = calloc(1, sizeof(engine_t));
+    if (!engine)
+        return NULL;
+
+    /* Largest power of two that fits in the budget */
+    size_t entries = 1;
+    size_t budget = (hash_mb ? hash_mb : ENGINE_DEFAULT_HASH_MB) * 1024 * 1024 / sizeof(tt_entry_t);
+    while (entries * 2 <= budget)
+        entries *= 2;
+
+    engine->table = calloc(entries, sizeof(tt_entry_t));
+    engine->searchers = calloc((size_t)threads, sizeof(searcher_t));
+    engine->helpers = calloc((size_t)threads, sizeof(pthread_t));
+    if (!engine->table || !engine->searchers || !engine->helpers) {
+        engine_destroy(engine);
+        return NULL;
+    }
+    engine->table_mask = entries - 1;
+    engine->thread_count = threads;
+
+    pthread_mutex_init(&engine->lock, NULL);
+    pthread_cond_init(&engine->start_cond, NULL);
+    pthread_cond_init(&engine->done_cond, NULL);
+
+    for (int i = 0; i < threads; i++) {
+        engine->searchers[i].engine = engine;
+        engine->searchers[i].index = i;
+    }
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&engine->helpers[engine->helper_count], NULL, helper_loop, &engine->searchers[i]) != 0) {
+            engine_destroy(engine);
+            return NULL;
+        }
+        engine->helper_count++;
+    }
+    return engine;
+}
+
+void engine_destroy(engine_t* engine) {
+    if (!engine)
+        return;
+
+    if (engine->thread_count > 0) {
+        pthread_mutex_lock(&engine->lock);
+        engine->quit = true;
+        pthread_cond_broadcast(&engine->start_cond);
+        pthread_mutex_unlock(&engine->lock);
+
+        for (int i = 0; i < engine->helper_count; i++)
+            pthread_join(engine->helpers[i], NULL);
+
+        pthread_cond_destroy(&engine->done_cond);
+        pthread_cond_destroy(&engine->start_cond);
+        pthread_mutex_destroy(&engine->lock);
+    }
+
+    free(engine->helpers);
+    free(engine->searchers);
+    free(engine->table);
+    free(engine);
+}
+
+void engine_clear(engine_t* engine) {
+    memset(engine->table, 0, (engine->table_mask + 1) * sizeof(tt_entry_t));
+    for (int i = 0; i < engine->thread_count; i++) {
+        memset(engine->searchers[i].killers, 0, sizeof(engine->searchers[i].killers));
+        memset(engine->searchers[i].history, 0, sizeof(engine->searchers[i].history));
+    }
+}
+
+int engine_thread_count(const engine_t* engine) {
+    return engine->thread_count;
+}
+
+static bool pin_thread(pthread_t thread, int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+
+bool engine_set_affinity(engine_t* engine, const int* cpus, int cpu_count, int first) {
+    if (!engine || !cpus || cpu_count <= 0)
+        return false;
+
+    bool pinned = pin_thread(pthread_self(), cpus[first % cpu_count]);
+    for (int i = 0; i < engine->helper_count; i++)
+        pinned = pin_thread(engine->helpers[i], cpus[(first + i + 1) % cpu_count]) && pinned;
+    return pinned;
+}
+
+int engine_parse_cpu_list(const char* spec, int* cpus, int max_cpus) {
+    int count = 0;
+    const char* p = spec;
+
+    while (p && *p) {
+        char* end;
+        long low = strtol(p, &end, 10);
+        if (end == p || low < 0 || low >= CPU_SETSIZE)
+            return -1;
+        long high = low;
+        p = end;
+        if (*p == '-') {
+            high = strtol(p + 1, &end, 10);
+            if (end == p + 1 || high < low || high >= CPU_SETSIZE)
+                return -1;
+            p = end;
+        }
+        for (long cpu = low; cpu <= high; cpu++) {
+            if (count == max_cpus)
+                return -1;
+            cpus[count++] = (int)cpu;
+        }
+        if (*p == ',')
+            p++;
+        else if (*p && !isspace((unsigned char)*p))
+            return -1;
+        else
+            break;
+    }
+    return count;
+}
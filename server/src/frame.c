@@ -0,0 +1,43 @@
+#include "../include/frame.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+frame_t* frame_create_len(const char* message, size_t len) {
+    if (!message)
+        return NULL;
+
+    bool has_newline = len > 0 && message[len - 1] == '\n';
+    size_t frame_len = has_newline ? len : len + 1;
+
+    frame_t* frame = malloc(sizeof(frame_t) + frame_len + 1);
+    if (!frame)
+        return NULL;
+
+    atomic_init(&frame->refcount, 1);
+    memcpy(frame->data, message, len);
+    frame->data[frame_len - 1] = '\n';
+    frame->data[frame_len] = '\0';
+    frame->len = frame_len;
+
+    return frame;
+}
+
+frame_t* frame_create(const char* message) {
+    if (!message)
+        return NULL;
+    return frame_create_len(message, strlen(message));
+}
+
+frame_t* frame_retain(frame_t* frame) {
+    if (frame)
+        atomic_fetch_add_explicit(&frame->refcount, 1, memory_order_relaxed);
+    return frame;
+}
+
+void frame_release(frame_t* frame) {
+    if (frame && atomic_fetch_sub_explicit(&frame->refcount, 1, memory_order_acq_rel) == 1) {
+        free(frame);
+    }
+}
@@ -1,17 +1,24 @@
+#include "handlers/handlers_admin.c"
+#include "handlers/handlers_analysis.c"
 #include "handlers/handlers_auth.c"
+#include "handlers/handlers_bot.c"
 #include "handlers/handlers_common.c"
 #include "handlers/handlers_lobby.c"
 #include "handlers/handlers_match.c"
 #include "handlers/handlers_query.c"
 #include "handlers/handlers_rematch.c"
+#include "handlers/handlers_relay.c"
 #include "handlers/handlers_room.c"
 #include "handlers/handlers_social.c"
 #include "handlers/handlers_spectate.c"
 
 #include "../include/handlers.h"
 #include "../include/log.h"
+#include "../include/metrics.h"
 #include "../include/protocol.h"
+#include "../include/relay.h"
 #include "../include/server.h"
+#include "../include/trace.h"
 
 #include <string.h>
 
@@ -42,6 +49,7 @@ static const handler_entry_t handler_table[] = {{"register", handle_register},
                                                 {"join_match", handle_join_match},
                                                 {"get_match", handle_get_match},
                                                 {"get_timer", handle_get_timer},
+                                                {"play_bot", handle_play_bot},
 
                                                 {"create_room", handle_create_room},
                                                 {"join_room", handle_join_room},
@@ -55,6 +63,7 @@ static const handler_entry_t handler_table[] = {{"register", handle_register},
 
                                                 {"join_spectate", handle_join_spectate},
                                                 {"leave_spectate", handle_leave_spectate},
+                                                {"spectate_sync", handle_spectate_sync},
 
                                                 {"rematch_request", handle_rematch_request},
                                                 {"rematch_response", handle_rematch_response},
@@ -62,12 +71,30 @@ static const handler_entry_t handler_table[] = {{"register", handle_register},
                                                 {"get_live_matches", handle_get_live_matches},
                                                 {"get_profile", handle_get_profile},
                                                 {"leaderboard", handle_leaderboard},
+                                                {"leaderboard_rank", handle_leaderboard_rank},
 
                                                 {"heartbeat", handle_heartbeat},
                                                 {"ping", handle_ping},
+                                                {"stats", handle_stats},
+                                                {"log_level", handle_log_level},
+                                                {"reload_ratings", handle_reload_ratings},
 
                                                 {NULL, NULL}};
 
+static const handler_entry_t relay_handler_table[] = {{"join_spectate", handle_relay_join_spectate},
+                                                      {"leave_spectate", handle_relay_leave_spectate},
+                                                      {"spectate_sync", handle_relay_spectate_sync},
+                                                      {"heartbeat", handle_heartbeat},
+                                                      {"ping", handle_ping},
+                                                      {"stats", handle_stats},
+                                                      {"log_level", handle_log_level},
+
+                                                      {NULL, NULL}};
+
+/* Latency series per table entry, registered the first time each message type is seen */
+static metrics_histogram_t* handler_histograms[sizeof(handler_table) / sizeof(handler_table[0])];
+static metrics_histogram_t* relay_handler_histograms[sizeof(relay_handler_table) / sizeof(relay_handler_table[0])];
+
 void dispatch_handler(server_t* server, client_t* client, message_t* msg) {
     if (!msg->type) {
         LOG_ERROR("No message type");
@@ -76,9 +103,19 @@ void dispatch_handler(server_t* server, client_t* client, message_t* msg) {
 
     LOG_DEBUG("Dispatch: type=%s seq=%d user=%d", msg->type, msg->seq, client->user_id);
 
-    for (const handler_entry_t* e = handler_table; e->type != NULL; e++) {
-        if (strcmp(msg->type, e->type) == 0) {
-            e->handler(server, client, msg);
+    bool relay = relay_is_enabled();
+    const handler_entry_t* table = relay ? relay_handler_table : handler_table;
+    metrics_histogram_t** histograms = relay ? relay_handler_histograms : handler_histograms;
+    for (size_t i = 0; table[i].type != NULL; i++) {
+        if (strcmp(msg->type, table[i].type) == 0) {
+            if (!histograms[i])
+                histograms[i] = metrics_histogram("xiangqi_handler_duration_seconds", "Message handler latency",
+                                                  "type", table[i].type, METRICS_UNIT_NS);
+
+            uint64_t start = metrics_now_ns();
+            table[i].handler(server, client, msg);
+            metrics_observe_since(histograms[i], start);
+            trace_span("handler", start);
             return;
         }
     }
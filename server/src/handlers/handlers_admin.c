@@ -0,0 +1,80 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "../../include/metrics.h"
+#include "handlers_common.h"
+
+/* Admin messages carry no role check of their own; they are only answered on loopback connections */
+static bool client_is_local(const client_t* client) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    if (getpeername(client->fd, (struct sockaddr*)&addr, &len) < 0 || addr.sin_family != AF_INET)
+        return false;
+    return ntohl(addr.sin_addr.s_addr) == INADDR_LOOPBACK;
+}
+
+void handle_stats(server_t* server, client_t* client, message_t* msg) {
+    if (!client_is_local(client)) {
+        send_response(server, client, msg->seq, false, "Forbidden", NULL);
+        return;
+    }
+
+    char* stats_json = metrics_format_json();
+    if (!stats_json) {
+        send_response(server, client, msg->seq, false, "Server memory error", NULL);
+        return;
+    }
+
+    send_response(server, client, msg->seq, true, "Stats", stats_json);
+    free(stats_json);
+}
+
+/* {"level":"debug","rate_limit":50}, both optional; replies with the settings now in effect */
+void handle_log_level(server_t* server, client_t* client, message_t* msg) {
+    if (!client_is_local(client)) {
+        send_response(server, client, msg->seq, false, "Forbidden", NULL);
+        return;
+    }
+
+    char* level_name = json_get_string(msg->payload_json, "level");
+    if (level_name) {
+        int level = log_level_from_name(level_name);
+        free(level_name);
+        if (level < 0) {
+            send_response(server, client, msg->seq, false, "Unknown log level", NULL);
+            return;
+        }
+        log_set_level(level);
+    }
+
+    if (msg->payload_json && strstr(msg->payload_json, "\"rate_limit\""))
+        log_set_rate_limit(json_get_int(msg->payload_json, "rate_limit"));
+
+    LOG_INFO("[Admin] Log level %s, rate limit %d/s", log_level_name(log_get_level()), log_get_rate_limit());
+
+    char payload[96];
+    snprintf(payload, sizeof(payload), "{\"level\":\"%s\",\"rate_limit\":%d}", log_level_name(log_get_level()),
+             log_get_rate_limit());
+    send_response(server, client, msg->seq, true, "Log level", payload);
+}
+
+/* Sent by bin/rerate after it rewrites ratings in the database; rebuilds the in-memory leaderboard from Users */
+void handle_reload_ratings(server_t* server, client_t* client, message_t* msg) {
+    if (!client_is_local(client)) {
+        send_response(server, client, msg->seq, false, "Forbidden", NULL);
+        return;
+    }
+
+    uint64_t start = metrics_now_ns();
+    if (!leaderboard_init()) {
+        send_response(server, client, msg->seq, false, "Leaderboard reload failed", NULL);
+        return;
+    }
+
+    char payload[96];
+    snprintf(payload, sizeof(payload), "{\"users\":%d,\"ms\":%llu}", leaderboard_count(),
+             (unsigned long long)((metrics_now_ns() - start) / 1000000));
+    LOG_INFO("[Admin] Ratings reloaded: %s", payload);
+    send_response(server, client, msg->seq, true, "Ratings reloaded", payload);
+}
@@ -0,0 +1,16 @@
+#include "handlers_common.h"
+
+#define ANALYSIS_RESULT_BATCH 32
+
+void handle_analysis_results(server_t* server) {
+    (void)server;
+    analysis_result_t results[ANALYSIS_RESULT_BATCH];
+    int count = analysis_take_results(results, ANALYSIS_RESULT_BATCH);
+    for (int i = 0; i < count; i++) {
+        if (!db_save_match_analysis(results[i].match_id, results[i].encoded))
+            LOG_WARN("[Analysis] Could not store analysis of %s", results[i].match_id);
+        free(results[i].encoded);
+    }
+    if (count > 0)
+        LOG_DEBUG("[Analysis] Stored %d analyses", count);
+}
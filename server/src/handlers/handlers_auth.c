@@ -30,7 +30,7 @@ void handle_register(server_t* server, client_t* client, message_t* msg) {
     snprintf(payload, sizeof(payload), "{\"user_id\":%d,\"username\":\"%s\"}", user_id, username);
     send_response(server, client, msg->seq, true, "Registration successful", payload);
 
-    printf("[Handler] User registered: %s (ID: %d)\n", username, user_id);
+    LOG_INFO("[Handler] User registered: %s (ID: %d)", username, user_id);
 }
 
 void handle_login(server_t* server, client_t* client, message_t* msg) {
@@ -61,7 +61,7 @@ void handle_login(server_t* server, client_t* client, message_t* msg) {
         return;
     }
 
-    client->user_id = user_id;
+    server_set_client_user(server, client, user_id);
     client->authenticated = true;
 
     char payload[512];
@@ -69,7 +69,7 @@ void handle_login(server_t* server, client_t* client, message_t* msg) {
              user_id, username, rating);
     send_response(server, client, msg->seq, true, "Login successful", payload);
 
-    printf("[Handler] User logged in: %s (ID: %d, fd=%d)\n", username, user_id, client->fd);
+    LOG_INFO("[Handler] User logged in: %s (ID: %d, fd=%d)", username, user_id, client->fd);
 }
 
 void handle_logout(server_t* server, client_t* client, message_t* msg) {
@@ -86,10 +86,10 @@ void handle_logout(server_t* server, client_t* client, message_t* msg) {
     lobby_remove_player(client->user_id);
 
     client->authenticated = false;
-    client->user_id = 0;
+    server_set_client_user(server, client, 0);
 
     send_response(server, client, msg->seq, true, "Logged out", NULL);
-    printf("[Handler] User logged out (ID: %d)\n", logged_out_user_id);
+    LOG_INFO("[Handler] User logged out (ID: %d)", logged_out_user_id);
 }
 
 void handle_validate_token(server_t* server, client_t* client, message_t* msg) {
@@ -110,11 +110,11 @@ void handle_validate_token(server_t* server, client_t* client, message_t* msg) {
         snprintf(payload, sizeof(payload), "{\"valid\":true,\"user_id\":%d,\"username\":\"%s\",\"rating\":%d}", user_id,
                  username, rating);
 
-        client->user_id = user_id;
+        server_set_client_user(server, client, user_id);
         client->authenticated = true;
 
         send_response(server, client, msg->seq, true, "Token valid", payload);
-        printf("[Handler] Token validated for user %d (%s)\n", user_id, username);
+        LOG_DEBUG("[Handler] Token validated for user %d (%s)", user_id, username);
     } else {
         send_response(server, client, msg->seq, false, "Token expired or invalid", "{\"valid\":false}");
     }
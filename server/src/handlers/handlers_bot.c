@@ -0,0 +1,130 @@
+#include "handlers_common.h"
+
+#define BOT_MOVE_BATCH 32
+
+void handle_play_bot(server_t* server, client_t* client, message_t* msg) {
+    REQUIRE_AUTH(server, client, msg);
+
+    if (!bot_enabled()) {
+        send_response(server, client, msg->seq, false, "Computer opponents are disabled", NULL);
+        return;
+    }
+
+    int level = json_get_int(msg->payload_json, "level");
+    if (level == 0)
+        level = BOT_DEFAULT_LEVEL;
+    if (level < BOT_LEVEL_MIN || level > BOT_LEVEL_MAX) {
+        send_response(server, client, msg->seq, false, "Invalid level", NULL);
+        return;
+    }
+
+    const char* color = json_get_string(msg->payload_json, "color");
+    bool user_red;
+    if (color && strcmp(color, "red") == 0)
+        user_red = true;
+    else if (color && strcmp(color, "black") == 0)
+        user_red = false;
+    else
+        user_red = rand() % 2 == 0;
+
+    int bot_id = bot_user_id(level);
+    lobby_remove_player(user_id);
+
+    /* Bot games never touch ratings */
+    char* match_id = user_red ? match_create(user_id, bot_id, false, 600000)
+                              : match_create(bot_id, user_id, false, 600000);
+    if (!match_id) {
+        send_response(server, client, msg->seq, false, "Failed to create match", NULL);
+        return;
+    }
+    match_persist(match_id);
+
+    char user_name[64], bot_name[64];
+    db_get_user_by_id(user_id, user_name, NULL, NULL, NULL, NULL, NULL);
+    db_get_user_by_id(bot_id, bot_name, NULL, NULL, NULL, NULL, NULL);
+
+    char payload[512];
+    snprintf(payload, sizeof(payload),
+             "{\"match_id\":\"%s\",\"red_user\":\"%s\",\"black_user\":\"%s\","
+             "\"your_color\":\"%s\",\"time_per_player\":600000,\"bot_level\":%d}",
+             match_id, user_red ? user_name : bot_name, user_red ? bot_name : user_name, user_red ? "red" : "black",
+             level);
+
+    char notify[1024];
+    snprintf(notify, sizeof(notify), "{\"type\":\"match_found\",\"payload\":%s}\n", payload);
+    send_to_user(server, user_id, notify);
+
+    send_response(server, client, msg->seq, true, "Match found", payload);
+
+    LOG_INFO("[Handler] Bot match created: %s vs %s (level %d)", user_name, bot_name, level);
+    free(match_id);
+}
+
+static void play_bot_move(server_t* server, const bot_move_t* result) {
+    match_t* match = match_find_by_id(result->match_id);
+    if (!match || !match->active || match->move_count != result->move_count) {
+        LOG_DEBUG("[Bot] Dropping stale move for %s", result->match_id);
+        return;
+    }
+
+    bool black = match->move_count % 2 == 1;
+    int bot_id = black ? match->black_user_id : match->red_user_id;
+
+    if (result->from < 0) {
+        /* No legal move: checkmated or stalemated, both lose in xiangqi */
+        finish_match(server, match, black ? "red_win" : "black_win", "checkmate");
+        return;
+    }
+
+    if (!match_is_legal_move(match, result->from, result->to)) {
+        LOG_WARN("[Bot] Illegal engine move dropped in %s", match->match_id);
+        return;
+    }
+
+    match_update_timer(match->match_id);
+    if (match_check_timeout(match->match_id))
+        return;
+
+    move_t move = {0};
+    move.from = (uint8_t)result->from;
+    move.to = (uint8_t)result->to;
+    move.clock_delta_ms = result->think_ms > MOVE_CLOCK_DELTA_MAX ? MOVE_CLOCK_DELTA_MAX : (uint32_t)result->think_ms;
+
+    if (!match_add_move(match->match_id, &move)) {
+        LOG_WARN("[Bot] Engine move rejected in %s", match->match_id);
+        return;
+    }
+
+    char payload[512];
+    snprintf(payload, sizeof(payload),
+             "{\"match_id\":\"%s\",\"from\":{\"row\":%d,\"col\":%d},\"to\":{"
+             "\"row\":%d,\"col\":%d},\"seq\":%d,\"red_time_ms\":%d,\"black_time_ms\":%d}",
+             match->match_id, SQUARE_ROW(result->from), SQUARE_COL(result->from), SQUARE_ROW(result->to),
+             SQUARE_COL(result->to), match->move_count, match->red_time_ms, match->black_time_ms);
+
+    char broadcast_msg[1024];
+    int broadcast_len =
+        snprintf(broadcast_msg, sizeof(broadcast_msg), "{\"type\":\"opponent_move\",\"payload\":%s}\n", payload);
+
+    frame_t* frame = frame_create_len(broadcast_msg, (size_t)broadcast_len);
+    if (frame) {
+        broadcast_frame_to_match(server, match, frame, bot_id);
+        frame_release(frame);
+    }
+
+    LOG_DEBUG("[Bot] Move: %s %d->%d after %d ms", match->match_id, result->from, result->to, result->think_ms);
+
+    match_persist(match->match_id);
+
+    const char* outcome;
+    const char* reason;
+    if (match_adjudicate(match, &outcome, &reason))
+        finish_match(server, match, outcome, reason);
+}
+
+void handle_bot_moves(server_t* server) {
+    bot_move_t results[BOT_MOVE_BATCH];
+    int count = bot_take_moves(results, BOT_MOVE_BATCH);
+    for (int i = 0; i < count; i++)
+        play_bot_move(server, &results[i]);
+}
@@ -48,25 +48,124 @@ void send_response(server_t* server, client_t* client, int seq, bool success, co
                    const char* payload) {
     char response[MAX_MESSAGE_SIZE];
     char escaped_msg[512];
+    uint64_t serialize_start = trace_clock();
 
     escape_json_string(message, escaped_msg, sizeof(escaped_msg));
 
     if (payload) {
-        snprintf(response, sizeof(response),
-                 "{\"type\":\"%s\",\"seq\":%d,\"success\":%s,\"message\":\"%s\","
-                 "\"payload\":%s}\n",
-                 success ? "response" : "error", seq, success ? "true" : "false", escaped_msg, payload);
+        const char* format = "{\"type\":\"%s\",\"seq\":%d,\"success\":%s,\"message\":\"%s\",\"payload\":%s}\n";
+        int needed = snprintf(response, sizeof(response), format, success ? "response" : "error", seq,
+                              success ? "true" : "false", escaped_msg, payload);
+
+        /* Large payloads (stats, long move lists) get a heap buffer instead of being cut mid-JSON */
+        if (needed >= (int)sizeof(response)) {
+            char* large = malloc((size_t)needed + 1);
+            if (large) {
+                snprintf(large, (size_t)needed + 1, format, success ? "response" : "error", seq,
+                         success ? "true" : "false", escaped_msg, payload);
+                trace_span("serialize", serialize_start);
+                client_send(server, client, large);
+                free(large);
+                return;
+            }
+        }
     } else {
         snprintf(response, sizeof(response), "{\"type\":\"%s\",\"seq\":%d,\"success\":%s,\"message\":\"%s\"}\n",
                  success ? "response" : "error", seq, success ? "true" : "false", escaped_msg);
     }
 
-    send_to_client(server, client->fd, response);
+    trace_span("serialize", serialize_start);
+    client_send(server, client, response);
 }
 
 bool validate_token_and_get_user(const char* token, int* out_user_id) {
     if (!token || !out_user_id) {
         return false;
     }
-    return session_validate(token, out_user_id);
+    uint64_t auth_start = trace_clock();
+    bool valid = session_validate(token, out_user_id);
+    trace_span("auth", auth_start);
+    return valid;
+}
+
+void finish_match(server_t* server, match_t* match, const char* result, const char* reason) {
+    const char* match_id = match->match_id;
+    match_end(match_id, result, reason);
+
+    int new_red_rating = 0;
+    int new_black_rating = 0;
+    int red_delta = 0;
+    int black_delta = 0;
+
+    if (match->rated) {
+        char u1[64], e1[128];
+        int r1, w1, l1, d1;
+        char u2[64], e2[128];
+        int r2, w2, l2, d2;
+
+        db_get_user_by_id(match->red_user_id, u1, e1, &r1, &w1, &l1, &d1);
+        db_get_user_by_id(match->black_user_id, u2, e2, &r2, &w2, &l2, &d2);
+
+        rating_change_t rc = rating_period_rate(match->red_user_id, match->black_user_id, r1, r2, result);
+
+        new_red_rating = r1 + rc.red_change;
+        new_black_rating = r2 + rc.black_change;
+        /* Glicko-2 only moves ratings when a period closes, so only Elo charges the timeout penalty */
+        if (strcmp(reason, "timeout") == 0 && !rating_period_glicko2()) {
+            int* loser_rating = strcmp(result, "red_win") == 0 ? &new_black_rating : &new_red_rating;
+            *loser_rating -= RATING_TIMEOUT_PENALTY;
+            if (*loser_rating < RATING_FLOOR)
+                *loser_rating = RATING_FLOOR;
+        }
+
+        red_delta = new_red_rating - r1;
+        black_delta = new_black_rating - r2;
+
+        if (strcmp(result, "red_win") == 0) {
+            w1++;
+            l2++;
+        } else if (strcmp(result, "black_win") == 0) {
+            l1++;
+            w2++;
+        } else if (strcmp(result, "draw") == 0) {
+            d1++;
+            d2++;
+        }
+
+        /* Under Glicko-2 the period tick writes ratings in batches */
+        if (!rating_period_glicko2()) {
+            db_update_user_rating(match->red_user_id, new_red_rating);
+            db_update_user_rating(match->black_user_id, new_black_rating);
+        }
+        db_update_user_stats(match->red_user_id, w1, l1, d1);
+        db_update_user_stats(match->black_user_id, w2, l2, d2);
+
+        LOG_INFO("[Rating] Game Over: Red(%d->%d), Black(%d->%d), Reason: %s", r1, new_red_rating, r2,
+                 new_black_rating, reason);
+    }
+
+    char* moves_json = match_get_annotated_moves_json(match);
+    char started[32], ended[32];
+    sprintf(started, "%ld", match->started_at);
+    sprintf(ended, "%ld", time(NULL));
+    bool save_result =
+        db_save_match(match_id, match->red_user_id, match->black_user_id, result, reason, moves_json, started, ended,
+                      match->rated, red_delta, black_delta);
+    LOG_DEBUG("[Handler] db_save_match returned: %s", save_result ? "true" : "false");
+    db_delete_active_match(match_id);
+    free(moves_json);
+    if (save_result)
+        analysis_request(match);
+
+    char payload[512];
+    snprintf(payload, sizeof(payload),
+             "{\"match_id\":\"%s\",\"result\":\"%s\",\"reason\":\"%s\",\"red_"
+             "rating\":%d,\"black_rating\":%d}",
+             match_id, result, reason, new_red_rating, new_black_rating);
+
+    char notify[1024];
+    snprintf(notify, sizeof(notify), "{\"type\":\"game_end\",\"payload\":%s}\n", payload);
+    broadcast_to_match(server, match_id, notify);
+
+    LOG_INFO("[Handler] Game over: match %s, result %s", match_id, result);
 }
@@ -1,26 +1,37 @@
 #ifndef HANDLERS_COMMON_H
 #define HANDLERS_COMMON_H
 
+#include <errno.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 #include "../../include/handlers.h"
+#include "../../include/analysis.h"
+#include "../../include/book.h"
+#include "../../include/bot.h"
 #include "../../include/broadcast.h"
 #include "../../include/db.h"
+#include "../../include/leaderboard.h"
 #include "../../include/lobby.h"
 #include "../../include/log.h"
 #include "../../include/match.h"
 #include "../../include/protocol.h"
 #include "../../include/rating.h"
+#include "../../include/rating_period.h"
 #include "../../include/server.h"
 #include "../../include/session.h"
+#include "../../include/stats.h"
+#include "../../include/trace.h"
 
 void escape_json_string(const char* src, char* dst, size_t dst_size);
 void send_response(server_t* server, client_t* client, int seq, bool success, 
                    const char* message, const char* payload);
 bool validate_token_and_get_user(const char* token, int* out_user_id);
+/* Ends an active match: ratings (if rated), history row, active-row cleanup and the game_end broadcast */
+void finish_match(server_t* server, match_t* match, const char* result, const char* reason);
 
 
 #define REQUIRE_AUTH(server, client, msg) \
@@ -29,7 +40,7 @@ bool validate_token_and_get_user(const char* token, int* out_user_id);
         send_response((server), (client), (msg)->seq, false, "Invalid or expired token", NULL); \
         return; \
     } \
-    (client)->user_id = user_id; \
+    server_set_client_user((server), (client), user_id); \
     (client)->authenticated = true;
 
 #endif
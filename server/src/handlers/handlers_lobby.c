@@ -12,7 +12,7 @@ void handle_set_ready(server_t* server, client_t* client, message_t* msg) {
         return;
     }
 
-    lobby_set_ready(user_id, username, rating, ready);
+    lobby_set_ready(user_id, username, rating, rating_period_rd(user_id), ready);
 
     char* ready_list = lobby_get_ready_list_json();
     if (ready_list) {
@@ -28,7 +28,7 @@ void handle_set_ready(server_t* server, client_t* client, message_t* msg) {
 void handle_find_match(server_t* server, client_t* client, message_t* msg) {
     REQUIRE_AUTH(server, client, msg);
 
-    LOG_INFO("handle_find_match called: user_id=%d, seq=%d", user_id, msg->seq);
+    LOG_DEBUG("handle_find_match called: user_id=%d, seq=%d", user_id, msg->seq);
 
     bool rated = json_get_bool(msg->payload_json, "rated");
 
@@ -36,8 +36,8 @@ void handle_find_match(server_t* server, client_t* client, message_t* msg) {
         char username[64];
         int rating;
         if (db_get_user_by_id(user_id, username, NULL, &rating, NULL, NULL, NULL)) {
-            lobby_set_ready(user_id, username, rating, true);
-            printf("[Handler] Marked user_id=%d as ready (auto)\n", user_id);
+            lobby_set_ready(user_id, username, rating, rating_period_rd(user_id), true);
+            LOG_DEBUG("[Handler] Marked user_id=%d as ready (auto)", user_id);
 
             char* ready_list = lobby_get_ready_list_json();
             if (ready_list) {
@@ -48,7 +48,7 @@ void handle_find_match(server_t* server, client_t* client, message_t* msg) {
                 free(ready_list);
             }
         } else {
-            printf("[Handler] Warning: failed to lookup user %d before queuing\n", user_id);
+            LOG_WARN("[Handler] Warning: failed to lookup user %d before queuing", user_id);
         }
     }
 
@@ -59,26 +59,26 @@ void handle_find_match(server_t* server, client_t* client, message_t* msg) {
 
         int rating;
         db_get_user_by_id(user_id, NULL, NULL, &rating, NULL, NULL, NULL);
-        found = lobby_find_rated_match(user_id, rating, 200, &opponent_id);
+        found = lobby_find_rated_match(user_id, rating, rating_period_rd(user_id), 200, &opponent_id);
     } else {
         found = lobby_find_random_match(user_id, &opponent_id);
     }
 
     if (!found) {
 
-        printf("[Handler] No opponent currently for user_id=%d — player queued\n", user_id);
+        LOG_DEBUG("[Handler] No opponent currently for user_id=%d — player queued", user_id);
         send_response(server, client, msg->seq, true, "Queued for match", "{\"status\":\"queued\"}");
         return;
     }
 
     if (!is_user_connected(server, user_id)) {
-        printf("[Handler] Aborting match: requester user_id=%d not connected\n", user_id);
+        LOG_INFO("[Handler] Aborting match: requester user_id=%d not connected", user_id);
         send_response(server, client, msg->seq, false, "You are not connected", NULL);
         return;
     }
     if (!is_user_connected(server, opponent_id)) {
 
-        printf("[Handler] Opponent %d not connected; keeping user %d queued\n", opponent_id, user_id);
+        LOG_INFO("[Handler] Opponent %d not connected; keeping user %d queued", opponent_id, user_id);
         send_response(server, client, msg->seq, true, "Queued for match", "{\"status\":\"queued\"}");
 
         lobby_remove_player(opponent_id);
@@ -118,9 +118,8 @@ void handle_find_match(server_t* server, client_t* client, message_t* msg) {
     bool sent_b = send_to_user(server, opponent_id, notify_b);
 
     if (!sent_a || !sent_b) {
-        printf("[Handler] Warning: match notify failed (sent_a=%d, sent_b=%d). "
-               "Rolling back match %s\n",
-               sent_a, sent_b, match_id);
+        LOG_WARN("[Handler] Match notify failed (sent_a=%d, sent_b=%d), rolling back match %s", sent_a, sent_b,
+                 match_id);
 
         match_end(match_id, "aborted", "notify_failed");
 
@@ -129,10 +128,10 @@ void handle_find_match(server_t* server, client_t* client, message_t* msg) {
         db_get_user_by_id(opponent_id, NULL, NULL, &rating_b, NULL, NULL, NULL);
 
         if (is_user_connected(server, user_id)) {
-            lobby_set_ready(user_id, user_name, rating_a, true);
+            lobby_set_ready(user_id, user_name, rating_a, rating_period_rd(user_id), true);
         }
         if (is_user_connected(server, opponent_id)) {
-            lobby_set_ready(opponent_id, opp_name, rating_b, true);
+            lobby_set_ready(opponent_id, opp_name, rating_b, rating_period_rd(opponent_id), true);
         }
 
         send_response(server, client, msg->seq, true, "Queued for match", "{\"status\":\"queued\"}");
@@ -144,7 +143,6 @@ void handle_find_match(server_t* server, client_t* client, message_t* msg) {
     send_response(server, client, msg->seq, true, "Match found", payload_a);
 
     free(match_id);
-    printf("[Handler] Match created: %s vs %s (sent to user %d: %d, opponent %d: "
-           "%d)\n",
-           user_name, opp_name, user_id, sent_a, opponent_id, sent_b);
+    LOG_INFO("[Handler] Match created: %s vs %s (sent to user %d: %d, opponent %d: %d)", user_name, opp_name,
+             user_id, sent_a, opponent_id, sent_b);
 }
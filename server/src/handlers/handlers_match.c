@@ -28,6 +28,18 @@ void handle_move(server_t* server, client_t* client, message_t* msg) {
         return;
     }
 
+    if (!is_valid_position(from_row, from_col) || !is_valid_position(to_row, to_col)) {
+        send_response(server, client, msg->seq, false, "Invalid position", NULL);
+        return;
+    }
+
+    if (!match_is_legal_move(match, SQUARE(from_row, from_col), SQUARE(to_row, to_col))) {
+        send_response(server, client, msg->seq, false, "Illegal move", NULL);
+        return;
+    }
+
+    long think_ms = (long)(time(NULL) - match->last_move_at) * 1000;
+
     match_update_timer(match_id);
 
     if (match_check_timeout(match_id)) {
@@ -36,14 +48,9 @@ void handle_move(server_t* server, client_t* client, message_t* msg) {
     }
 
     move_t move = {0};
-    move.from_row = from_row;
-    move.from_col = from_col;
-    move.to_row = to_row;
-    move.to_col = to_col;
-    move.timestamp = time(NULL);
-
-    move.red_time_ms = match->red_time_ms;
-    move.black_time_ms = match->black_time_ms;
+    move.from = SQUARE(from_row, from_col);
+    move.to = SQUARE(to_row, to_col);
+    move.clock_delta_ms = think_ms > MOVE_CLOCK_DELTA_MAX ? MOVE_CLOCK_DELTA_MAX : (uint32_t)think_ms;
 
     if (!match_add_move(match_id, &move)) {
         send_response(server, client, msg->seq, false, "Failed to add move", NULL);
@@ -58,23 +65,31 @@ void handle_move(server_t* server, client_t* client, message_t* msg) {
     char payload[512];
     snprintf(payload, sizeof(payload),
              "{\"match_id\":\"%s\",\"from\":{\"row\":%d,\"col\":%d},\"to\":{"
-             "\"row\":%d,\"col\":%d},\"red_time_ms\":%d,\"black_time_ms\":%d}",
-             match_id, from_row, from_col, to_row, to_col, match->red_time_ms, match->black_time_ms);
+             "\"row\":%d,\"col\":%d},\"seq\":%d,\"red_time_ms\":%d,\"black_time_ms\":%d}",
+             match_id, from_row, from_col, to_row, to_col, match->move_count, match->red_time_ms, match->black_time_ms);
 
     char broadcast_msg[1024];
-    snprintf(broadcast_msg, sizeof(broadcast_msg), "{\"type\":\"opponent_move\",\"payload\":%s}\n", payload);
-
-    int opponent_id = (match->red_user_id == user_id) ? match->black_user_id : match->red_user_id;
-    send_to_user(server, opponent_id, broadcast_msg);
+    int broadcast_len =
+        snprintf(broadcast_msg, sizeof(broadcast_msg), "{\"type\":\"opponent_move\",\"payload\":%s}\n", payload);
 
-    for (int i = 0; i < match->spectator_count; i++) {
-        send_to_user(server, match->spectator_ids[i], broadcast_msg);
+    frame_t* frame = frame_create_len(broadcast_msg, (size_t)broadcast_len);
+    if (frame) {
+        broadcast_frame_to_match(server, match, frame, user_id);
+        frame_release(frame);
     }
 
-    printf("[Handler] Move: %s (%d,%d)->(%d,%d) [Red:%dms, Black:%dms]\n", match_id, from_row, from_col, to_row, to_col,
-           match->red_time_ms, match->black_time_ms);
+    LOG_DEBUG("[Handler] Move: %s (%d,%d)->(%d,%d) [Red:%dms, Black:%dms]", match_id, from_row, from_col, to_row,
+              to_col, match->red_time_ms, match->black_time_ms);
 
     match_persist(match_id);
+
+    const char* result;
+    const char* reason;
+    if (match_adjudicate(match, &result, &reason)) {
+        finish_match(server, match, result, reason);
+        return;
+    }
+    bot_request_move(match);
 }
 
 void handle_resign(server_t* server, client_t* client, message_t* msg) {
@@ -94,61 +109,8 @@ void handle_resign(server_t* server, client_t* client, message_t* msg) {
 
     const char* result = (user_id == match->red_user_id) ? "black_win" : "red_win";
 
-    match_end(match_id, result, "resign");
-
-    int new_red_rating = 0;
-    int new_black_rating = 0;
-
-    if (match->rated) {
-        char u1[64], e1[128];
-        int r1, w1, l1, d1;
-        char u2[64], e2[128];
-        int r2, w2, l2, d2;
-
-        db_get_user_by_id(match->red_user_id, u1, e1, &r1, &w1, &l1, &d1);
-        db_get_user_by_id(match->black_user_id, u2, e2, &r2, &w2, &l2, &d2);
-
-        rating_change_t rc = rating_calculate(r1, r2, result, DEFAULT_K_FACTOR);
-
-        new_red_rating = r1 + rc.red_change;
-        new_black_rating = r2 + rc.black_change;
-
-        if (strcmp(result, "red_win") == 0) {
-            w1++;
-            l2++;
-        } else {
-            l1++;
-            w2++;
-        }
-
-        db_update_user_rating(match->red_user_id, new_red_rating);
-        db_update_user_stats(match->red_user_id, w1, l1, d1);
-
-        db_update_user_rating(match->black_user_id, new_black_rating);
-        db_update_user_stats(match->black_user_id, w2, l2, d2);
-
-        printf("[Rating] Resign: Red(%d->%d), Black(%d->%d)\n", r1, new_red_rating, r2, new_black_rating);
-    }
-
-    char* moves_json = match_get_moves_json(match);
-    char started[32], ended[32];
-    sprintf(started, "%ld", match->started_at);
-    sprintf(ended, "%ld", time(NULL));
-    db_save_match(match_id, match->red_user_id, match->black_user_id, result, moves_json, started, ended);
-    db_delete_active_match(match_id);
-    free(moves_json);
-
+    finish_match(server, match, result, "resign");
     send_response(server, client, msg->seq, true, "Resigned", NULL);
-
-    char payload[512];
-    snprintf(payload, sizeof(payload),
-             "{\"match_id\":\"%s\",\"result\":\"%s\",\"red_rating\":%d,\"black_"
-             "rating\":%d}",
-             match_id, result, new_red_rating, new_black_rating);
-
-    char notify[1024];
-    snprintf(notify, sizeof(notify), "{\"type\":\"game_end\",\"payload\":%s}\n", payload);
-    broadcast_to_match(server, match_id, notify);
 }
 
 void handle_draw_offer(server_t* server, client_t* client, message_t* msg) {
@@ -194,57 +156,9 @@ void handle_draw_response(server_t* server, client_t* client, message_t* msg) {
             return;
         }
 
-        match_end(match_id, "draw", "agreement");
-
-        int new_red_rating = 0;
-        int new_black_rating = 0;
-
-        if (match->rated) {
-            char u1[64], e1[128];
-            int r1, w1, l1, d1;
-            char u2[64], e2[128];
-            int r2, w2, l2, d2;
-
-            db_get_user_by_id(match->red_user_id, u1, e1, &r1, &w1, &l1, &d1);
-            db_get_user_by_id(match->black_user_id, u2, e2, &r2, &w2, &l2, &d2);
-
-            rating_change_t rc = rating_calculate(r1, r2, "draw", DEFAULT_K_FACTOR);
-
-            new_red_rating = r1 + rc.red_change;
-            new_black_rating = r2 + rc.black_change;
-
-            d1++;
-            d2++;
-            db_update_user_rating(match->red_user_id, new_red_rating);
-            db_update_user_stats(match->red_user_id, w1, l1, d1);
-
-            db_update_user_rating(match->black_user_id, new_black_rating);
-            db_update_user_stats(match->black_user_id, w2, l2, d2);
-
-            printf("[Rating] Draw: Red(%d->%d), Black(%d->%d)\n", r1, new_red_rating, r2, new_black_rating);
-        }
-
-        char* moves_json = match_get_moves_json(match);
-        char started[32], ended[32];
-        sprintf(started, "%ld", match->started_at);
-        sprintf(ended, "%ld", time(NULL));
-        db_save_match(match_id, match->red_user_id, match->black_user_id, "draw", moves_json, started, ended);
-        db_delete_active_match(match_id);
-        free(moves_json);
-
-        char payload[512];
-        snprintf(payload, sizeof(payload),
-                 "{\"match_id\":\"%s\",\"result\":\"draw\",\"red_rating\":%d,"
-                 "\"black_rating\":%d}",
-                 match_id, new_red_rating, new_black_rating);
-
-        char notify[1024];
-        snprintf(notify, sizeof(notify), "{\"type\":\"game_end\",\"payload\":%s}\n", payload);
-        broadcast_to_match(server, match_id, notify);
-
+        finish_match(server, match, "draw", "agreement");
         send_response(server, client, msg->seq, true, "Draw accepted", NULL);
     } else {
-
         send_response(server, client, msg->seq, true, "Draw declined", NULL);
     }
 }
@@ -267,69 +181,22 @@ void handle_game_over(server_t* server, client_t* client, message_t* msg) {
         return;
     }
 
-    if (match->active) {
-        match_end(match_id, result, reason ? reason : "game_over");
-
-        int new_red_rating = 0;
-        int new_black_rating = 0;
-
-        if (match->rated) {
-            char u1[64], e1[128];
-            int r1, w1, l1, d1;
-            char u2[64], e2[128];
-            int r2, w2, l2, d2;
-
-            db_get_user_by_id(match->red_user_id, u1, e1, &r1, &w1, &l1, &d1);
-            db_get_user_by_id(match->black_user_id, u2, e2, &r2, &w2, &l2, &d2);
-
-            rating_change_t rc = rating_calculate(r1, r2, result, DEFAULT_K_FACTOR);
-
-            new_red_rating = r1 + rc.red_change;
-            new_black_rating = r2 + rc.black_change;
+    if (match->active)
+        finish_match(server, match, result, reason ? reason : "game_over");
 
-            if (strcmp(result, "red_win") == 0) {
-                w1++;
-                l2++;
-            } else if (strcmp(result, "black_win") == 0) {
-                l1++;
-                w2++;
-            } else if (strcmp(result, "draw") == 0) {
-                d1++;
-                d2++;
-            }
-
-            db_update_user_rating(match->red_user_id, new_red_rating);
-            db_update_user_stats(match->red_user_id, w1, l1, d1);
+    send_response(server, client, msg->seq, true, "Game ended", NULL);
+}
 
-            db_update_user_rating(match->black_user_id, new_black_rating);
-            db_update_user_stats(match->black_user_id, w2, l2, d2);
+void handle_match_timeouts(server_t* server) {
+    /* match_get_pending_timeouts drops whatever does not fit, so take the whole queue */
+    timeout_info_t timeouts[MAX_PENDING_TIMEOUTS];
+    int timeout_count = match_get_pending_timeouts(timeouts, MAX_PENDING_TIMEOUTS);
 
-            printf("[Rating] Game Over: Red(%d->%d), Black(%d->%d), Reason: %s\n", r1, new_red_rating, r2,
-                   new_black_rating, reason);
-        }
+    for (int i = 0; i < timeout_count; i++) {
+        match_t* match = match_get(timeouts[i].match_id);
+        if (!match)
+            continue;
 
-        char* moves_json = match_get_moves_json(match);
-        char started[32], ended[32];
-        sprintf(started, "%ld", match->started_at);
-        sprintf(ended, "%ld", time(NULL));
-        bool save_result =
-            db_save_match(match_id, match->red_user_id, match->black_user_id, result, moves_json, started, ended);
-        printf("[Handler] db_save_match returned: %s\n", save_result ? "true" : "false");
-        db_delete_active_match(match_id);
-        free(moves_json);
-
-        char payload[512];
-        snprintf(payload, sizeof(payload),
-                 "{\"match_id\":\"%s\",\"result\":\"%s\",\"reason\":\"%s\",\"red_"
-                 "rating\":%d,\"black_rating\":%d}",
-                 match_id, result, reason ? reason : "game_over", new_red_rating, new_black_rating);
-
-        char notify[1024];
-        snprintf(notify, sizeof(notify), "{\"type\":\"game_end\",\"payload\":%s}\n", payload);
-        broadcast_to_match(server, match_id, notify);
-
-        printf("[Handler] Game over: match %s, result %s\n", match_id, result);
+        finish_match(server, match, timeouts[i].result, "timeout");
     }
-
-    send_response(server, client, msg->seq, true, "Game ended", NULL);
 }
@@ -1,5 +1,47 @@
 #include "handlers_common.h"
 
+/* Tags a saved match with the deepest named book position its opening reached; may move *match_json */
+static void append_opening(char** match_json_ptr) {
+    char* match_json = *match_json_ptr;
+    if (!book_loaded())
+        return;
+
+    uint8_t moves[BOOK_MAX_PLY][2];
+    int count = 0;
+    const char* p = strstr(match_json, "\"moves\":[");
+    while (p && count < BOOK_MAX_PLY && (p = strstr(p, "{\"from\":")) != NULL) {
+        int from_row, from_col, to_row, to_col;
+        if (sscanf(p, "{\"from\":{\"row\":%d,\"col\":%d},\"to\":{\"row\":%d,\"col\":%d}", &from_row, &from_col,
+                   &to_row, &to_col) != 4 ||
+            !is_valid_position(from_row, from_col) || !is_valid_position(to_row, to_col))
+            break;
+        moves[count][0] = (uint8_t)SQUARE(from_row, from_col);
+        moves[count][1] = (uint8_t)SQUARE(to_row, to_col);
+        count++;
+        p++;
+    }
+
+    int book_plies = 0;
+    const char* name = book_identify((const uint8_t(*)[2])moves, count, &book_plies);
+    size_t len = strlen(match_json);
+    if (!name || len == 0 || match_json[len - 1] != '}')
+        return;
+
+    char escaped[256];
+    escape_json_string(name, escaped, sizeof(escaped));
+    char field[384];
+    int field_len =
+        snprintf(field, sizeof(field), ",\"opening\":{\"name\":\"%s\",\"book_plies\":%d}}", escaped, book_plies);
+    if (field_len <= 0 || (size_t)field_len >= sizeof(field))
+        return;
+
+    char* grown = realloc(match_json, len + (size_t)field_len);
+    if (!grown)
+        return;
+    memcpy(grown + len - 1, field, (size_t)field_len + 1);
+    *match_json_ptr = grown;
+}
+
 void handle_get_match(server_t* server, client_t* client, message_t* msg) {
     REQUIRE_AUTH(server, client, msg);
 
@@ -9,13 +51,19 @@ void handle_get_match(server_t* server, client_t* client, message_t* msg) {
         return;
     }
 
-    char match_json[65536];
-    if (!db_get_match(match_id, match_json, sizeof(match_json))) {
+    char* match_json = db_get_match(match_id);
+    if (!match_json) {
         send_response(server, client, msg->seq, false, "Match not found", NULL);
         return;
     }
 
+    /* Someone is waiting on this replay, so its analysis jumps the queue */
+    if (strstr(match_json, "\"analysis\":null"))
+        analysis_prioritize(match_id);
+    append_opening(&match_json);
+
     send_response(server, client, msg->seq, true, "Match found", match_json);
+    free(match_json);
 }
 
 void handle_leaderboard(server_t* server, client_t* client, message_t* msg) {
@@ -32,11 +80,20 @@ void handle_leaderboard(server_t* server, client_t* client, message_t* msg) {
     if (offset < 0)
         offset = 0;
 
+    if (leaderboard_ready()) {
+        const char* page = leaderboard_page_json(limit, offset);
+        if (page)
+            send_response(server, client, msg->seq, true, "Leaderboard", page);
+        else
+            send_response(server, client, msg->seq, false, "Server memory error", NULL);
+        return;
+    }
+
     size_t buffer_size = 16384;
     char* leaderboard_json = (char*)malloc(buffer_size);
 
     if (!leaderboard_json) {
-        perror("malloc failed in handle_leaderboard");
+        LOG_ERROR("[Handler] malloc failed in handle_leaderboard: %s", strerror(errno));
         send_response(server, client, msg->seq, false, "Server memory error", NULL);
         return;
     }
@@ -51,6 +108,25 @@ void handle_leaderboard(server_t* server, client_t* client, message_t* msg) {
     free(leaderboard_json);
 }
 
+void handle_leaderboard_rank(server_t* server, client_t* client, message_t* msg) {
+    REQUIRE_AUTH(server, client, msg);
+
+    int target_user_id = json_get_int(msg->payload_json, "user_id");
+    if (target_user_id <= 0)
+        target_user_id = user_id;
+    int radius = json_get_int(msg->payload_json, "radius");
+    if (radius <= 0)
+        radius = 2;
+
+    char* json = leaderboard_around_json(target_user_id, radius);
+    if (!json) {
+        send_response(server, client, msg->seq, false, "User not ranked", NULL);
+        return;
+    }
+    send_response(server, client, msg->seq, true, "Leaderboard rank", json);
+    free(json);
+}
+
 void handle_join_match(server_t* server, client_t* client, message_t* msg) {
     REQUIRE_AUTH(server, client, msg);
 
@@ -89,6 +165,10 @@ void handle_join_match(server_t* server, client_t* client, message_t* msg) {
 
     send_response(server, client, msg->seq, true, "Joined match", payload);
 
-    printf("[Handler] User %d joined match %s (move_count=%d, is_my_turn=%d)\n", user_id, match_id, match->move_count,
-           is_my_turn);
+    /* A bot playing red waits for its opponent's game page before the opening move */
+    if (!is_my_turn)
+        bot_request_move(match);
+
+    LOG_DEBUG("[Handler] User %d joined match %s (move_count=%d, is_my_turn=%d)", user_id, match_id, match->move_count,
+              is_my_turn);
 }
@@ -0,0 +1,52 @@
+#include "handlers_common.h"
+
+#include "../../include/relay.h"
+
+/* Spectate handlers used instead of the full handler table when running as a relay */
+
+void handle_relay_join_spectate(server_t* server, client_t* client, message_t* msg) {
+    const char* match_id = json_get_string(msg->payload_json, "match_id");
+    if (!match_id) {
+        send_response(server, client, msg->seq, false, "Missing match_id", NULL);
+        return;
+    }
+
+    if (!relay_join_spectate(server, client, match_id, msg->seq)) {
+        send_response(server, client, msg->seq, false, "Match not found or ended", NULL);
+        return;
+    }
+
+    LOG_DEBUG("[Handler] Relay spectator fd=%d joined %s", client->fd, match_id);
+}
+
+void handle_relay_leave_spectate(server_t* server, client_t* client, message_t* msg) {
+    const char* match_id = json_get_string(msg->payload_json, "match_id");
+    if (!match_id) {
+        send_response(server, client, msg->seq, false, "Missing match_id", NULL);
+        return;
+    }
+
+    if (relay_leave_spectate(client, match_id)) {
+        send_response(server, client, msg->seq, true, "Left spectate mode", NULL);
+    } else {
+        send_response(server, client, msg->seq, false, "Not spectating this match", NULL);
+    }
+}
+
+void handle_relay_spectate_sync(server_t* server, client_t* client, message_t* msg) {
+    const char* match_id = json_get_string(msg->payload_json, "match_id");
+    if (!match_id) {
+        send_response(server, client, msg->seq, false, "Missing match_id", NULL);
+        return;
+    }
+
+    /* NULL also while the relay itself is resyncing from the primary; the spectator retries on its next gap */
+    char* keyframe_json = relay_get_keyframe_json(match_id);
+    if (!keyframe_json) {
+        send_response(server, client, msg->seq, false, "Keyframe not available", NULL);
+        return;
+    }
+
+    send_response(server, client, msg->seq, true, "Keyframe", keyframe_json);
+    free(keyframe_json);
+}
@@ -71,7 +71,7 @@ void handle_rematch_response(server_t* server, client_t* client, message_t* msg)
                      "{\"type\":\"rematch_declined\",\"payload\":{\"match_id\":\"%s\"}}\n", match_id);
             send_to_client(server, opponent_client->fd, notification);
         }
-        printf("[Handler] Rematch declined by user %d\n", user_id);
+        LOG_INFO("[Handler] Rematch declined by user %d", user_id);
         return;
     }
 
@@ -122,34 +122,132 @@ void handle_rematch_response(server_t* server, client_t* client, message_t* msg)
     }
 
     send_response(server, client, msg->seq, true, "Rematch accepted", NULL);
-    printf("[Handler] Rematch created: %s (colors swapped)\n", new_match_id);
+    LOG_INFO("[Handler] Rematch created: %s (colors swapped)", new_match_id);
     free(new_match_id);
 }
 
+#define HISTORY_DEFAULT_LIMIT 20
+#define HISTORY_MAX_LIMIT 1000
+#define HISTORY_CHUNK_ROWS 50
+#define HISTORY_ROW_JSON_MAX 320
+
+/* Rows are flushed to the client HISTORY_CHUNK_ROWS at a time, so a long history never needs one large buffer */
+typedef struct {
+    server_t* server;
+    client_t* client;
+    int seq;
+    int limit;
+    int rows;
+    bool more; /* a row past limit exists */
+    int chunks_sent;
+    db_history_cursor_t last;
+    size_t len;
+    char json[HISTORY_CHUNK_ROWS * HISTORY_ROW_JSON_MAX + 2];
+} history_stream_t;
+
+/* The continuation token is the keyset of the last row sent: "<ended_at>|<match_id>". Clients treat it as opaque. */
+static int format_cursor(const db_history_cursor_t* cursor, char* out, size_t size) {
+    return snprintf(out, size, "\"%s|%s\"", cursor->ended_at, cursor->match_id);
+}
+
+static bool parse_cursor(const char* token, db_history_cursor_t* out) {
+    const char* bar = token ? strchr(token, '|') : NULL;
+    if (!bar || bar == token || (size_t)(bar - token) >= sizeof(out->ended_at) ||
+        strlen(bar + 1) >= sizeof(out->match_id))
+        return false;
+    snprintf(out->ended_at, sizeof(out->ended_at), "%.*s", (int)(bar - token), token);
+    snprintf(out->match_id, sizeof(out->match_id), "%s", bar + 1);
+    return true;
+}
+
+/* Sends the buffered rows as a match_history_chunk frame carrying the cursor that resumes after them */
+static void flush_history_chunk(history_stream_t* stream) {
+    char cursor[128];
+    format_cursor(&stream->last, cursor, sizeof(cursor));
+
+    char frame[sizeof(stream->json) + 256];
+    snprintf(frame, sizeof(frame), "{\"type\":\"match_history_chunk\",\"seq\":%d,\"payload\":{\"matches\":[%.*s],"
+             "\"cursor\":%s}}\n", stream->seq, (int)stream->len, stream->json, cursor);
+    client_send(stream->server, stream->client, frame);
+    stream->chunks_sent++;
+    stream->len = 0;
+}
+
+static bool stream_history_row(const db_history_row_t* row, void* ctx) {
+    history_stream_t* stream = ctx;
+    if (stream->rows == stream->limit) {
+        stream->more = true;
+        return false;
+    }
+
+    if (stream->len > 0 && stream->rows % HISTORY_CHUNK_ROWS == 0)
+        flush_history_chunk(stream);
+
+    int written = snprintf(stream->json + stream->len, sizeof(stream->json) - stream->len,
+                           "%s{\"match_id\":\"%s\",\"opponent\":\"%s\",\"my_color\":\"%s\","
+                           "\"result\":\"%s\",\"started_at\":\"%s\",\"ended_at\":\"%s\",\"rating_delta\":%d}",
+                           stream->len ? "," : "", row->match_id, row->opponent, row->my_color, row->result,
+                           row->started_at, row->ended_at, row->rating_delta);
+    if (written < 0 || (size_t)written >= sizeof(stream->json) - stream->len) {
+        stream->json[stream->len] = '\0';
+        return false;
+    }
+
+    stream->len += (size_t)written;
+    stream->rows++;
+    snprintf(stream->last.ended_at, sizeof(stream->last.ended_at), "%s", row->ended_at);
+    snprintf(stream->last.match_id, sizeof(stream->last.match_id), "%s", row->match_id);
+    return true;
+}
+
+/*
+ * Newest first, keyset-paginated: the payload's "cursor" (from a previous reply's next_cursor) resumes just past
+ * the last match seen, so every page is one index seek however deep it is. Pages larger than HISTORY_CHUNK_ROWS
+ * arrive as match_history_chunk frames with the request's seq, then the final response with the last rows and
+ * next_cursor (null once the history is exhausted).
+ */
 void handle_match_history(server_t* server, client_t* client, message_t* msg) {
     REQUIRE_AUTH(server, client, msg);
 
-    int limit = json_get_int(msg->payload_json, "limit");
-    int offset = json_get_int(msg->payload_json, "offset");
-
-    if (limit <= 0)
-        limit = 20;
-    if (limit > 100)
-        limit = 100;
-    if (offset < 0)
-        offset = 0;
+    static history_stream_t stream; /* reactor thread only; too large for the stack */
+    memset(&stream, 0, offsetof(history_stream_t, json));
+    stream.server = server;
+    stream.client = client;
+    stream.seq = msg->seq;
+    stream.limit = json_get_int(msg->payload_json, "limit");
+
+    if (stream.limit <= 0)
+        stream.limit = HISTORY_DEFAULT_LIMIT;
+    if (stream.limit > HISTORY_MAX_LIMIT)
+        stream.limit = HISTORY_MAX_LIMIT;
+
+    char* token = json_get_string(msg->payload_json, "cursor");
+    db_history_cursor_t after;
+    bool resume = token && token[0];
+    if (resume && !parse_cursor(token, &after)) {
+        free(token);
+        send_response(server, client, msg->seq, false, "Invalid history cursor", NULL);
+        return;
+    }
+    free(token);
 
-    char history_json[16384];
-    if (!db_get_match_history(user_id, limit, offset, history_json, sizeof(history_json))) {
+    /* One row past the page tells whether there is a next one */
+    if (db_get_match_history(user_id, resume ? &after : NULL, stream.limit + 1, stream_history_row, &stream) < 0) {
         send_response(server, client, msg->seq, false, "Failed to get match history", NULL);
         return;
     }
 
-    char payload[16500];
-    snprintf(payload, sizeof(payload), "{\"matches\":%s}", history_json);
+    char next_cursor[128] = "null";
+    if (stream.more)
+        format_cursor(&stream.last, next_cursor, sizeof(next_cursor));
+
+    char payload[sizeof(stream.json) + 192];
+    snprintf(payload, sizeof(payload), "{\"matches\":[%.*s],\"next_cursor\":%s,\"chunks\":%d}", (int)stream.len,
+             stream.json, next_cursor, stream.chunks_sent);
     send_response(server, client, msg->seq, true, "Match history", payload);
 
-    printf("[Handler] Match history for user %d (limit=%d, offset=%d)\n", user_id, limit, offset);
+    LOG_DEBUG("[Handler] Match history for user %d: %d rows in %d frames", user_id, stream.rows,
+              stream.chunks_sent + 1);
 }
 
 void handle_get_live_matches(server_t* server, client_t* client, message_t* msg) {
@@ -174,7 +272,7 @@ void handle_get_live_matches(server_t* server, client_t* client, message_t* msg)
     free(live_matches_json);
     free(payload);
 
-    printf("[Handler] Get live matches for user %d\n", user_id);
+    LOG_DEBUG("[Handler] Get live matches for user %d", user_id);
 }
 
 void handle_get_profile(server_t* server, client_t* client, message_t* msg) {
@@ -191,12 +289,38 @@ void handle_get_profile(server_t* server, client_t* client, message_t* msg) {
         return;
     }
 
-    char payload[2200];
-    snprintf(payload, sizeof(payload), "{\"profile\":%s}", profile_json);
+    /* The rank and the chart aggregates come from memory and are spliced into the profile object */
+    size_t profile_len = strlen(profile_json);
+    if (profile_len == 0 || profile_json[profile_len - 1] != '}') {
+        send_response(server, client, msg->seq, false, "User not found", NULL);
+        return;
+    }
+    profile_json[--profile_len] = '\0';
+
+    char extra[128] = "";
+    int rank = leaderboard_rank(target_user_id);
+    if (rank > 0)
+        snprintf(extra, sizeof(extra), ",\"leaderboard_rank\":%d,\"leaderboard_total\":%d", rank, leaderboard_count());
+    int rd = rating_period_rd(target_user_id);
+    if (rd > 0)
+        snprintf(extra + strlen(extra), sizeof(extra) - strlen(extra), ",\"rating_deviation\":%d", rd);
+
+    char* stats_json = stats_profile_json(target_user_id);
+    size_t payload_size = profile_len + strlen(extra) + (stats_json ? strlen(stats_json) : 0) + 32;
+    char* payload = malloc(payload_size);
+    if (!payload) {
+        free(stats_json);
+        send_response(server, client, msg->seq, false, "Memory allocation failed", NULL);
+        return;
+    }
+    snprintf(payload, payload_size, "{\"profile\":%s%s%s%s}}", profile_json, extra, stats_json ? ",\"stats\":" : "",
+             stats_json ? stats_json : "");
 
     send_response(server, client, msg->seq, true, "Profile data", payload);
+    free(payload);
+    free(stats_json);
 
-    printf("[Handler] Get profile for user %d (requested by %d)\n", target_user_id, user_id);
+    LOG_DEBUG("[Handler] Get profile for user %d (requested by %d)", target_user_id, user_id);
 }
 
 void handle_get_timer(server_t* server, client_t* client, message_t* msg) {
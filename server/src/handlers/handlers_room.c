@@ -29,7 +29,7 @@ void handle_create_room(server_t* server, client_t* client, message_t* msg) {
         free(rooms_json);
     }
 
-    printf("[Handler] Room created: %s by user %d\n", room_code, user_id);
+    LOG_INFO("[Handler] Room created: %s by user %d", room_code, user_id);
     free(room_code);
 }
 
@@ -81,7 +81,7 @@ void handle_join_room(server_t* server, client_t* client, message_t* msg) {
         free(rooms_json);
     }
 
-    printf("[Handler] User %d joined room %s\n", user_id, room_code);
+    LOG_INFO("[Handler] User %d joined room %s", user_id, room_code);
 }
 
 void handle_leave_room(server_t* server, client_t* client, message_t* msg) {
@@ -140,7 +140,7 @@ void handle_leave_room(server_t* server, client_t* client, message_t* msg) {
         free(rooms_json);
     }
 
-    printf("[Handler] User %d left room %s\n", user_id, room_code);
+    LOG_INFO("[Handler] User %d left room %s", user_id, room_code);
 }
 
 void handle_get_rooms(server_t* server, client_t* client, message_t* msg) {
@@ -233,6 +233,6 @@ void handle_start_room_game(server_t* server, client_t* client, message_t* msg)
         free(rooms_json);
     }
 
-    printf("[Handler] Room game started: %s -> match %s\n", room_code, match_id);
+    LOG_INFO("[Handler] Room game started: %s -> match %s", room_code, match_id);
     free(match_id);
 }
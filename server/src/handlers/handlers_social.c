@@ -128,5 +128,5 @@ void handle_chat_message(server_t* server, client_t* client, message_t* msg) {
 
     send_response(server, client, msg->seq, true, "Message sent", NULL);
 
-    printf("[Handler] Chat message from user %d in match %s\n", user_id, match_id);
+    LOG_DEBUG("[Handler] Chat message from user %d in match %s", user_id, match_id);
 }
@@ -8,7 +8,7 @@ void handle_join_spectate(server_t* server, client_t* client, message_t* msg) {
     }
 
     if (user_id > 0) {
-        client->user_id = user_id;
+        server_set_client_user(server, client, user_id);
         client->authenticated = true;
     }
 
@@ -27,29 +27,63 @@ void handle_join_spectate(server_t* server, client_t* client, message_t* msg) {
     bool is_red_turn = (match->move_count % 2 == 0);
     const char* current_turn = is_red_turn ? "red" : "black";
 
-    char* match_json = match_get_json(match_id);
-    if (!match_json) {
+    /* Keyframe instead of the full history: its size no longer grows with the game */
+    char* keyframe_json = match_get_keyframe_json(match, SPECTATE_KEYFRAME_MOVES);
+    if (!keyframe_json) {
         send_response(server, client, msg->seq, false, "Failed to get match state", NULL);
         return;
     }
 
-    if (!match_add_spectator(match_id, user_id)) {
+    if (!match_add_spectator(match_id, client)) {
         send_response(server, client, msg->seq, false, "Failed to add spectator", NULL);
-        free(match_json);
+        free(keyframe_json);
         return;
     }
 
-    char payload[4096];
-    snprintf(payload, sizeof(payload),
+    size_t payload_size = strlen(keyframe_json) + 256;
+    char* payload = malloc(payload_size);
+    if (!payload) {
+        match_remove_spectator(match_id, client);
+        send_response(server, client, msg->seq, false, "Failed to get match state", NULL);
+        free(keyframe_json);
+        return;
+    }
+
+    snprintf(payload, payload_size,
              "{\"match_id\":\"%s\",\"move_count\":%d,\"current_turn\":\"%s\","
-             "\"is_spectator\":true,\"match_data\":%s}",
-             match_id, match->move_count, current_turn, match_json);
+             "\"is_spectator\":true,\"keyframe\":%s}",
+             match_id, match->move_count, current_turn, keyframe_json);
 
     send_response(server, client, msg->seq, true, "Joined as spectator", payload);
 
-    printf("[Handler] User %d spectating match %s (move_count=%d)\n", user_id, match_id, match->move_count);
+    LOG_DEBUG("[Handler] User %d spectating match %s (move_count=%d)", user_id, match_id, match->move_count);
+
+    free(payload);
+    free(keyframe_json);
+}
+
+/* Resync for a spectator that noticed a gap in opponent_move seq numbers */
+void handle_spectate_sync(server_t* server, client_t* client, message_t* msg) {
+    const char* match_id = json_get_string(msg->payload_json, "match_id");
+    if (!match_id) {
+        send_response(server, client, msg->seq, false, "Missing match_id", NULL);
+        return;
+    }
+
+    match_t* match = match_find_by_id(match_id);
+    if (!match) {
+        send_response(server, client, msg->seq, false, "Match not found", NULL);
+        return;
+    }
+
+    char* keyframe_json = match_get_keyframe_json(match, SPECTATE_KEYFRAME_MOVES);
+    if (!keyframe_json) {
+        send_response(server, client, msg->seq, false, "Failed to get match state", NULL);
+        return;
+    }
 
-    free(match_json);
+    send_response(server, client, msg->seq, true, "Keyframe", keyframe_json);
+    free(keyframe_json);
 }
 
 void handle_leave_spectate(server_t* server, client_t* client, message_t* msg) {
@@ -61,7 +95,7 @@ void handle_leave_spectate(server_t* server, client_t* client, message_t* msg) {
         return;
     }
 
-    if (match_remove_spectator(match_id, user_id)) {
+    if (match_remove_spectator(match_id, client)) {
         send_response(server, client, msg->seq, true, "Left spectate mode", NULL);
     } else {
         send_response(server, client, msg->seq, false, "Not spectating this match", NULL);
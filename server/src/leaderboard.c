@@ -0,0 +1,394 @@
+#include "../include/leaderboard.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/db.h"
+#include "../include/log.h"
+#include "../include/metrics.h"
+
+#define MAX_LEVEL 24
+#define CACHE_PAGES 16
+#define ENTRY_JSON_MAX 192
+
+typedef struct lb_node lb_node_t;
+
+typedef struct {
+    lb_node_t* next;
+    int span; /* level-0 steps to next; past the tail, to one beyond the last entry */
+} lb_link_t;
+
+struct lb_node {
+    int user_id;
+    int rating;
+    int wins;
+    int losses;
+    int draws;
+    char username[64];
+    int level;
+    lb_link_t links[];
+};
+
+typedef struct {
+    int limit;
+    int offset;
+    unsigned generation;
+    char* json;
+} lb_page_t;
+
+static struct {
+    bool ready;
+    lb_node_t* head;
+    int level;
+    int count;
+
+    lb_node_t** by_id; /* indexed by user_id */
+    int by_id_capacity;
+
+    uint64_t rng;
+    unsigned generation; /* bumped on every change; cached pages from older generations are stale */
+    lb_page_t pages[CACHE_PAGES];
+    int next_page;
+} lb = {0};
+
+static metrics_counter_t* page_hits = NULL;
+static metrics_counter_t* page_misses = NULL;
+
+/* Whether a sorts before the (rating, user_id) position: higher rating first, older account on ties */
+static bool sorts_before(const lb_node_t* a, int rating, int user_id) {
+    return a->rating > rating || (a->rating == rating && a->user_id < user_id);
+}
+
+static int random_level(void) {
+    lb.rng ^= lb.rng << 13;
+    lb.rng ^= lb.rng >> 7;
+    lb.rng ^= lb.rng << 17;
+    /* Each level keeps a quarter of the one below */
+    int level = 1;
+    for (uint64_t bits = lb.rng; level < MAX_LEVEL && (bits & 3) == 0; bits >>= 2)
+        level++;
+    return level;
+}
+
+static void list_insert(lb_node_t* node) {
+    lb_node_t* update[MAX_LEVEL];
+    int rank[MAX_LEVEL];
+
+    lb_node_t* x = lb.head;
+    for (int i = lb.level - 1; i >= 0; i--) {
+        rank[i] = i == lb.level - 1 ? 0 : rank[i + 1];
+        while (x->links[i].next && sorts_before(x->links[i].next, node->rating, node->user_id)) {
+            rank[i] += x->links[i].span;
+            x = x->links[i].next;
+        }
+        update[i] = x;
+    }
+
+    if (node->level > lb.level) {
+        for (int i = lb.level; i < node->level; i++) {
+            rank[i] = 0;
+            update[i] = lb.head;
+            lb.head->links[i].span = lb.count;
+        }
+        lb.level = node->level;
+    }
+
+    for (int i = 0; i < node->level; i++) {
+        node->links[i].next = update[i]->links[i].next;
+        update[i]->links[i].next = node;
+        node->links[i].span = update[i]->links[i].span - (rank[0] - rank[i]);
+        update[i]->links[i].span = rank[0] - rank[i] + 1;
+    }
+    for (int i = node->level; i < lb.level; i++)
+        update[i]->links[i].span++;
+    lb.count++;
+}
+
+static void list_remove(lb_node_t* node) {
+    lb_node_t* update[MAX_LEVEL];
+
+    lb_node_t* x = lb.head;
+    for (int i = lb.level - 1; i >= 0; i--) {
+        while (x->links[i].next && sorts_before(x->links[i].next, node->rating, node->user_id))
+            x = x->links[i].next;
+        update[i] = x;
+    }
+
+    for (int i = 0; i < lb.level; i++) {
+        if (update[i]->links[i].next == node) {
+            update[i]->links[i].span += node->links[i].span - 1;
+            update[i]->links[i].next = node->links[i].next;
+        } else {
+            update[i]->links[i].span--;
+        }
+    }
+    while (lb.level > 1 && !lb.head->links[lb.level - 1].next)
+        lb.level--;
+    lb.count--;
+}
+
+/* The entry at 1-based rank, or NULL */
+static lb_node_t* list_at(int rank) {
+    if (rank < 1 || rank > lb.count)
+        return NULL;
+    lb_node_t* x = lb.head;
+    int traversed = 0;
+    for (int i = lb.level - 1; i >= 0; i--) {
+        while (x->links[i].next && traversed + x->links[i].span <= rank) {
+            traversed += x->links[i].span;
+            x = x->links[i].next;
+        }
+        if (traversed == rank)
+            return x;
+    }
+    return NULL;
+}
+
+static lb_node_t* find(int user_id) {
+    return user_id > 0 && user_id < lb.by_id_capacity ? lb.by_id[user_id] : NULL;
+}
+
+static void changed(void) {
+    lb.generation++;
+}
+
+static bool visit_user(int user_id, const char* username, int rating, int wins, int losses, int draws, void* ctx) {
+    (void)ctx;
+    leaderboard_set_user(user_id, username, rating, wins, losses, draws);
+    return true;
+}
+
+bool leaderboard_init(void) {
+    leaderboard_shutdown();
+
+    lb.head = calloc(1, sizeof(lb_node_t) + MAX_LEVEL * sizeof(lb_link_t));
+    if (!lb.head)
+        return false;
+    lb.head->level = MAX_LEVEL;
+    lb.level = 1;
+    lb.rng = 0x9E3779B97F4A7C15ULL;
+    lb.ready = true;
+
+    uint64_t start = metrics_now_ns();
+    if (db_for_each_user(visit_user, NULL) < 0) {
+        LOG_ERROR("[Leaderboard] Failed to load users");
+        leaderboard_shutdown();
+        return false;
+    }
+
+    if (!page_hits) {
+        page_hits = metrics_counter("xiangqi_leaderboard_pages_total", "Leaderboard pages served", "cache", "hit");
+        page_misses = metrics_counter("xiangqi_leaderboard_pages_total", "Leaderboard pages served", "cache", "miss");
+    }
+
+    LOG_INFO("[Leaderboard] %d users ranked in %llu ms", lb.count,
+             (unsigned long long)((metrics_now_ns() - start) / 1000000));
+    return true;
+}
+
+void leaderboard_shutdown(void) {
+    if (lb.head) {
+        lb_node_t* x = lb.head->links[0].next;
+        while (x) {
+            lb_node_t* next = x->links[0].next;
+            free(x);
+            x = next;
+        }
+        free(lb.head);
+    }
+    for (int i = 0; i < CACHE_PAGES; i++)
+        free(lb.pages[i].json);
+    free(lb.by_id);
+    memset(&lb, 0, sizeof(lb));
+}
+
+bool leaderboard_ready(void) {
+    return lb.ready;
+}
+
+void leaderboard_set_user(int user_id, const char* username, int rating, int wins, int losses, int draws) {
+    if (!lb.ready || user_id <= 0)
+        return;
+
+    if (user_id >= lb.by_id_capacity) {
+        int capacity = lb.by_id_capacity ? lb.by_id_capacity : 1024;
+        while (capacity <= user_id)
+            capacity *= 2;
+        lb_node_t** grown = realloc(lb.by_id, (size_t)capacity * sizeof(lb_node_t*));
+        if (!grown) {
+            LOG_ERROR("[Leaderboard] Out of memory adding user %d", user_id);
+            return;
+        }
+        memset(grown + lb.by_id_capacity, 0, (size_t)(capacity - lb.by_id_capacity) * sizeof(lb_node_t*));
+        lb.by_id = grown;
+        lb.by_id_capacity = capacity;
+    }
+
+    lb_node_t* node = lb.by_id[user_id];
+    if (node) {
+        list_remove(node);
+    } else {
+        int level = random_level();
+        node = calloc(1, sizeof(lb_node_t) + (size_t)level * sizeof(lb_link_t));
+        if (!node) {
+            LOG_ERROR("[Leaderboard] Out of memory adding user %d", user_id);
+            return;
+        }
+        node->user_id = user_id;
+        node->level = level;
+        lb.by_id[user_id] = node;
+    }
+
+    snprintf(node->username, sizeof(node->username), "%s", username ? username : "");
+    node->rating = rating;
+    node->wins = wins;
+    node->losses = losses;
+    node->draws = draws;
+    list_insert(node);
+    changed();
+}
+
+void leaderboard_set_rating(int user_id, int rating) {
+    lb_node_t* node = find(user_id);
+    if (!node || node->rating == rating)
+        return;
+    list_remove(node);
+    node->rating = rating;
+    list_insert(node);
+    changed();
+}
+
+void leaderboard_set_stats(int user_id, int wins, int losses, int draws) {
+    lb_node_t* node = find(user_id);
+    if (!node)
+        return;
+    node->wins = wins;
+    node->losses = losses;
+    node->draws = draws;
+    changed();
+}
+
+int leaderboard_count(void) {
+    return lb.count;
+}
+
+int leaderboard_rank(int user_id) {
+    const lb_node_t* node = find(user_id);
+    if (!node)
+        return 0;
+
+    const lb_node_t* x = lb.head;
+    int rank = 0;
+    for (int i = lb.level - 1; i >= 0; i--) {
+        while (x->links[i].next && (x->links[i].next == node || sorts_before(x->links[i].next, node->rating,
+                                                                              node->user_id))) {
+            rank += x->links[i].span;
+            x = x->links[i].next;
+        }
+        if (x == node)
+            return rank;
+    }
+    return 0;
+}
+
+int leaderboard_rating(int user_id) {
+    const lb_node_t* node = find(user_id);
+    return node ? node->rating : 0;
+}
+
+const char* leaderboard_username(int user_id) {
+    const lb_node_t* node = find(user_id);
+    return node ? node->username : NULL;
+}
+
+/* Appends entries from rank first on; returns the JSON length or 0 if it did not fit */
+static size_t format_entries(char* out, size_t size, int first, int limit) {
+    size_t len = 0;
+    out[len++] = '[';
+    const lb_node_t* x = list_at(first);
+    for (int n = 0; x && n < limit; n++, x = x->links[0].next) {
+        int written = snprintf(out + len, size - len,
+                               "%s{\"rank\":%d,\"user_id\":%d,\"username\":\"%s\",\"rating\":%d,\"wins\":%d,"
+                               "\"losses\":%d,\"draws\":%d}",
+                               n ? "," : "", first + n, x->user_id, x->username, x->rating, x->wins, x->losses,
+                               x->draws);
+        if (written < 0 || (size_t)written >= size - len)
+            return 0;
+        len += (size_t)written;
+    }
+    if (len + 2 > size)
+        return 0;
+    out[len++] = ']';
+    out[len] = '\0';
+    return len;
+}
+
+const char* leaderboard_page_json(int limit, int offset) {
+    if (!lb.ready)
+        return NULL;
+    if (limit > LEADERBOARD_MAX_PAGE)
+        limit = LEADERBOARD_MAX_PAGE;
+
+    for (int i = 0; i < CACHE_PAGES; i++) {
+        lb_page_t* page = &lb.pages[i];
+        if (page->json && page->generation == lb.generation && page->limit == limit && page->offset == offset) {
+            metrics_counter_add(page_hits, 1);
+            return page->json;
+        }
+    }
+    metrics_counter_add(page_misses, 1);
+
+    size_t size = (size_t)limit * ENTRY_JSON_MAX + 4;
+    char* json = malloc(size);
+    if (!json || format_entries(json, size, offset + 1, limit) == 0) {
+        free(json);
+        return NULL;
+    }
+
+    /* Stale pages go first, then the oldest in round-robin order */
+    int slot = -1;
+    for (int i = 0; i < CACHE_PAGES && slot < 0; i++) {
+        if (!lb.pages[i].json || lb.pages[i].generation != lb.generation)
+            slot = i;
+    }
+    if (slot < 0) {
+        slot = lb.next_page;
+        lb.next_page = (lb.next_page + 1) % CACHE_PAGES;
+    }
+
+    lb_page_t* page = &lb.pages[slot];
+    free(page->json);
+    page->json = json;
+    page->limit = limit;
+    page->offset = offset;
+    page->generation = lb.generation;
+    return json;
+}
+
+char* leaderboard_around_json(int user_id, int radius) {
+    int rank = leaderboard_rank(user_id);
+    if (rank == 0)
+        return NULL;
+    if (radius < 0)
+        radius = 0;
+    if (radius > LEADERBOARD_MAX_RADIUS)
+        radius = LEADERBOARD_MAX_RADIUS;
+
+    int first = rank - radius < 1 ? 1 : rank - radius;
+    int limit = rank + radius - first + 1;
+    size_t size = (size_t)limit * ENTRY_JSON_MAX + 64;
+    char* json = malloc(size);
+    if (!json)
+        return NULL;
+
+    int prefix = snprintf(json, size, "{\"rank\":%d,\"total\":%d,\"entries\":", rank, lb.count);
+    size_t len = format_entries(json + prefix, size - (size_t)prefix - 1, first, limit);
+    if (len == 0) {
+        free(json);
+        return NULL;
+    }
+    strcpy(json + prefix + len, "}");
+    return json;
+}
@@ -1,11 +1,14 @@
 #include "../include/lobby.h"
 
+#include <limits.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 #include "../include/db.h"
+#include "../include/log.h"
 
 static lobby_player_t ready_players[MAX_READY_PLAYERS];
 static int ready_count = 0;
@@ -18,7 +21,7 @@ bool lobby_init(void) {
     memset(rooms, 0, sizeof(rooms));
     memset(challenges, 0, sizeof(challenges));
     ready_count = 0;
-    printf("Lobby initialized\n");
+    LOG_INFO("Lobby initialized");
     return true;
 }
 
@@ -26,15 +29,16 @@ void lobby_shutdown(void) {
     ready_count = 0;
 }
 
-void lobby_set_ready(int user_id, const char* username, int rating, bool ready) {
+void lobby_set_ready(int user_id, const char* username, int rating, int rd, bool ready) {
     if (ready) {
 
         for (int i = 0; i < ready_count; i++) {
             if (ready_players[i].user_id == user_id) {
 
                 ready_players[i].rating = rating;
+                ready_players[i].rd = rd;
                 ready_players[i].ready_since = time(NULL);
-                printf("[Lobby] Updated ready player: %s (ID: %d)\n", username, user_id);
+                LOG_DEBUG("[Lobby] Updated ready player: %s (ID: %d)", username, user_id);
                 return;
             }
         }
@@ -43,12 +47,13 @@ void lobby_set_ready(int user_id, const char* username, int rating, bool ready)
             ready_players[ready_count].user_id = user_id;
             strncpy(ready_players[ready_count].username, username, 63);
             ready_players[ready_count].rating = rating;
+            ready_players[ready_count].rd = rd;
             ready_players[ready_count].ready = true;
             ready_players[ready_count].ready_since = time(NULL);
             ready_count++;
-            printf("[Lobby] Added ready player: %s (ID: %d). Ready count=%d\n", username, user_id, ready_count);
+            LOG_DEBUG("[Lobby] Added ready player: %s (ID: %d). Ready count=%d", username, user_id, ready_count);
         } else {
-            printf("[Lobby] Ready list full, cannot add: %s (ID: %d)\n", username, user_id);
+            LOG_INFO("[Lobby] Ready list full, cannot add: %s (ID: %d)", username, user_id);
         }
     } else {
 
@@ -102,14 +107,16 @@ bool lobby_find_random_match(int user_id, int* out_opponent_id) {
     return false;
 }
 
-bool lobby_find_rated_match(int user_id, int rating, int tolerance, int* out_opponent_id) {
+bool lobby_find_rated_match(int user_id, int rating, int rd, int tolerance, int* out_opponent_id) {
     int best_opponent = -1;
-    int best_diff = tolerance + 1;
+    int best_diff = INT_MAX;
 
     for (int i = 0; i < ready_count; i++) {
         if (ready_players[i].user_id != user_id) {
             int diff = abs(ready_players[i].rating - rating);
-            if (diff <= tolerance && diff < best_diff) {
+            int other_rd = ready_players[i].rd;
+            int allowed = tolerance + (int)sqrt((double)rd * rd + (double)other_rd * other_rd);
+            if (diff <= allowed && diff < best_diff) {
                 best_diff = diff;
                 best_opponent = ready_players[i].user_id;
             }
@@ -327,10 +334,10 @@ void lobby_cleanup_rooms_for_user(int user_id) {
             continue;
 
         if (rooms[i].host_user_id == user_id) {
-            printf("[Lobby] Cleaning up room %s (host %d disconnected)\n", rooms[i].room_code, user_id);
+            LOG_INFO("[Lobby] Cleaning up room %s (host %d disconnected)", rooms[i].room_code, user_id);
             memset(&rooms[i], 0, sizeof(room_t));
         } else if (rooms[i].guest_user_id == user_id) {
-            printf("[Lobby] Removing guest %d from room %s\n", user_id, rooms[i].room_code);
+            LOG_INFO("[Lobby] Removing guest %d from room %s", user_id, rooms[i].room_code);
             rooms[i].guest_user_id = 0;
         }
     }
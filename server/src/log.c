@@ -0,0 +1,293 @@
+#include "../include/log.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_WRITE_BUFFER 65536
+#define LOG_IDLE_SLEEP_NS 2000000L
+
+typedef struct {
+    int64_t timestamp_ns;
+    int level;
+    char text[LOG_MESSAGE_MAX];
+} log_record_t;
+
+/* Single producer (the owning thread), single consumer (the writer) */
+typedef struct log_ring {
+    _Atomic uint64_t head;
+    _Atomic uint64_t tail;
+    _Atomic uint64_t dropped;
+    atomic_bool closed;
+    struct log_ring* next;
+    log_record_t slots[LOG_RING_SLOTS];
+} log_ring_t;
+
+_Atomic int log_runtime_level = LOG_LEVEL_INFO;
+static _Atomic int rate_limit = LOG_DEFAULT_RATE_LIMIT;
+
+static log_ring_t* _Atomic rings = NULL;
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local log_ring_t* thread_ring = NULL;
+
+static pthread_t writer_thread;
+static atomic_bool writer_running = false;
+
+static const char* level_names[] = {"DEBUG", "INFO", "WARN", "ERROR", "OFF"};
+
+static void ring_release(void* ring) {
+    atomic_store_explicit(&((log_ring_t*)ring)->closed, true, memory_order_release);
+}
+
+static void ring_key_create(void) {
+    pthread_key_create(&ring_key, ring_release);
+}
+
+static log_ring_t* ring_for_thread(void) {
+    if (thread_ring)
+        return thread_ring;
+
+    log_ring_t* ring = calloc(1, sizeof(log_ring_t));
+    if (!ring)
+        return NULL;
+
+    pthread_once(&ring_key_once, ring_key_create);
+    pthread_setspecific(ring_key, ring);
+
+    pthread_mutex_lock(&rings_lock);
+    ring->next = atomic_load_explicit(&rings, memory_order_relaxed);
+    atomic_store_explicit(&rings, ring, memory_order_release);
+    pthread_mutex_unlock(&rings_lock);
+
+    thread_ring = ring;
+    return ring;
+}
+
+static int64_t realtime_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static size_t format_line(char* out, size_t size, int64_t timestamp_ns, int level, const char* text) {
+    time_t seconds = (time_t)(timestamp_ns / 1000000000LL);
+    struct tm tm;
+    localtime_r(&seconds, &tm);
+
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+
+    int n = snprintf(out, size, "%s.%03d %-5s %s\n", stamp, (int)(timestamp_ns / 1000000LL % 1000),
+                     level_names[level], text);
+    if (n < 0)
+        return 0;
+    return (size_t)n < size ? (size_t)n : size - 1;
+}
+
+static void write_all(const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(STDERR_FILENO, data, len);
+        if (n <= 0)
+            return;
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+/* Drains every ring once; returns the number of records written */
+static size_t drain_rings(char* buffer) {
+    size_t used = 0;
+    size_t written = 0;
+
+    for (log_ring_t* ring = atomic_load_explicit(&rings, memory_order_acquire); ring; ring = ring->next) {
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+        uint64_t dropped = atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+        if (dropped > 0) {
+            char text[LOG_MESSAGE_MAX];
+            snprintf(text, sizeof(text), "[Log] Ring full, dropped %llu messages", (unsigned long long)dropped);
+            used += format_line(buffer + used, LOG_WRITE_BUFFER - used, realtime_ns(), LOG_LEVEL_WARN, text);
+        }
+
+        for (; head != tail; head++) {
+            if (LOG_WRITE_BUFFER - used < LOG_MESSAGE_MAX + 64) {
+                write_all(buffer, used);
+                used = 0;
+            }
+            const log_record_t* record = &ring->slots[head & (LOG_RING_SLOTS - 1)];
+            used += format_line(buffer + used, LOG_WRITE_BUFFER - used, record->timestamp_ns, record->level,
+                                record->text);
+            written++;
+        }
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+    }
+
+    if (used > 0)
+        write_all(buffer, used);
+    return written;
+}
+
+/* Frees rings whose threads have exited and whose records are all written */
+static void reap_closed_rings(void) {
+    pthread_mutex_lock(&rings_lock);
+    log_ring_t* prev = NULL;
+    log_ring_t* ring = atomic_load_explicit(&rings, memory_order_relaxed);
+    while (ring) {
+        log_ring_t* next = ring->next;
+        bool drained = atomic_load(&ring->head) == atomic_load(&ring->tail);
+        if (atomic_load_explicit(&ring->closed, memory_order_acquire) && drained) {
+            if (prev)
+                prev->next = next;
+            else
+                atomic_store_explicit(&rings, next, memory_order_release);
+            free(ring);
+        } else {
+            prev = ring;
+        }
+        ring = next;
+    }
+    pthread_mutex_unlock(&rings_lock);
+}
+
+static void* writer_loop(void* arg) {
+    (void)arg;
+    char* buffer = malloc(LOG_WRITE_BUFFER);
+    if (!buffer)
+        return NULL;
+
+    while (atomic_load_explicit(&writer_running, memory_order_acquire)) {
+        if (drain_rings(buffer) == 0) {
+            reap_closed_rings();
+            struct timespec idle = {0, LOG_IDLE_SLEEP_NS};
+            nanosleep(&idle, NULL);
+        }
+    }
+
+    /* Producers fall back to synchronous writes now; flush what they queued before */
+    drain_rings(buffer);
+    free(buffer);
+    return NULL;
+}
+
+bool log_init(void) {
+    if (atomic_load(&writer_running))
+        return true;
+
+    atomic_store(&writer_running, true);
+    if (pthread_create(&writer_thread, NULL, writer_loop, NULL) != 0) {
+        atomic_store(&writer_running, false);
+        return false;
+    }
+    return true;
+}
+
+void log_shutdown(void) {
+    if (!atomic_exchange(&writer_running, false))
+        return;
+    pthread_join(writer_thread, NULL);
+}
+
+void log_set_level(int level) {
+    if (level >= LOG_LEVEL_DEBUG && level <= LOG_LEVEL_OFF)
+        atomic_store(&log_runtime_level, level);
+}
+
+int log_get_level(void) {
+    return atomic_load(&log_runtime_level);
+}
+
+int log_level_from_name(const char* name) {
+    if (!name)
+        return -1;
+    for (int i = LOG_LEVEL_DEBUG; i <= LOG_LEVEL_OFF; i++) {
+        if (strcasecmp(name, level_names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+const char* log_level_name(int level) {
+    if (level < LOG_LEVEL_DEBUG || level > LOG_LEVEL_OFF)
+        return "UNKNOWN";
+    return level_names[level];
+}
+
+void log_set_rate_limit(int per_second) {
+    atomic_store(&rate_limit, per_second < 0 ? 0 : per_second);
+}
+
+int log_get_rate_limit(void) {
+    return atomic_load(&rate_limit);
+}
+
+bool log_site_allow(log_site_t* site, uint32_t* out_suppressed) {
+    *out_suppressed = 0;
+
+    int limit = atomic_load_explicit(&rate_limit, memory_order_relaxed);
+    if (limit <= 0)
+        return true;
+
+    int64_t now = (int64_t)time(NULL);
+    int64_t window = atomic_load_explicit(&site->window, memory_order_relaxed);
+    if (window != now && atomic_compare_exchange_strong(&site->window, &window, now)) {
+        atomic_store_explicit(&site->count, 0, memory_order_relaxed);
+    }
+
+    if (atomic_fetch_add_explicit(&site->count, 1, memory_order_relaxed) < (uint32_t)limit) {
+        *out_suppressed = atomic_exchange_explicit(&site->suppressed, 0, memory_order_relaxed);
+        return true;
+    }
+
+    atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+    return false;
+}
+
+static void format_text(char* text, uint32_t suppressed, const char* fmt, va_list args) {
+    int n = vsnprintf(text, LOG_MESSAGE_MAX, fmt, args);
+    if (n >= LOG_MESSAGE_MAX)
+        memcpy(text + LOG_MESSAGE_MAX - 4, "...", 4);
+
+    if (suppressed > 0) {
+        size_t len = strlen(text);
+        snprintf(text + len, LOG_MESSAGE_MAX - len, " (+%u suppressed)", suppressed);
+    }
+}
+
+void log_write(int level, uint32_t suppressed, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+
+    log_ring_t* ring = atomic_load_explicit(&writer_running, memory_order_acquire) ? ring_for_thread() : NULL;
+    if (!ring) {
+        char text[LOG_MESSAGE_MAX];
+        char line[LOG_MESSAGE_MAX + 64];
+        format_text(text, suppressed, fmt, args);
+        write_all(line, format_line(line, sizeof(line), realtime_ns(), level, text));
+        va_end(args);
+        return;
+    }
+
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail - head >= LOG_RING_SLOTS) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        va_end(args);
+        return;
+    }
+
+    log_record_t* record = &ring->slots[tail & (LOG_RING_SLOTS - 1)];
+    record->timestamp_ns = realtime_ns();
+    record->level = level;
+    format_text(record->text, suppressed, fmt, args);
+    va_end(args);
+
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
@@ -1,53 +1,365 @@
 #include "../include/match.h"
 
 #include "../include/db.h"
+#include "../include/log.h"
+#include "../include/server.h"
+#include "../include/tablebase.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
-static match_t matches[MAX_MATCHES];
-static int match_count = 0;
+/* Live and recently finished matches. Each match_t is allocated on its own so
+ * pointers handed out by match_get stay valid until the match is reaped. */
+static match_t** match_list = NULL;
+static int match_list_count = 0;
+static int match_list_capacity = 0;
 
-static timeout_info_t pending_timeouts[MAX_MATCHES];
+/* Reaped match_t structs kept for reuse, together with their move buffers */
+static match_t** free_matches = NULL;
+static int free_match_count = 0;
+static int free_match_capacity = 0;
+
+static unsigned long next_match_seq = 0;
+
+static timeout_info_t pending_timeouts[MAX_PENDING_TIMEOUTS];
 static int pending_timeout_count = 0;
 
+/* Open-addressing index: match_id -> match_t* */
+#define INDEX_TOMBSTONE ((match_t*)-1)
+
+static match_t** id_index = NULL;
+static size_t id_index_capacity = 0;
+static size_t id_index_used = 0;
+
+/* Open-addressing index: user_id -> active match_t* */
+typedef struct {
+    int user_id;
+    match_t* match;
+} user_index_entry_t;
+
+static user_index_entry_t* user_index = NULL;
+static size_t user_index_capacity = 0;
+static size_t user_index_used = 0;
+
+static uint32_t hash_string(const char* str) {
+    uint32_t h = 2166136261u;
+    while (*str) {
+        h ^= (unsigned char)*str++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static uint32_t hash_int(int value) {
+    uint32_t h = (uint32_t)value;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+static bool id_index_insert(match_t* match);
+
+static bool id_index_resize(size_t new_capacity) {
+    match_t** old = id_index;
+    size_t old_capacity = id_index_capacity;
+
+    id_index = calloc(new_capacity, sizeof(match_t*));
+    if (!id_index) {
+        id_index = old;
+        return false;
+    }
+    id_index_capacity = new_capacity;
+    id_index_used = 0;
+
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i] && old[i] != INDEX_TOMBSTONE) {
+            id_index_insert(old[i]);
+        }
+    }
+    free(old);
+    return true;
+}
+
+static bool id_index_insert(match_t* match) {
+    if ((id_index_used + 1) * 10 >= id_index_capacity * 7) {
+        if (!id_index_resize(id_index_capacity ? id_index_capacity * 2 : MATCH_INITIAL_CAPACITY * 2))
+            return false;
+    }
+
+    size_t mask = id_index_capacity - 1;
+    size_t i = hash_string(match->match_id) & mask;
+    while (id_index[i] && id_index[i] != INDEX_TOMBSTONE) {
+        i = (i + 1) & mask;
+    }
+    if (!id_index[i])
+        id_index_used++;
+    id_index[i] = match;
+    return true;
+}
+
+static size_t id_index_find_slot(const char* match_id) {
+    if (!id_index_capacity)
+        return SIZE_MAX;
+
+    size_t mask = id_index_capacity - 1;
+    size_t i = hash_string(match_id) & mask;
+    while (id_index[i]) {
+        if (id_index[i] != INDEX_TOMBSTONE && strcmp(id_index[i]->match_id, match_id) == 0) {
+            return i;
+        }
+        i = (i + 1) & mask;
+    }
+    return SIZE_MAX;
+}
+
+static void id_index_remove(const char* match_id) {
+    size_t i = id_index_find_slot(match_id);
+    if (i != SIZE_MAX) {
+        id_index[i] = INDEX_TOMBSTONE;
+    }
+}
+
+static bool user_index_put(int user_id, match_t* match);
+
+static bool user_index_resize(size_t new_capacity) {
+    user_index_entry_t* old = user_index;
+    size_t old_capacity = user_index_capacity;
+
+    user_index = calloc(new_capacity, sizeof(user_index_entry_t));
+    if (!user_index) {
+        user_index = old;
+        return false;
+    }
+    user_index_capacity = new_capacity;
+    user_index_used = 0;
+
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i].match && old[i].match != INDEX_TOMBSTONE) {
+            user_index_put(old[i].user_id, old[i].match);
+        }
+    }
+    free(old);
+    return true;
+}
+
+static bool user_index_put(int user_id, match_t* match) {
+    if (user_id <= 0)
+        return false;
+
+    if ((user_index_used + 1) * 10 >= user_index_capacity * 7) {
+        if (!user_index_resize(user_index_capacity ? user_index_capacity * 2 : MATCH_INITIAL_CAPACITY * 4))
+            return false;
+    }
+
+    size_t mask = user_index_capacity - 1;
+    size_t i = hash_int(user_id) & mask;
+    size_t insert_at = SIZE_MAX;
+    while (user_index[i].match) {
+        if (user_index[i].match == INDEX_TOMBSTONE) {
+            if (insert_at == SIZE_MAX)
+                insert_at = i;
+        } else if (user_index[i].user_id == user_id) {
+            user_index[i].match = match;
+            return true;
+        }
+        i = (i + 1) & mask;
+    }
+
+    if (insert_at == SIZE_MAX) {
+        insert_at = i;
+        user_index_used++;
+    }
+    user_index[insert_at].user_id = user_id;
+    user_index[insert_at].match = match;
+    return true;
+}
+
+static match_t* user_index_get(int user_id) {
+    if (!user_index_capacity || user_id <= 0)
+        return NULL;
+
+    size_t mask = user_index_capacity - 1;
+    size_t i = hash_int(user_id) & mask;
+    while (user_index[i].match) {
+        if (user_index[i].match != INDEX_TOMBSTONE && user_index[i].user_id == user_id) {
+            return user_index[i].match;
+        }
+        i = (i + 1) & mask;
+    }
+    return NULL;
+}
+
+static void user_index_remove(int user_id, const match_t* match) {
+    if (!user_index_capacity || user_id <= 0)
+        return;
+
+    size_t mask = user_index_capacity - 1;
+    size_t i = hash_int(user_id) & mask;
+    while (user_index[i].match) {
+        if (user_index[i].match != INDEX_TOMBSTONE && user_index[i].user_id == user_id) {
+            if (user_index[i].match == match)
+                user_index[i].match = INDEX_TOMBSTONE;
+            return;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+/* Drops the players from the user index once a match stops being active */
+static void match_release_players(match_t* match) {
+    user_index_remove(match->red_user_id, match);
+    user_index_remove(match->black_user_id, match);
+    match->ended_at = time(NULL);
+}
+
+static bool match_reserve_moves(match_t* match, int needed) {
+    if (needed <= match->move_capacity)
+        return true;
+
+    int new_capacity = match->move_capacity ? match->move_capacity : MATCH_INITIAL_MOVES;
+    while (new_capacity < needed)
+        new_capacity *= 2;
+
+    move_t* moves = realloc(match->moves, (size_t)new_capacity * sizeof(move_t));
+    if (!moves)
+        return false;
+
+    match->moves = moves;
+    match->move_capacity = new_capacity;
+    return true;
+}
+
+static match_t* match_alloc(const char* match_id) {
+    if (match_list_count >= match_list_capacity) {
+        int new_capacity = match_list_capacity ? match_list_capacity * 2 : MATCH_INITIAL_CAPACITY;
+        match_t** list = realloc(match_list, (size_t)new_capacity * sizeof(match_t*));
+        if (!list)
+            return NULL;
+        match_list = list;
+        match_list_capacity = new_capacity;
+    }
+
+    match_t* match;
+    if (free_match_count > 0) {
+        match = free_matches[--free_match_count];
+        move_t* moves = match->moves;
+        int move_capacity = match->move_capacity;
+        struct client** spectators = match->spectators;
+        int spectator_capacity = match->spectator_capacity;
+        memset(match, 0, sizeof(match_t));
+        match->moves = moves;
+        match->move_capacity = move_capacity;
+        match->spectators = spectators;
+        match->spectator_capacity = spectator_capacity;
+    } else {
+        match = calloc(1, sizeof(match_t));
+        if (!match)
+            return NULL;
+    }
+
+    snprintf(match->match_id, sizeof(match->match_id), "%s", match_id);
+    if (!id_index_insert(match)) {
+        free(match->moves);
+        free(match->spectators);
+        free(match);
+        return NULL;
+    }
+
+    match->slot_index = match_list_count;
+    match_list[match_list_count++] = match;
+    return match;
+}
+
+static void match_release(match_t* match) {
+    id_index_remove(match->match_id);
+    if (match->active)
+        match_release_players(match);
+
+    for (int i = 0; i < match->spectator_count; i++) {
+        match->spectators[i]->spectate_match_id[0] = '\0';
+    }
+    match->spectator_count = 0;
+
+    int slot = match->slot_index;
+    match_list[slot] = match_list[--match_list_count];
+    match_list[slot]->slot_index = slot;
+
+    if (free_match_count >= free_match_capacity) {
+        int new_capacity = free_match_capacity ? free_match_capacity * 2 : MATCH_INITIAL_CAPACITY;
+        match_t** list = realloc(free_matches, (size_t)new_capacity * sizeof(match_t*));
+        if (!list) {
+            free(match->moves);
+            free(match->spectators);
+            free(match);
+            return;
+        }
+        free_matches = list;
+        free_match_capacity = new_capacity;
+    }
+
+    match->match_id[0] = '\0';
+    match->active = false;
+    free_matches[free_match_count++] = match;
+}
+
 bool match_init(void) {
-    memset(matches, 0, sizeof(matches));
     memset(pending_timeouts, 0, sizeof(pending_timeouts));
-    match_count = 0;
     pending_timeout_count = 0;
-    printf("Match manager initialized\n");
+
+    if (!id_index_resize(MATCH_INITIAL_CAPACITY * 2) || !user_index_resize(MATCH_INITIAL_CAPACITY * 4)) {
+        return false;
+    }
+
+    LOG_INFO("Match manager initialized");
     return true;
 }
 
 void match_shutdown(void) {
-    match_count = 0;
+    for (int i = 0; i < match_list_count; i++) {
+        free(match_list[i]->moves);
+        free(match_list[i]->spectators);
+        free(match_list[i]);
+    }
+    for (int i = 0; i < free_match_count; i++) {
+        free(free_matches[i]->moves);
+        free(free_matches[i]->spectators);
+        free(free_matches[i]);
+    }
+
+    free(match_list);
+    free(free_matches);
+    free(id_index);
+    free(user_index);
+
+    match_list = NULL;
+    free_matches = NULL;
+    id_index = NULL;
+    user_index = NULL;
+    match_list_count = match_list_capacity = 0;
+    free_match_count = free_match_capacity = 0;
+    id_index_capacity = id_index_used = 0;
+    user_index_capacity = user_index_used = 0;
     pending_timeout_count = 0;
 }
 
 char* match_create(int red_user_id, int black_user_id, bool rated, int time_ms) {
-    if (match_count >= MAX_MATCHES) {
-        return NULL;
-    }
-
-    match_t* match = NULL;
-    for (int i = 0; i < MAX_MATCHES; i++) {
-        if (!matches[i].active && matches[i].match_id[0] == '\0') {
-            match = &matches[i];
-            match_count++;
-            break;
-        }
-    }
+    char match_id[32];
+    snprintf(match_id, sizeof(match_id), "match_%lu_%ld", ++next_match_seq, (long)time(NULL));
 
+    match_t* match = match_alloc(match_id);
     if (!match)
         return NULL;
 
-    sprintf(match->match_id, "match_%d_%ld", match_count, time(NULL));
     match->red_user_id = red_user_id;
     match->black_user_id = black_user_id;
     strcpy(match->current_turn, "red");
     match->move_count = 0;
+    board_init(&match->board);
     match->rated = rated;
     match->red_time_ms = time_ms;
     match->black_time_ms = time_ms;
@@ -56,16 +368,45 @@ char* match_create(int red_user_id, int black_user_id, bool rated, int time_ms)
     match->active = true;
     strcpy(match->result, "ongoing");
 
+    user_index_put(red_user_id, match);
+    user_index_put(black_user_id, match);
+
     return strdup(match->match_id);
 }
 
 match_t* match_get(const char* match_id) {
-    for (int i = 0; i < MAX_MATCHES; i++) {
-        if (strcmp(matches[i].match_id, match_id) == 0) {
-            return &matches[i];
+    if (!match_id)
+        return NULL;
+
+    size_t i = id_index_find_slot(match_id);
+    return (i == SIZE_MAX) ? NULL : id_index[i];
+}
+
+int match_get_active_count(void) {
+    int count = 0;
+    for (int i = 0; i < match_list_count; i++) {
+        if (match_list[i]->active)
+            count++;
+    }
+    return count;
+}
+
+int match_reap_finished(void) {
+    time_t now = time(NULL);
+    int reaped = 0;
+
+    for (int i = match_list_count - 1; i >= 0; i--) {
+        match_t* match = match_list[i];
+        if (!match->active && now - match->ended_at >= MATCH_RETAIN_SECONDS) {
+            match_release(match);
+            reaped++;
         }
     }
-    return NULL;
+
+    if (reaped > 0) {
+        LOG_INFO("[Match] Reaped %d finished matches (%d in memory)", reaped, match_list_count);
+    }
+    return reaped;
 }
 
 bool is_valid_position(int row, int col) {
@@ -106,7 +447,13 @@ bool match_add_move(const char* match_id, const move_t* move) {
     if (match->move_count >= MAX_MOVES_PER_MATCH)
         return false;
 
-    match->moves[match->move_count++] = *move;
+    if (!match_reserve_moves(match, match->move_count + 1))
+        return false;
+
+    move_t* stored = &match->moves[match->move_count++];
+    *stored = *move;
+    stored->piece = match->board.squares[move->from];
+    stored->capture = board_apply(&match->board, move->from, move->to);
     match->last_move_at = time(NULL);
 
     if (strcmp(match->current_turn, "red") == 0) {
@@ -126,6 +473,9 @@ bool match_end(const char* match_id, const char* result, const char* reason) {
     if (!match)
         return false;
 
+    if (match->active)
+        match_release_players(match);
+
     match->active = false;
     strncpy(match->result, result, 15);
     strncpy(match->end_reason, reason, 31);
@@ -138,7 +488,7 @@ char* match_get_json(const char* match_id) {
     if (!match)
         return NULL;
 
-    char* json = malloc(65536);
+    char* json = malloc((size_t)match->move_count * 72 + 512);
     if (!json)
         return NULL;
 
@@ -158,8 +508,8 @@ char* match_get_json(const char* match_id) {
         ptr += sprintf(ptr,
                        "{\"move_id\":%d,\"from\":{\"row\":%d,\"col\":%d},"
                        "\"to\":{\"row\":%d,\"col\":%d}}",
-                       match->moves[i].move_id, match->moves[i].from_row, match->moves[i].from_col,
-                       match->moves[i].to_row, match->moves[i].to_col);
+                       i, MOVE_FROM_ROW(&match->moves[i]), MOVE_FROM_COL(&match->moves[i]),
+                       MOVE_TO_ROW(&match->moves[i]), MOVE_TO_COL(&match->moves[i]));
     }
 
     sprintf(ptr, "]}");
@@ -172,20 +522,44 @@ match_t* match_find_by_id(const char* match_id) {
 }
 
 match_t* match_find_by_user(int user_id) {
-    for (int i = 0; i < MAX_MATCHES; i++) {
-        if (matches[i].active && (matches[i].red_user_id == user_id || matches[i].black_user_id == user_id)) {
-            return &matches[i];
-        }
-    }
-    return NULL;
+    match_t* match = user_index_get(user_id);
+    return (match && match->active) ? match : NULL;
 }
 
-bool match_is_checkmate(match_t* match) {
-    (void)match;
+/* No legal move for the side to move; stalemate loses in xiangqi just like checkmate */
+bool match_is_checkmate(const match_t* match) {
+    board_move_t moves[BOARD_MAX_MOVES];
+    return board_generate_moves(&match->board, match->move_count % 2 == 1, moves) == 0;
+}
 
+bool match_is_legal_move(const match_t* match, int from, int to) {
+    board_move_t moves[BOARD_MAX_MOVES];
+    int count = board_generate_moves(&match->board, match->move_count % 2 == 1, moves);
+    for (int i = 0; i < count; i++) {
+        if (moves[i].from == from && moves[i].to == to)
+            return true;
+    }
     return false;
 }
 
+bool match_adjudicate(const match_t* match, const char** result, const char** reason) {
+    bool black = match->move_count % 2 == 1;
+    if (match_is_checkmate(match)) {
+        *result = black ? "red_win" : "black_win";
+        *reason = "checkmate";
+        return true;
+    }
+
+    /* A tablebase draw may still be a win under the long-check and long-chase rules the generator does not model */
+    tb_result_t tb;
+    if (!tb_probe(&match->board, black, &tb) || tb.wdl == 0)
+        return false;
+    *result = (tb.wdl > 0) != black ? "red_win" : "black_win";
+    *reason = "tablebase";
+    LOG_INFO("[Match] %s adjudicated by tablebase: %s (mate in %d plies)", match->match_id, *result, tb.dtm);
+    return true;
+}
+
 int match_get_opponent_id(const match_t* match, int user_id) {
     if (match->red_user_id == user_id) {
         return match->black_user_id;
@@ -198,7 +572,7 @@ char* match_get_moves_json(const match_t* match) {
     if (!match)
         return NULL;
 
-    char* json = malloc(32768);
+    char* json = malloc((size_t)match->move_count * 56 + 16);
     if (!json)
         return NULL;
 
@@ -206,70 +580,163 @@ char* match_get_moves_json(const match_t* match) {
     ptr += sprintf(ptr, "[");
 
     for (int i = 0; i < match->move_count; i++) {
+        const move_t* m = &match->moves[i];
         if (i > 0)
             ptr += sprintf(ptr, ",");
-        ptr +=
-            sprintf(ptr,
-                    "{\"from\":{\"row\":%d,\"col\":%d},"
-                    "\"to\":{\"row\":%d,\"col\":%d}}",
-                    match->moves[i].from_row, match->moves[i].from_col, match->moves[i].to_row, match->moves[i].to_col);
+        ptr += sprintf(ptr,
+                       "{\"from\":{\"row\":%d,\"col\":%d},"
+                       "\"to\":{\"row\":%d,\"col\":%d}}",
+                       MOVE_FROM_ROW(m), MOVE_FROM_COL(m), MOVE_TO_ROW(m), MOVE_TO_COL(m));
     }
 
     sprintf(ptr, "]");
     return json;
 }
 
-bool match_add_spectator(const char* match_id, int user_id) {
-    match_t* match = match_get(match_id);
-    if (!match || !match->active)
-        return false;
+/* Same as match_get_moves_json plus notation, replaying the board once */
+char* match_get_annotated_moves_json(const match_t* match) {
+    if (!match)
+        return NULL;
 
-    for (int i = 0; i < match->spectator_count; i++) {
-        if (match->spectator_ids[i] == user_id) {
-            return true;
-        }
+    char* json = malloc((size_t)match->move_count * 96 + 16);
+    if (!json)
+        return NULL;
+
+    board_t board;
+    board_init(&board);
+
+    char* ptr = json;
+    ptr += sprintf(ptr, "[");
+
+    for (int i = 0; i < match->move_count; i++) {
+        const move_t* m = &match->moves[i];
+        char notation[16];
+        if (!board_format_notation(&board, m->from, m->to, notation, sizeof(notation)))
+            notation[0] = '\0';
+        board_apply(&board, m->from, m->to);
+
+        if (i > 0)
+            ptr += sprintf(ptr, ",");
+        ptr += sprintf(ptr,
+                       "{\"from\":{\"row\":%d,\"col\":%d},"
+                       "\"to\":{\"row\":%d,\"col\":%d},\"notation\":\"%s\",\"ms\":%u}",
+                       MOVE_FROM_ROW(m), MOVE_FROM_COL(m), MOVE_TO_ROW(m), MOVE_TO_COL(m), notation,
+                       (unsigned)m->clock_delta_ms);
+    }
+
+    sprintf(ptr, "]");
+    return json;
+}
+
+/*
+ * Keyframe for spectators: the live board position, clocks and the last few moves, each tagged with the
+ * seq it produced. opponent_move carries the same seq, so a spectator that sees a gap re-requests this.
+ */
+char* match_get_keyframe_json(const match_t* match, int recent_moves) {
+    if (!match)
+        return NULL;
+
+    if (recent_moves < 0)
+        recent_moves = 0;
+    if (recent_moves > match->move_count)
+        recent_moves = match->move_count;
+
+    char* json = malloc((size_t)recent_moves * 80 + BOARD_SQUARES + 512);
+    if (!json)
+        return NULL;
+
+    char position[BOARD_SQUARES + 1];
+    board_format_position(&match->board, position);
+
+    char* ptr = json;
+    ptr += sprintf(ptr,
+                   "{\"match_id\":\"%s\",\"seq\":%d,\"position\":\"%s\",\"current_turn\":\"%s\","
+                   "\"red_user_id\":%d,\"black_user_id\":%d,\"red_time_ms\":%d,\"black_time_ms\":%d,"
+                   "\"active\":%s,\"moves\":[",
+                   match->match_id, match->move_count, position, (match->move_count % 2 == 0) ? "red" : "black",
+                   match->red_user_id, match->black_user_id, match->red_time_ms, match->black_time_ms,
+                   match->active ? "true" : "false");
+
+    for (int i = match->move_count - recent_moves; i < match->move_count; i++) {
+        const move_t* m = &match->moves[i];
+        if (i > match->move_count - recent_moves)
+            ptr += sprintf(ptr, ",");
+        ptr += sprintf(ptr, "{\"seq\":%d,\"from\":{\"row\":%d,\"col\":%d},\"to\":{\"row\":%d,\"col\":%d}}", i + 1,
+                       MOVE_FROM_ROW(m), MOVE_FROM_COL(m), MOVE_TO_ROW(m), MOVE_TO_COL(m));
     }
 
-    if (match->spectator_count >= MAX_SPECTATORS_PER_MATCH) {
+    sprintf(ptr, "]}");
+    return json;
+}
+
+bool match_get_move_notation(const match_t* match, int index, char* out, size_t out_size) {
+    if (!match || index < 0 || index >= match->move_count)
         return false;
+
+    board_t board;
+    board_init(&board);
+    for (int i = 0; i < index; i++) {
+        board_apply(&board, match->moves[i].from, match->moves[i].to);
     }
 
-    match->spectator_ids[match->spectator_count++] = user_id;
-    return true;
+    return board_format_notation(&board, match->moves[index].from, match->moves[index].to, out, out_size);
 }
 
-bool match_remove_spectator(const char* match_id, int user_id) {
+bool match_add_spectator(const char* match_id, struct client* client) {
     match_t* match = match_get(match_id);
-    if (!match)
+    if (!match || !match->active || !client)
         return false;
 
-    for (int i = 0; i < match->spectator_count; i++) {
-        if (match->spectator_ids[i] == user_id) {
+    if (match_is_spectator(match, client))
+        return true;
 
-            for (int j = i; j < match->spectator_count - 1; j++) {
-                match->spectator_ids[j] = match->spectator_ids[j + 1];
-            }
-            match->spectator_count--;
-            return true;
-        }
+    if (client->spectate_match_id[0] != '\0') {
+        match_remove_spectator(client->spectate_match_id, client);
     }
-    return false;
+
+    if (match->spectator_count >= match->spectator_capacity) {
+        int new_capacity = match->spectator_capacity ? match->spectator_capacity * 2 : MATCH_INITIAL_SPECTATORS;
+        struct client** list = realloc(match->spectators, (size_t)new_capacity * sizeof(struct client*));
+        if (!list)
+            return false;
+        match->spectators = list;
+        match->spectator_capacity = new_capacity;
+    }
+
+    match->spectators[match->spectator_count++] = client;
+    snprintf(client->spectate_match_id, sizeof(client->spectate_match_id), "%s", match->match_id);
+    return true;
 }
 
-bool match_is_spectator(const match_t* match, int user_id) {
-    if (!match)
+bool match_remove_spectator(const char* match_id, struct client* client) {
+    match_t* match = match_get(match_id);
+    if (!match || !client)
         return false;
 
     for (int i = 0; i < match->spectator_count; i++) {
-        if (match->spectator_ids[i] == user_id) {
+        if (match->spectators[i] == client) {
+            match->spectators[i] = match->spectators[--match->spectator_count];
+            client->spectate_match_id[0] = '\0';
             return true;
         }
     }
     return false;
 }
 
+bool match_is_spectator(const match_t* match, const struct client* client) {
+    if (!match || !client)
+        return false;
+
+    return strcmp(client->spectate_match_id, match->match_id) == 0;
+}
+
+int match_get_spectator_count(const char* match_id) {
+    match_t* match = match_get(match_id);
+    return match ? match->spectator_count : 0;
+}
+
 char* match_get_live_matches_json(void) {
-    char* json = malloc(65536);
+    char* json = malloc((size_t)match_list_count * 256 + 16);
     if (!json)
         return NULL;
 
@@ -277,8 +744,9 @@ char* match_get_live_matches_json(void) {
     ptr += sprintf(ptr, "[");
 
     int first = 1;
-    for (int i = 0; i < MAX_MATCHES; i++) {
-        if (matches[i].active) {
+    for (int i = 0; i < match_list_count; i++) {
+        const match_t* m = match_list[i];
+        if (m->active) {
             if (!first)
                 ptr += sprintf(ptr, ",");
             first = 0;
@@ -291,8 +759,8 @@ char* match_get_live_matches_json(void) {
                            "\"spectator_count\":%d,"
                            "\"current_turn\":\"%s\","
                            "\"started_at\":%ld}",
-                           matches[i].match_id, matches[i].red_user_id, matches[i].black_user_id, matches[i].move_count,
-                           matches[i].spectator_count, matches[i].current_turn, (long)matches[i].started_at);
+                           m->match_id, m->red_user_id, m->black_user_id, m->move_count, m->spectator_count,
+                           m->current_turn, (long)m->started_at);
         }
     }
 
@@ -378,20 +846,21 @@ char* match_get_timer_json(const char* match_id) {
 void match_check_all_timeouts(void) {
     time_t now = time(NULL);
 
-    for (int i = 0; i < MAX_MATCHES; i++) {
-        if (matches[i].active) {
-            int elapsed_ms = (int)((now - matches[i].last_move_at) * 1000);
+    for (int i = 0; i < match_list_count; i++) {
+        match_t* m = match_list[i];
+        if (m->active) {
+            int elapsed_ms = (int)((now - m->last_move_at) * 1000);
 
             bool timeout = false;
             const char* winner;
 
-            if (strcmp(matches[i].current_turn, "red") == 0) {
-                if (matches[i].red_time_ms - elapsed_ms <= 0) {
+            if (strcmp(m->current_turn, "red") == 0) {
+                if (m->red_time_ms - elapsed_ms <= 0) {
                     timeout = true;
                     winner = "black_win";
                 }
             } else {
-                if (matches[i].black_time_ms - elapsed_ms <= 0) {
+                if (m->black_time_ms - elapsed_ms <= 0) {
                     timeout = true;
                     winner = "red_win";
                 }
@@ -399,19 +868,20 @@ void match_check_all_timeouts(void) {
 
             if (timeout) {
 
-                matches[i].active = false;
-                strncpy(matches[i].result, winner, sizeof(matches[i].result) - 1);
-                strncpy(matches[i].end_reason, "timeout", sizeof(matches[i].end_reason) - 1);
+                match_release_players(m);
+                m->active = false;
+                strncpy(m->result, winner, sizeof(m->result) - 1);
+                strncpy(m->end_reason, "timeout", sizeof(m->end_reason) - 1);
 
-                if (pending_timeout_count < MAX_MATCHES) {
+                if (pending_timeout_count < MAX_PENDING_TIMEOUTS) {
                     timeout_info_t* ti = &pending_timeouts[pending_timeout_count++];
-                    snprintf(ti->match_id, sizeof(ti->match_id), "%s", matches[i].match_id);
+                    snprintf(ti->match_id, sizeof(ti->match_id), "%s", m->match_id);
                     snprintf(ti->result, sizeof(ti->result), "%s", winner);
-                    ti->red_user_id = matches[i].red_user_id;
-                    ti->black_user_id = matches[i].black_user_id;
+                    ti->red_user_id = m->red_user_id;
+                    ti->black_user_id = m->black_user_id;
                 }
 
-                printf("[Match] Timeout detected: %s -> %s\n", matches[i].match_id, winner);
+                LOG_INFO("[Match] Timeout detected: %s -> %s", m->match_id, winner);
             }
         }
     }
@@ -447,42 +917,68 @@ bool match_persist(const char* match_id) {
     free(moves_json);
 
     if (result) {
-        printf("[Match] Persisted match %s to database\n", match_id);
+        LOG_INFO("[Match] Persisted match %s to database", match_id);
     } else {
-        printf("[Match] Failed to persist match %s\n", match_id);
+        LOG_WARN("[Match] Failed to persist match %s", match_id);
     }
 
     return result;
 }
 
 bool match_restore_all(void) {
-    printf("[Match] Checking for active matches in database...\n");
+    LOG_INFO("[Match] Checking for active matches in database...");
 
     int count = db_load_all_active_matches(NULL, 0);
     if (count == 0) {
-        printf("[Match] No active matches to restore\n");
+        LOG_INFO("[Match] No active matches to restore");
         return true;
     }
 
-    printf("[Match] Found %d active matches - restoration requires client "
-           "reconnect\n",
-           count);
+    LOG_INFO("[Match] Found %d active matches - restoration requires client reconnect", count);
 
     return true;
 }
 
+static int match_parse_moves_json(match_t* match, const char* moves_json) {
+    int count = 0;
+    const char* p = moves_json;
+
+    while ((p = strstr(p, "{\"from\":")) != NULL) {
+        int from_row, from_col, to_row, to_col;
+        if (sscanf(p, "{\"from\":{\"row\":%d,\"col\":%d},\"to\":{\"row\":%d,\"col\":%d}}", &from_row, &from_col,
+                   &to_row, &to_col) != 4)
+            break;
+        if (count >= MAX_MOVES_PER_MATCH || !match_reserve_moves(match, count + 1))
+            break;
+
+        if (!is_valid_position(from_row, from_col) || !is_valid_position(to_row, to_col))
+            break;
+
+        move_t* move = &match->moves[count];
+        memset(move, 0, sizeof(move_t));
+        move->from = SQUARE(from_row, from_col);
+        move->to = SQUARE(to_row, to_col);
+        move->piece = match->board.squares[move->from];
+        move->capture = board_apply(&match->board, move->from, move->to);
+        count++;
+        p++;
+    }
+
+    return count;
+}
+
 match_t* match_load_from_db(const char* match_id) {
     if (!match_id)
         return NULL;
 
     match_t* existing = match_get(match_id);
     if (existing && existing->active) {
-        printf("[Match] Match %s already in memory\n", match_id);
+        LOG_INFO("[Match] Match %s already in memory", match_id);
         return existing;
     }
 
     int red_user_id, black_user_id, red_time_ms, black_time_ms, move_count;
-    char current_turn[6] = {0};
+    char current_turn[DB_TURN_SIZE] = {0};
     char moves_json[60000] = {0};
     bool rated;
     time_t started_at, last_move_at;
@@ -492,32 +988,30 @@ match_t* match_load_from_db(const char* match_id) {
                             &move_count, moves_json, sizeof(moves_json), &rated, &started_at, &last_move_at);
 
     if (!loaded) {
-        printf("[Match] Match %s not found in database\n", match_id);
+        LOG_INFO("[Match] Match %s not found in database", match_id);
         return NULL;
     }
 
-    match_t* match = NULL;
-    for (int i = 0; i < MAX_MATCHES; i++) {
-        if (!matches[i].active && matches[i].match_id[0] == '\0') {
-            match = &matches[i];
-            match_count++;
-            break;
-        }
+    if (existing) {
+        match_release(existing);
     }
 
+    match_t* match = match_alloc(match_id);
     if (!match) {
-        printf("[Match] No empty slot available to load match\n");
+        LOG_INFO("[Match] No memory available to load match");
         return NULL;
     }
 
-    strncpy(match->match_id, match_id, sizeof(match->match_id) - 1);
-    match->match_id[sizeof(match->match_id) - 1] = '\0';
     match->red_user_id = red_user_id;
     match->black_user_id = black_user_id;
     snprintf(match->current_turn, sizeof(match->current_turn), "%s", current_turn);
     match->red_time_ms = red_time_ms;
     match->black_time_ms = black_time_ms;
-    match->move_count = move_count;
+    board_init(&match->board);
+    match->move_count = match_parse_moves_json(match, moves_json);
+    if (match->move_count != move_count) {
+        LOG_INFO("[Match] Restored %d of %d moves for %s", match->move_count, move_count, match_id);
+    }
     match->rated = rated;
     match->started_at = started_at;
     match->last_move_at = last_move_at;
@@ -525,8 +1019,11 @@ match_t* match_load_from_db(const char* match_id) {
     strcpy(match->result, "ongoing");
     match->spectator_count = 0;
 
-    printf("[Match] Loaded match %s from DB (red=%d, black=%d, moves=%d)\n", match_id, red_user_id, black_user_id,
-           move_count);
+    user_index_put(red_user_id, match);
+    user_index_put(black_user_id, match);
+
+    LOG_INFO("[Match] Loaded match %s from DB (red=%d, black=%d, moves=%d)", match_id, red_user_id, black_user_id,
+             move_count);
 
     return match;
 }
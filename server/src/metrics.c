@@ -0,0 +1,491 @@
+#include "../include/metrics.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/log.h"
+
+typedef enum { METRIC_COUNTER, METRIC_GAUGE, METRIC_HISTOGRAM } metric_kind_t;
+
+/* Common header; every series struct starts with one so the registry can hold them side by side */
+typedef struct {
+    metric_kind_t kind;
+    char name[64];
+    char help[128];
+    char label[32];
+    char label_value[64];
+} metric_desc_t;
+
+struct metrics_counter {
+    metric_desc_t desc;
+    _Atomic uint64_t value;
+};
+
+struct metrics_gauge {
+    metric_desc_t desc;
+    _Atomic int64_t value;
+};
+
+struct metrics_histogram {
+    metric_desc_t desc;
+    double unit;
+    _Atomic uint64_t buckets[METRICS_HIST_BUCKETS];
+    _Atomic uint64_t sum;
+    _Atomic uint64_t max;
+};
+
+static metric_desc_t* registry[METRICS_MAX_SERIES];
+static _Atomic size_t registry_count = 0;
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static time_t started_at = 0;
+
+static int http_fd = -1;
+static pthread_t http_thread;
+static atomic_bool http_running = false;
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t capacity;
+} text_buffer_t;
+
+static void text_append(text_buffer_t* buf, const char* fmt, ...) {
+    for (;;) {
+        size_t room = buf->capacity - buf->len;
+        va_list args;
+        va_start(args, fmt);
+        int n = buf->data ? vsnprintf(buf->data + buf->len, room, fmt, args) : -1;
+        va_end(args);
+
+        if (n >= 0 && (size_t)n < room) {
+            buf->len += (size_t)n;
+            return;
+        }
+
+        size_t new_capacity = buf->capacity ? buf->capacity * 2 : 4096;
+        if (n >= 0 && new_capacity < buf->len + (size_t)n + 1)
+            new_capacity = buf->len + (size_t)n + 1;
+        char* grown = realloc(buf->data, new_capacity);
+        if (!grown)
+            return;
+        buf->data = grown;
+        buf->capacity = new_capacity;
+    }
+}
+
+static size_t bucket_index(uint64_t value) {
+    if (value < (1u << METRICS_HIST_SUB_BITS))
+        return (size_t)value;
+
+    int msb = 63 - __builtin_clzll(value);
+    size_t sub = (size_t)(value >> (msb - METRICS_HIST_SUB_BITS)) & ((1u << METRICS_HIST_SUB_BITS) - 1);
+    return ((size_t)(msb - METRICS_HIST_SUB_BITS + 1) << METRICS_HIST_SUB_BITS) + sub;
+}
+
+/* Largest value that lands in bucket i */
+static uint64_t bucket_upper(size_t i) {
+    if (i < (1u << METRICS_HIST_SUB_BITS))
+        return i;
+
+    int shift = (int)(i >> METRICS_HIST_SUB_BITS) - 1;
+    uint64_t sub = i & ((1u << METRICS_HIST_SUB_BITS) - 1);
+    uint64_t lower = ((1ULL << METRICS_HIST_SUB_BITS) + sub) << shift;
+    return lower + (1ULL << shift) - 1;
+}
+
+static metric_desc_t* registry_find(metric_kind_t kind, const char* name, const char* label_value) {
+    size_t count = atomic_load_explicit(&registry_count, memory_order_acquire);
+    for (size_t i = 0; i < count; i++) {
+        metric_desc_t* desc = registry[i];
+        if (desc->kind == kind && strcmp(desc->name, name) == 0 &&
+            strcmp(desc->label_value, label_value ? label_value : "") == 0) {
+            return desc;
+        }
+    }
+    return NULL;
+}
+
+static metric_desc_t* registry_add(metric_kind_t kind, size_t size, const char* name, const char* help,
+                                   const char* label, const char* label_value) {
+    pthread_mutex_lock(&registry_lock);
+
+    metric_desc_t* desc = registry_find(kind, name, label_value);
+    size_t count = atomic_load_explicit(&registry_count, memory_order_relaxed);
+    if (!desc && count < METRICS_MAX_SERIES) {
+        desc = calloc(1, size);
+        if (desc) {
+            desc->kind = kind;
+            snprintf(desc->name, sizeof(desc->name), "%s", name);
+            snprintf(desc->help, sizeof(desc->help), "%s", help ? help : "");
+            snprintf(desc->label, sizeof(desc->label), "%s", label ? label : "");
+            snprintf(desc->label_value, sizeof(desc->label_value), "%s", label_value ? label_value : "");
+            registry[count] = desc;
+            atomic_store_explicit(&registry_count, count + 1, memory_order_release);
+        }
+    }
+
+    pthread_mutex_unlock(&registry_lock);
+    return desc;
+}
+
+bool metrics_init(void) {
+    started_at = time(NULL);
+    return true;
+}
+
+void metrics_shutdown(void) {
+    if (atomic_exchange(&http_running, false)) {
+        shutdown(http_fd, SHUT_RDWR);
+        pthread_join(http_thread, NULL);
+        close(http_fd);
+        http_fd = -1;
+    }
+
+    pthread_mutex_lock(&registry_lock);
+    size_t count = atomic_load(&registry_count);
+    for (size_t i = 0; i < count; i++) {
+        free(registry[i]);
+        registry[i] = NULL;
+    }
+    atomic_store(&registry_count, 0);
+    pthread_mutex_unlock(&registry_lock);
+}
+
+metrics_counter_t* metrics_counter(const char* name, const char* help, const char* label, const char* label_value) {
+    return (metrics_counter_t*)registry_add(METRIC_COUNTER, sizeof(metrics_counter_t), name, help, label,
+                                            label_value);
+}
+
+metrics_gauge_t* metrics_gauge(const char* name, const char* help) {
+    return (metrics_gauge_t*)registry_add(METRIC_GAUGE, sizeof(metrics_gauge_t), name, help, NULL, NULL);
+}
+
+metrics_histogram_t* metrics_histogram(const char* name, const char* help, const char* label,
+                                       const char* label_value, double unit) {
+    metrics_histogram_t* histogram = (metrics_histogram_t*)registry_add(
+        METRIC_HISTOGRAM, sizeof(metrics_histogram_t), name, help, label, label_value);
+    if (histogram && histogram->unit == 0.0)
+        histogram->unit = unit;
+    return histogram;
+}
+
+void metrics_counter_add(metrics_counter_t* counter, uint64_t delta) {
+    if (counter)
+        atomic_fetch_add_explicit(&counter->value, delta, memory_order_relaxed);
+}
+
+void metrics_gauge_set(metrics_gauge_t* gauge, int64_t value) {
+    if (gauge)
+        atomic_store_explicit(&gauge->value, value, memory_order_relaxed);
+}
+
+void metrics_observe(metrics_histogram_t* histogram, uint64_t value) {
+    if (!histogram)
+        return;
+
+    atomic_fetch_add_explicit(&histogram->buckets[bucket_index(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->sum, value, memory_order_relaxed);
+
+    uint64_t max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+    while (value > max &&
+           !atomic_compare_exchange_weak_explicit(&histogram->max, &max, value, memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+uint64_t metrics_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Buckets are read one by one, so a snapshot taken mid-update may be off by the observations in flight */
+static uint64_t histogram_snapshot(const metrics_histogram_t* histogram, uint64_t* buckets) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < METRICS_HIST_BUCKETS; i++) {
+        buckets[i] = atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+        total += buckets[i];
+    }
+    return total;
+}
+
+static uint64_t quantile_from_snapshot(const uint64_t* buckets, uint64_t total, uint64_t max, double q) {
+    if (total == 0)
+        return 0;
+
+    uint64_t target = (uint64_t)(q * (double)total + 0.5);
+    if (target < 1)
+        target = 1;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < METRICS_HIST_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= target) {
+            uint64_t upper = bucket_upper(i);
+            return upper < max ? upper : max;
+        }
+    }
+    return max;
+}
+
+uint64_t metrics_histogram_quantile(const metrics_histogram_t* histogram, double q) {
+    if (!histogram)
+        return 0;
+
+    uint64_t buckets[METRICS_HIST_BUCKETS];
+    uint64_t total = histogram_snapshot(histogram, buckets);
+    return quantile_from_snapshot(buckets, total, atomic_load_explicit(&histogram->max, memory_order_relaxed), q);
+}
+
+static void append_labels(text_buffer_t* out, const metric_desc_t* desc, const char* extra) {
+    bool has_label = desc->label[0] != '\0';
+    if (!has_label && !extra)
+        return;
+
+    text_append(out, "{");
+    if (has_label)
+        text_append(out, "%s=\"%s\"", desc->label, desc->label_value);
+    if (extra)
+        text_append(out, "%s%s", has_label ? "," : "", extra);
+    text_append(out, "}");
+}
+
+/* Exported bucket edges are the values 2^p - 1, each the top of an internal sub-bucket, so the cumulative count for
+ * le="2^p - 1" is every bucket up to and including the one that value lands in */
+static void append_histogram(text_buffer_t* out, const metrics_histogram_t* histogram) {
+    const metric_desc_t* desc = &histogram->desc;
+    uint64_t buckets[METRICS_HIST_BUCKETS];
+    uint64_t total = histogram_snapshot(histogram, buckets);
+
+    /* 2^10 ns ~ 1 us up to 2^36 ns ~ 69 s; counts from 1 up to 2^20 */
+    int first_power = histogram->unit < 1.0 ? 10 : 1;
+    int last_power = histogram->unit < 1.0 ? 36 : 20;
+
+    uint64_t cumulative = 0;
+    size_t next_bucket = 0;
+    for (int p = first_power; p <= last_power; p++) {
+        size_t end = bucket_index((1ULL << p) - 1) + 1;
+        while (next_bucket < end && next_bucket < METRICS_HIST_BUCKETS) {
+            cumulative += buckets[next_bucket++];
+        }
+
+        char le[48];
+        snprintf(le, sizeof(le), "le=\"%g\"", (double)((1ULL << p) - 1) * histogram->unit);
+        text_append(out, "%s_bucket", desc->name);
+        append_labels(out, desc, le);
+        text_append(out, " %llu\n", (unsigned long long)cumulative);
+    }
+
+    text_append(out, "%s_bucket", desc->name);
+    append_labels(out, desc, "le=\"+Inf\"");
+    text_append(out, " %llu\n", (unsigned long long)total);
+
+    text_append(out, "%s_sum", desc->name);
+    append_labels(out, desc, NULL);
+    text_append(out, " %g\n", (double)atomic_load_explicit(&histogram->sum, memory_order_relaxed) * histogram->unit);
+
+    text_append(out, "%s_count", desc->name);
+    append_labels(out, desc, NULL);
+    text_append(out, " %llu\n", (unsigned long long)total);
+}
+
+char* metrics_format_prometheus(void) {
+    text_buffer_t out = {0};
+    size_t count = atomic_load_explicit(&registry_count, memory_order_acquire);
+
+    text_append(&out, "# HELP xiangqi_uptime_seconds Seconds since the server started\n");
+    text_append(&out, "# TYPE xiangqi_uptime_seconds gauge\n");
+    text_append(&out, "xiangqi_uptime_seconds %ld\n", (long)(time(NULL) - started_at));
+
+    /* Series of one family must be contiguous under a single HELP/TYPE header */
+    for (size_t i = 0; i < count; i++) {
+        const metric_desc_t* family = registry[i];
+        bool emitted = false;
+        for (size_t j = 0; j < i && !emitted; j++) {
+            emitted = strcmp(registry[j]->name, family->name) == 0;
+        }
+        if (emitted)
+            continue;
+
+        static const char* type_names[] = {"counter", "gauge", "histogram"};
+        text_append(&out, "# HELP %s %s\n", family->name, family->help);
+        text_append(&out, "# TYPE %s %s\n", family->name, type_names[family->kind]);
+
+        for (size_t j = i; j < count; j++) {
+            const metric_desc_t* desc = registry[j];
+            if (strcmp(desc->name, family->name) != 0)
+                continue;
+
+            if (desc->kind == METRIC_COUNTER) {
+                text_append(&out, "%s", desc->name);
+                append_labels(&out, desc, NULL);
+                text_append(&out, " %llu\n", (unsigned long long)atomic_load_explicit(
+                                                 &((const metrics_counter_t*)desc)->value, memory_order_relaxed));
+            } else if (desc->kind == METRIC_GAUGE) {
+                text_append(&out, "%s", desc->name);
+                append_labels(&out, desc, NULL);
+                text_append(&out, " %lld\n", (long long)atomic_load_explicit(&((const metrics_gauge_t*)desc)->value,
+                                                                             memory_order_relaxed));
+            } else {
+                append_histogram(&out, (const metrics_histogram_t*)desc);
+            }
+        }
+    }
+
+    return out.data;
+}
+
+char* metrics_format_json(void) {
+    text_buffer_t out = {0};
+    size_t count = atomic_load_explicit(&registry_count, memory_order_acquire);
+
+    text_append(&out, "{\"uptime_s\":%ld,\"counters\":[", (long)(time(NULL) - started_at));
+    bool first = true;
+    for (size_t i = 0; i < count; i++) {
+        const metric_desc_t* desc = registry[i];
+        if (desc->kind != METRIC_COUNTER)
+            continue;
+        text_append(&out, "%s{\"name\":\"%s\",\"label\":\"%s\",\"value\":%llu}", first ? "" : ",", desc->name,
+                    desc->label_value,
+                    (unsigned long long)atomic_load_explicit(&((const metrics_counter_t*)desc)->value,
+                                                             memory_order_relaxed));
+        first = false;
+    }
+
+    text_append(&out, "],\"gauges\":[");
+    first = true;
+    for (size_t i = 0; i < count; i++) {
+        const metric_desc_t* desc = registry[i];
+        if (desc->kind != METRIC_GAUGE)
+            continue;
+        text_append(&out, "%s{\"name\":\"%s\",\"value\":%lld}", first ? "" : ",", desc->name,
+                    (long long)atomic_load_explicit(&((const metrics_gauge_t*)desc)->value, memory_order_relaxed));
+        first = false;
+    }
+
+    /* Latencies are reported in microseconds; idle series are left out to keep the reply small */
+    text_append(&out, "],\"histograms\":[");
+    first = true;
+    for (size_t i = 0; i < count; i++) {
+        const metric_desc_t* desc = registry[i];
+        if (desc->kind != METRIC_HISTOGRAM)
+            continue;
+
+        const metrics_histogram_t* histogram = (const metrics_histogram_t*)desc;
+        uint64_t buckets[METRICS_HIST_BUCKETS];
+        uint64_t total = histogram_snapshot(histogram, buckets);
+        if (total == 0)
+            continue;
+
+        uint64_t max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+        double scale = histogram->unit < 1.0 ? histogram->unit * 1e6 : 1.0;
+        text_append(&out,
+                    "%s{\"name\":\"%s\",\"label\":\"%s\",\"unit\":\"%s\",\"count\":%llu,\"p50\":%.1f,\"p99\":%.1f,"
+                    "\"p999\":%.1f,\"max\":%.1f}",
+                    first ? "" : ",", desc->name, desc->label_value, histogram->unit < 1.0 ? "us" : "count",
+                    (unsigned long long)total, quantile_from_snapshot(buckets, total, max, 0.50) * scale,
+                    quantile_from_snapshot(buckets, total, max, 0.99) * scale,
+                    quantile_from_snapshot(buckets, total, max, 0.999) * scale, max * scale);
+        first = false;
+    }
+
+    text_append(&out, "]}");
+    return out.data;
+}
+
+static void send_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0)
+            return;
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+static void* metrics_http_loop(void* arg) {
+    (void)arg;
+
+    while (atomic_load(&http_running)) {
+        int fd = accept(http_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;
+        }
+
+        struct timeval timeout = {1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        /* One request per connection; only the request line matters */
+        char request[1024];
+        ssize_t n = recv(fd, request, sizeof(request) - 1, 0);
+        request[n > 0 ? n : 0] = '\0';
+
+        bool found = strncmp(request, "GET /metrics", 12) == 0 || strncmp(request, "GET / ", 6) == 0;
+        char* body = found ? metrics_format_prometheus() : NULL;
+        const char* status = body ? "200 OK" : "404 Not Found";
+        size_t body_len = body ? strlen(body) : 0;
+
+        char header[256];
+        int header_len = snprintf(header, sizeof(header),
+                                  "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                  "Content-Length: %zu\r\nConnection: close\r\n\r\n",
+                                  status, body_len);
+        send_all(fd, header, (size_t)header_len);
+        if (body)
+            send_all(fd, body, body_len);
+
+        free(body);
+        close(fd);
+    }
+
+    return NULL;
+}
+
+bool metrics_http_start(int port) {
+    http_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (http_fd < 0) {
+        LOG_ERROR("[Metrics] metrics socket: %s", strerror(errno));
+        return false;
+    }
+
+    int opt = 1;
+    setsockopt(http_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+
+    if (bind(http_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(http_fd, 16) < 0) {
+        LOG_ERROR("[Metrics] metrics bind: %s", strerror(errno));
+        close(http_fd);
+        http_fd = -1;
+        return false;
+    }
+
+    atomic_store(&http_running, true);
+    if (pthread_create(&http_thread, NULL, metrics_http_loop, NULL) != 0) {
+        atomic_store(&http_running, false);
+        close(http_fd);
+        http_fd = -1;
+        return false;
+    }
+
+    LOG_INFO("[Metrics] Prometheus endpoint on http://127.0.0.1:%d/metrics", port);
+    return true;
+}
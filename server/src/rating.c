@@ -1,12 +1,27 @@
 #include "../include/rating.h"
 
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
 
+/* Glicko-2 works on its own scale: mu = (r - 1500) / 173.7178 */
+#define GLICKO2_CENTER 1500.0
+#define GLICKO2_SCALE 173.7178
+#define GLICKO2_EPSILON 0.000001
+#define GLICKO2_PI 3.14159265358979323846
+
 double rating_expected_score(int rating_a, int rating_b) {
     return 1.0 / (1.0 + pow(10.0, (rating_b - rating_a) / 400.0));
 }
 
+double rating_score(const char* result, bool red) {
+    if (strcmp(result, "red_win") == 0)
+        return red ? 1.0 : 0.0;
+    if (strcmp(result, "black_win") == 0)
+        return red ? 0.0 : 1.0;
+    return 0.5;
+}
+
 rating_change_t rating_calculate(int red_rating, int black_rating, const char* result, int k_factor) {
     rating_change_t change = {0, 0};
 
@@ -31,3 +46,225 @@ rating_change_t rating_calculate(int red_rating, int black_rating, const char* r
 
     return change;
 }
+
+static double glicko2_g(double phi) {
+    return 1.0 / sqrt(1.0 + 3.0 * phi * phi / (GLICKO2_PI * GLICKO2_PI));
+}
+
+typedef struct {
+    double a; /* ln(sigma^2) */
+    double phi2;
+    double delta2;
+    double v;
+    double tau;
+} glicko2_volatility_t;
+
+static double glicko2_f(const glicko2_volatility_t* p, double x) {
+    double ex = exp(x);
+    double d = p->phi2 + p->v + ex;
+    return ex * (p->delta2 - p->phi2 - p->v - ex) / (2.0 * d * d) - (x - p->a) / (p->tau * p->tau);
+}
+
+/* Step 5 of the paper: the new volatility is the root of f, found by the Illinois variant of regula falsi */
+static double glicko2_volatility(double phi, double sigma, double v, double delta, double tau) {
+    glicko2_volatility_t p = {log(sigma * sigma), phi * phi, delta * delta, v, tau};
+
+    double A = p.a;
+    double B;
+    if (p.delta2 > p.phi2 + v) {
+        B = log(p.delta2 - p.phi2 - v);
+    } else {
+        int k = 1;
+        while (glicko2_f(&p, p.a - k * tau) < 0)
+            k++;
+        B = p.a - k * tau;
+    }
+
+    double fA = glicko2_f(&p, A);
+    double fB = glicko2_f(&p, B);
+    while (fabs(B - A) > GLICKO2_EPSILON) {
+        double C = A + (A - B) * fA / (fB - fA);
+        double fC = glicko2_f(&p, C);
+        if (fC * fB <= 0) {
+            A = B;
+            fA = fB;
+        } else {
+            fA /= 2.0;
+        }
+        B = C;
+        fB = fC;
+    }
+    return exp(A / 2.0);
+}
+
+glicko2_rating_t glicko2_update(glicko2_rating_t player, const glicko2_result_t* results, int count, double tau) {
+    double mu = (player.rating - GLICKO2_CENTER) / GLICKO2_SCALE;
+    double phi = player.rd / GLICKO2_SCALE;
+    double sigma = player.volatility;
+
+    if (count == 0) {
+        player.rd = glicko2_idle_rd(player.rd, sigma, 1);
+        return player;
+    }
+
+    /* v is the estimated variance of the rating from these results alone, delta the improvement they show */
+    double v_inverse = 0.0;
+    double improvement = 0.0;
+    for (int i = 0; i < count; i++) {
+        double mu_j = (results[i].opponent_rating - GLICKO2_CENTER) / GLICKO2_SCALE;
+        double g = glicko2_g(results[i].opponent_rd / GLICKO2_SCALE);
+        double expected = 1.0 / (1.0 + exp(-g * (mu - mu_j)));
+        v_inverse += g * g * expected * (1.0 - expected);
+        improvement += g * (results[i].score - expected);
+    }
+    double v = 1.0 / v_inverse;
+
+    double new_sigma = glicko2_volatility(phi, sigma, v, v * improvement, tau);
+    double phi_star = sqrt(phi * phi + new_sigma * new_sigma);
+    double new_phi = 1.0 / sqrt(1.0 / (phi_star * phi_star) + 1.0 / v);
+    double new_mu = mu + new_phi * new_phi * improvement;
+
+    player.rating = new_mu * GLICKO2_SCALE + GLICKO2_CENTER;
+    player.rd = new_phi * GLICKO2_SCALE;
+    player.volatility = new_sigma;
+    return player;
+}
+
+double glicko2_idle_rd(double rd, double volatility, int periods) {
+    double phi = rd / GLICKO2_SCALE;
+    double widened = sqrt(phi * phi + periods * volatility * volatility) * GLICKO2_SCALE;
+    return widened < GLICKO2_DEFAULT_RD ? widened : GLICKO2_DEFAULT_RD;
+}
+
+static bool grow_array(void** array, size_t elem_size, int capacity) {
+    void* grown = realloc(*array, (size_t)capacity * elem_size);
+    if (!grown)
+        return false;
+    *array = grown;
+    return true;
+}
+
+int glicko2_period_add_player(glicko2_period_t* period, glicko2_rating_t rating) {
+    if (period->player_count == period->player_capacity) {
+        int capacity = period->player_capacity ? period->player_capacity * 2 : 256;
+        if (!grow_array((void**)&period->mu, sizeof(double), capacity) ||
+            !grow_array((void**)&period->phi, sizeof(double), capacity) ||
+            !grow_array((void**)&period->sigma, sizeof(double), capacity) ||
+            !grow_array((void**)&period->g, sizeof(double), capacity) ||
+            !grow_array((void**)&period->variance_sum, sizeof(double), capacity) ||
+            !grow_array((void**)&period->improvement_sum, sizeof(double), capacity))
+            return -1;
+        period->player_capacity = capacity;
+    }
+    int i = period->player_count++;
+    period->mu[i] = (rating.rating - GLICKO2_CENTER) / GLICKO2_SCALE;
+    period->phi[i] = rating.rd / GLICKO2_SCALE;
+    period->sigma[i] = rating.volatility;
+    period->g[i] = glicko2_g(period->phi[i]);
+    return i;
+}
+
+bool glicko2_period_add_game(glicko2_period_t* period, int player, int opponent, double score) {
+    if (period->result_count + 2 > period->result_capacity) {
+        int capacity = period->result_capacity ? period->result_capacity * 2 : 1024;
+        if (!grow_array((void**)&period->owner, sizeof(int), capacity) ||
+            !grow_array((void**)&period->opponent, sizeof(int), capacity) ||
+            !grow_array((void**)&period->score, sizeof(double), capacity) ||
+            !grow_array((void**)&period->own_mu, sizeof(double), capacity) ||
+            !grow_array((void**)&period->opponent_mu, sizeof(double), capacity) ||
+            !grow_array((void**)&period->opponent_g, sizeof(double), capacity) ||
+            !grow_array((void**)&period->variance, sizeof(double), capacity) ||
+            !grow_array((void**)&period->improvement, sizeof(double), capacity))
+            return false;
+        period->result_capacity = capacity;
+    }
+    int i = period->result_count;
+    period->owner[i] = player;
+    period->opponent[i] = opponent;
+    period->score[i] = score;
+    period->owner[i + 1] = opponent;
+    period->opponent[i + 1] = player;
+    period->score[i + 1] = 1.0 - score;
+    period->result_count += 2;
+    return true;
+}
+
+/* The per-result terms of v and delta; every iteration is independent */
+static void glicko2_period_terms(int count, const double* restrict own_mu, const double* restrict opponent_mu,
+                                 const double* restrict opponent_g, const double* restrict score,
+                                 double* restrict variance, double* restrict improvement) {
+    for (int i = 0; i < count; i++) {
+        double g = opponent_g[i];
+        double expected = 1.0 / (1.0 + exp(-g * (own_mu[i] - opponent_mu[i])));
+        variance[i] = g * g * expected * (1.0 - expected);
+        improvement[i] = g * (score[i] - expected);
+    }
+}
+
+void glicko2_period_run(glicko2_period_t* period, double tau) {
+    int players = period->player_count;
+    int results = period->result_count;
+
+    for (int i = 0; i < results; i++) {
+        period->own_mu[i] = period->mu[period->owner[i]];
+        period->opponent_mu[i] = period->mu[period->opponent[i]];
+        period->opponent_g[i] = period->g[period->opponent[i]];
+    }
+    glicko2_period_terms(results, period->own_mu, period->opponent_mu, period->opponent_g, period->score,
+                         period->variance, period->improvement);
+
+    for (int p = 0; p < players; p++) {
+        period->variance_sum[p] = 0.0;
+        period->improvement_sum[p] = 0.0;
+    }
+    for (int i = 0; i < results; i++) {
+        period->variance_sum[period->owner[i]] += period->variance[i];
+        period->improvement_sum[period->owner[i]] += period->improvement[i];
+    }
+
+    for (int p = 0; p < players; p++) {
+        double phi = period->phi[p];
+        double sigma = period->sigma[p];
+        if (period->variance_sum[p] <= 0.0) {
+            period->phi[p] = glicko2_idle_rd(phi * GLICKO2_SCALE, sigma, 1) / GLICKO2_SCALE;
+            continue;
+        }
+
+        double v = 1.0 / period->variance_sum[p];
+        double new_sigma = glicko2_volatility(phi, sigma, v, v * period->improvement_sum[p], tau);
+        double phi_star = sqrt(phi * phi + new_sigma * new_sigma);
+        double new_phi = 1.0 / sqrt(1.0 / (phi_star * phi_star) + 1.0 / v);
+        period->mu[p] += new_phi * new_phi * period->improvement_sum[p];
+        period->phi[p] = new_phi;
+        period->sigma[p] = new_sigma;
+    }
+}
+
+glicko2_rating_t glicko2_period_rating(const glicko2_period_t* period, int player) {
+    glicko2_rating_t rating = {period->mu[player] * GLICKO2_SCALE + GLICKO2_CENTER,
+                               period->phi[player] * GLICKO2_SCALE, period->sigma[player]};
+    return rating;
+}
+
+void glicko2_period_clear(glicko2_period_t* period) {
+    period->player_count = 0;
+    period->result_count = 0;
+}
+
+void glicko2_period_free(glicko2_period_t* period) {
+    free(period->mu);
+    free(period->phi);
+    free(period->sigma);
+    free(period->g);
+    free(period->variance_sum);
+    free(period->improvement_sum);
+    free(period->owner);
+    free(period->opponent);
+    free(period->score);
+    free(period->own_mu);
+    free(period->opponent_mu);
+    free(period->opponent_g);
+    free(period->variance);
+    free(period->improvement);
+    memset(period, 0, sizeof(*period));
+}
@@ -0,0 +1,318 @@
+#include "../include/rating_period.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/db.h"
+#include "../include/leaderboard.h"
+#include "../include/log.h"
+#include "../include/metrics.h"
+#include "../include/stats.h"
+
+typedef struct {
+    double rd; /* 0 until known: GLICKO2_DEFAULT_RD */
+    double volatility;
+    long rated_at;
+    unsigned stamp; /* period that last gathered the player */
+    int slot;       /* their index in that period */
+} rp_player_t;
+
+typedef struct {
+    int red_user_id;
+    int black_user_id;
+    double red_score;
+    long ended_at;
+} rp_game_t;
+
+static struct {
+    bool ready;
+    bool glicko2;
+    long period_seconds;
+
+    rp_player_t* by_id; /* indexed by user_id */
+    int by_id_capacity;
+
+    rp_game_t* games; /* the open period and any not yet closed, oldest first */
+    int game_count;
+    int game_capacity;
+
+    glicko2_period_t batch;
+    int* batch_users; /* user_id of each batch player */
+    db_rating_update_t* updates;
+    int batch_capacity;
+    unsigned stamp;
+} rp = {0};
+
+static metrics_gauge_t* pending_gauge = NULL;
+static metrics_histogram_t* close_histogram = NULL;
+
+static rp_player_t* find_or_add(int user_id) {
+    if (user_id <= 0)
+        return NULL;
+    if (user_id >= rp.by_id_capacity) {
+        int capacity = rp.by_id_capacity ? rp.by_id_capacity : 1024;
+        while (capacity <= user_id)
+            capacity *= 2;
+        rp_player_t* grown = realloc(rp.by_id, (size_t)capacity * sizeof(rp_player_t));
+        if (!grown)
+            return NULL;
+        memset(grown + rp.by_id_capacity, 0, (size_t)(capacity - rp.by_id_capacity) * sizeof(rp_player_t));
+        rp.by_id = grown;
+        rp.by_id_capacity = capacity;
+    }
+    return &rp.by_id[user_id];
+}
+
+/* Deviation at time at: the stored one grown by every full period since the player was last rated */
+static double current_rd(const rp_player_t* player, long at) {
+    if (!player || player->rd <= 0)
+        return GLICKO2_DEFAULT_RD;
+    long idle = player->rated_at > 0 && at > player->rated_at ? (at - player->rated_at) / rp.period_seconds : 0;
+    if (idle <= 0)
+        return player->rd;
+    return glicko2_idle_rd(player->rd, player->volatility, idle > 1000 ? 1000 : (int)idle);
+}
+
+static bool queue_game(int red_user_id, int black_user_id, double red_score, long ended_at) {
+    if (rp.game_count == rp.game_capacity) {
+        int capacity = rp.game_capacity ? rp.game_capacity * 2 : 256;
+        rp_game_t* grown = realloc(rp.games, (size_t)capacity * sizeof(rp_game_t));
+        if (!grown)
+            return false;
+        rp.games = grown;
+        rp.game_capacity = capacity;
+    }
+    rp.games[rp.game_count++] = (rp_game_t){red_user_id, black_user_id, red_score, ended_at};
+    metrics_gauge_set(pending_gauge, rp.game_count);
+    return true;
+}
+
+static bool visit_user_rating(const db_user_rating_t* row, void* ctx) {
+    long* last_close = ctx;
+    rp_player_t* player = find_or_add(row->user_id);
+    if (player) {
+        player->rd = row->rd;
+        player->volatility = row->volatility;
+        player->rated_at = row->rated_at;
+    }
+    if (row->rated_at > *last_close)
+        *last_close = row->rated_at;
+    return true;
+}
+
+static bool visit_rated_match(const db_rated_match_t* match, void* ctx) {
+    (void)ctx;
+    return queue_game(match->red_user_id, match->black_user_id, rating_score(match->result, true), match->ended_at);
+}
+
+/* Returns the end of the last period closed, 0 if there never was one, or -1 */
+static long load_players(void) {
+    long last_close = 0;
+    memset(rp.by_id, 0, (size_t)rp.by_id_capacity * sizeof(rp_player_t));
+    return db_for_each_user_rating(visit_user_rating, &last_close) < 0 ? -1 : last_close;
+}
+
+/* Player state plus, since the last close, every rated game the server finished */
+static bool load(void) {
+    long last_close = load_players();
+    if (last_close < 0)
+        return false;
+    /* A database never rated in periods starts now rather than rating all of history as one period */
+    rp.game_count = 0;
+    if (last_close > 0 && db_for_each_rated_match(last_close, visit_rated_match, NULL) < 0)
+        return false;
+    metrics_gauge_set(pending_gauge, rp.game_count);
+    return true;
+}
+
+bool rating_period_init(bool glicko2, int period_seconds) {
+    rating_period_shutdown();
+    rp.glicko2 = glicko2;
+    rp.period_seconds = period_seconds > 0 ? period_seconds : RATING_PERIOD_DEFAULT_SECONDS;
+    rp.ready = true;
+    if (!glicko2) {
+        LOG_INFO("[Rating] Elo, K=%d", DEFAULT_K_FACTOR);
+        return true;
+    }
+
+    if (!pending_gauge) {
+        pending_gauge = metrics_gauge("xiangqi_rating_pending_games", "Rated games waiting for their period to close");
+        close_histogram = metrics_histogram("xiangqi_rating_period_close_duration_seconds",
+                                            "Time to rate and write one Glicko-2 period", NULL, NULL, METRICS_UNIT_NS);
+    }
+
+    if (!load()) {
+        LOG_ERROR("[Rating] Failed to load Glicko-2 state");
+        rating_period_shutdown();
+        return false;
+    }
+    LOG_INFO("[Rating] Glicko-2, %ld s periods, %d games pending", rp.period_seconds, rp.game_count);
+    return true;
+}
+
+void rating_period_shutdown(void) {
+    if (rp.game_count > 0)
+        LOG_INFO("[Rating] %d games left for the next start to rate", rp.game_count);
+    metrics_gauge_set(pending_gauge, 0);
+    glicko2_period_free(&rp.batch);
+    free(rp.by_id);
+    free(rp.games);
+    free(rp.batch_users);
+    free(rp.updates);
+    memset(&rp, 0, sizeof(rp));
+}
+
+bool rating_period_glicko2(void) {
+    return rp.ready && rp.glicko2;
+}
+
+rating_change_t rating_period_rate(int red_user_id, int black_user_id, int red_rating, int black_rating,
+                                   const char* result) {
+    if (!rating_period_glicko2())
+        return rating_calculate(red_rating, black_rating, result, DEFAULT_K_FACTOR);
+
+    if (!queue_game(red_user_id, black_user_id, rating_score(result, true), (long)time(NULL)))
+        LOG_ERROR("[Rating] Out of memory queuing a game for %d and %d", red_user_id, black_user_id);
+    rating_change_t none = {0, 0};
+    return none;
+}
+
+int rating_period_rd(int user_id) {
+    if (!rating_period_glicko2())
+        return 0;
+    const rp_player_t* player = user_id > 0 && user_id < rp.by_id_capacity ? &rp.by_id[user_id] : NULL;
+    return (int)lround(current_rd(player, (long)time(NULL)));
+}
+
+/* The player's batch index for this period, adding them with their state at the period start */
+static int gather(int user_id, long period_start) {
+    int rating = leaderboard_rating(user_id);
+    rp_player_t* player = rating > 0 ? find_or_add(user_id) : NULL;
+    if (!player)
+        return -1;
+    if (player->stamp == rp.stamp)
+        return player->slot;
+
+    int count = rp.batch.player_count;
+    if (count == rp.batch_capacity) {
+        int capacity = rp.batch_capacity ? rp.batch_capacity * 2 : 256;
+        int* users = realloc(rp.batch_users, (size_t)capacity * sizeof(int));
+        if (!users)
+            return -1;
+        rp.batch_users = users;
+        db_rating_update_t* updates = realloc(rp.updates, (size_t)capacity * sizeof(db_rating_update_t));
+        if (!updates)
+            return -1;
+        rp.updates = updates;
+        rp.batch_capacity = capacity;
+    }
+
+    glicko2_rating_t state = {rating, current_rd(player, period_start),
+                              player->rd > 0 ? player->volatility : GLICKO2_DEFAULT_VOLATILITY};
+    int slot = glicko2_period_add_player(&rp.batch, state);
+    if (slot < 0)
+        return -1;
+    rp.batch_users[slot] = user_id;
+    player->stamp = rp.stamp;
+    player->slot = slot;
+    return slot;
+}
+
+/* Rates the games that ended before period_end; they leave the queue only once the ratings are written */
+static bool close_period(long period_end) {
+    uint64_t start = metrics_now_ns();
+    long period_start = period_end - rp.period_seconds;
+    rp.stamp++;
+    glicko2_period_clear(&rp.batch);
+
+    int games = 0;
+    for (int i = 0; i < rp.game_count; i++) {
+        const rp_game_t* game = &rp.games[i];
+        if (game->ended_at >= period_end)
+            continue;
+        games++;
+        int red = gather(game->red_user_id, period_start);
+        int black = gather(game->black_user_id, period_start);
+        if (red < 0 || black < 0 || red == black)
+            continue;
+        if (!glicko2_period_add_game(&rp.batch, red, black, game->red_score)) {
+            LOG_ERROR("[Rating] Out of memory closing the period ending %ld", period_end);
+            return false;
+        }
+    }
+
+    int players = rp.batch.player_count;
+    for (int i = 0; i < players; i++)
+        rp.updates[i].old_rating = (int)lround(glicko2_period_rating(&rp.batch, i).rating);
+    glicko2_period_run(&rp.batch, GLICKO2_TAU);
+
+    for (int i = 0; i < players; i++) {
+        glicko2_rating_t after = glicko2_period_rating(&rp.batch, i);
+        db_rating_update_t* update = &rp.updates[i];
+        update->user_id = rp.batch_users[i];
+        update->rating = (int)lround(after.rating);
+        update->rd = after.rd;
+        update->volatility = after.volatility;
+        update->rated_at = period_end;
+    }
+
+    int applied = db_update_ratings(rp.updates, players);
+    if (applied < 0) {
+        LOG_ERROR("[Rating] Failed to write the period ending %ld; retrying on the next tick", period_end);
+        return false;
+    }
+
+    for (int i = 0; i < players; i++) {
+        const db_rating_update_t* update = &rp.updates[i];
+        rp_player_t* player = &rp.by_id[update->user_id];
+        player->rd = update->rd;
+        player->volatility = update->volatility;
+        player->rated_at = update->rated_at;
+        leaderboard_set_rating(update->user_id, update->rating);
+        if (update->rating != update->old_rating)
+            stats_rating_changed(update->user_id, period_end, update->rating - update->old_rating);
+    }
+
+    /* Someone changed a rating behind our back (bin/rerate): start over from what the database holds */
+    if (applied != players) {
+        LOG_WARN("[Rating] %d of %d ratings were changed elsewhere; reloading", players - applied, players);
+        leaderboard_init();
+        if (load_players() < 0)
+            LOG_ERROR("[Rating] Failed to reload Glicko-2 state");
+    }
+
+    int kept = 0;
+    for (int i = 0; i < rp.game_count; i++) {
+        if (rp.games[i].ended_at >= period_end)
+            rp.games[kept++] = rp.games[i];
+    }
+    rp.game_count = kept;
+    metrics_gauge_set(pending_gauge, rp.game_count);
+
+    metrics_observe_since(close_histogram, start);
+    LOG_INFO("[Rating] Period ending %ld closed: %d games, %d players in %llu ms", period_end, games, players,
+             (unsigned long long)((metrics_now_ns() - start) / 1000000));
+    return true;
+}
+
+int rating_period_tick(time_t now) {
+    if (!rating_period_glicko2())
+        return 0;
+
+    long boundary = (long)now - (long)now % rp.period_seconds;
+    int closed = 0;
+    while (rp.game_count > 0) {
+        long oldest = rp.games[0].ended_at;
+        for (int i = 1; i < rp.game_count; i++) {
+            if (rp.games[i].ended_at < oldest)
+                oldest = rp.games[i].ended_at;
+        }
+        long period_end = oldest - oldest % rp.period_seconds + rp.period_seconds;
+        if (period_end > boundary || !close_period(period_end))
+            break;
+        closed++;
+    }
+    return closed;
+}
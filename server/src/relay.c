@@ -0,0 +1,566 @@
+#include "../include/relay.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/board.h"
+#include "../include/frame.h"
+#include "../include/log.h"
+#include "../include/match.h"
+#include "../include/protocol.h"
+
+typedef struct {
+    client_t* client;
+    int seq;
+} relay_pending_t;
+
+typedef struct {
+    char match_id[32];
+    client_t* upstream;
+    int upstream_seq;
+    int sync_seq;
+    bool synced;
+
+    /* Mirror of the primary's keyframe, advanced by every opponent_move */
+    bool active;
+    int seq;
+    board_t board;
+    int red_user_id;
+    int black_user_id;
+    int red_time_ms;
+    int black_time_ms;
+    move_t recent[SPECTATE_KEYFRAME_MOVES];
+
+    client_t** spectators;
+    int spectator_count;
+    int spectator_capacity;
+    relay_pending_t* pending;
+    int pending_count;
+    int pending_capacity;
+    time_t idle_since;
+} relay_feed_t;
+
+static relay_feed_t* feeds[RELAY_MAX_FEEDS];
+static int feed_count = 0;
+static bool relay_enabled = false;
+static char primary_host[256];
+static int primary_port = 0;
+
+static relay_feed_t* relay_find_feed(const char* match_id) {
+    for (int i = 0; i < feed_count; i++) {
+        if (strcmp(feeds[i]->match_id, match_id) == 0)
+            return feeds[i];
+    }
+    return NULL;
+}
+
+static relay_feed_t* relay_find_feed_by_upstream(const client_t* upstream) {
+    for (int i = 0; i < feed_count; i++) {
+        if (feeds[i]->upstream == upstream)
+            return feeds[i];
+    }
+    return NULL;
+}
+
+static int relay_connect_primary(void) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    char port_str[16];
+    snprintf(port_str, sizeof(port_str), "%d", primary_port);
+
+    struct addrinfo* res = NULL;
+    if (getaddrinfo(primary_host, port_str, &hints, &res) != 0)
+        return -1;
+
+    int fd = -1;
+    for (struct addrinfo* ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+            continue;
+        /* The primary is expected on the same host or LAN, so a blocking connect is brief */
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (fd >= 0) {
+        int flags = fcntl(fd, F_GETFL, 0);
+        if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+static bool relay_send_upstream(server_t* server, relay_feed_t* feed, const char* type) {
+    char request[256];
+    feed->sync_seq = ++feed->upstream_seq;
+    snprintf(request, sizeof(request),
+             "{\"type\":\"%s\",\"seq\":%d,\"token\":\"\",\"payload\":{\"match_id\":\"%s\"}}\n", type,
+             feed->sync_seq, feed->match_id);
+    return client_send(server, feed->upstream, request) == 0;
+}
+
+static void relay_reply(server_t* server, client_t* client, int seq, bool success, const char* message,
+                        const char* payload) {
+    size_t size = strlen(message) + (payload ? strlen(payload) : 0) + 128;
+    char* response = malloc(size);
+    if (!response)
+        return;
+
+    if (payload) {
+        snprintf(response, size,
+                 "{\"type\":\"response\",\"seq\":%d,\"success\":true,\"message\":\"%s\",\"payload\":%s}\n", seq,
+                 message, payload);
+    } else {
+        snprintf(response, size, "{\"type\":\"%s\",\"seq\":%d,\"success\":%s,\"message\":\"%s\"}\n",
+                 success ? "response" : "error", seq, success ? "true" : "false", message);
+    }
+
+    client_send(server, client, response);
+    free(response);
+}
+
+static char* relay_feed_keyframe_json(const relay_feed_t* feed) {
+    int recent = feed->seq < SPECTATE_KEYFRAME_MOVES ? feed->seq : SPECTATE_KEYFRAME_MOVES;
+
+    char* json = malloc((size_t)recent * 80 + BOARD_SQUARES + 512);
+    if (!json)
+        return NULL;
+
+    char position[BOARD_SQUARES + 1];
+    board_format_position(&feed->board, position);
+
+    char* ptr = json;
+    ptr += sprintf(ptr,
+                   "{\"match_id\":\"%s\",\"seq\":%d,\"position\":\"%s\",\"current_turn\":\"%s\","
+                   "\"red_user_id\":%d,\"black_user_id\":%d,\"red_time_ms\":%d,\"black_time_ms\":%d,"
+                   "\"active\":%s,\"moves\":[",
+                   feed->match_id, feed->seq, position, (feed->seq % 2 == 0) ? "red" : "black", feed->red_user_id,
+                   feed->black_user_id, feed->red_time_ms, feed->black_time_ms, feed->active ? "true" : "false");
+
+    for (int s = feed->seq - recent + 1; s <= feed->seq; s++) {
+        const move_t* m = &feed->recent[(s - 1) % SPECTATE_KEYFRAME_MOVES];
+        if (s > feed->seq - recent + 1)
+            ptr += sprintf(ptr, ",");
+        ptr += sprintf(ptr, "{\"seq\":%d,\"from\":{\"row\":%d,\"col\":%d},\"to\":{\"row\":%d,\"col\":%d}}", s,
+                       MOVE_FROM_ROW(m), MOVE_FROM_COL(m), MOVE_TO_ROW(m), MOVE_TO_COL(m));
+    }
+
+    sprintf(ptr, "]}");
+    return json;
+}
+
+static bool relay_parse_square(const char* json, const char* key, int* out_square) {
+    char search[32];
+    snprintf(search, sizeof(search), "\"%s\":", key);
+
+    const char* pos = strstr(json, search);
+    int row, col;
+    if (!pos || sscanf(pos + strlen(search), "{\"row\":%d,\"col\":%d}", &row, &col) != 2)
+        return false;
+    if (!is_valid_position(row, col))
+        return false;
+
+    *out_square = SQUARE(row, col);
+    return true;
+}
+
+static void relay_send_join(server_t* server, relay_feed_t* feed, client_t* client, int seq) {
+    char* keyframe = relay_feed_keyframe_json(feed);
+    if (!keyframe) {
+        relay_reply(server, client, seq, false, "Failed to get match state", NULL);
+        return;
+    }
+
+    size_t size = strlen(keyframe) + 256;
+    char* payload = malloc(size);
+    if (payload) {
+        snprintf(payload, size,
+                 "{\"match_id\":\"%s\",\"move_count\":%d,\"current_turn\":\"%s\",\"is_spectator\":true,"
+                 "\"keyframe\":%s}",
+                 feed->match_id, feed->seq, (feed->seq % 2 == 0) ? "red" : "black", keyframe);
+        relay_reply(server, client, seq, true, "Joined as spectator", payload);
+        free(payload);
+    }
+    free(keyframe);
+}
+
+/* Replaces the mirrored state with a keyframe from the primary (join response or spectate_sync) */
+static bool relay_apply_keyframe(relay_feed_t* feed, const char* payload) {
+    const char* keyframe = strstr(payload, "\"keyframe\":");
+    if (keyframe)
+        payload = keyframe;
+
+    char* position = json_get_string(payload, "position");
+    if (!position)
+        return false;
+
+    board_t board;
+    bool ok = board_parse_position(&board, position);
+    free(position);
+    if (!ok)
+        return false;
+
+    feed->board = board;
+    feed->seq = json_get_int(payload, "seq");
+    feed->red_user_id = json_get_int(payload, "red_user_id");
+    feed->black_user_id = json_get_int(payload, "black_user_id");
+    feed->red_time_ms = json_get_int(payload, "red_time_ms");
+    feed->black_time_ms = json_get_int(payload, "black_time_ms");
+    feed->active = json_get_bool(payload, "active");
+
+    const char* moves = strstr(payload, "\"moves\":[");
+    const char* entry = moves;
+    while (entry && (entry = strstr(entry, "{\"seq\":")) != NULL) {
+        int seq, from, to;
+        if (sscanf(entry, "{\"seq\":%d", &seq) == 1 && seq > 0 && relay_parse_square(entry, "from", &from) &&
+            relay_parse_square(entry, "to", &to)) {
+            move_t* m = &feed->recent[(seq - 1) % SPECTATE_KEYFRAME_MOVES];
+            memset(m, 0, sizeof(*m));
+            m->from = (uint8_t)from;
+            m->to = (uint8_t)to;
+        }
+        entry++;
+    }
+
+    feed->synced = true;
+    return true;
+}
+
+static void relay_fanout(server_t* server, relay_feed_t* feed, const char* json) {
+    if (feed->spectator_count == 0)
+        return;
+
+    frame_t* frame = frame_create(json);
+    if (!frame)
+        return;
+
+    for (int i = 0; i < feed->spectator_count; i++) {
+        client_send_frame(server, feed->spectators[i], frame);
+    }
+    frame_release(frame);
+}
+
+static void relay_apply_move(server_t* server, relay_feed_t* feed, const char* json, const char* payload) {
+    int seq = json_get_int(payload, "seq");
+    if (seq <= feed->seq)
+        return;
+
+    if (seq != feed->seq + 1) {
+        /* Lost a move upstream: keep forwarding, spectators resync from us once we have caught up */
+        LOG_INFO("[Relay] Gap on %s (have %d, got %d), resyncing", feed->match_id, feed->seq, seq);
+        feed->synced = false;
+        relay_send_upstream(server, feed, "spectate_sync");
+        relay_fanout(server, feed, json);
+        return;
+    }
+
+    int from, to;
+    if (!relay_parse_square(payload, "from", &from) || !relay_parse_square(payload, "to", &to))
+        return;
+
+    board_apply(&feed->board, from, to);
+    move_t* m = &feed->recent[(seq - 1) % SPECTATE_KEYFRAME_MOVES];
+    memset(m, 0, sizeof(*m));
+    m->from = (uint8_t)from;
+    m->to = (uint8_t)to;
+    feed->seq = seq;
+    feed->red_time_ms = json_get_int(payload, "red_time_ms");
+    feed->black_time_ms = json_get_int(payload, "black_time_ms");
+
+    relay_fanout(server, feed, json);
+}
+
+static void relay_detach_spectators(server_t* server, relay_feed_t* feed, bool notify) {
+    char notice[128];
+    snprintf(notice, sizeof(notice), "{\"type\":\"spectate_closed\",\"payload\":{\"match_id\":\"%s\"}}\n",
+             feed->match_id);
+
+    for (int i = 0; i < feed->spectator_count; i++) {
+        if (notify)
+            client_send(server, feed->spectators[i], notice);
+        feed->spectators[i]->spectate_match_id[0] = '\0';
+    }
+    feed->spectator_count = 0;
+
+    for (int i = 0; i < feed->pending_count; i++) {
+        relay_reply(server, feed->pending[i].client, feed->pending[i].seq, false, "Match not found or ended", NULL);
+        feed->pending[i].client->spectate_match_id[0] = '\0';
+    }
+    feed->pending_count = 0;
+}
+
+static void relay_free_feed(relay_feed_t* feed) {
+    for (int i = 0; i < feed_count; i++) {
+        if (feeds[i] == feed) {
+            feeds[i] = feeds[--feed_count];
+            break;
+        }
+    }
+
+    free(feed->spectators);
+    free(feed->pending);
+    free(feed);
+}
+
+/*
+ * Closing the upstream socket re-enters relay_upstream_closed, so unlink it first. While the reactor is
+ * still reading from that socket it must not be destroyed; a shutdown lets the reactor reap it instead.
+ */
+static void relay_close_feed(server_t* server, relay_feed_t* feed, bool defer) {
+    relay_detach_spectators(server, feed, true);
+
+    client_t* upstream = feed->upstream;
+    feed->upstream = NULL;
+    relay_free_feed(feed);
+
+    if (!upstream)
+        return;
+    if (defer)
+        shutdown(upstream->fd, SHUT_RDWR);
+    else
+        client_disconnect(server, upstream);
+}
+
+static relay_feed_t* relay_open_feed(server_t* server, const char* match_id) {
+    if (feed_count >= RELAY_MAX_FEEDS) {
+        LOG_ERROR("[Relay] Feed limit reached, cannot relay %s", match_id);
+        return NULL;
+    }
+
+    int fd = relay_connect_primary();
+    if (fd < 0) {
+        LOG_ERROR("[Relay] Cannot reach primary %s:%d", primary_host, primary_port);
+        return NULL;
+    }
+
+    client_t* upstream = client_create(fd);
+    relay_feed_t* feed = calloc(1, sizeof(relay_feed_t));
+    if (!upstream || !feed) {
+        if (upstream)
+            client_destroy(upstream);
+        else
+            close(fd);
+        free(feed);
+        return NULL;
+    }
+    upstream->upstream = true;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = upstream;
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        LOG_ERROR("[Relay] epoll_ctl add upstream: %s", strerror(errno));
+        client_destroy(upstream);
+        free(feed);
+        return NULL;
+    }
+
+    snprintf(feed->match_id, sizeof(feed->match_id), "%s", match_id);
+    feed->upstream = upstream;
+    feed->idle_since = time(NULL);
+    board_init(&feed->board);
+    feeds[feed_count++] = feed;
+
+    if (!relay_send_upstream(server, feed, "join_spectate")) {
+        relay_close_feed(server, feed, false);
+        return NULL;
+    }
+
+    LOG_INFO("[Relay] Subscribed to %s on %s:%d", match_id, primary_host, primary_port);
+    return feed;
+}
+
+bool relay_init(const char* host, int port) {
+    if (!host || port <= 0 || port > 65535)
+        return false;
+
+    snprintf(primary_host, sizeof(primary_host), "%s", host);
+    primary_port = port;
+    feed_count = 0;
+    relay_enabled = true;
+
+    LOG_INFO("[Relay] Relaying spectators from %s:%d", primary_host, primary_port);
+    return true;
+}
+
+void relay_shutdown(server_t* server) {
+    while (feed_count > 0) {
+        relay_close_feed(server, feeds[feed_count - 1], false);
+    }
+    relay_enabled = false;
+}
+
+bool relay_is_enabled(void) {
+    return relay_enabled;
+}
+
+bool relay_join_spectate(server_t* server, client_t* client, const char* match_id, int seq) {
+    if (client->spectate_match_id[0] != '\0')
+        relay_remove_spectator(client);
+
+    relay_feed_t* feed = relay_find_feed(match_id);
+    if (!feed)
+        feed = relay_open_feed(server, match_id);
+    if (!feed)
+        return false;
+
+    if (feed->synced) {
+        if (feed->spectator_count == feed->spectator_capacity) {
+            int new_capacity = feed->spectator_capacity ? feed->spectator_capacity * 2 : MATCH_INITIAL_SPECTATORS;
+            client_t** spectators = realloc(feed->spectators, new_capacity * sizeof(client_t*));
+            if (!spectators)
+                return false;
+            feed->spectators = spectators;
+            feed->spectator_capacity = new_capacity;
+        }
+        feed->spectators[feed->spectator_count++] = client;
+        relay_send_join(server, feed, client, seq);
+    } else {
+        if (feed->pending_count == feed->pending_capacity) {
+            int new_capacity = feed->pending_capacity ? feed->pending_capacity * 2 : MATCH_INITIAL_SPECTATORS;
+            relay_pending_t* pending = realloc(feed->pending, new_capacity * sizeof(relay_pending_t));
+            if (!pending)
+                return false;
+            feed->pending = pending;
+            feed->pending_capacity = new_capacity;
+        }
+        feed->pending[feed->pending_count].client = client;
+        feed->pending[feed->pending_count].seq = seq;
+        feed->pending_count++;
+    }
+
+    snprintf(client->spectate_match_id, sizeof(client->spectate_match_id), "%s", feed->match_id);
+    return true;
+}
+
+bool relay_leave_spectate(client_t* client, const char* match_id) {
+    if (strcmp(client->spectate_match_id, match_id) != 0)
+        return false;
+
+    relay_remove_spectator(client);
+    return true;
+}
+
+void relay_remove_spectator(client_t* client) {
+    relay_feed_t* feed = relay_find_feed(client->spectate_match_id);
+    client->spectate_match_id[0] = '\0';
+    if (!feed)
+        return;
+
+    for (int i = 0; i < feed->spectator_count; i++) {
+        if (feed->spectators[i] == client) {
+            feed->spectators[i] = feed->spectators[--feed->spectator_count];
+            break;
+        }
+    }
+    for (int i = 0; i < feed->pending_count; i++) {
+        if (feed->pending[i].client == client) {
+            feed->pending[i] = feed->pending[--feed->pending_count];
+            break;
+        }
+    }
+
+    if (feed->spectator_count == 0 && feed->pending_count == 0)
+        feed->idle_since = time(NULL);
+}
+
+char* relay_get_keyframe_json(const char* match_id) {
+    relay_feed_t* feed = relay_find_feed(match_id);
+    if (!feed || !feed->synced)
+        return NULL;
+    return relay_feed_keyframe_json(feed);
+}
+
+void relay_handle_upstream(server_t* server, client_t* upstream, const char* json) {
+    relay_feed_t* feed = relay_find_feed_by_upstream(upstream);
+    if (!feed)
+        return;
+
+    char* type = json_get_string(json, "type");
+    if (!type)
+        return;
+
+    if (strcmp(type, "response") == 0 || strcmp(type, "error") == 0) {
+        if (json_get_int(json, "seq") == feed->sync_seq) {
+            feed->sync_seq = 0;
+            message_t* msg = parse_message(json);
+            bool ok = json_get_bool(json, "success") && msg && relay_apply_keyframe(feed, msg->payload_json);
+            free_message(msg);
+
+            if (!ok) {
+                LOG_INFO("[Relay] Primary refused %s", feed->match_id);
+                free(type);
+                relay_close_feed(server, feed, true);
+                return;
+            }
+
+            /* Swap the list out: relay_join_spectate appends to it while the feed is unsynced */
+            relay_pending_t* pending = feed->pending;
+            int pending_count = feed->pending_count;
+            feed->pending = NULL;
+            feed->pending_count = 0;
+            feed->pending_capacity = 0;
+
+            for (int i = 0; i < pending_count; i++) {
+                pending[i].client->spectate_match_id[0] = '\0';
+                relay_join_spectate(server, pending[i].client, feed->match_id, pending[i].seq);
+            }
+            free(pending);
+        }
+    } else {
+        message_t* msg = parse_message(json);
+        if (strcmp(type, "opponent_move") == 0 && msg && feed->synced) {
+            relay_apply_move(server, feed, json, msg->payload_json);
+        } else if (strcmp(type, "opponent_move") == 0) {
+            relay_fanout(server, feed, json);
+        } else {
+            if (strcmp(type, "game_end") == 0)
+                feed->active = false;
+            relay_fanout(server, feed, json);
+        }
+        free_message(msg);
+    }
+
+    free(type);
+}
+
+void relay_upstream_closed(server_t* server, client_t* upstream) {
+    relay_feed_t* feed = relay_find_feed_by_upstream(upstream);
+    if (!feed)
+        return;
+
+    LOG_INFO("[Relay] Upstream for %s closed", feed->match_id);
+    feed->upstream = NULL;
+    relay_detach_spectators(server, feed, true);
+    relay_free_feed(feed);
+}
+
+int relay_reap_idle(server_t* server) {
+    time_t now = time(NULL);
+    int reaped = 0;
+
+    for (int i = feed_count - 1; i >= 0; i--) {
+        relay_feed_t* feed = feeds[i];
+        if (feed->spectator_count == 0 && feed->pending_count == 0 && now - feed->idle_since >= RELAY_IDLE_SECONDS) {
+            relay_close_feed(server, feed, false);
+            reaped++;
+        }
+    }
+
+    return reaped;
+}
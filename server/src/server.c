@@ -10,24 +10,54 @@
 #include <string.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include "../include/analysis.h"
+#include "../include/book.h"
+#include "../include/bot.h"
 #include "../include/broadcast.h"
 #include "../include/db.h"
+#include "../include/engine.h"
 #include "../include/handlers.h"
+#include "../include/leaderboard.h"
 #include "../include/lobby.h"
+#include "../include/log.h"
 #include "../include/match.h"
+#include "../include/metrics.h"
 #include "../include/protocol.h"
 #include "../include/rating.h"
+#include "../include/rating_period.h"
+#include "../include/relay.h"
 #include "../include/session.h"
-
-static server_t g_server;
-
-static void signal_handler(int sig) {
-    if (sig == SIGINT || sig == SIGTERM) {
-        printf("\nReceived signal %d, shutting down...\n", sig);
-        g_server.running = false;
-    }
+#include "../include/stats.h"
+#include "../include/tablebase.h"
+#include "../include/trace.h"
+
+/* epoll data.ptr for the worker eventfds; NULL is the listen socket and anything else a client_t */
+static char bot_event_tag;
+static char analysis_event_tag;
+
+static metrics_histogram_t* loop_histogram = NULL;
+static metrics_histogram_t* send_queue_histogram = NULL;
+static metrics_counter_t* accepted_counter = NULL;
+static metrics_counter_t* messages_counter = NULL;
+static metrics_counter_t* bytes_received_counter = NULL;
+static metrics_counter_t* bytes_sent_counter = NULL;
+static metrics_gauge_t* clients_gauge = NULL;
+static metrics_gauge_t* matches_gauge = NULL;
+
+static void server_register_metrics(void) {
+    loop_histogram = metrics_histogram("xiangqi_loop_iteration_duration_seconds",
+                                       "Time spent handling one batch of epoll events", NULL, NULL, METRICS_UNIT_NS);
+    send_queue_histogram = metrics_histogram("xiangqi_send_queue_depth", "Frames still queued after a send attempt",
+                                             NULL, NULL, METRICS_UNIT_COUNT);
+    accepted_counter = metrics_counter("xiangqi_connections_accepted_total", "Accepted client connections", NULL, NULL);
+    messages_counter = metrics_counter("xiangqi_messages_received_total", "Messages read from clients", NULL, NULL);
+    bytes_received_counter = metrics_counter("xiangqi_received_bytes_total", "Bytes read from clients", NULL, NULL);
+    bytes_sent_counter = metrics_counter("xiangqi_sent_bytes_total", "Bytes written to clients", NULL, NULL);
+    clients_gauge = metrics_gauge("xiangqi_connected_clients", "Currently connected clients");
+    matches_gauge = metrics_gauge("xiangqi_active_matches", "Matches currently in progress");
 }
 
 static int set_nonblocking(int fd) {
@@ -42,13 +72,13 @@ int server_init(server_t* server, int port) {
 
     server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server->listen_fd < 0) {
-        perror("socket");
+        LOG_ERROR("[Server] socket: %s", strerror(errno));
         return -1;
     }
 
     int opt = 1;
     if (setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        perror("setsockopt");
+        LOG_ERROR("[Server] setsockopt: %s", strerror(errno));
         close(server->listen_fd);
         return -1;
     }
@@ -60,26 +90,26 @@ int server_init(server_t* server, int port) {
     addr.sin_port = htons(port);
 
     if (bind(server->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-        perror("bind");
+        LOG_ERROR("[Server] bind: %s", strerror(errno));
         close(server->listen_fd);
         return -1;
     }
 
     if (listen(server->listen_fd, 128) < 0) {
-        perror("listen");
+        LOG_ERROR("[Server] listen: %s", strerror(errno));
         close(server->listen_fd);
         return -1;
     }
 
     if (set_nonblocking(server->listen_fd) < 0) {
-        perror("set_nonblocking");
+        LOG_ERROR("[Server] set_nonblocking: %s", strerror(errno));
         close(server->listen_fd);
         return -1;
     }
 
     server->epoll_fd = epoll_create1(0);
     if (server->epoll_fd < 0) {
-        perror("epoll_create1");
+        LOG_ERROR("[Server] epoll_create1: %s", strerror(errno));
         close(server->listen_fd);
         return -1;
     }
@@ -89,15 +119,39 @@ int server_init(server_t* server, int port) {
     ev.data.ptr = NULL;
 
     if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &ev) < 0) {
-        perror("epoll_ctl");
+        LOG_ERROR("[Server] epoll_ctl: %s", strerror(errno));
         close(server->epoll_fd);
         close(server->listen_fd);
         return -1;
     }
 
+    if (bot_event_fd() >= 0) {
+        ev.events = EPOLLIN;
+        ev.data.ptr = &bot_event_tag;
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, bot_event_fd(), &ev) < 0) {
+            LOG_ERROR("[Server] epoll_ctl bot events: %s", strerror(errno));
+            close(server->epoll_fd);
+            close(server->listen_fd);
+            return -1;
+        }
+    }
+
+    if (analysis_event_fd() >= 0) {
+        ev.events = EPOLLIN;
+        ev.data.ptr = &analysis_event_tag;
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, analysis_event_fd(), &ev) < 0) {
+            LOG_ERROR("[Server] epoll_ctl analysis events: %s", strerror(errno));
+            close(server->epoll_fd);
+            close(server->listen_fd);
+            return -1;
+        }
+    }
+
+    server_register_metrics();
+
     server->running = true;
-    printf("Server initialized on port %d\n", port);
-    printf("Listening on 0.0.0.0:%d\n", port);
+    LOG_INFO("Server initialized on port %d", port);
+    LOG_INFO("Listening on 0.0.0.0:%d", port);
 
     return 0;
 }
@@ -123,6 +177,11 @@ void client_destroy(client_t* client) {
         free(client->session_token);
     }
 
+    for (size_t i = 0; i < client->send_count; i++) {
+        frame_release(client->send_queue[(client->send_head + i) & (client->send_capacity - 1)]);
+    }
+    free(client->send_queue);
+
     if (client->fd >= 0) {
         close(client->fd);
     }
@@ -134,14 +193,26 @@ void client_disconnect(server_t* server, client_t* client) {
     if (!client)
         return;
 
-    printf("Client disconnected (fd=%d, user_id=%d)\n", client->fd, client->user_id);
+    LOG_INFO("Client disconnected (fd=%d, user_id=%d)", client->fd, client->user_id);
 
     if (client->authenticated) {
         lobby_remove_player(client->user_id);
         lobby_cleanup_rooms_for_user(client->user_id);
     }
 
+    if (client->spectate_match_id[0] != '\0') {
+        if (relay_is_enabled())
+            relay_remove_spectator(client);
+        else
+            match_remove_spectator(client->spectate_match_id, client);
+    }
+
+    if (client->upstream) {
+        relay_upstream_closed(server, client);
+    }
+
     epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    server_set_client_user(server, client, 0);
 
     for (int i = 0; i < MAX_CLIENTS; i++) {
         if (server->clients[i] == client) {
@@ -154,37 +225,177 @@ void client_disconnect(server_t* server, client_t* client) {
     client_destroy(client);
 }
 
+static size_t user_bucket(int user_id) {
+    return ((uint32_t)user_id * 2654435761u) & (CLIENT_USER_BUCKETS - 1);
+}
+
 client_t* server_get_client_by_user_id(server_t* server, int user_id) {
     if (!server || user_id <= 0)
         return NULL;
 
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (server->clients[i] && server->clients[i]->user_id == user_id) {
-            return server->clients[i];
-        }
+    for (client_t* client = server->user_index[user_bucket(user_id)]; client; client = client->user_next) {
+        if (client->user_id == user_id)
+            return client;
     }
 
     return NULL;
 }
 
-int client_send(client_t* client, const char* json) {
-    if (!client || !json)
+void server_set_client_user(server_t* server, client_t* client, int user_id) {
+    if (user_id < 0)
+        user_id = 0;
+    if (client->user_id == user_id)
+        return;
+
+    if (client->user_id > 0) {
+        client_t** link = &server->user_index[user_bucket(client->user_id)];
+        while (*link && *link != client)
+            link = &(*link)->user_next;
+        if (*link)
+            *link = client->user_next;
+        client->user_next = NULL;
+    }
+
+    client->user_id = user_id;
+
+    if (user_id > 0) {
+        client_t** head = &server->user_index[user_bucket(user_id)];
+        client->user_next = *head;
+        *head = client;
+    }
+}
+
+static void client_update_write_interest(server_t* server, client_t* client) {
+    bool want_write = client->send_count > 0;
+    if (want_write == client->want_write)
+        return;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET | (want_write ? EPOLLOUT : 0);
+    ev.data.ptr = client;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, client->fd, &ev);
+    client->want_write = want_write;
+}
+
+/* Drops everything queued and lets the reactor see the hangup on its next pass */
+static void client_fail_send(client_t* client) {
+    for (size_t i = 0; i < client->send_count; i++) {
+        frame_release(client->send_queue[(client->send_head + i) & (client->send_capacity - 1)]);
+    }
+    client->send_head = 0;
+    client->send_count = 0;
+    client->send_offset = 0;
+    client->send_bytes = 0;
+    client->send_failed = true;
+    shutdown(client->fd, SHUT_RDWR);
+}
+
+static bool client_grow_send_queue(client_t* client) {
+    size_t new_capacity = client->send_capacity ? client->send_capacity * 2 : SEND_QUEUE_INITIAL;
+    frame_t** queue = malloc(new_capacity * sizeof(frame_t*));
+    if (!queue)
+        return false;
+
+    for (size_t i = 0; i < client->send_count; i++) {
+        queue[i] = client->send_queue[(client->send_head + i) & (client->send_capacity - 1)];
+    }
+
+    free(client->send_queue);
+    client->send_queue = queue;
+    client->send_capacity = new_capacity;
+    client->send_head = 0;
+    return true;
+}
+
+int client_send_frame(server_t* server, client_t* client, frame_t* frame) {
+    if (!client || !frame || client->send_failed)
         return -1;
 
-    size_t len = strlen(json);
-    if (len >= MAX_MESSAGE_SIZE - client->send_len - 2) {
-        fprintf(stderr, "Send buffer full for client fd=%d\n", client->fd);
+    uint64_t enqueue_start = trace_clock();
+
+    if (client->send_bytes + frame->len > SEND_QUEUE_MAX_BYTES) {
+        LOG_ERROR("Send queue full for client fd=%d, dropping frame", client->fd);
         return -1;
     }
 
-    memcpy(client->send_buffer + client->send_len, json, len);
-    client->send_len += len;
-    client->send_buffer[client->send_len++] = '\n';
-    client->send_buffer[client->send_len] = '\0';
+    if (client->send_count == client->send_capacity && !client_grow_send_queue(client)) {
+        return -1;
+    }
 
+    size_t tail = (client->send_head + client->send_count) & (client->send_capacity - 1);
+    client->send_queue[tail] = frame_retain(frame);
+    client->send_count++;
+    client->send_bytes += frame->len;
+
+    client_flush(server, client);
+    metrics_observe(send_queue_histogram, client->send_count);
+    trace_span("send_enqueue", enqueue_start);
     return 0;
 }
 
+int client_send(server_t* server, client_t* client, const char* json) {
+    if (!client || !json)
+        return -1;
+
+    frame_t* frame = frame_create(json);
+    if (!frame)
+        return -1;
+
+    int result = client_send_frame(server, client, frame);
+    frame_release(frame);
+    return result;
+}
+
+void client_flush(server_t* server, client_t* client) {
+    while (client->send_count > 0) {
+        struct iovec iov[SEND_IOV_BATCH];
+        int iovcnt = 0;
+
+        for (size_t i = 0; i < client->send_count && iovcnt < SEND_IOV_BATCH; i++) {
+            frame_t* frame = client->send_queue[(client->send_head + i) & (client->send_capacity - 1)];
+            size_t skip = (i == 0) ? client->send_offset : 0;
+            iov[iovcnt].iov_base = frame->data + skip;
+            iov[iovcnt].iov_len = frame->len - skip;
+            iovcnt++;
+        }
+
+        struct msghdr hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_iov = iov;
+        hdr.msg_iovlen = iovcnt;
+
+        ssize_t n = sendmsg(client->fd, &hdr, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            LOG_ERROR("[Server] sendmsg: %s", strerror(errno));
+            client_fail_send(client);
+            return;
+        }
+
+        size_t written = (size_t)n;
+        client->send_bytes -= written;
+        metrics_counter_add(bytes_sent_counter, written);
+        while (written > 0) {
+            frame_t* head = client->send_queue[client->send_head];
+            size_t remaining = head->len - client->send_offset;
+            if (written < remaining) {
+                client->send_offset += written;
+                break;
+            }
+            written -= remaining;
+            frame_release(head);
+            client->send_head = (client->send_head + 1) & (client->send_capacity - 1);
+            client->send_count--;
+            client->send_offset = 0;
+        }
+    }
+
+    client_update_write_interest(server, client);
+}
+
 void handle_new_connection(server_t* server) {
     while (1) {
         struct sockaddr_in client_addr;
@@ -196,18 +407,18 @@ void handle_new_connection(server_t* server) {
 
                 break;
             }
-            perror("accept");
+            LOG_ERROR("[Server] accept: %s", strerror(errno));
             break;
         }
 
         if (server->client_count >= MAX_CLIENTS) {
-            printf("Max clients reached, rejecting connection\n");
+            LOG_INFO("Max clients reached, rejecting connection");
             close(client_fd);
             continue;
         }
 
         if (set_nonblocking(client_fd) < 0) {
-            perror("set_nonblocking client");
+            LOG_ERROR("[Server] set_nonblocking client: %s", strerror(errno));
             close(client_fd);
             continue;
         }
@@ -231,18 +442,20 @@ void handle_new_connection(server_t* server) {
         ev.data.ptr = client;
 
         if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
-            perror("epoll_ctl add client");
+            LOG_ERROR("[Server] epoll_ctl add client: %s", strerror(errno));
             client_disconnect(server, client);
             continue;
         }
 
-        printf("New connection from %s:%d (fd=%d)\n", inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port),
-               client_fd);
+        metrics_counter_add(accepted_counter, 1);
+        LOG_INFO("New connection from %s:%d (fd=%d)", inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port),
+                 client_fd);
     }
 }
 
-void handle_client_read(server_t* server, client_t* client) {
+bool handle_client_read(server_t* server, client_t* client) {
     while (1) {
+        uint64_t recv_start = trace_enabled() ? metrics_now_ns() : 0;
         ssize_t n =
             recv(client->fd, client->recv_buffer + client->recv_len, MAX_MESSAGE_SIZE - client->recv_len - 1, 0);
 
@@ -251,19 +464,21 @@ void handle_client_read(server_t* server, client_t* client) {
 
                 break;
             }
-            perror("recv");
+            LOG_ERROR("[Server] recv: %s", strerror(errno));
             client_disconnect(server, client);
-            return;
+            return false;
         }
 
         if (n == 0) {
 
             client_disconnect(server, client);
-            return;
+            return false;
         }
 
         client->recv_len += n;
         client->recv_buffer[client->recv_len] = '\0';
+        metrics_counter_add(bytes_received_counter, (uint64_t)n);
+        trace_recv(recv_start);
 
         char* line_start = client->recv_buffer;
         char* newline;
@@ -272,6 +487,7 @@ void handle_client_read(server_t* server, client_t* client) {
             *newline = '\0';
 
             if (strlen(line_start) > 0) {
+                metrics_counter_add(messages_counter, 1);
                 process_message(server, client, line_start);
             }
 
@@ -286,63 +502,50 @@ void handle_client_read(server_t* server, client_t* client) {
         client->recv_buffer[client->recv_len] = '\0';
 
         if (client->recv_len >= MAX_MESSAGE_SIZE - 1) {
-            fprintf(stderr, "Client recv buffer overflow (fd=%d)\n", client->fd);
+            LOG_ERROR("Client recv buffer overflow (fd=%d)", client->fd);
             client_disconnect(server, client);
-            return;
+            return false;
         }
     }
+    return true;
 }
 
 void handle_client_write(server_t* server, client_t* client) {
-    while (client->send_len > client->send_offset) {
-        ssize_t n =
-            send(client->fd, client->send_buffer + client->send_offset, client->send_len - client->send_offset, 0);
-
-        if (n < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-
-                break;
-            }
-            perror("send");
-            client_disconnect(server, client);
-            return;
-        }
-
-        client->send_offset += n;
-    }
-
-    if (client->send_offset >= client->send_len) {
-        client->send_len = 0;
-        client->send_offset = 0;
-
-        struct epoll_event ev;
-        ev.events = EPOLLIN | EPOLLET;
-        ev.data.ptr = client;
-        epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, client->fd, &ev);
-    }
+    client_flush(server, client);
 }
 
 void process_message(server_t* server, client_t* client, const char* json) {
+    if (client->upstream) {
+        relay_handle_upstream(server, client, json);
+        return;
+    }
+
+    trace_begin(client->fd);
+    uint64_t parse_start = trace_clock();
     message_t* msg = parse_message(json);
+    trace_span("parse", parse_start);
     if (!msg) {
-        fprintf(stderr, "Failed to parse message from client fd=%d: %s\n", client->fd, json);
+        LOG_ERROR("Failed to parse message from client fd=%d: %s", client->fd, json);
         char* err = create_error(0, "PARSE_ERROR", "Invalid JSON", false);
-        client_send(client, err);
+        client_send(server, client, err);
         free(err);
+        trace_end();
         return;
     }
 
-    printf("Received message type=%s seq=%d from fd=%d\n", msg->type, msg->seq, client->fd);
+    LOG_DEBUG("Received message type=%s seq=%d from fd=%d", msg->type, msg->seq, client->fd);
+    trace_set_key(msg->seq, msg->type);
 
     dispatch_handler(server, client, msg);
 
     free_message(msg);
+    trace_end();
 }
 
 void server_run(server_t* server) {
     struct epoll_event events[MAX_EVENTS];
 
-    printf("Server running...\n");
+    LOG_INFO("Server running...");
 
     while (server->running) {
         int nfds = epoll_wait(server->epoll_fd, events, MAX_EVENTS, 1000);
@@ -350,20 +553,26 @@ void server_run(server_t* server) {
         if (nfds < 0) {
             if (errno == EINTR)
                 continue;
-            perror("epoll_wait");
+            LOG_ERROR("[Server] epoll_wait: %s", strerror(errno));
             break;
         }
 
+        uint64_t iteration_start = metrics_now_ns();
+
         for (int i = 0; i < nfds; i++) {
             if (events[i].data.ptr == NULL) {
 
                 handle_new_connection(server);
+            } else if (events[i].data.ptr == &bot_event_tag) {
+                handle_bot_moves(server);
+            } else if (events[i].data.ptr == &analysis_event_tag) {
+                handle_analysis_results(server);
             } else {
 
                 client_t* client = (client_t*)events[i].data.ptr;
 
-                if (events[i].events & EPOLLIN) {
-                    handle_client_read(server, client);
+                if ((events[i].events & EPOLLIN) && !handle_client_read(server, client)) {
+                    continue;
                 }
 
                 if (events[i].events & EPOLLOUT) {
@@ -376,77 +585,42 @@ void server_run(server_t* server) {
             }
         }
 
+        if (nfds > 0)
+            metrics_observe_since(loop_histogram, iteration_start);
+
         static time_t last_cleanup = 0;
         static time_t last_timeout_check = 0;
+        static time_t last_gauge_update = 0;
         time_t now = time(NULL);
 
+        if (now != last_gauge_update) {
+            metrics_gauge_set(clients_gauge, server->client_count);
+            metrics_gauge_set(matches_gauge, match_get_active_count());
+            trace_flush();
+            last_gauge_update = now;
+        }
+
         if (now - last_timeout_check >= 5) {
             match_check_all_timeouts();
+            handle_match_timeouts(server);
 
-            timeout_info_t timeouts[100];
-            int timeout_count = match_get_pending_timeouts(timeouts, 100);
-
-            for (int i = 0; i < timeout_count; i++) {
-
-                int r1 = 1500, r2 = 1500;
-                db_get_user_by_id(timeouts[i].red_user_id, NULL, NULL, &r1, NULL, NULL, NULL);
-                db_get_user_by_id(timeouts[i].black_user_id, NULL, NULL, &r2, NULL, NULL, NULL);
-
-                rating_change_t rc = rating_calculate(r1, r2, timeouts[i].result, DEFAULT_K_FACTOR);
-
-                int new_red_rating = r1 + rc.red_change;
-                int new_black_rating = r2 + rc.black_change;
-
-                int timeout_penalty = 25;
-                if (strcmp(timeouts[i].result, "red_win") == 0) {
-                    new_black_rating -= timeout_penalty;
-                    db_update_user_stats(timeouts[i].red_user_id, 1, 0, 0);
-                    db_update_user_stats(timeouts[i].black_user_id, 0, 1, 0);
-                } else {
-                    new_red_rating -= timeout_penalty;
-                    db_update_user_stats(timeouts[i].red_user_id, 0, 1, 0);
-                    db_update_user_stats(timeouts[i].black_user_id, 1, 0, 0);
-                }
-
-                if (new_red_rating < 100)
-                    new_red_rating = 100;
-                if (new_black_rating < 100)
-                    new_black_rating = 100;
-
-                db_update_user_rating(timeouts[i].red_user_id, new_red_rating);
-                db_update_user_rating(timeouts[i].black_user_id, new_black_rating);
-
-                printf("[Timeout] Rating: Red(%d->%d), Black(%d->%d), Penalty: %d\n", r1, new_red_rating, r2,
-                       new_black_rating, timeout_penalty);
-
-                char payload[1024];
-                snprintf(payload, sizeof(payload),
-                         "{\"match_id\":\"%.63s\",\"result\":\"%.15s\",\"reason\":"
-                         "\"timeout\","
-                         "\"red_rating\":%d,\"black_rating\":%d}",
-                         timeouts[i].match_id, timeouts[i].result, new_red_rating, new_black_rating);
-                char notify[1280];
-                snprintf(notify, sizeof(notify), "{\"type\":\"game_end\",\"payload\":%s}\n", payload);
-
-                send_to_user(server, timeouts[i].red_user_id, notify);
-                send_to_user(server, timeouts[i].black_user_id, notify);
-
-                printf("[Server] Broadcast timeout: %s -> %s\n", timeouts[i].match_id, timeouts[i].result);
-            }
-
+            rating_period_tick(now);
             last_timeout_check = now;
         }
 
         if (now - last_cleanup > 60) {
             session_cleanup_expired();
             lobby_cleanup_expired_challenges();
+            match_reap_finished();
+            if (relay_is_enabled())
+                relay_reap_idle(server);
             last_cleanup = now;
         }
     }
 }
 
 void server_shutdown(server_t* server) {
-    printf("Shutting down server...\n");
+    LOG_INFO("Shutting down server...");
 
     for (int i = 0; i < MAX_CLIENTS; i++) {
         if (server->clients[i]) {
@@ -462,17 +636,74 @@ void server_shutdown(server_t* server) {
         close(server->listen_fd);
     }
 
+    if (relay_is_enabled())
+        relay_shutdown(server);
+
+    bot_shutdown();
+    analysis_shutdown();
+    book_close();
+    tb_shutdown();
     lobby_shutdown();
     match_shutdown();
     session_shutdown();
+    rating_period_shutdown();
+    stats_shutdown();
+    leaderboard_shutdown();
     db_shutdown();
+    trace_shutdown();
+    metrics_shutdown();
 
-    printf("Server shut down complete.\n");
+    LOG_INFO("Server shut down complete.");
+}
+
+/* bench/micro links every server module and brings its own entry point */
+#ifndef XIANGQI_NO_MAIN
+static server_t g_server;
+
+static volatile sig_atomic_t received_signal = 0;
+
+/* Only async-signal-safe work here; the shutdown is logged once server_run returns */
+static void signal_handler(int sig) {
+    if (sig == SIGINT || sig == SIGTERM) {
+        received_signal = sig;
+        g_server.running = false;
+    }
+}
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s <port> [--relay <primary_host>:<primary_port>] [--db <spec>] [--metrics <port>]\n"
+                    "       [--log-level <level>] [--log-rate <n>] [--trace <file>] [--bot-threads <n>]\n", prog);
+    fprintf(stderr, "  --db memory               in-process store, nothing persisted\n");
+    fprintf(stderr, "  --db \"odbc:<conn string>\" SQL Server (default in ODBC builds: local XiangqiDB)\n");
+    fprintf(stderr, "  XIANGQI_DB in the environment is used when --db is not given\n");
+    fprintf(stderr, "  --metrics <port>          serve Prometheus metrics on 127.0.0.1:<port>\n");
+    fprintf(stderr, "  --log-level <level>       debug, info, warn, error or off (default info; XIANGQI_LOG_LEVEL)\n");
+    fprintf(stderr, "  --trace <file>            write Chrome trace events for sampled messages to <file>\n");
+    fprintf(stderr, "  --trace-sample <n>        trace 1 in <n> messages (default %d)\n", TRACE_DEFAULT_SAMPLE);
+    fprintf(stderr, "  --trace-min-us <n>        only keep traces that took at least <n> microseconds\n");
+    fprintf(stderr, "  --log-rate <n>            messages per second per log statement, 0 = unlimited (default %d)\n",
+            LOG_DEFAULT_RATE_LIMIT);
+    fprintf(stderr, "  --bot-threads <n>         engine threads for computer opponents, 0 = disabled (default %d)\n",
+            BOT_DEFAULT_THREADS);
+    fprintf(stderr, "  --search-threads <n>      Lazy SMP threads per bot search (default %d)\n",
+            BOT_DEFAULT_SEARCH_THREADS);
+    fprintf(stderr, "  --engine-hash <mb>        transposition table per bot worker (default %d)\n",
+            ENGINE_DEFAULT_HASH_MB);
+    fprintf(stderr, "  --engine-cpus <list>      pin engine threads to these cpus, e.g. 2-7\n");
+    fprintf(stderr, "  --book <file>             opening book built by bin/bookgen, for bots and replay labels\n");
+    fprintf(stderr, "  --tablebases <dir>        endgame tablebases built by bin/tbgen, for bots and adjudication\n");
+    fprintf(stderr, "  --analysis-threads <n>    idle-priority post-game analysis workers, 0 = disabled (default %d)\n",
+            ANALYSIS_DEFAULT_THREADS);
+    fprintf(stderr, "  --analysis-depth <n>      fixed search depth for post-game analysis (default %d)\n",
+            ANALYSIS_DEFAULT_DEPTH);
+    fprintf(stderr, "  --rating <system>         elo (per game) or glicko2 (per rating period) (default elo)\n");
+    fprintf(stderr, "  --rating-period <s>       Glicko-2 rating period in seconds (default %d)\n",
+            RATING_PERIOD_DEFAULT_SECONDS);
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <port>\n", argv[0]);
+    if (argc < 2) {
+        print_usage(argv[0]);
         return 1;
     }
 
@@ -482,28 +713,171 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    const char* conn_str = "Driver={ODBC Driver 17 for SQL "
-                           "Server};Server=localhost;Database=XiangqiDB;"
-                           "UID=sa;PWD=Hieudo@831;";
+    const char* relay_addr = NULL;
+    const char* db_spec = getenv("XIANGQI_DB");
+    int metrics_port = 0;
+    const char* log_level = getenv("XIANGQI_LOG_LEVEL");
+    int log_rate = LOG_DEFAULT_RATE_LIMIT;
+    const char* trace_path = NULL;
+    int trace_sample = TRACE_DEFAULT_SAMPLE;
+    int trace_min_us = 0;
+    int bot_threads = BOT_DEFAULT_THREADS;
+    int search_threads = BOT_DEFAULT_SEARCH_THREADS;
+    int engine_hash_mb = ENGINE_DEFAULT_HASH_MB;
+    const char* engine_cpus = NULL;
+    const char* book_path = NULL;
+    const char* tablebase_dir = NULL;
+    int analysis_threads = ANALYSIS_DEFAULT_THREADS;
+    int analysis_depth = ANALYSIS_DEFAULT_DEPTH;
+    const char* rating_system = "elo";
+    int rating_period = RATING_PERIOD_DEFAULT_SECONDS;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--relay") == 0 && i + 1 < argc) {
+            relay_addr = argv[++i];
+        } else if (strcmp(argv[i], "--db") == 0 && i + 1 < argc) {
+            db_spec = argv[++i];
+        } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            metrics_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            log_level = argv[++i];
+        } else if (strcmp(argv[i], "--log-rate") == 0 && i + 1 < argc) {
+            log_rate = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--trace-sample") == 0 && i + 1 < argc) {
+            trace_sample = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--trace-min-us") == 0 && i + 1 < argc) {
+            trace_min_us = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bot-threads") == 0 && i + 1 < argc) {
+            bot_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--search-threads") == 0 && i + 1 < argc) {
+            search_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--engine-hash") == 0 && i + 1 < argc) {
+            engine_hash_mb = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--engine-cpus") == 0 && i + 1 < argc) {
+            engine_cpus = argv[++i];
+        } else if (strcmp(argv[i], "--book") == 0 && i + 1 < argc) {
+            book_path = argv[++i];
+        } else if (strcmp(argv[i], "--tablebases") == 0 && i + 1 < argc) {
+            tablebase_dir = argv[++i];
+        } else if (strcmp(argv[i], "--analysis-threads") == 0 && i + 1 < argc) {
+            analysis_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--analysis-depth") == 0 && i + 1 < argc) {
+            analysis_depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rating") == 0 && i + 1 < argc) {
+            rating_system = argv[++i];
+        } else if (strcmp(argv[i], "--rating-period") == 0 && i + 1 < argc) {
+            rating_period = atoi(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (strcmp(rating_system, "elo") != 0 && strcmp(rating_system, "glicko2") != 0) {
+        fprintf(stderr, "Invalid rating system: %s\n", rating_system);
+        return 1;
+    }
+
+    if (log_level && log_level[0]) {
+        int level = log_level_from_name(log_level);
+        if (level < 0) {
+            fprintf(stderr, "Invalid log level: %s\n", log_level);
+            return 1;
+        }
+        log_set_level(level);
+    }
+    log_set_rate_limit(log_rate);
+
+    /* atexit so the early error returns below still flush what they logged */
+    if (log_init())
+        atexit(log_shutdown);
 
-    if (!db_init(conn_str)) {
-        fprintf(stderr, "Failed to initialize database\n");
-        fprintf(stderr, "Connection string: %s\n", conn_str);
+    metrics_init();
+    if (trace_path && !trace_init(trace_path, trace_sample, trace_min_us))
         return 1;
+    if (metrics_port > 0 && !metrics_http_start(metrics_port)) {
+        LOG_ERROR("Failed to start metrics endpoint on port %d", metrics_port);
+        return 1;
+    }
+
+    if (relay_addr) {
+        /* Relay processes only serve spectators and never touch the database */
+        char primary_host[256];
+        snprintf(primary_host, sizeof(primary_host), "%s", relay_addr);
+        char* colon = strrchr(primary_host, ':');
+        if (!colon) {
+            LOG_ERROR("Invalid primary address: %s", relay_addr);
+            return 1;
+        }
+        *colon = '\0';
+
+        if (!relay_init(primary_host, atoi(colon + 1))) {
+            LOG_ERROR("Invalid primary address: %s", relay_addr);
+            return 1;
+        }
+    } else {
+        if (!db_spec || !db_spec[0]) {
+#ifdef DB_DEFAULT_SPEC
+            LOG_INFO("[Server] No --db given, using the default SQL Server connection");
+            db_spec = DB_DEFAULT_SPEC;
+#else
+            LOG_ERROR("[Server] No --db given and this build has no ODBC; pass --db memory to run without persistence");
+            return 1;
+#endif
+        }
+
+        if (!db_init(db_spec)) {
+            LOG_ERROR("Failed to initialize database");
+            return 1;
+        }
+
+        if (!leaderboard_init()) {
+            LOG_ERROR("Failed to load the leaderboard");
+            return 1;
+        }
+
+        if (!stats_init()) {
+            LOG_ERROR("Failed to load profile stats");
+            return 1;
+        }
+
+        if (!rating_period_init(strcmp(rating_system, "glicko2") == 0, rating_period)) {
+            LOG_ERROR("Failed to initialize ratings");
+            return 1;
+        }
     }
 
     if (!session_init()) {
-        fprintf(stderr, "Failed to initialize session manager\n");
+        LOG_ERROR("Failed to initialize session manager");
         return 1;
     }
 
     if (!lobby_init()) {
-        fprintf(stderr, "Failed to initialize lobby\n");
+        LOG_ERROR("Failed to initialize lobby");
         return 1;
     }
 
     if (!match_init()) {
-        fprintf(stderr, "Failed to initialize match manager\n");
+        LOG_ERROR("Failed to initialize match manager");
+        return 1;
+    }
+
+    if (book_path && !relay_addr && !book_open(book_path))
+        return 1;
+
+    if (tablebase_dir && !relay_addr && tb_init(tablebase_dir) < 0)
+        return 1;
+
+    /* Bots play through the database accounts, which relays do not have */
+    if (!bot_init(relay_addr ? 0 : bot_threads, search_threads, engine_hash_mb, engine_cpus)) {
+        LOG_ERROR("Failed to initialize computer opponents");
+        return 1;
+    }
+
+    /* Relays never save matches, so they have nothing to analyse */
+    if (!analysis_init(relay_addr ? 0 : analysis_threads, analysis_depth, engine_hash_mb)) {
+        LOG_ERROR("Failed to initialize post-game analysis");
         return 1;
     }
 
@@ -516,7 +890,10 @@ int main(int argc, char* argv[]) {
     }
 
     server_run(&g_server);
+    if (received_signal)
+        LOG_INFO("Received signal %d, shutting down...", (int)received_signal);
     server_shutdown(&g_server);
 
     return 0;
 }
+#endif
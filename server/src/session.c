@@ -1,5 +1,6 @@
 #include "../include/session.h"
 #include "../include/db.h"
+#include "../include/log.h"
 
 #include <fcntl.h>
 #include <stdio.h>
@@ -28,7 +29,7 @@ static void generate_token(char* token) {
         }
     }
 
-    fprintf(stderr, "[WARNING] /dev/urandom failed, falling back to rand()\n");
+    LOG_WARN("/dev/urandom failed, falling back to rand()");
     for (int i = 0; i < 64; i++) {
         token[i] = charset[rand() % 16];
     }
@@ -46,12 +47,12 @@ char* session_create(int user_id) {
     generate_token(token);
 
     if (!db_session_create(token, user_id, SESSION_EXPIRES_HOURS)) {
-        fprintf(stderr, "[Session] Failed to create session in DB\n");
+        LOG_ERROR("[Session] Failed to create session in DB");
         return NULL;
     }
 
     char* token_copy = strdup(token);
-    printf("[Session] Created session for user %d\n", user_id);
+    LOG_DEBUG("[Session] Created session for user %d", user_id);
     return token_copy;
 }
 
@@ -76,5 +77,5 @@ void session_cleanup_expired(void) {
 }
 
 void session_shutdown(void) {
-    printf("[Session] Shutdown complete\n");
+    LOG_INFO("[Session] Shutdown complete");
 }
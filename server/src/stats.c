@@ -0,0 +1,313 @@
+#include "../include/stats.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/db.h"
+#include "../include/leaderboard.h"
+#include "../include/log.h"
+#include "../include/metrics.h"
+
+typedef struct {
+    int wins;
+    int losses;
+    int draws;
+} stats_tally_t;
+
+typedef struct {
+    int opponent_id;
+    stats_tally_t tally;
+} stats_opponent_t;
+
+typedef struct {
+    uint32_t ended_at;
+    int32_t delta;
+} stats_point_t;
+
+typedef struct {
+    stats_tally_t colors[2]; /* red, black */
+    int streak;              /* +n after n straight wins, -n after n straight losses, 0 after a draw */
+    int best_win_streak;
+
+    stats_point_t* points; /* oldest first, at most STATS_RATING_POINTS */
+    int point_count;
+    int point_capacity;
+
+    stats_opponent_t* opponents; /* sorted by opponent_id */
+    int opponent_count;
+    int opponent_capacity;
+} stats_user_t;
+
+static struct {
+    bool ready;
+    stats_user_t** by_id; /* indexed by user_id; NULL until the player's first game */
+    int by_id_capacity;
+    int players;
+    int pairs;
+} st = {0};
+
+static metrics_gauge_t* pairs_gauge = NULL;
+
+static bool grow(void** array, int* capacity, int needed, size_t elem_size) {
+    if (needed <= *capacity)
+        return true;
+    int new_capacity = *capacity ? *capacity * 2 : 8;
+    while (new_capacity < needed)
+        new_capacity *= 2;
+    void* grown = realloc(*array, (size_t)new_capacity * elem_size);
+    if (!grown)
+        return false;
+    *array = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+static stats_user_t* find(int user_id) {
+    return user_id > 0 && user_id < st.by_id_capacity ? st.by_id[user_id] : NULL;
+}
+
+static stats_user_t* find_or_add(int user_id) {
+    stats_user_t* user = find(user_id);
+    if (user || user_id <= 0)
+        return user;
+
+    if (user_id >= st.by_id_capacity) {
+        int capacity = st.by_id_capacity ? st.by_id_capacity : 1024;
+        while (capacity <= user_id)
+            capacity *= 2;
+        stats_user_t** grown = realloc(st.by_id, (size_t)capacity * sizeof(stats_user_t*));
+        if (!grown)
+            return NULL;
+        memset(grown + st.by_id_capacity, 0, (size_t)(capacity - st.by_id_capacity) * sizeof(stats_user_t*));
+        st.by_id = grown;
+        st.by_id_capacity = capacity;
+    }
+
+    user = calloc(1, sizeof(stats_user_t));
+    if (user) {
+        st.by_id[user_id] = user;
+        st.players++;
+    }
+    return user;
+}
+
+/* Binary search; a new zeroed record is inserted in order when the pair has not played before */
+static stats_opponent_t* find_opponent(stats_user_t* user, int opponent_id) {
+    int low = 0, high = user->opponent_count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (user->opponents[mid].opponent_id < opponent_id)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low < user->opponent_count && user->opponents[low].opponent_id == opponent_id)
+        return &user->opponents[low];
+
+    if (!grow((void**)&user->opponents, &user->opponent_capacity, user->opponent_count + 1, sizeof(stats_opponent_t)))
+        return NULL;
+    memmove(&user->opponents[low + 1], &user->opponents[low],
+            (size_t)(user->opponent_count - low) * sizeof(stats_opponent_t));
+    memset(&user->opponents[low], 0, sizeof(stats_opponent_t));
+    user->opponents[low].opponent_id = opponent_id;
+    user->opponent_count++;
+    metrics_gauge_set(pairs_gauge, ++st.pairs);
+    return &user->opponents[low];
+}
+
+static void add_point(stats_user_t* user, long ended_at, int delta) {
+    if (user->point_count == STATS_RATING_POINTS) {
+        memmove(&user->points[0], &user->points[1], (STATS_RATING_POINTS - 1) * sizeof(stats_point_t));
+        user->point_count--;
+    } else if (!grow((void**)&user->points, &user->point_capacity, user->point_count + 1, sizeof(stats_point_t))) {
+        return;
+    }
+    user->points[user->point_count].ended_at = (uint32_t)ended_at;
+    user->points[user->point_count].delta = delta;
+    user->point_count++;
+}
+
+static void tally_add(stats_tally_t* tally, int outcome) {
+    if (outcome > 0)
+        tally->wins++;
+    else if (outcome < 0)
+        tally->losses++;
+    else
+        tally->draws++;
+}
+
+static bool visit_user_match(const db_user_match_t* row, void* ctx) {
+    (void)ctx;
+    stats_record(row->user_id, row->opponent_id, strcmp(row->color, "red") == 0, row->result,
+                 strtol(row->ended_at, NULL, 10), row->rating_delta);
+    return true;
+}
+
+bool stats_init(void) {
+    stats_shutdown();
+    st.ready = true;
+
+    if (!pairs_gauge)
+        pairs_gauge = metrics_gauge("xiangqi_stats_opponent_pairs", "Head-to-head records held in memory");
+
+    uint64_t start = metrics_now_ns();
+    int rows = db_for_each_user_match(visit_user_match, NULL);
+    if (rows < 0) {
+        LOG_ERROR("[Stats] Failed to load match results");
+        stats_shutdown();
+        return false;
+    }
+
+    LOG_INFO("[Stats] %d results for %d players loaded in %llu ms", rows, st.players,
+             (unsigned long long)((metrics_now_ns() - start) / 1000000));
+    return true;
+}
+
+void stats_shutdown(void) {
+    metrics_gauge_set(pairs_gauge, 0);
+    for (int i = 0; i < st.by_id_capacity; i++) {
+        if (st.by_id[i]) {
+            free(st.by_id[i]->points);
+            free(st.by_id[i]->opponents);
+            free(st.by_id[i]);
+        }
+    }
+    free(st.by_id);
+    memset(&st, 0, sizeof(st));
+}
+
+bool stats_ready(void) {
+    return st.ready;
+}
+
+void stats_record(int user_id, int opponent_id, bool red, const char* result, long ended_at, int rating_delta) {
+    if (!st.ready || !result)
+        return;
+    stats_user_t* user = find_or_add(user_id);
+    if (!user)
+        return;
+
+    int outcome = strcmp(result, "win") == 0 ? 1 : strcmp(result, "loss") == 0 ? -1 : 0;
+
+    tally_add(&user->colors[red ? 0 : 1], outcome);
+    stats_opponent_t* opponent = find_opponent(user, opponent_id);
+    if (opponent)
+        tally_add(&opponent->tally, outcome);
+
+    if (outcome > 0)
+        user->streak = user->streak > 0 ? user->streak + 1 : 1;
+    else if (outcome < 0)
+        user->streak = user->streak < 0 ? user->streak - 1 : -1;
+    else
+        user->streak = 0;
+    if (user->streak > user->best_win_streak)
+        user->best_win_streak = user->streak;
+
+    /* Unrated games leave the curve flat, so only real changes are kept */
+    if (rating_delta != 0)
+        add_point(user, ended_at, rating_delta);
+}
+
+void stats_rating_changed(int user_id, long at, int rating_delta) {
+    stats_user_t* user = st.ready && rating_delta != 0 ? find_or_add(user_id) : NULL;
+    if (user)
+        add_point(user, at, rating_delta);
+}
+
+static int games(const stats_opponent_t* opponent) {
+    return opponent->tally.wins + opponent->tally.losses + opponent->tally.draws;
+}
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t capacity;
+    bool failed;
+} text_buffer_t;
+
+static void text_append(text_buffer_t* buf, const char* fmt, ...) {
+    while (!buf->failed) {
+        size_t room = buf->capacity - buf->len;
+        va_list args;
+        va_start(args, fmt);
+        int n = buf->data ? vsnprintf(buf->data + buf->len, room, fmt, args) : -1;
+        va_end(args);
+
+        if (n >= 0 && (size_t)n < room) {
+            buf->len += (size_t)n;
+            return;
+        }
+
+        size_t new_capacity = buf->capacity ? buf->capacity * 2 : 1024;
+        if (n >= 0 && new_capacity < buf->len + (size_t)n + 1)
+            new_capacity = buf->len + (size_t)n + 1;
+        char* grown = realloc(buf->data, new_capacity);
+        if (!grown)
+            buf->failed = true;
+        else {
+            buf->data = grown;
+            buf->capacity = new_capacity;
+        }
+    }
+}
+
+char* stats_profile_json(int user_id) {
+    const stats_user_t* user = st.ready ? find(user_id) : NULL;
+    if (!user)
+        return NULL;
+
+    text_buffer_t buf = {0};
+    const stats_tally_t* red = &user->colors[0];
+    const stats_tally_t* black = &user->colors[1];
+    text_append(&buf,
+                "{\"colors\":{\"red\":{\"wins\":%d,\"losses\":%d,\"draws\":%d},"
+                "\"black\":{\"wins\":%d,\"losses\":%d,\"draws\":%d}},"
+                "\"streak\":{\"current\":%d,\"best_win\":%d},\"rating_history\":[",
+                red->wins, red->losses, red->draws, black->wins, black->losses, black->draws, user->streak,
+                user->best_win_streak);
+
+    /* Points hold deltas; the curve is rebuilt backwards from the current rating */
+    int current = leaderboard_rating(user_id);
+    if (current > 0 && user->point_count > 0) {
+        int ratings[STATS_RATING_POINTS];
+        for (int i = user->point_count - 1; i >= 0; i--) {
+            ratings[i] = current;
+            current -= user->points[i].delta;
+        }
+        for (int i = 0; i < user->point_count; i++)
+            text_append(&buf, "%s[%u,%d]", i ? "," : "", (unsigned)user->points[i].ended_at, ratings[i]);
+    }
+
+    /* Most played opponents first: a partial insertion sort into the top slots */
+    const stats_opponent_t* top[STATS_TOP_OPPONENTS];
+    int top_count = 0;
+    for (int i = 0; i < user->opponent_count; i++) {
+        const stats_opponent_t* candidate = &user->opponents[i];
+        int slot = top_count < STATS_TOP_OPPONENTS ? top_count++ : STATS_TOP_OPPONENTS;
+        while (slot > 0 && games(top[slot - 1]) < games(candidate)) {
+            if (slot < STATS_TOP_OPPONENTS)
+                top[slot] = top[slot - 1];
+            slot--;
+        }
+        if (slot < STATS_TOP_OPPONENTS)
+            top[slot] = candidate;
+    }
+
+    text_append(&buf, "],\"head_to_head\":[");
+    for (int i = 0; i < top_count; i++) {
+        const char* username = leaderboard_username(top[i]->opponent_id);
+        text_append(&buf, "%s{\"user_id\":%d,\"username\":\"%s\",\"wins\":%d,\"losses\":%d,\"draws\":%d}",
+                    i ? "," : "", top[i]->opponent_id, username ? username : "", top[i]->tally.wins,
+                    top[i]->tally.losses, top[i]->tally.draws);
+    }
+    text_append(&buf, "]}");
+
+    if (buf.failed) {
+        free(buf.data);
+        return NULL;
+    }
+    return buf.data;
+}
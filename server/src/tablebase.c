@@ -0,0 +1,404 @@
+#include "../include/tablebase.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/log.h"
+
+#define TB_MAX_TABLES 64
+#define NO_DOMAIN 0xFF
+#define FLIP(sq) SQUARE(BOARD_ROWS - 1 - SQUARE_ROW(sq), SQUARE_COL(sq))
+
+typedef struct {
+    tb_material_t material;
+    void* map;
+    size_t map_size;
+    const tb_header_t* header;
+    const uint32_t* offsets;
+    const uint8_t* data;
+} tb_table_t;
+
+static struct {
+    tb_table_t tables[TB_MAX_TABLES];
+    int count;
+    int max_pieces;
+} tb = {0};
+
+/* Piece letters by type, as in material names */
+static const char type_letter[8] = {'.', 'K', 'A', 'E', 'H', 'R', 'C', 'P'};
+/* Order of the non-general pieces of a side within a name and within the index */
+static const int type_order[6] = {PIECE_CHARIOT, PIECE_HORSE, PIECE_CANNON, PIECE_PAWN, PIECE_ADVISOR, PIECE_ELEPHANT};
+/* Rough material weights, only used to decide which side is the stronger one */
+static const int type_strength[8] = {0, 0, 1, 1, 4, 9, 5, 2};
+
+/* Per piece code: the squares it can stand on in any reachable position, ascending, and the reverse map */
+static uint8_t domain_squares[16][BOARD_SQUARES];
+static uint8_t domain_size[16];
+static uint8_t domain_index[16][BOARD_SQUARES];
+static pthread_once_t domains_once = PTHREAD_ONCE_INIT;
+
+/* Red's view: red sits on rows 7-9 and crosses the river at row 4 */
+static bool red_reachable(int type, int row, int col) {
+    switch (type) {
+    case PIECE_KING:
+        return row >= 7 && col >= 3 && col <= 5;
+    case PIECE_ADVISOR:
+        return row >= 7 && col >= 3 && col <= 5 && (row + col) % 2 == 0;
+    case PIECE_ELEPHANT:
+        return row >= 5 && col % 2 == 0 && (row - 5) % 2 == 0 && (row == 7) == (col % 4 == 0);
+    case PIECE_PAWN:
+        return row <= 4 || ((row == 5 || row == 6) && col % 2 == 0);
+    default:
+        return true;
+    }
+}
+
+static void init_domains(void) {
+    memset(domain_index, NO_DOMAIN, sizeof(domain_index));
+    for (int type = PIECE_KING; type <= PIECE_PAWN; type++) {
+        for (int color = 0; color < 2; color++) {
+            int code = type | (color ? PIECE_BLACK : 0);
+            for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+                int red_sq = color ? FLIP(sq) : sq;
+                if (!red_reachable(type, SQUARE_ROW(red_sq), SQUARE_COL(red_sq)))
+                    continue;
+                domain_index[code][sq] = domain_size[code];
+                domain_squares[code][domain_size[code]++] = (uint8_t)sq;
+            }
+        }
+    }
+}
+
+/* Red is the stronger side, or the material is symmetric */
+static bool red_is_stronger(const int counts[2][8]) {
+    int strength[2] = {0, 0};
+    for (int color = 0; color < 2; color++) {
+        for (int type = 0; type < 8; type++)
+            strength[color] += counts[color][type] * type_strength[type];
+    }
+    if (strength[0] != strength[1])
+        return strength[0] > strength[1];
+    for (int i = 0; i < 6; i++) {
+        if (counts[0][type_order[i]] != counts[1][type_order[i]])
+            return counts[0][type_order[i]] > counts[1][type_order[i]];
+    }
+    return true;
+}
+
+static bool material_build(const int counts[2][8], tb_material_t* out) {
+    pthread_once(&domains_once, init_domains);
+    memset(out, 0, sizeof(*out));
+
+    int extra = 0;
+    for (int color = 0; color < 2; color++) {
+        for (int i = 0; i < 6; i++) {
+            int type = type_order[i];
+            if (counts[color][type] > 3)
+                return false;
+            extra += counts[color][type];
+            out->key |= (uint32_t)counts[color][type] << (2 * (color * 6 + type - PIECE_ADVISOR));
+        }
+    }
+    if (extra > TB_MAX_EXTRA)
+        return false;
+
+    int len = 0, slot = 0;
+    out->pieces[slot++] = PIECE_KING;
+    out->pieces[slot++] = PIECE_KING | PIECE_BLACK;
+    for (int color = 0; color < 2; color++) {
+        out->name[len++] = 'K';
+        for (int i = 0; i < 6; i++) {
+            for (int n = 0; n < counts[color][type_order[i]]; n++) {
+                out->name[len++] = type_letter[type_order[i]];
+                out->pieces[slot++] = (uint8_t)(type_order[i] | (color ? PIECE_BLACK : 0));
+            }
+        }
+    }
+    out->name[len] = '\0';
+    out->piece_count = slot;
+
+    out->size = 2;
+    for (int i = 0; i < slot; i++) {
+        out->domains[i] = domain_size[out->pieces[i]];
+        out->size *= out->domains[i];
+    }
+    return true;
+}
+
+static void swap_colors(int counts[2][8]) {
+    for (int type = 0; type < 8; type++) {
+        int t = counts[0][type];
+        counts[0][type] = counts[1][type];
+        counts[1][type] = t;
+    }
+}
+
+bool tb_material_parse(const char* name, tb_material_t* out) {
+    int counts[2][8] = {{0}};
+    int color = -1;
+    for (const char* p = name; *p; p++) {
+        const char* hit = memchr(type_letter + 1, *p, 7);
+        if (!hit || (color < 0 && *p != 'K'))
+            return false;
+        int type = (int)(hit - type_letter);
+        if (type == PIECE_KING) {
+            if (++color > 1)
+                return false;
+            continue;
+        }
+        counts[color][type]++;
+    }
+    if (color != 1)
+        return false;
+
+    if (!red_is_stronger(counts))
+        swap_colors(counts);
+    return material_build(counts, out);
+}
+
+bool tb_material_of(const board_t* board, tb_material_t* out, bool* mirrored) {
+    int counts[2][8] = {{0}};
+    int pieces = 0;
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        uint8_t piece = board->squares[sq];
+        if (piece == PIECE_NONE)
+            continue;
+        if (++pieces > TB_MAX_PIECES)
+            return false;
+        counts[PIECE_IS_BLACK(piece)][PIECE_TYPE(piece)]++;
+    }
+    if (counts[0][PIECE_KING] != 1 || counts[1][PIECE_KING] != 1)
+        return false;
+
+    *mirrored = !red_is_stronger(counts);
+    if (*mirrored)
+        swap_colors(counts);
+    return material_build(counts, out);
+}
+
+uint64_t tb_index(const tb_material_t* material, const board_t* board, bool black, bool mirrored) {
+    uint32_t digits[TB_MAX_PIECES];
+    bool used[TB_MAX_PIECES] = {false};
+    int placed = 0;
+
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        uint8_t piece = board->squares[sq];
+        if (piece == PIECE_NONE)
+            continue;
+        int at = sq;
+        if (mirrored) {
+            piece ^= PIECE_BLACK;
+            at = FLIP(sq);
+        }
+
+        int slot = 0;
+        while (slot < material->piece_count && (used[slot] || material->pieces[slot] != piece))
+            slot++;
+        if (slot == material->piece_count || domain_index[piece][at] == NO_DOMAIN)
+            return TB_NO_INDEX;
+        used[slot] = true;
+        digits[slot] = domain_index[piece][at];
+        placed++;
+    }
+    if (placed != material->piece_count)
+        return TB_NO_INDEX;
+
+    /* Interchangeable pieces are stored in ascending square order only */
+    for (int i = 1; i < material->piece_count; i++) {
+        for (int j = i; j > 0 && material->pieces[j] == material->pieces[j - 1] && digits[j] < digits[j - 1]; j--) {
+            uint32_t t = digits[j];
+            digits[j] = digits[j - 1];
+            digits[j - 1] = t;
+        }
+    }
+
+    uint64_t index = 0;
+    for (int i = 0; i < material->piece_count; i++)
+        index = index * material->domains[i] + digits[i];
+    /* Side to move is the most significant digit: neighbouring entries then share it and compress together */
+    return (black != mirrored ? material->size / 2 : 0) + index;
+}
+
+bool tb_decode(const tb_material_t* material, uint64_t index, board_t* board, bool* black) {
+    uint32_t digits[TB_MAX_PIECES];
+    uint64_t half = material->size / 2;
+    *black = index >= half;
+    index %= half;
+    for (int i = material->piece_count - 1; i >= 0; i--) {
+        digits[i] = (uint32_t)(index % material->domains[i]);
+        index /= material->domains[i];
+    }
+
+    memset(board, 0, sizeof(*board));
+    for (int i = 0; i < material->piece_count; i++) {
+        if (i > 0 && material->pieces[i] == material->pieces[i - 1] && digits[i] <= digits[i - 1])
+            return false;
+        int sq = domain_squares[material->pieces[i]][digits[i]];
+        if (board->squares[sq] != PIECE_NONE)
+            return false;
+        board->squares[sq] = material->pieces[i];
+    }
+    return true;
+}
+
+bool tb_value_decode(uint8_t value, tb_result_t* out) {
+    if (value == TB_INVALID)
+        return false;
+    if (value == TB_DRAW) {
+        out->wdl = 0;
+        out->dtm = 0;
+        return true;
+    }
+    out->dtm = value - 1;
+    out->wdl = out->dtm % 2 ? 1 : -1;
+    return true;
+}
+
+static bool open_table(const char* path) {
+    if (tb.count == TB_MAX_TABLES) {
+        LOG_WARN("[Tablebase] Ignoring %s: more than %d tables", path, TB_MAX_TABLES);
+        return false;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERROR("[Tablebase] Cannot open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(tb_header_t)) {
+        LOG_ERROR("[Tablebase] %s is not a tablebase", path);
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void* map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        LOG_ERROR("[Tablebase] mmap %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    const tb_header_t* header = map;
+    tb_table_t* table = &tb.tables[tb.count];
+    size_t data_at = sizeof(tb_header_t) + ((size_t)header->block_count + 1) * sizeof(uint32_t);
+    char name[sizeof(header->name) + 1];
+    memcpy(name, header->name, sizeof(header->name));
+    name[sizeof(header->name)] = '\0';
+
+    const char* problem = NULL;
+    if (memcmp(header->magic, TB_MAGIC, sizeof(header->magic)) != 0)
+        problem = "bad magic";
+    else if (header->version != TB_VERSION)
+        problem = "unsupported version";
+    else if (!tb_material_parse(name, &table->material) || strcmp(name, table->material.name) != 0 ||
+             header->material_key != table->material.key)
+        problem = "unknown material";
+    else if (header->entry_count != table->material.size || header->block_size != TB_BLOCK_SIZE ||
+             header->block_count != (header->entry_count + TB_BLOCK_SIZE - 1) / TB_BLOCK_SIZE)
+        problem = "built with a different indexing";
+    else if (data_at > size ||
+             data_at + ((const uint32_t*)((const char*)map + sizeof(tb_header_t)))[header->block_count] != size)
+        problem = "truncated or oversized";
+
+    for (int i = 0; i < tb.count && !problem; i++) {
+        if (tb.tables[i].material.key == table->material.key)
+            problem = "duplicate material";
+    }
+
+    if (problem) {
+        LOG_ERROR("[Tablebase] Rejecting %s: %s", path, problem);
+        munmap(map, size);
+        return false;
+    }
+
+    madvise(map, size, MADV_RANDOM);
+    table->map = map;
+    table->map_size = size;
+    table->header = header;
+    table->offsets = (const uint32_t*)((const char*)map + sizeof(tb_header_t));
+    table->data = (const uint8_t*)map + data_at;
+    tb.count++;
+    if (table->material.piece_count > tb.max_pieces)
+        tb.max_pieces = table->material.piece_count;
+
+    LOG_INFO("[Tablebase] %s: %llu positions, %zu KB, longest mate %u plies", table->material.name,
+             (unsigned long long)header->entry_count, size / 1024, header->max_dtm);
+    return true;
+}
+
+int tb_init(const char* dir) {
+    tb_shutdown();
+
+    DIR* d = opendir(dir);
+    if (!d) {
+        LOG_ERROR("[Tablebase] Cannot open directory %s: %s", dir, strerror(errno));
+        return -1;
+    }
+
+    struct dirent* entry;
+    size_t suffix_len = strlen(TB_FILE_SUFFIX);
+    while ((entry = readdir(d)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len <= suffix_len || strcmp(entry->d_name + len - suffix_len, TB_FILE_SUFFIX) != 0)
+            continue;
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        open_table(path);
+    }
+    closedir(d);
+
+    LOG_INFO("[Tablebase] %d table(s) loaded from %s", tb.count, dir);
+    return tb.count;
+}
+
+void tb_shutdown(void) {
+    for (int i = 0; i < tb.count; i++)
+        munmap(tb.tables[i].map, tb.tables[i].map_size);
+    memset(&tb, 0, sizeof(tb));
+}
+
+int tb_max_pieces(void) {
+    return tb.max_pieces;
+}
+
+static uint8_t table_value(const tb_table_t* table, uint64_t index) {
+    uint64_t block = index / TB_BLOCK_SIZE;
+    uint32_t skip = (uint32_t)(index % TB_BLOCK_SIZE);
+    const uint8_t* p = table->data + table->offsets[block];
+    const uint8_t* end = table->data + table->offsets[block + 1];
+    for (; p + 1 < end; p += 2) {
+        if (skip < p[0])
+            return p[1];
+        skip -= p[0];
+    }
+    return TB_INVALID;
+}
+
+bool tb_probe(const board_t* board, bool black, tb_result_t* out) {
+    if (tb.count == 0)
+        return false;
+
+    tb_material_t material;
+    bool mirrored;
+    if (!tb_material_of(board, &material, &mirrored))
+        return false;
+
+    for (int i = 0; i < tb.count; i++) {
+        const tb_table_t* table = &tb.tables[i];
+        if (table->material.key != material.key)
+            continue;
+        uint64_t index = tb_index(&table->material, board, black, mirrored);
+        return index != TB_NO_INDEX && tb_value_decode(table_value(table, index), out);
+    }
+    return false;
+}
@@ -0,0 +1,158 @@
+#include "../include/trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/log.h"
+#include "../include/metrics.h"
+
+typedef struct {
+    const char* name;
+    uint64_t start_ns;
+    uint64_t end_ns;
+} trace_span_t;
+
+typedef struct {
+    int fd;
+    int seq;
+    char type[32];
+    uint64_t start_ns;
+    int span_count;
+    trace_span_t spans[TRACE_MAX_SPANS];
+} trace_t;
+
+static FILE* trace_file = NULL;
+static int sample_every = TRACE_DEFAULT_SAMPLE;
+static uint64_t min_duration_ns = 0;
+static uint64_t message_counter = 0;
+static uint64_t events_written = 0;
+static int pid = 0;
+
+/* Window of the last recv(); cleared once a traced message claims it */
+static uint64_t recv_start_ns = 0;
+static uint64_t recv_end_ns = 0;
+
+static trace_t current;
+static _Thread_local trace_t* active = NULL;
+
+bool trace_init(const char* path, int every, int min_duration_us) {
+    trace_file = fopen(path, "w");
+    if (!trace_file) {
+        LOG_ERROR("[Trace] Cannot open %s", path);
+        return false;
+    }
+
+    sample_every = every > 0 ? every : 1;
+    min_duration_ns = min_duration_us > 0 ? (uint64_t)min_duration_us * 1000 : 0;
+    pid = (int)getpid();
+
+    setvbuf(trace_file, NULL, _IOFBF, 1 << 16);
+    fputs("[\n", trace_file);
+
+    LOG_INFO("[Trace] Tracing 1 in %d messages to %s", sample_every, path);
+    return true;
+}
+
+void trace_shutdown(void) {
+    if (!trace_file)
+        return;
+
+    fputs("\n]\n", trace_file);
+    fclose(trace_file);
+    trace_file = NULL;
+    LOG_INFO("[Trace] Wrote %llu events", (unsigned long long)events_written);
+}
+
+bool trace_enabled(void) {
+    return trace_file != NULL;
+}
+
+void trace_flush(void) {
+    if (trace_file)
+        fflush(trace_file);
+}
+
+uint64_t trace_clock(void) {
+    return active ? metrics_now_ns() : 0;
+}
+
+void trace_recv(uint64_t start_ns) {
+    if (!trace_file || start_ns == 0)
+        return;
+    recv_start_ns = start_ns;
+    recv_end_ns = metrics_now_ns();
+}
+
+bool trace_begin(int fd) {
+    if (!trace_file || active)
+        return false;
+    if (message_counter++ % (uint64_t)sample_every != 0)
+        return false;
+
+    current.fd = fd;
+    current.seq = 0;
+    strcpy(current.type, "message");
+    current.span_count = 0;
+    current.start_ns = metrics_now_ns();
+
+    if (recv_start_ns != 0) {
+        current.start_ns = recv_start_ns;
+        current.spans[current.span_count++] = (trace_span_t){"recv", recv_start_ns, recv_end_ns};
+        recv_start_ns = 0;
+    }
+
+    active = &current;
+    return true;
+}
+
+void trace_set_key(int seq, const char* type) {
+    if (!active)
+        return;
+    active->seq = seq;
+    if (!type)
+        return;
+
+    /* The type comes straight from the client, so keep only characters that need no JSON escaping */
+    size_t len = 0;
+    for (; type[len] && len < sizeof(active->type) - 1; len++) {
+        char c = type[len];
+        bool plain = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+        active->type[len] = plain ? c : '?';
+    }
+    active->type[len] = '\0';
+}
+
+void trace_span(const char* name, uint64_t start_ns) {
+    if (!active || start_ns == 0 || active->span_count >= TRACE_MAX_SPANS)
+        return;
+    active->spans[active->span_count++] = (trace_span_t){name, start_ns, metrics_now_ns()};
+}
+
+/* Complete ("X") event; Chrome timestamps are microseconds */
+static void write_event(const char* name, uint64_t start_ns, uint64_t end_ns, int fd, const char* args) {
+    fprintf(trace_file,
+            "%s{\"name\":\"%s\",\"cat\":\"xiangqi\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d%s}",
+            events_written > 0 ? ",\n" : "", name, start_ns / 1000.0, (end_ns - start_ns) / 1000.0, pid, fd, args);
+    events_written++;
+}
+
+void trace_end(void) {
+    if (!active)
+        return;
+
+    trace_t* trace = active;
+    active = NULL;
+
+    uint64_t end_ns = metrics_now_ns();
+    if (end_ns - trace->start_ns < min_duration_ns)
+        return;
+
+    char args[96];
+    snprintf(args, sizeof(args), ",\"args\":{\"fd\":%d,\"seq\":%d}", trace->fd, trace->seq);
+    write_event(trace->type, trace->start_ns, end_ns, trace->fd, args);
+
+    for (int i = 0; i < trace->span_count; i++)
+        write_event(trace->spans[i].name, trace->spans[i].start_ns, trace->spans[i].end_ns, trace->fd, "");
+}
@@ -0,0 +1,449 @@
+#define _DEFAULT_SOURCE
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/board.h"
+#include "../include/book.h"
+#include "../include/db.h"
+#include "../include/engine.h"
+
+/*
+ * Opening book builder. Replays the first plies of every saved match (from the Matches table through the
+ * normal storage backends, or from a "result<TAB>moves_json" export) and counts, per position, how each move
+ * scored for the side that played it. Moves seen in enough games are weighted by the points they earned; a
+ * handful of named main lines are always included so fresh servers still get a repertoire and names.
+ *
+ *   bin/bookgen --db "odbc:Driver={...};Server=localhost;Database=XiangqiDB;..." -o book.bin
+ *   bin/bookgen -i matches.tsv -o book.bin -p 20 -m 3
+ */
+
+#define DEFAULT_MIN_GAMES 3
+#define DEFAULT_OUTPUT "book.bin"
+
+typedef struct {
+    const char* name;
+    const char* moves; /* ICCS from the initial position */
+} named_line_t;
+
+static const named_line_t named_lines[] = {
+    {"Pháo đầu", "h2e2"},
+    {"Pháo đầu", "b2e2"},
+    {"Thuận pháo", "h2e2 h7e7"},
+    {"Nghịch pháo", "h2e2 b7e7"},
+    {"Thuận pháo trực xa đối hoành xa", "h2e2 h7e7 h0g2 h9g7 i0h0 i9i8"},
+    {"Pháo đầu đối bình phong mã", "h2e2 h9g7 h0g2 b9c7"},
+    {"Pháo đầu xe qua hà đối bình phong mã", "h2e2 h9g7 h0g2 b9c7 i0h0 i9h9 h0h6"},
+    {"Phi tượng cục", "c0e2"},
+    {"Phi tượng cục", "g0e2"},
+    {"Phi tượng đối pháo đầu", "c0e2 h7e7"},
+    {"Tiên nhân chỉ lộ", "c3c4"},
+    {"Tiên nhân chỉ lộ", "g3g4"},
+    {"Đối binh cục", "c3c4 c6c5"},
+    {"Khởi mã cục", "b0c2"},
+    {"Khởi mã cục", "h0g2"},
+    {"Sĩ giác pháo", "b2d2"},
+    {"Sĩ giác pháo", "h2f2"},
+    {"Quá cung pháo", "h2d2"},
+    {"Quá cung pháo", "b2f2"},
+};
+
+#define NAMED_LINE_COUNT (sizeof(named_lines) / sizeof(named_lines[0]))
+
+typedef struct {
+    uint8_t from;
+    uint8_t to;
+    bool seeded;
+    uint32_t games;
+    uint32_t points; /* 2 per win, 1 per draw, for the side that played the move */
+} gen_move_t;
+
+typedef struct {
+    uint64_t key;
+    int name; /* index into names, -1 for none */
+    gen_move_t* moves;
+    int move_count;
+    int move_capacity;
+} gen_position_t;
+
+static struct {
+    int max_ply;
+    int min_games;
+} opts = {BOOK_MAX_PLY, DEFAULT_MIN_GAMES};
+
+/* Open addressing on the position key; capacity is a power of two */
+static gen_position_t* table = NULL;
+static size_t table_capacity = 0;
+static size_t table_count = 0;
+
+static const char* names[NAMED_LINE_COUNT];
+static int name_count = 0;
+
+static long games_read = 0;
+static long games_used = 0;
+
+static bool table_grow(void);
+
+static gen_position_t* position_get(uint64_t key) {
+    if ((table_count + 1) * 2 > table_capacity && !table_grow())
+        return NULL;
+
+    size_t mask = table_capacity - 1;
+    for (size_t i = (size_t)key & mask;; i = (i + 1) & mask) {
+        gen_position_t* pos = &table[i];
+        if (pos->key == key)
+            return pos;
+        if (!pos->key) {
+            pos->key = key;
+            pos->name = -1;
+            table_count++;
+            return pos;
+        }
+    }
+}
+
+static bool table_grow(void) {
+    size_t new_capacity = table_capacity ? table_capacity * 2 : 4096;
+    gen_position_t* grown = calloc(new_capacity, sizeof(gen_position_t));
+    if (!grown)
+        return false;
+
+    for (size_t i = 0; i < table_capacity; i++) {
+        if (!table[i].key)
+            continue;
+        size_t j = (size_t)table[i].key & (new_capacity - 1);
+        while (grown[j].key)
+            j = (j + 1) & (new_capacity - 1);
+        grown[j] = table[i];
+    }
+    free(table);
+    table = grown;
+    table_capacity = new_capacity;
+    return true;
+}
+
+static gen_move_t* position_move(gen_position_t* pos, int from, int to) {
+    for (int i = 0; i < pos->move_count; i++) {
+        if (pos->moves[i].from == from && pos->moves[i].to == to)
+            return &pos->moves[i];
+    }
+    if (pos->move_count == pos->move_capacity) {
+        int new_capacity = pos->move_capacity ? pos->move_capacity * 2 : 4;
+        gen_move_t* grown = realloc(pos->moves, (size_t)new_capacity * sizeof(gen_move_t));
+        if (!grown)
+            return NULL;
+        pos->moves = grown;
+        pos->move_capacity = new_capacity;
+    }
+    gen_move_t* move = &pos->moves[pos->move_count++];
+    memset(move, 0, sizeof(*move));
+    move->from = (uint8_t)from;
+    move->to = (uint8_t)to;
+    return move;
+}
+
+static bool is_legal(const board_t* board, bool black, int from, int to) {
+    board_move_t moves[BOARD_MAX_MOVES];
+    int count = board_generate_moves(board, black, moves);
+    for (int i = 0; i < count; i++) {
+        if (moves[i].from == from && moves[i].to == to)
+            return true;
+    }
+    return false;
+}
+
+/* ICCS: files a-i left to right from red's side, ranks 0-9 from red's back rank */
+static int parse_square(const char* s) {
+    if (s[0] < 'a' || s[0] > 'i' || s[1] < '0' || s[1] > '9')
+        return -1;
+    return SQUARE(9 - (s[1] - '0'), s[0] - 'a');
+}
+
+static bool add_named_line(const named_line_t* line) {
+    int name = -1;
+    for (int i = 0; i < name_count && name < 0; i++) {
+        if (strcmp(names[i], line->name) == 0)
+            name = i;
+    }
+    if (name < 0) {
+        names[name_count] = line->name;
+        name = name_count++;
+    }
+
+    board_t board;
+    board_init(&board);
+    bool black = false;
+    for (const char* m = line->moves; *m;) {
+        int from = parse_square(m);
+        int to = from >= 0 ? parse_square(m + 2) : -1;
+        if (to < 0 || !is_legal(&board, black, from, to)) {
+            fprintf(stderr, "%s: illegal move at \"%.4s\"\n", line->name, m);
+            return false;
+        }
+
+        gen_position_t* pos = position_get(engine_position_key(&board, black));
+        gen_move_t* move = pos ? position_move(pos, from, to) : NULL;
+        if (!move)
+            return false;
+        move->seeded = true;
+
+        board_apply(&board, from, to);
+        black = !black;
+        m += 4;
+        while (*m == ' ')
+            m++;
+    }
+
+    gen_position_t* end = position_get(engine_position_key(&board, black));
+    if (!end)
+        return false;
+    end->name = name;
+    return true;
+}
+
+static bool add_game(const char* result, const char* moves_json, void* ctx) {
+    (void)ctx;
+    games_read++;
+
+    int winner; /* 0 red, 1 black, 2 draw */
+    if (strcmp(result, "red_win") == 0)
+        winner = 0;
+    else if (strcmp(result, "black_win") == 0)
+        winner = 1;
+    else if (strcmp(result, "draw") == 0)
+        winner = 2;
+    else
+        return true;
+
+    board_t board;
+    board_init(&board);
+    const char* p = moves_json;
+    for (int ply = 0; ply < opts.max_ply && (p = strstr(p, "{\"from\":")) != NULL; ply++, p++) {
+        int from_row, from_col, to_row, to_col;
+        if (sscanf(p, "{\"from\":{\"row\":%d,\"col\":%d},\"to\":{\"row\":%d,\"col\":%d}", &from_row, &from_col,
+                   &to_row, &to_col) != 4)
+            break;
+        bool black = ply % 2 == 1;
+        int from = SQUARE(from_row, from_col);
+        int to = SQUARE(to_row, to_col);
+        if (from_row < 0 || from_row >= BOARD_ROWS || from_col < 0 || from_col >= BOARD_COLS || to_row < 0 ||
+            to_row >= BOARD_ROWS || to_col < 0 || to_col >= BOARD_COLS || !is_legal(&board, black, from, to))
+            break;
+
+        gen_position_t* pos = position_get(engine_position_key(&board, black));
+        gen_move_t* move = pos ? position_move(pos, from, to) : NULL;
+        if (!move)
+            return false;
+        move->games++;
+        move->points += winner == 2 ? 1 : winner == (black ? 1 : 0) ? 2 : 0;
+
+        board_apply(&board, from, to);
+    }
+    games_used++;
+    return true;
+}
+
+static bool read_export(const char* path) {
+    FILE* in = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return false;
+    }
+
+    char* line = NULL;
+    size_t line_capacity = 0;
+    bool ok = true;
+    while (ok && getline(&line, &line_capacity, in) > 0) {
+        char* tab = strchr(line, '\t');
+        if (!tab)
+            continue;
+        *tab = '\0';
+        ok = add_game(line, tab + 1, NULL);
+    }
+
+    free(line);
+    if (in != stdin)
+        fclose(in);
+    return ok;
+}
+
+/* Keeps moves seen in enough games that scored at least once, plus the seeded main lines */
+static uint16_t move_weight(const gen_move_t* move) {
+    uint32_t weight = move->seeded ? 1 : 0;
+    if ((int)move->games >= opts.min_games)
+        weight += move->points;
+    return weight > 0xFFFF ? 0xFFFF : (uint16_t)weight;
+}
+
+static int compare_keys(const void* a, const void* b) {
+    uint64_t ka = (*(gen_position_t* const*)a)->key;
+    uint64_t kb = (*(gen_position_t* const*)b)->key;
+    return ka < kb ? -1 : ka > kb;
+}
+
+static int compare_weights(const void* a, const void* b) {
+    return (int)move_weight(b) - (int)move_weight(a);
+}
+
+/* In-order walk of the implicit tree assigns sorted positions to their breadth-first slots */
+static size_t eytzinger(gen_position_t** sorted, gen_position_t** out, size_t i, size_t k, size_t n) {
+    if (k <= n) {
+        i = eytzinger(sorted, out, i, 2 * k, n);
+        out[k] = sorted[i++];
+        i = eytzinger(sorted, out, i, 2 * k + 1, n);
+    }
+    return i;
+}
+
+static bool write_book(const char* path) {
+    /* Drop moves without weight, then positions left with neither moves nor a name */
+    size_t n = 0;
+    uint32_t total_moves = 0;
+    gen_position_t** sorted = malloc((table_count + 1) * sizeof(gen_position_t*));
+    gen_position_t** layout = calloc(table_count + 1, sizeof(gen_position_t*));
+    if (!sorted || !layout)
+        return false;
+
+    for (size_t i = 0; i < table_capacity; i++) {
+        gen_position_t* pos = &table[i];
+        if (!pos->key)
+            continue;
+        qsort(pos->moves, (size_t)pos->move_count, sizeof(gen_move_t), compare_weights);
+        while (pos->move_count > 0 && move_weight(&pos->moves[pos->move_count - 1]) == 0)
+            pos->move_count--;
+        if (pos->move_count > BOOK_MAX_MOVES)
+            pos->move_count = BOOK_MAX_MOVES;
+        if (pos->move_count == 0 && pos->name < 0)
+            continue;
+        sorted[n++] = pos;
+        total_moves += (uint32_t)pos->move_count;
+    }
+    qsort(sorted, n, sizeof(gen_position_t*), compare_keys);
+    eytzinger(sorted, layout, 0, 1, n);
+
+    FILE* out = fopen(path, "wb");
+    if (!out) {
+        perror(path);
+        return false;
+    }
+
+    uint32_t names_size = 0;
+    for (int i = 0; i < name_count; i++)
+        names_size += (uint32_t)strlen(names[i]) + 1;
+
+    book_header_t header = {0};
+    memcpy(header.magic, BOOK_MAGIC, sizeof(header.magic));
+    header.version = BOOK_VERSION;
+    header.position_count = (uint32_t)n;
+    header.move_count = total_moves;
+    header.name_count = (uint32_t)name_count;
+    header.names_size = names_size;
+    board_t start;
+    board_init(&start);
+    header.start_key = engine_position_key(&start, false);
+    fwrite(&header, sizeof(header), 1, out);
+
+    uint64_t key = 0;
+    fwrite(&key, sizeof(key), 1, out);
+    for (size_t k = 1; k <= n; k++)
+        fwrite(&layout[k]->key, sizeof(uint64_t), 1, out);
+
+    book_position_t slot = {0, 0, BOOK_NO_NAME};
+    fwrite(&slot, sizeof(slot), 1, out);
+    uint32_t first = 0;
+    for (size_t k = 1; k <= n; k++) {
+        slot.first_move = first;
+        slot.move_count = (uint16_t)layout[k]->move_count;
+        slot.name = layout[k]->name >= 0 ? (uint16_t)layout[k]->name : BOOK_NO_NAME;
+        fwrite(&slot, sizeof(slot), 1, out);
+        first += (uint32_t)layout[k]->move_count;
+    }
+
+    for (size_t k = 1; k <= n; k++) {
+        for (int i = 0; i < layout[k]->move_count; i++) {
+            const gen_move_t* m = &layout[k]->moves[i];
+            book_move_t move = {m->from, m->to, move_weight(m)};
+            fwrite(&move, sizeof(move), 1, out);
+        }
+    }
+
+    uint32_t offset = 0;
+    for (int i = 0; i < name_count; i++) {
+        fwrite(&offset, sizeof(offset), 1, out);
+        offset += (uint32_t)strlen(names[i]) + 1;
+    }
+    for (int i = 0; i < name_count; i++)
+        fwrite(names[i], strlen(names[i]) + 1, 1, out);
+
+    bool ok = !ferror(out);
+    ok = fclose(out) == 0 && ok;
+    printf("%s: %zu positions, %u moves, %d names from %ld of %ld games\n", path, n, total_moves, name_count,
+           games_used, games_read);
+
+    free(sorted);
+    free(layout);
+    return ok;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s (--db <spec> | -i <file>) [-o book.bin] [-p plies] [-m games]\n", prog);
+    fprintf(stderr, "  --db   read the Matches table through a storage backend, e.g. \"odbc:DSN=...\"\n");
+    fprintf(stderr, "  -i     read \"result<TAB>moves_json\" lines instead (- for stdin)\n");
+    fprintf(stderr, "  -o     output file (default %s)\n", DEFAULT_OUTPUT);
+    fprintf(stderr, "  -p     follow games this many plies deep (default and maximum %d)\n", BOOK_MAX_PLY);
+    fprintf(stderr, "  -m     a move needs this many games to be weighted (default %d)\n", DEFAULT_MIN_GAMES);
+}
+
+int main(int argc, char* argv[]) {
+    const char* db_spec = NULL;
+    const char* input = NULL;
+    const char* output = DEFAULT_OUTPUT;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--db") == 0 && i + 1 < argc)
+            db_spec = argv[++i];
+        else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            input = argv[++i];
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            output = argv[++i];
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+            opts.max_ply = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+            opts.min_games = atoi(argv[++i]);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if ((!db_spec && !input) || opts.max_ply < 1 || opts.max_ply > BOOK_MAX_PLY || opts.min_games < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (size_t i = 0; i < NAMED_LINE_COUNT; i++) {
+        if (!add_named_line(&named_lines[i]))
+            return 1;
+    }
+
+    if (input && !read_export(input))
+        return 1;
+
+    if (db_spec) {
+        if (!db_init(db_spec)) {
+            fprintf(stderr, "Cannot open database %s\n", db_spec);
+            return 1;
+        }
+        int visited = db_for_each_match(add_game, NULL);
+        db_shutdown();
+        if (visited < 0) {
+            fprintf(stderr, "Reading Matches failed\n");
+            return 1;
+        }
+    }
+
+    return write_book(output) ? 0 : 1;
+}
@@ -0,0 +1,542 @@
+#define _DEFAULT_SOURCE
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/db.h"
+#include "../include/rating.h"
+
+/*
+ * Rating replay. Reads every rated game in the order it ended (the Matches table through the normal storage
+ * backends) and recomputes every player's rating from scratch, either under the server's Elo (rating_calculate with
+ * a fixed K) or under Glicko-2 with rating deviation and volatility. Elo replays also charge the loser of a game
+ * that ended by timeout (Matches.end_reason) the server's RATING_TIMEOUT_PENALTY; Glicko-2 has no such penalty.
+ *
+ * Elo depends on the order of every single game and runs on one thread; it is a few arithmetic operations a game.
+ * Glicko-2 updates every player of a rating period against the ratings from before the period, so the players of
+ * a busy period are split between threads the way tbgen splits a round.
+ *
+ * Results go to a TSV report and, with --apply, back into Users a few hundred rows per statement. A row is only
+ * written while the player still has the rating the replay read, so the tool runs against a live database: players
+ * whose rating the server changed meanwhile are counted as skipped and a second run picks them up. --reload then
+ * asks the server on 127.0.0.1 to reload its leaderboard. Glicko-2 runs also write each player's deviation and
+ * volatility, which is how a server switching to --rating glicko2 gets its starting state.
+ *
+ *   bin/rerate --db "odbc:Driver={...};Server=localhost;Database=XiangqiDB;..." -s glicko2 -o ratings.tsv
+ *   bin/rerate --db "odbc:..." -s elo --apply --reload 8080
+ *   bin/rerate --synthetic 5000000 -P 200000 -j 8        # timing run without a database
+ */
+
+#define DEFAULT_PERIOD GLICKO2_DEFAULT_PERIOD
+#define PARALLEL_MIN_PLAYERS 1024
+#define CHUNK 64
+
+typedef struct {
+    int32_t red;
+    int32_t black;
+    uint32_t ended_at;
+    uint8_t red_points; /* 2 for a red win, 1 for a draw, 0 for a black win */
+    bool timeout;       /* lost on time: the Elo loser pays RATING_TIMEOUT_PENALTY */
+} game_t;
+
+typedef struct {
+    bool known;     /* listed in Users */
+    int old_rating; /* as read from Users */
+    int games;
+    double rating;
+    double rd;
+    double volatility;
+    int last_period; /* -1 before the first game */
+    int stamp;       /* 1 + the period the player was last gathered for */
+    int slot;        /* index in that period's touched list */
+} player_t;
+
+/* One player of a rating period: their results are entries[first .. first + count) */
+typedef struct {
+    int user_id;
+    int first;
+    int count;
+} touched_t;
+
+typedef enum { SYSTEM_ELO, SYSTEM_GLICKO2 } rating_system_t;
+
+static struct {
+    rating_system_t system;
+    int k_factor;
+    long period;
+    double tau;
+    int threads;
+} opts = {SYSTEM_GLICKO2, DEFAULT_K_FACTOR, DEFAULT_PERIOD, GLICKO2_TAU, 1};
+
+static game_t* games = NULL;
+static size_t game_count = 0;
+static size_t game_capacity = 0;
+
+static player_t* players = NULL; /* indexed by user_id */
+static int player_capacity = 0;
+static long rated_until = 0; /* end of the last Glicko-2 period replayed */
+
+static const char* const result_names[3] = {"black_win", "draw", "red_win"};
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static player_t* player(int user_id) {
+    if (user_id <= 0)
+        return NULL;
+    if (user_id >= player_capacity) {
+        int capacity = player_capacity ? player_capacity : 1024;
+        while (capacity <= user_id)
+            capacity *= 2;
+        player_t* grown = realloc(players, (size_t)capacity * sizeof(player_t));
+        if (!grown)
+            return NULL;
+        memset(grown + player_capacity, 0, (size_t)(capacity - player_capacity) * sizeof(player_t));
+        players = grown;
+        player_capacity = capacity;
+    }
+    return &players[user_id];
+}
+
+static bool add_game(int red, int black, long ended_at, int red_points, bool timeout) {
+    if (!player(red) || !player(black) || red == black)
+        return false;
+    if (game_count == game_capacity) {
+        size_t capacity = game_capacity ? game_capacity * 2 : 65536;
+        game_t* grown = realloc(games, capacity * sizeof(game_t));
+        if (!grown)
+            return false;
+        games = grown;
+        game_capacity = capacity;
+    }
+    games[game_count++] = (game_t){red, black, (uint32_t)ended_at, (uint8_t)red_points, timeout};
+    return true;
+}
+
+static bool visit_match(const db_rated_match_t* match, void* ctx) {
+    size_t* skipped = ctx;
+    int red_points = -1;
+    for (int i = 0; i < 3; i++) {
+        if (strcmp(match->result, result_names[i]) == 0)
+            red_points = i;
+    }
+    bool timeout = match->end_reason && strcmp(match->end_reason, "timeout") == 0;
+    if (red_points < 0 || !add_game(match->red_user_id, match->black_user_id, match->ended_at, red_points, timeout))
+        (*skipped)++;
+    return true;
+}
+
+static bool visit_user(int user_id, const char* username, int rating, int wins, int losses, int draws, void* ctx) {
+    (void)username;
+    (void)wins;
+    (void)losses;
+    (void)draws;
+    (void)ctx;
+    player_t* p = player(user_id);
+    if (p) {
+        p->known = true;
+        p->old_rating = rating;
+    }
+    return p != NULL;
+}
+
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/* Uniformly paired players with hidden strengths, games spread evenly over two years */
+static bool make_synthetic(size_t count, int player_count) {
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+
+    double* strength = malloc((size_t)(player_count + 1) * sizeof(double));
+    if (!strength || !player(player_count))
+        return false;
+    for (int i = 1; i <= player_count; i++) {
+        double sum = 0;
+        for (int k = 0; k < 4; k++)
+            sum += (double)(next_random(&rng) % 1000) / 1000.0;
+        strength[i] = DEFAULT_RATING + (sum - 2.0) * 350.0;
+        players[i].known = true;
+        players[i].old_rating = DEFAULT_RATING;
+    }
+
+    long start = 1600000000;
+    double step = 2.0 * 365 * 24 * 3600 / (double)count;
+    for (size_t g = 0; g < count; g++) {
+        int red = 1 + (int)(next_random(&rng) % (uint64_t)player_count);
+        int black = 1 + (int)(next_random(&rng) % (uint64_t)(player_count - 1));
+        if (black >= red)
+            black++;
+        double expected = 1.0 / (1.0 + pow(10.0, (strength[black] - strength[red]) / 400.0));
+        double roll = (double)(next_random(&rng) % 1000000) / 1000000.0;
+        int red_points = roll < 0.1 ? 1 : roll < 0.1 + 0.9 * expected ? 2 : 0;
+        if (!add_game(red, black, start + (long)(g * step), red_points, false)) {
+            free(strength);
+            return false;
+        }
+    }
+    free(strength);
+    return true;
+}
+
+static void replay_elo(void) {
+    for (int i = 0; i < player_capacity; i++)
+        players[i].rating = DEFAULT_RATING;
+
+    for (size_t g = 0; g < game_count; g++) {
+        player_t* red = &players[games[g].red];
+        player_t* black = &players[games[g].black];
+        rating_change_t rc =
+            rating_calculate((int)red->rating, (int)black->rating, result_names[games[g].red_points], opts.k_factor);
+        red->rating += rc.red_change;
+        black->rating += rc.black_change;
+        /* Same order as finish_match: the rated change first, then the penalty, floored at RATING_FLOOR */
+        if (games[g].timeout && games[g].red_points != 1) {
+            player_t* loser = games[g].red_points == 2 ? black : red;
+            loser->rating -= RATING_TIMEOUT_PENALTY;
+            if (loser->rating < RATING_FLOOR)
+                loser->rating = RATING_FLOOR;
+        }
+        red->games++;
+        black->games++;
+    }
+}
+
+typedef struct {
+    const touched_t* touched;
+    int touched_count;
+    const glicko2_result_t* entries;
+    glicko2_rating_t* out;
+    int next;
+} period_t;
+
+static void* period_worker(void* arg) {
+    period_t* period = arg;
+    for (;;) {
+        int start = __atomic_fetch_add(&period->next, CHUNK, __ATOMIC_RELAXED);
+        if (start >= period->touched_count)
+            break;
+        int end = start + CHUNK < period->touched_count ? start + CHUNK : period->touched_count;
+        for (int i = start; i < end; i++) {
+            const touched_t* t = &period->touched[i];
+            const player_t* p = &players[t->user_id];
+            glicko2_rating_t current = {p->rating, p->rd, p->volatility};
+            period->out[i] = glicko2_update(current, &period->entries[t->first], t->count, opts.tau);
+        }
+    }
+    return NULL;
+}
+
+static void run_period(period_t* period) {
+    pthread_t threads[256];
+    int started = 0;
+    if (period->touched_count >= PARALLEL_MIN_PLAYERS) {
+        for (int i = 1; i < opts.threads && started < 256; i++) {
+            if (pthread_create(&threads[started], NULL, period_worker, period) == 0)
+                started++;
+        }
+    }
+    period_worker(period);
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+}
+
+/* Gathers the player into the period, first widening their deviation for the periods they sat out */
+static touched_t* gather(touched_t* touched, int* touched_count, int user_id, int period_index) {
+    player_t* p = &players[user_id];
+    if (p->stamp != period_index + 1) {
+        p->stamp = period_index + 1;
+        p->slot = (*touched_count)++;
+        touched[p->slot] = (touched_t){user_id, 0, 0};
+        if (p->last_period >= 0 && period_index - p->last_period > 1)
+            p->rd = glicko2_idle_rd(p->rd, p->volatility, period_index - p->last_period - 1);
+    }
+    return &touched[p->slot];
+}
+
+static bool replay_glicko2(void) {
+    for (int i = 0; i < player_capacity; i++) {
+        players[i].rating = DEFAULT_RATING;
+        players[i].rd = GLICKO2_DEFAULT_RD;
+        players[i].volatility = GLICKO2_DEFAULT_VOLATILITY;
+        players[i].last_period = -1;
+    }
+    if (game_count == 0)
+        return true;
+
+    /* Sized for the busiest period the first time round, then grown when a bigger one comes along */
+    size_t capacity = 0;
+    touched_t* touched = NULL;
+    glicko2_result_t* entries = NULL;
+    glicko2_rating_t* out = NULL;
+    int* fill = NULL;
+
+    /* Periods line up with the server's --rating glicko2 periods, whole multiples of the length in unix time */
+    uint32_t origin = games[0].ended_at - games[0].ended_at % (uint32_t)opts.period;
+    int last_index = 0;
+    for (size_t first = 0; first < game_count;) {
+        int period_index = (int)((games[first].ended_at - origin) / (uint32_t)opts.period);
+        size_t end = first;
+        while (end < game_count && (int)((games[end].ended_at - origin) / (uint32_t)opts.period) == period_index)
+            end++;
+
+        size_t needed = 2 * (end - first);
+        if (needed > capacity) {
+            free(touched), free(entries), free(out), free(fill);
+            touched = malloc(needed * sizeof(touched_t));
+            entries = malloc(needed * sizeof(glicko2_result_t));
+            out = malloc(needed * sizeof(glicko2_rating_t));
+            fill = malloc(needed * sizeof(int));
+            capacity = needed;
+            if (!touched || !entries || !out || !fill) {
+                free(touched), free(entries), free(out), free(fill);
+                return false;
+            }
+        }
+
+        int touched_count = 0;
+        for (size_t g = first; g < end; g++) {
+            gather(touched, &touched_count, games[g].red, period_index)->count++;
+            gather(touched, &touched_count, games[g].black, period_index)->count++;
+        }
+        int offset = 0;
+        for (int i = 0; i < touched_count; i++) {
+            touched[i].first = fill[i] = offset;
+            offset += touched[i].count;
+        }
+
+        /* Every result is scored against the opponent as they stood before the period */
+        for (size_t g = first; g < end; g++) {
+            const player_t* red = &players[games[g].red];
+            const player_t* black = &players[games[g].black];
+            double red_score = games[g].red_points / 2.0;
+            entries[fill[red->slot]++] = (glicko2_result_t){black->rating, black->rd, red_score};
+            entries[fill[black->slot]++] = (glicko2_result_t){red->rating, red->rd, 1.0 - red_score};
+        }
+
+        period_t period = {touched, touched_count, entries, out, 0};
+        run_period(&period);
+
+        for (int i = 0; i < touched_count; i++) {
+            player_t* p = &players[touched[i].user_id];
+            p->rating = out[i].rating;
+            p->rd = out[i].rd;
+            p->volatility = out[i].volatility;
+            p->games += touched[i].count;
+            p->last_period = period_index;
+        }
+        last_index = period_index;
+        first = end;
+    }
+
+    /* Deviations as of the last period, so long-idle players show their uncertainty */
+    for (int i = 0; i < player_capacity; i++) {
+        if (players[i].last_period >= 0 && last_index > players[i].last_period)
+            players[i].rd = glicko2_idle_rd(players[i].rd, players[i].volatility, last_index - players[i].last_period);
+    }
+    rated_until = (long)origin + (long)(last_index + 1) * opts.period;
+
+    free(touched), free(entries), free(out), free(fill);
+    return true;
+}
+
+static int new_rating(const player_t* p) {
+    return (int)(p->rating + (p->rating >= 0 ? 0.5 : -0.5));
+}
+
+static bool write_report(const char* path) {
+    FILE* f = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    fprintf(f, "user_id\tgames\told_rating\trating\trd\tvolatility\n");
+    for (int i = 1; i < player_capacity; i++) {
+        const player_t* p = &players[i];
+        if (!p->known && p->games == 0)
+            continue;
+        if (p->known)
+            fprintf(f, "%d\t%d\t%d\t%d", i, p->games, p->old_rating, new_rating(p));
+        else
+            fprintf(f, "%d\t%d\t-\t%d", i, p->games, new_rating(p));
+        if (opts.system == SYSTEM_GLICKO2)
+            fprintf(f, "\t%.1f\t%.6f\n", p->rd, p->volatility);
+        else
+            fprintf(f, "\t-\t-\n");
+    }
+    if (f != stdout)
+        fclose(f);
+    return true;
+}
+
+/* Only users read from Users are written, and only when the replay changes their rating or, under Glicko-2, rated
+ * them at all; a server running Glicko-2 picks up from rated_until */
+static bool apply_ratings(void) {
+    db_rating_update_t* updates = malloc((size_t)player_capacity * sizeof(db_rating_update_t));
+    if (!updates)
+        return false;
+    int count = 0;
+    for (int i = 1; i < player_capacity; i++) {
+        const player_t* p = &players[i];
+        bool glicko2 = opts.system == SYSTEM_GLICKO2 && p->games > 0;
+        if (p->known && (glicko2 || new_rating(p) != p->old_rating))
+            updates[count++] = (db_rating_update_t){i, p->old_rating, new_rating(p), glicko2 ? p->rd : 0,
+                                                    p->volatility, rated_until};
+    }
+
+    double start = now_ms();
+    int applied = db_update_ratings(updates, count);
+    free(updates);
+    if (applied < 0) {
+        fprintf(stderr, "Writing ratings failed\n");
+        return false;
+    }
+    fprintf(stderr, "%d ratings written in %.0f ms\n", applied, now_ms() - start);
+    if (applied < count)
+        fprintf(stderr, "%d skipped because the server changed them meanwhile; run again\n", count - applied);
+    return true;
+}
+
+/* Admin messages are answered on loopback only */
+static bool request_reload(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("reload");
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+
+    const char* request = "{\"type\":\"reload_ratings\",\"seq\":1,\"payload\":{}}\n";
+    char reply[512];
+    ssize_t n = write(fd, request, strlen(request)) < 0 ? -1 : read(fd, reply, sizeof(reply) - 1);
+    close(fd);
+    if (n <= 0) {
+        fprintf(stderr, "reload: no reply from port %d\n", port);
+        return false;
+    }
+    reply[n] = '\0';
+    fprintf(stderr, "reload: %s", reply);
+    return strstr(reply, "\"success\":true") != NULL;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s (--db <spec> | --synthetic games) [options]\n", prog);
+    fprintf(stderr, "  --db         read rated games from Matches through a storage backend, e.g. \"odbc:DSN=...\"\n");
+    fprintf(stderr, "  --synthetic  replay this many generated games instead (timing runs)\n");
+    fprintf(stderr, "  -P           players in the generated games (default 10000)\n");
+    fprintf(stderr, "  -s           elo or glicko2 (default glicko2)\n");
+    fprintf(stderr, "  -k           Elo K factor (default %d)\n", DEFAULT_K_FACTOR);
+    fprintf(stderr, "  -p           Glicko-2 rating period in seconds (default %d)\n", DEFAULT_PERIOD);
+    fprintf(stderr, "  -t           Glicko-2 tau (default %.1f)\n", GLICKO2_TAU);
+    fprintf(stderr, "  -j           worker threads for Glicko-2 periods (default: online cpus)\n");
+    fprintf(stderr, "  -o           write the report as TSV to this file (- for stdout)\n");
+    fprintf(stderr, "  --apply      write the new ratings to Users\n");
+    fprintf(stderr, "  --reload     then ask the server on 127.0.0.1:<port> to reload its leaderboard\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* db_spec = NULL;
+    const char* report = NULL;
+    long synthetic = 0;
+    int synthetic_players = 10000;
+    bool apply = false;
+    int reload_port = 0;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    opts.threads = cpus > 0 ? (int)cpus : 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--db") == 0 && i + 1 < argc)
+            db_spec = argv[++i];
+        else if (strcmp(argv[i], "--synthetic") == 0 && i + 1 < argc)
+            synthetic = atol(argv[++i]);
+        else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc)
+            synthetic_players = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc && strcmp(argv[i + 1], "elo") == 0)
+            opts.system = SYSTEM_ELO, i++;
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc && strcmp(argv[i + 1], "glicko2") == 0)
+            opts.system = SYSTEM_GLICKO2, i++;
+        else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+            opts.k_factor = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+            opts.period = atol(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            opts.tau = atof(argv[++i]);
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            opts.threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            report = argv[++i];
+        else if (strcmp(argv[i], "--apply") == 0)
+            apply = true;
+        else if (strcmp(argv[i], "--reload") == 0 && i + 1 < argc)
+            reload_port = atoi(argv[++i]);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if ((!db_spec) == (synthetic <= 0) || (apply && !db_spec) || synthetic_players < 2 || opts.k_factor < 1 ||
+        opts.period < 1 || opts.tau <= 0 || opts.threads < 1 || opts.threads > 256) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    double start = now_ms();
+    if (db_spec) {
+        if (!db_init(db_spec)) {
+            fprintf(stderr, "Cannot open database %s\n", db_spec);
+            return 1;
+        }
+        size_t skipped = 0;
+        if (db_for_each_user(visit_user, NULL) < 0 || db_for_each_rated_match(0, visit_match, &skipped) < 0) {
+            fprintf(stderr, "Reading Users and Matches failed\n");
+            db_shutdown();
+            return 1;
+        }
+        if (skipped)
+            fprintf(stderr, "%zu games skipped (unknown result or player)\n", skipped);
+    } else if (!make_synthetic((size_t)synthetic, synthetic_players)) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    double loaded = now_ms();
+
+    if (opts.system == SYSTEM_ELO) {
+        replay_elo();
+    } else if (!replay_glicko2()) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    double replayed = now_ms();
+
+    fprintf(stderr, "%zu games read in %.0f ms, replayed under %s in %.0f ms (%.1f M games/s, %d threads)\n",
+            game_count, loaded - start, opts.system == SYSTEM_ELO ? "Elo" : "Glicko-2", replayed - loaded,
+            game_count / ((replayed - loaded) * 1000.0 + 1e-9), opts.system == SYSTEM_ELO ? 1 : opts.threads);
+
+    bool ok = !report || write_report(report);
+    if (ok && apply)
+        ok = apply_ratings() && (!reload_port || request_reload(reload_port));
+    if (db_spec)
+        db_shutdown();
+    return ok ? 0 : 1;
+}
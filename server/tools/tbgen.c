@@ -0,0 +1,365 @@
+#define _DEFAULT_SOURCE
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/board.h"
+#include "../include/tablebase.h"
+
+/*
+ * Endgame tablebase generator. Every table is solved by retrograde analysis in rounds: round 0 marks the
+ * unreachable positions and the ones where the side to move has no legal move (lost in xiangqi, stalemate
+ * included); round d then settles the positions lost or won in exactly d plies, a win as soon as one move
+ * reaches a loss in d - 1, a loss once every move reaches a win in at most d - 1. Captures lead into smaller
+ * tables, which are generated first and kept in memory. Each round splits the index range between all
+ * threads; a round only writes the value it is assigning and only reads the ones settled before it, so the
+ * threads need no locks.
+ *
+ *   bin/tbgen -d tablebases                  # the default set
+ *   bin/tbgen -d tablebases -j 8 KRKAA KHPK
+ */
+
+#define DEFAULT_DIR "."
+#define MAX_TABLES 128
+#define CHUNK 4096
+
+static const char* const default_tables[] = {"KRKAA", "KRKEE", "KRKH", "KRKC", "KHPK", "KCAK", "KPPK"};
+static const char type_letter[8] = {'.', 'K', 'A', 'E', 'H', 'R', 'C', 'P'};
+
+typedef struct {
+    tb_material_t material;
+    uint8_t* values;
+    int max_dtm;
+} table_t;
+
+static table_t tables[MAX_TABLES];
+static int table_count = 0;
+static int thread_count = 1;
+
+typedef struct {
+    table_t* table;
+    int dtm; /* 0 for the initial pass */
+    uint64_t next;
+    uint64_t changed;
+} round_t;
+
+static uint8_t load_value(const uint8_t* p) {
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+static table_t* find_table(uint32_t key) {
+    for (int i = 0; i < table_count; i++) {
+        if (tables[i].material.key == key)
+            return &tables[i];
+    }
+    return NULL;
+}
+
+/* Value of the position after a move, for the side then to move; captures are looked up in the smaller table */
+static uint8_t child_value(const table_t* table, const board_t* board, bool black, bool captured) {
+    if (!captured)
+        return load_value(&table->values[tb_index(&table->material, board, black, false)]);
+
+    tb_material_t material;
+    bool mirrored;
+    if (!tb_material_of(board, &material, &mirrored))
+        return TB_INVALID;
+    const table_t* sub = find_table(material.key);
+    uint64_t index = sub ? tb_index(&sub->material, board, black, mirrored) : TB_NO_INDEX;
+    return index == TB_NO_INDEX ? TB_INVALID : sub->values[index];
+}
+
+static uint8_t initial_value(const board_t* board, bool black) {
+    int kings[2] = {-1, -1};
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        if (PIECE_TYPE(board->squares[sq]) == PIECE_KING)
+            kings[PIECE_IS_BLACK(board->squares[sq])] = sq;
+    }
+    /* The side that just moved cannot have left its general attacked, facing generals included */
+    if (board_king_attacked(board, kings[!black], !black))
+        return TB_INVALID;
+
+    board_move_t moves[BOARD_MAX_MOVES];
+    return board_generate_moves(board, black, moves) == 0 ? 1 : 0;
+}
+
+/* Whether an unsettled position is won (odd dtm) or lost (even dtm) in exactly dtm plies */
+static bool settles(const table_t* table, const board_t* board, bool black, int dtm) {
+    board_move_t moves[BOARD_MAX_MOVES];
+    int count = board_generate_moves(board, black, moves);
+    bool win_round = dtm % 2 == 1;
+
+    for (int i = 0; i < count; i++) {
+        board_t child = *board;
+        bool captured = board_apply(&child, moves[i].from, moves[i].to) != PIECE_NONE;
+        uint8_t value = child_value(table, &child, !black, captured);
+        if (win_round) {
+            if (value == dtm)
+                return true;
+        } else if (value == TB_DRAW || value == TB_INVALID || value % 2 == 1 || value > dtm) {
+            return false;
+        }
+    }
+    return !win_round;
+}
+
+static void* round_worker(void* arg) {
+    round_t* round = arg;
+    table_t* table = round->table;
+    uint64_t size = table->material.size;
+    uint64_t changed = 0;
+
+    for (;;) {
+        uint64_t start = __atomic_fetch_add(&round->next, CHUNK, __ATOMIC_RELAXED);
+        if (start >= size)
+            break;
+        uint64_t end = start + CHUNK < size ? start + CHUNK : size;
+
+        for (uint64_t index = start; index < end; index++) {
+            board_t board;
+            bool black;
+            uint8_t value;
+            if (round->dtm == 0) {
+                value = tb_decode(&table->material, index, &board, &black) ? initial_value(&board, black) : TB_INVALID;
+            } else {
+                if (load_value(&table->values[index]) != TB_DRAW)
+                    continue;
+                tb_decode(&table->material, index, &board, &black);
+                if (!settles(table, &board, black, round->dtm))
+                    continue;
+                value = (uint8_t)(round->dtm + 1);
+            }
+            __atomic_store_n(&table->values[index], value, __ATOMIC_RELAXED);
+            changed += value != TB_DRAW && value != TB_INVALID;
+        }
+    }
+
+    __atomic_fetch_add(&round->changed, changed, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+static uint64_t run_round(table_t* table, int dtm) {
+    round_t round = {.table = table, .dtm = dtm, .next = 0, .changed = 0};
+    pthread_t threads[256];
+    int started = 0;
+    for (int i = 1; i < thread_count && started < 256; i++) {
+        if (pthread_create(&threads[started], NULL, round_worker, &round) == 0)
+            started++;
+    }
+    round_worker(&round);
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    return round.changed;
+}
+
+static table_t* generate(const tb_material_t* material);
+
+/* Tables reached by capturing each piece other than the generals; returns the longest mate among them */
+static int generate_captures(const tb_material_t* material) {
+    int sub_max = 0;
+    for (int removed = 2; removed < material->piece_count; removed++) {
+        if (removed > 2 && material->pieces[removed] == material->pieces[removed - 1])
+            continue;
+
+        char name[16];
+        int len = 0;
+        for (int color = 0; color < 2; color++) {
+            name[len++] = 'K';
+            for (int i = 2; i < material->piece_count; i++) {
+                if (i != removed && PIECE_IS_BLACK(material->pieces[i]) == color)
+                    name[len++] = type_letter[PIECE_TYPE(material->pieces[i])];
+            }
+        }
+        name[len] = '\0';
+
+        tb_material_t sub;
+        table_t* table = tb_material_parse(name, &sub) ? generate(&sub) : NULL;
+        if (!table) {
+            fprintf(stderr, "%s: cannot build %s\n", material->name, name);
+            exit(1);
+        }
+        if (table->max_dtm > sub_max)
+            sub_max = table->max_dtm;
+    }
+    return sub_max;
+}
+
+static table_t* generate(const tb_material_t* material) {
+    table_t* table = find_table(material->key);
+    if (table)
+        return table;
+
+    int sub_max = generate_captures(material);
+    if (table_count == MAX_TABLES) {
+        fprintf(stderr, "Too many tables\n");
+        return NULL;
+    }
+
+    table = &tables[table_count];
+    table->material = *material;
+    table->max_dtm = 0;
+    table->values = malloc(material->size);
+    if (!table->values) {
+        fprintf(stderr, "%s: out of memory\n", material->name);
+        return NULL;
+    }
+    table_count++;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    run_round(table, 0);
+    int idle = 0, dtm;
+    for (dtm = 1; dtm <= TB_MAX_DTM; dtm++) {
+        if (run_round(table, dtm) > 0) {
+            table->max_dtm = dtm;
+            idle = 0;
+        } else if (++idle >= 2 && dtm > sub_max + 1) {
+            break;
+        }
+    }
+    if (dtm > TB_MAX_DTM)
+        fprintf(stderr, "%s: mates beyond %d plies are stored as draws\n", material->name, TB_MAX_DTM);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double seconds = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    uint64_t wins = 0, losses = 0, draws = 0;
+    for (uint64_t i = 0; i < material->size; i++) {
+        uint8_t v = table->values[i];
+        if (v == TB_DRAW)
+            draws++;
+        else if (v != TB_INVALID && (v - 1) % 2 == 1)
+            wins++;
+        else if (v != TB_INVALID)
+            losses++;
+    }
+    printf("%-6s %9llu positions: %llu won, %llu lost, %llu drawn for the side to move; longest mate %d plies "
+           "(%d rounds, %.1fs)\n",
+           material->name, (unsigned long long)material->size, (unsigned long long)wins,
+           (unsigned long long)losses, (unsigned long long)draws, table->max_dtm, dtm, seconds);
+    return table;
+}
+
+/* Block-wise run-length encoding; unreachable positions take the previous value so they never break a run */
+static bool write_table(const table_t* table, const char* dir) {
+    const tb_material_t* material = &table->material;
+    uint32_t block_count = (uint32_t)((material->size + TB_BLOCK_SIZE - 1) / TB_BLOCK_SIZE);
+    uint32_t* offsets = malloc(((size_t)block_count + 1) * sizeof(uint32_t));
+    uint8_t* data = malloc(material->size * 2);
+    if (!offsets || !data) {
+        free(offsets);
+        free(data);
+        return false;
+    }
+
+    uint32_t at = 0;
+    uint8_t previous = TB_DRAW;
+    for (uint32_t block = 0; block < block_count; block++) {
+        offsets[block] = at;
+        uint64_t start = (uint64_t)block * TB_BLOCK_SIZE;
+        uint64_t end = start + TB_BLOCK_SIZE < material->size ? start + TB_BLOCK_SIZE : material->size;
+        for (uint64_t i = start; i < end; i++) {
+            uint8_t value = table->values[i] == TB_INVALID ? previous : table->values[i];
+            if (i > start && data[at - 1] == value && data[at - 2] < 255) {
+                data[at - 2]++;
+            } else {
+                data[at++] = 1;
+                data[at++] = value;
+            }
+            previous = value;
+        }
+    }
+    offsets[block_count] = at;
+
+    tb_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TB_MAGIC, sizeof(header.magic));
+    header.version = TB_VERSION;
+    header.material_key = material->key;
+    memcpy(header.name, material->name, sizeof(header.name));
+    header.entry_count = material->size;
+    header.block_size = TB_BLOCK_SIZE;
+    header.block_count = block_count;
+    header.max_dtm = (uint32_t)table->max_dtm;
+
+    char path[4096];
+    int path_len = snprintf(path, sizeof(path), "%s/%s%s", dir, material->name, TB_FILE_SUFFIX);
+    FILE* out = path_len < (int)sizeof(path) ? fopen(path, "wb") : NULL;
+    bool ok = out != NULL;
+    if (ok) {
+        fwrite(&header, sizeof(header), 1, out);
+        fwrite(offsets, sizeof(uint32_t), (size_t)block_count + 1, out);
+        fwrite(data, 1, at, out);
+        ok = !ferror(out);
+        ok = fclose(out) == 0 && ok;
+    }
+    if (ok)
+        printf("%s: %u KB (%.1f%% of raw)\n", path, (unsigned)((sizeof(header) + (block_count + 1) * 4 + at) / 1024),
+               100.0 * at / (double)material->size);
+    else
+        fprintf(stderr, "Cannot write %s\n", path);
+
+    free(offsets);
+    free(data);
+    return ok;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-d dir] [-j threads] [material...]\n", prog);
+    fprintf(stderr, "  -d     output directory (default %s)\n", DEFAULT_DIR);
+    fprintf(stderr, "  -j     worker threads (default: online cpus)\n");
+    fprintf(stderr, "  material names like KRKAA, at most %d pieces besides the generals; tables for the\n",
+            TB_MAX_EXTRA);
+    fprintf(stderr, "  positions after captures are built and written too\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* dir = DEFAULT_DIR;
+    const char* names[MAX_TABLES];
+    int name_count = 0;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    thread_count = cpus > 0 ? (int)cpus : 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            dir = argv[++i];
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            thread_count = atoi(argv[++i]);
+        else if (argv[i][0] != '-' && name_count < MAX_TABLES)
+            names[name_count++] = argv[i];
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (thread_count < 1 || thread_count > 256) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (name_count == 0) {
+        for (size_t i = 0; i < sizeof(default_tables) / sizeof(default_tables[0]); i++)
+            names[name_count++] = default_tables[i];
+    }
+
+    for (int i = 0; i < name_count; i++) {
+        tb_material_t material;
+        if (!tb_material_parse(names[i], &material)) {
+            fprintf(stderr, "%s: not a material name with at most %d extra pieces\n", names[i], TB_MAX_EXTRA);
+            return 1;
+        }
+        if (!generate(&material))
+            return 1;
+    }
+
+    for (int i = 0; i < table_count; i++) {
+        if (!write_table(&tables[i], dir))
+            return 1;
+    }
+    return 0;
+}